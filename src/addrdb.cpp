@@ -18,15 +18,27 @@
 
 namespace {
 
+/** Header of the peers.dat journal, which ties it to the snapshot it applies to */
+struct AddrJournalHeader {
+    //! checksum of that peers.dat
+    uint256 snapshot_hash;
+    //! CAddrMan::GetAsmapVersion() of the address manager the journal was written for
+    uint256 asmap_version;
+
+    SERIALIZE_METHODS(AddrJournalHeader, obj) { READWRITE(obj.snapshot_hash, obj.asmap_version); }
+};
+
 template <typename Stream, typename Data>
-bool SerializeDB(Stream& stream, const Data& data)
+bool SerializeDB(Stream& stream, const Data& data, uint256* checksum = nullptr)
 {
     // Write and commit header, data
     try {
         CHashWriter hasher(SER_DISK, CLIENT_VERSION);
         stream << Params().MessageStart() << data;
         hasher << Params().MessageStart() << data;
-        stream << hasher.GetHash();
+        const uint256 hash = hasher.GetHash();
+        stream << hash;
+        if (checksum) *checksum = hash;
     } catch (const std::exception& e) {
         return error("%s: Serialize or I/O error - %s", __func__, e.what());
     }
@@ -35,7 +47,7 @@ bool SerializeDB(Stream& stream, const Data& data)
 }
 
 template <typename Data>
-bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data)
+bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data, uint256* checksum = nullptr)
 {
     // Generate random temporary filename
     uint16_t randv = 0;
@@ -53,7 +65,7 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
     }
 
     // Serialize
-    if (!SerializeDB(fileout, data)) {
+    if (!SerializeDB(fileout, data, checksum)) {
         fileout.fclose();
         remove(pathTmp);
         return false;
@@ -75,7 +87,7 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
 }
 
 template <typename Stream, typename Data>
-bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
+bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true, uint256* checksum = nullptr)
 {
     try {
         CHashVerifier<Stream> verifier(&stream);
@@ -96,6 +108,7 @@ bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
             if (hashTmp != verifier.GetHash()) {
                 return error("%s: Checksum mismatch, data corrupted", __func__);
             }
+            if (checksum) *checksum = hashTmp;
         }
     }
     catch (const std::exception& e) {
@@ -106,7 +119,7 @@ bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
 }
 
 template <typename Data>
-bool DeserializeFileDB(const fs::path& path, Data& data)
+bool DeserializeFileDB(const fs::path& path, Data& data, uint256* checksum = nullptr)
 {
     // open input file, and associate with CAutoFile
     FILE *file = fsbridge::fopen(path, "rb");
@@ -114,7 +127,32 @@ bool DeserializeFileDB(const fs::path& path, Data& data)
     if (filein.IsNull())
         return error("%s: Failed to open file %s", __func__, path.string());
 
-    return DeserializeDB(filein, data);
+    return DeserializeDB(filein, data, true, checksum);
+}
+
+//! Size of a file, or -1 if it cannot be determined
+int64_t FileSize(FILE* file)
+{
+    if (fseek(file, 0, SEEK_END) != 0) return -1;
+    const int64_t size = ftell(file);
+    if (fseek(file, 0, SEEK_SET) != 0) return -1;
+    return size;
+}
+
+//! Read the checksum at the end of a file written by SerializeFileDB, and its size
+bool ReadFileChecksum(const fs::path& path, uint256& checksum, int64_t& size)
+{
+    FILE* file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) return false;
+    size = FileSize(filein.Get());
+    if (size < (int64_t)sizeof(checksum) || fseek(filein.Get(), -(long)sizeof(checksum), SEEK_END) != 0) return false;
+    try {
+        filein >> checksum;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
 }
 
 }
@@ -136,16 +174,100 @@ bool CBanDB::Read(banmap_t& banSet)
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
+    m_journal_path = GetDataDir() / "peers_journal.dat";
 }
 
-bool CAddrDB::Write(const CAddrMan& addr)
+bool CAddrDB::Write(CAddrMan& addr)
 {
-    return SerializeFileDB("peers", pathAddr, addr);
+    // Changes made from here on end up in the snapshot, the next journal record, or both
+    addr.ClearChanges();
+    uint256 snapshot_hash;
+    if (!SerializeFileDB("peers", pathAddr, addr, &snapshot_hash)) {
+        // The journal might still match peers.dat, but misses the cleared changes
+        fs::remove(m_journal_path);
+        return false;
+    }
+    // A journal left behind by a failure here belongs to the old peers.dat and is ignored
+    return SerializeFileDB("peers_journal", m_journal_path, AddrJournalHeader{snapshot_hash, addr.GetAsmapVersion()});
+}
+
+bool CAddrDB::Update(CAddrMan& addr)
+{
+    FILE* file = fsbridge::fopen(m_journal_path, "rb");
+    CAutoFile journal(file, SER_DISK, CLIENT_VERSION);
+    AddrJournalHeader header;
+    uint256 snapshot_hash;
+    int64_t snapshot_size;
+    if (journal.IsNull() || !ReadFileChecksum(pathAddr, snapshot_hash, snapshot_size)) {
+        return Write(addr);
+    }
+    const int64_t journal_size = FileSize(journal.Get());
+    if (!DeserializeDB(journal, header) || header.snapshot_hash != snapshot_hash ||
+        header.asmap_version != addr.GetAsmapVersion() || journal_size < 0) {
+        return Write(addr);
+    }
+    journal.fclose();
+    // Compact once replaying the journal takes longer than reading a fresh snapshot would
+    if (journal_size > snapshot_size) {
+        return Write(addr);
+    }
+
+    const CAddrManChanges changes = addr.TakeChanges();
+    if (changes.empty()) return true;
+
+    file = fsbridge::fopen(m_journal_path, "ab");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull() || !SerializeDB(fileout, changes) || !FileCommit(fileout.Get())) {
+        fileout.fclose();
+        // The changes are no longer tracked by addr, so only a new snapshot has them
+        LogPrintf("%s: Failed to append to %s, writing peers.dat instead\n", __func__, m_journal_path.string());
+        return Write(addr);
+    }
+    return true;
 }
 
 bool CAddrDB::Read(CAddrMan& addr)
 {
-    return DeserializeFileDB(pathAddr, addr);
+    uint256 snapshot_hash;
+    if (!DeserializeFileDB(pathAddr, addr, &snapshot_hash)) {
+        return false;
+    }
+
+    FILE* file = fsbridge::fopen(m_journal_path, "rb");
+    CAutoFile journal(file, SER_DISK, CLIENT_VERSION);
+    if (!journal.IsNull()) {
+        const int64_t journal_size = FileSize(journal.Get());
+        AddrJournalHeader header;
+        if (journal_size < 0 || !DeserializeDB(journal, header)) {
+            LogPrintf("Ignoring unreadable %s\n", m_journal_path.filename().string());
+        } else if (header.snapshot_hash != snapshot_hash) {
+            LogPrintf("Ignoring %s, which belongs to an earlier peers.dat\n", m_journal_path.filename().string());
+        } else {
+            const bool bucketing_unchanged = header.asmap_version == addr.GetAsmapVersion();
+            int records = 0;
+            int64_t good_size = ftell(journal.Get());
+            while (good_size < journal_size) {
+                CAddrManChanges changes;
+                if (!DeserializeDB(journal, changes)) break;
+                addr.ApplyChanges(changes, bucketing_unchanged);
+                records++;
+                good_size = ftell(journal.Get());
+            }
+            LogPrint(BCLog::ADDRMAN, "Applied %d records of %s\n", records, m_journal_path.filename().string());
+            journal.fclose();
+            if (good_size < journal_size) {
+                // Drop a record cut short by a crash while appending, so that new records can follow the good ones
+                LogPrintf("Truncating %s after %d records\n", m_journal_path.filename().string(), records);
+                try {
+                    fs::resize_file(m_journal_path, good_size);
+                } catch (const fs::filesystem_error& e) {
+                    LogPrintf("Failed to truncate %s: %s\n", m_journal_path.filename().string(), e.what());
+                }
+            }
+        }
+    }
+    addr.ClearChanges();
+    return true;
 }
 
 bool CAddrDB::Read(CAddrMan& addr, CDataStream& ssPeers)
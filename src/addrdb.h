@@ -50,14 +50,25 @@ public:
     }
 };
 
-/** Access to the (IP) address database (peers.dat) */
+/**
+ * Access to the (IP) address database (peers.dat)
+ *
+ * peers.dat holds a snapshot of the address manager. Changes made after it was
+ * written are appended to peers_journal.dat, and folded into a new snapshot once
+ * the journal outgrows it.
+ */
 class CAddrDB
 {
 private:
     fs::path pathAddr;
+    fs::path m_journal_path;
 public:
     CAddrDB();
-    bool Write(const CAddrMan& addr);
+    //! Write a snapshot of addr and start an empty journal
+    bool Write(CAddrMan& addr);
+    //! Append the changes to addr to the journal, or Write() if it is missing, stale or too large
+    bool Update(CAddrMan& addr);
+    //! Read the snapshot and apply the journal
     bool Read(CAddrMan& addr);
     static bool Read(CAddrMan& addr, CDataStream& ssPeers);
 };
@@ -9,7 +9,9 @@
 #include <logging.h>
 #include <serialize.h>
 
-int CAddrInfo::GetTriedBucket(const uint256& nKey, const std::vector<bool> &asmap) const
+#include <unordered_map>
+
+int CAddrInfo::GetTriedBucket(const uint256& nKey, const ASMap& asmap) const
 {
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetCheapHash();
     uint64_t hash2 = (CHashWriter(SER_GETHASH, 0) << nKey << GetGroup(asmap) << (hash1 % ADDRMAN_TRIED_BUCKETS_PER_GROUP)).GetCheapHash();
@@ -19,7 +21,7 @@ int CAddrInfo::GetTriedBucket(const uint256& nKey, const std::vector<bool> &asma
     return tried_bucket;
 }
 
-int CAddrInfo::GetNewBucket(const uint256& nKey, const CNetAddr& src, const std::vector<bool> &asmap) const
+int CAddrInfo::GetNewBucket(const uint256& nKey, const CNetAddr& src, const ASMap& asmap) const
 {
     std::vector<unsigned char> vchSourceGroupKey = src.GetGroup(asmap);
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetGroup(asmap) << vchSourceGroupKey).GetCheapHash();
@@ -71,29 +73,120 @@ double CAddrInfo::GetChance(int64_t nNow) const
     return fChance;
 }
 
+bool CAddrMan::IsValidId(int nId) const
+{
+    return nId >= 0 && (size_t)nId < m_infos.size() && m_infos[nId].nRandomPos != -1;
+}
+
+size_t CAddrMan::IndexSlot(const CNetAddr& addr) const
+{
+    return m_addr_hasher(addr) & (m_addr_index.size() - 1);
+}
+
+void CAddrMan::IndexInsert(int nId)
+{
+    // Keep the table at most half full so that probe sequences stay short
+    if (vRandom.size() * 2 > m_addr_index.size()) {
+        m_addr_index.assign(std::max<size_t>(64, m_addr_index.size() * 2), -1);
+        for (int nIdOld : vRandom) {
+            size_t slot = IndexSlot(m_infos[nIdOld]);
+            while (m_addr_index[slot] != -1) {
+                slot = (slot + 1) & (m_addr_index.size() - 1);
+            }
+            m_addr_index[slot] = nIdOld;
+        }
+        return;
+    }
+    size_t slot = IndexSlot(m_infos[nId]);
+    while (m_addr_index[slot] != -1) {
+        slot = (slot + 1) & (m_addr_index.size() - 1);
+    }
+    m_addr_index[slot] = nId;
+}
+
+void CAddrMan::IndexErase(int nId)
+{
+    const size_t mask = m_addr_index.size() - 1;
+    size_t slot = IndexSlot(m_infos[nId]);
+    while (m_addr_index[slot] != nId) {
+        slot = (slot + 1) & mask;
+    }
+    // Shift later entries of the probe sequence back into the gap, so that no
+    // lookup stops early at it.
+    for (size_t next = (slot + 1) & mask; m_addr_index[next] != -1; next = (next + 1) & mask) {
+        const size_t home = IndexSlot(m_infos[m_addr_index[next]]);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            m_addr_index[slot] = m_addr_index[next];
+            slot = next;
+        }
+    }
+    m_addr_index[slot] = -1;
+}
+
+void CAddrMan::MarkDirty(int nId)
+{
+    if ((size_t)nId >= m_dirty_ids.size()) {
+        m_dirty_ids.resize(m_infos.size());
+    }
+    m_dirty_ids[nId] = true;
+}
+
+void CAddrMan::SetNew(int nUBucket, int nUBucketPos, int nId)
+{
+    vvNew[nUBucket][nUBucketPos] = nId;
+    m_dirty_positions[nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos] = true;
+    if (nId != -1) MarkDirty(nId);
+}
+
+void CAddrMan::SetTried(int nKBucket, int nKBucketPos, int nId)
+{
+    vvTried[nKBucket][nKBucketPos] = nId;
+    m_dirty_positions[ADDRMAN_NEW_POSITION_COUNT + nKBucket * ADDRMAN_BUCKET_SIZE + nKBucketPos] = true;
+    if (nId != -1) MarkDirty(nId);
+}
+
+int& CAddrMan::AtPosition(int position)
+{
+    if (position < ADDRMAN_NEW_POSITION_COUNT) {
+        return vvNew[position / ADDRMAN_BUCKET_SIZE][position % ADDRMAN_BUCKET_SIZE];
+    }
+    position -= ADDRMAN_NEW_POSITION_COUNT;
+    return vvTried[position / ADDRMAN_BUCKET_SIZE][position % ADDRMAN_BUCKET_SIZE];
+}
+
 CAddrInfo* CAddrMan::Find(const CNetAddr& addr, int* pnId)
 {
-    std::map<CNetAddr, int>::iterator it = mapAddr.find(addr);
-    if (it == mapAddr.end())
+    if (m_addr_index.empty())
         return nullptr;
-    if (pnId)
-        *pnId = (*it).second;
-    std::map<int, CAddrInfo>::iterator it2 = mapInfo.find((*it).second);
-    if (it2 != mapInfo.end())
-        return &(*it2).second;
+    for (size_t slot = IndexSlot(addr); m_addr_index[slot] != -1; slot = (slot + 1) & (m_addr_index.size() - 1)) {
+        const int nId = m_addr_index[slot];
+        if (static_cast<const CNetAddr&>(m_infos[nId]) == addr) {
+            if (pnId)
+                *pnId = nId;
+            return &m_infos[nId];
+        }
+    }
     return nullptr;
 }
 
 CAddrInfo* CAddrMan::Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId)
 {
-    int nId = nIdCount++;
-    mapInfo[nId] = CAddrInfo(addr, addrSource);
-    mapAddr[addr] = nId;
-    mapInfo[nId].nRandomPos = vRandom.size();
+    int nId;
+    if (m_free_ids.empty()) {
+        nId = m_infos.size();
+        m_infos.emplace_back(addr, addrSource);
+    } else {
+        nId = m_free_ids.back();
+        m_free_ids.pop_back();
+        m_infos[nId] = CAddrInfo(addr, addrSource);
+    }
+    m_infos[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
+    IndexInsert(nId);
+    MarkDirty(nId);
     if (pnId)
         *pnId = nId;
-    return &mapInfo[nId];
+    return &m_infos[nId];
 }
 
 void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
@@ -106,11 +199,11 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
     int nId1 = vRandom[nRndPos1];
     int nId2 = vRandom[nRndPos2];
 
-    assert(mapInfo.count(nId1) == 1);
-    assert(mapInfo.count(nId2) == 1);
+    assert(IsValidId(nId1));
+    assert(IsValidId(nId2));
 
-    mapInfo[nId1].nRandomPos = nRndPos2;
-    mapInfo[nId2].nRandomPos = nRndPos1;
+    m_infos[nId1].nRandomPos = nRndPos2;
+    m_infos[nId2].nRandomPos = nRndPos1;
 
     vRandom[nRndPos1] = nId2;
     vRandom[nRndPos2] = nId1;
@@ -118,15 +211,18 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
 
 void CAddrMan::Delete(int nId)
 {
-    assert(mapInfo.count(nId) != 0);
-    CAddrInfo& info = mapInfo[nId];
+    assert(IsValidId(nId));
+    CAddrInfo& info = m_infos[nId];
     assert(!info.fInTried);
     assert(info.nRefCount == 0);
 
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
-    mapAddr.erase(info);
-    mapInfo.erase(nId);
+    IndexErase(nId);
+    // The nId will be reused for another address
+    m_tried_collisions.erase(nId);
+    info = CAddrInfo();
+    m_free_ids.push_back(nId);
     nNew--;
 }
 
@@ -135,10 +231,10 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
     // if there is an entry in the specified bucket, delete it.
     if (vvNew[nUBucket][nUBucketPos] != -1) {
         int nIdDelete = vvNew[nUBucket][nUBucketPos];
-        CAddrInfo& infoDelete = mapInfo[nIdDelete];
+        CAddrInfo& infoDelete = m_infos[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        SetNew(nUBucket, nUBucketPos, -1);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -151,7 +247,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            SetNew(bucket, pos, -1);
             info.nRefCount--;
         }
     }
@@ -167,12 +263,12 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     if (vvTried[nKBucket][nKBucketPos] != -1) {
         // find an item to evict
         int nIdEvict = vvTried[nKBucket][nKBucketPos];
-        assert(mapInfo.count(nIdEvict) == 1);
-        CAddrInfo& infoOld = mapInfo[nIdEvict];
+        assert(IsValidId(nIdEvict));
+        CAddrInfo& infoOld = m_infos[nIdEvict];
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        SetTried(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -183,12 +279,12 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        SetNew(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    SetTried(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -215,6 +311,7 @@ void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime
     info.nLastSuccess = nTime;
     info.nLastTry = nTime;
     info.nAttempts = 0;
+    MarkDirty(nId);
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -246,8 +343,8 @@ void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime
     // Will moving this address into tried evict another entry?
     if (test_before_evict && (vvTried[tried_bucket][tried_bucket_pos] != -1)) {
         // Output the entry we'd be colliding with, for debugging purposes
-        auto colliding_entry = mapInfo.find(vvTried[tried_bucket][tried_bucket_pos]);
-        LogPrint(BCLog::ADDRMAN, "Collision inserting element into tried table (%s), moving %s to m_tried_collisions=%d\n", colliding_entry != mapInfo.end() ? colliding_entry->second.ToString() : "", addr.ToString(), m_tried_collisions.size());
+        const CAddrInfo& colliding_entry = m_infos[vvTried[tried_bucket][tried_bucket_pos]];
+        LogPrint(BCLog::ADDRMAN, "Collision inserting element into tried table (%s), moving %s to m_tried_collisions=%d\n", colliding_entry.ToString(), addr.ToString(), m_tried_collisions.size());
         if (m_tried_collisions.size() < ADDRMAN_SET_TRIED_COLLISION_SIZE) {
             m_tried_collisions.insert(nId);
         }
@@ -277,11 +374,16 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         // periodically update nTime
         bool fCurrentlyOnline = (GetAdjustedTime() - addr.nTime < 24 * 60 * 60);
         int64_t nUpdateInterval = (fCurrentlyOnline ? 60 * 60 : 24 * 60 * 60);
-        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty))
+        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty)) {
             pinfo->nTime = std::max((int64_t)0, addr.nTime - nTimePenalty);
+            MarkDirty(nId);
+        }
 
         // add services
-        pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
+        if ((pinfo->nServices | addr.nServices) != pinfo->nServices) {
+            pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
+            MarkDirty(nId);
+        }
 
         // do not update if no new information is present
         if (!addr.nTime || (pinfo->nTime && addr.nTime <= pinfo->nTime))
@@ -313,7 +415,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
         if (!fInsert) {
-            CAddrInfo& infoExisting = mapInfo[vvNew[nUBucket][nUBucketPos]];
+            CAddrInfo& infoExisting = m_infos[vvNew[nUBucket][nUBucketPos]];
             if (infoExisting.IsTerrible() || (infoExisting.nRefCount > 1 && pinfo->nRefCount == 0)) {
                 // Overwrite the existing new table entry.
                 fInsert = true;
@@ -322,7 +424,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            SetNew(nUBucket, nUBucketPos, nId);
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -334,7 +436,8 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
 
 void CAddrMan::Attempt_(const CService& addr, bool fCountFailure, int64_t nTime)
 {
-    CAddrInfo* pinfo = Find(addr);
+    int nId;
+    CAddrInfo* pinfo = Find(addr, &nId);
 
     // if not found, bail out
     if (!pinfo)
@@ -351,6 +454,7 @@ void CAddrMan::Attempt_(const CService& addr, bool fCountFailure, int64_t nTime)
     if (fCountFailure && info.nLastCountAttempt < nLastGood) {
         info.nLastCountAttempt = nTime;
         info.nAttempts++;
+        MarkDirty(nId);
     }
 }
 
@@ -375,8 +479,8 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
                 nKBucketPos = (nKBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
             }
             int nId = vvTried[nKBucket][nKBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            assert(IsValidId(nId));
+            CAddrInfo& info = m_infos[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
@@ -392,8 +496,8 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
                 nUBucketPos = (nUBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
             }
             int nId = vvNew[nUBucket][nUBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            assert(IsValidId(nId));
+            CAddrInfo& info = m_infos[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
@@ -410,9 +514,13 @@ int CAddrMan::Check_()
     if (vRandom.size() != (size_t)(nTried + nNew))
         return -7;
 
-    for (const auto& entry : mapInfo) {
-        int n = entry.first;
-        const CAddrInfo& info = entry.second;
+    if (m_infos.size() != vRandom.size() + m_free_ids.size())
+        return -20;
+
+    for (int n = 0; n < (int)m_infos.size(); n++) {
+        if (!IsValidId(n))
+            continue;
+        const CAddrInfo& info = m_infos[n];
         if (info.fInTried) {
             if (!info.nLastSuccess)
                 return -1;
@@ -426,7 +534,8 @@ int CAddrMan::Check_()
                 return -4;
             mapNew[n] = info.nRefCount;
         }
-        if (mapAddr[info] != n)
+        int nIdFound = -1;
+        if (Find(info, &nIdFound) == nullptr || nIdFound != n)
             return -5;
         if (info.nRandomPos < 0 || (size_t)info.nRandomPos >= vRandom.size() || vRandom[info.nRandomPos] != n)
             return -14;
@@ -446,9 +555,9 @@ int CAddrMan::Check_()
              if (vvTried[n][i] != -1) {
                  if (!setTried.count(vvTried[n][i]))
                      return -11;
-                 if (mapInfo[vvTried[n][i]].GetTriedBucket(nKey, m_asmap) != n)
+                 if (m_infos[vvTried[n][i]].GetTriedBucket(nKey, m_asmap) != n)
                      return -17;
-                 if (mapInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
+                 if (m_infos[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
                      return -18;
                  setTried.erase(vvTried[n][i]);
              }
@@ -460,7 +569,7 @@ int CAddrMan::Check_()
             if (vvNew[n][i] != -1) {
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
-                if (mapInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
+                if (m_infos[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
                     return -19;
                 if (--mapNew[vvNew[n][i]] == 0)
                     mapNew.erase(vvNew[n][i]);
@@ -489,16 +598,34 @@ void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr, size_t max_addresses, size
         nNodes = std::min(nNodes, max_addresses);
     }
 
-    // gather a list of random nodes, skipping those of low quality
-    for (unsigned int n = 0; n < vRandom.size(); n++) {
-        if (vAddr.size() >= nNodes)
-            break;
-
-        int nRndPos = insecure_rand.randrange(vRandom.size() - n) + n;
-        SwapRandom(n, nRndPos);
-        assert(mapInfo.count(vRandom[n]) == 1);
+    // Hand out consecutive parts of a shuffled snapshot of all nIds, so that a
+    // request costs O(nNodes) instead of a partial shuffle of vRandom. Entries
+    // added since the snapshot was taken show up once it is used up, and nIds of
+    // deleted entries are skipped (or refer to whichever entry reused them).
+    bool fFresh = false;
+    if (m_addr_snapshot.size() - m_addr_snapshot_pos < nNodes) {
+        m_addr_snapshot = vRandom;
+        Shuffle(m_addr_snapshot.begin(), m_addr_snapshot.end(), insecure_rand);
+        m_addr_snapshot_pos = 0;
+        fFresh = true;
+    }
+    while (vAddr.size() < nNodes) {
+        if (m_addr_snapshot_pos == m_addr_snapshot.size()) {
+            // Too many were skipped; start over on a fresh snapshot, which
+            // must not return an address twice either.
+            if (fFresh)
+                break;
+            m_addr_snapshot = vRandom;
+            Shuffle(m_addr_snapshot.begin(), m_addr_snapshot.end(), insecure_rand);
+            m_addr_snapshot_pos = 0;
+            fFresh = true;
+            vAddr.clear();
+        }
+        const int nId = m_addr_snapshot[m_addr_snapshot_pos++];
+        if (!IsValidId(nId))
+            continue;
 
-        const CAddrInfo& ai = mapInfo[vRandom[n]];
+        const CAddrInfo& ai = m_infos[nId];
         if (!ai.IsTerrible())
             vAddr.push_back(ai);
     }
@@ -506,7 +633,8 @@ void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr, size_t max_addresses, size
 
 void CAddrMan::Connected_(const CService& addr, int64_t nTime)
 {
-    CAddrInfo* pinfo = Find(addr);
+    int nId;
+    CAddrInfo* pinfo = Find(addr, &nId);
 
     // if not found, bail out
     if (!pinfo)
@@ -520,13 +648,16 @@ void CAddrMan::Connected_(const CService& addr, int64_t nTime)
 
     // update info
     int64_t nUpdateInterval = 20 * 60;
-    if (nTime - info.nTime > nUpdateInterval)
+    if (nTime - info.nTime > nUpdateInterval) {
         info.nTime = nTime;
+        MarkDirty(nId);
+    }
 }
 
 void CAddrMan::SetServices_(const CService& addr, ServiceFlags nServices)
 {
-    CAddrInfo* pinfo = Find(addr);
+    int nId;
+    CAddrInfo* pinfo = Find(addr, &nId);
 
     // if not found, bail out
     if (!pinfo)
@@ -540,6 +671,7 @@ void CAddrMan::SetServices_(const CService& addr, ServiceFlags nServices)
 
     // update info
     info.nServices = nServices;
+    MarkDirty(nId);
 }
 
 void CAddrMan::ResolveCollisions_()
@@ -549,11 +681,11 @@ void CAddrMan::ResolveCollisions_()
 
         bool erase_collision = false;
 
-        // If id_new not found in mapInfo remove it from m_tried_collisions
-        if (mapInfo.count(id_new) != 1) {
+        // If id_new no longer refers to an entry remove it from m_tried_collisions
+        if (!IsValidId(id_new)) {
             erase_collision = true;
         } else {
-            CAddrInfo& info_new = mapInfo[id_new];
+            CAddrInfo& info_new = m_infos[id_new];
 
             // Which tried bucket to move the entry to.
             int tried_bucket = info_new.GetTriedBucket(nKey, m_asmap);
@@ -564,7 +696,7 @@ void CAddrMan::ResolveCollisions_()
 
                 // Get the to-be-evicted address that is being tested
                 int id_old = vvTried[tried_bucket][tried_bucket_pos];
-                CAddrInfo& info_old = mapInfo[id_old];
+                CAddrInfo& info_old = m_infos[id_old];
 
                 // Has successfully connected in last X hours
                 if (GetAdjustedTime() - info_old.nLastSuccess < ADDRMAN_REPLACEMENT_HOURS*(60*60)) {
@@ -611,13 +743,13 @@ CAddrInfo CAddrMan::SelectTriedCollision_()
     std::advance(it, insecure_rand.randrange(m_tried_collisions.size()));
     int id_new = *it;
 
-    // If id_new not found in mapInfo remove it from m_tried_collisions
-    if (mapInfo.count(id_new) != 1) {
+    // If id_new no longer refers to an entry remove it from m_tried_collisions
+    if (!IsValidId(id_new)) {
         m_tried_collisions.erase(it);
         return CAddrInfo();
     }
 
-    CAddrInfo& newInfo = mapInfo[id_new];
+    CAddrInfo& newInfo = m_infos[id_new];
 
     // which tried bucket to move the entry to
     int tried_bucket = newInfo.GetTriedBucket(nKey, m_asmap);
@@ -625,7 +757,123 @@ CAddrInfo CAddrMan::SelectTriedCollision_()
 
     int id_old = vvTried[tried_bucket][tried_bucket_pos];
 
-    return mapInfo[id_old];
+    return id_old == -1 ? CAddrInfo() : m_infos[id_old];
+}
+
+CAddrManChanges CAddrMan::TakeChanges()
+{
+    LOCK(cs);
+    CAddrManChanges changes;
+    std::unordered_map<int, int32_t> entry_index;
+    auto add_entry = [&](int nId) {
+        auto inserted = entry_index.emplace(nId, changes.entries.size());
+        if (inserted.second) changes.entries.push_back(m_infos[nId]);
+        return inserted.first->second;
+    };
+    for (size_t n = 0; n < m_dirty_ids.size(); n++) {
+        if (m_dirty_ids[n] && IsValidId(n)) add_entry(n);
+    }
+    for (int position = 0; position < ADDRMAN_POSITION_COUNT; position++) {
+        if (!m_dirty_positions[position]) continue;
+        // Entries are marked when stored in a position, so this only adds any for consistency
+        const int nId = AtPosition(position);
+        changes.positions.emplace_back(position, nId == -1 ? -1 : add_entry(nId));
+    }
+    m_dirty_ids.clear();
+    m_dirty_positions.assign(ADDRMAN_POSITION_COUNT, false);
+    return changes;
+}
+
+void CAddrMan::ApplyChanges(const CAddrManChanges& changes, bool bucketing_unchanged)
+{
+    LOCK(cs);
+
+    // Entries that may have been left without a position
+    std::vector<int> touched;
+
+    std::vector<int> ids;
+    ids.reserve(changes.entries.size());
+    for (const CAddrInfo& entry : changes.entries) {
+        int nId;
+        CAddrInfo* pinfo = Find(entry, &nId);
+        if (!pinfo) {
+            pinfo = Create(entry, entry.source, &nId);
+        }
+        // Only the stored fields are taken over, table membership follows from the positions
+        static_cast<CAddress&>(*pinfo) = entry;
+        pinfo->source = entry.source;
+        pinfo->nLastSuccess = entry.nLastSuccess;
+        pinfo->nAttempts = entry.nAttempts;
+        ids.push_back(nId);
+        touched.push_back(nId);
+    }
+
+    if (bucketing_unchanged) {
+        // Empty all changed positions first, so that entries can move between them.
+        for (const auto& change : changes.positions) {
+            if (change.first < 0 || change.first >= ADDRMAN_POSITION_COUNT) continue;
+            int& nIdOld = AtPosition(change.first);
+            if (nIdOld == -1) continue;
+            if (change.first < ADDRMAN_NEW_POSITION_COUNT) {
+                m_infos[nIdOld].nRefCount--;
+            } else {
+                m_infos[nIdOld].fInTried = false;
+            }
+            touched.push_back(nIdOld);
+            nIdOld = -1;
+        }
+        for (const auto& change : changes.positions) {
+            if (change.first < 0 || change.first >= ADDRMAN_POSITION_COUNT) continue;
+            if (change.second < 0 || (size_t)change.second >= ids.size()) continue;
+            int& nIdAt = AtPosition(change.first);
+            const int nId = ids[change.second];
+            CAddrInfo& info = m_infos[nId];
+            if (nIdAt != -1 || info.fInTried) continue;
+            if (change.first < ADDRMAN_NEW_POSITION_COUNT) {
+                const int nUBucket = change.first / ADDRMAN_BUCKET_SIZE;
+                if (info.nRefCount == ADDRMAN_NEW_BUCKETS_PER_ADDRESS ||
+                    info.GetBucketPosition(nKey, true, nUBucket) != change.first % ADDRMAN_BUCKET_SIZE) continue;
+                info.nRefCount++;
+            } else {
+                const int nKBucket = (change.first - ADDRMAN_NEW_POSITION_COUNT) / ADDRMAN_BUCKET_SIZE;
+                if (info.nRefCount != 0 || info.GetTriedBucket(nKey, m_asmap) != nKBucket ||
+                    info.GetBucketPosition(nKey, false, nKBucket) != change.first % ADDRMAN_BUCKET_SIZE) continue;
+                info.fInTried = true;
+            }
+            nIdAt = nId;
+        }
+    }
+
+    // Entries without a position were deleted, unless their positions could not be
+    // used. Those get one based on their primary source, as in Unserialize().
+    for (int nId : touched) {
+        if (!IsValidId(nId)) continue;
+        CAddrInfo& info = m_infos[nId];
+        if (info.fInTried || info.nRefCount > 0) continue;
+        if (!bucketing_unchanged) {
+            const int nUBucket = info.GetNewBucket(nKey, m_asmap);
+            const int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
+            if (vvNew[nUBucket][nUBucketPos] == -1) {
+                vvNew[nUBucket][nUBucketPos] = nId;
+                info.nRefCount = 1;
+                continue;
+            }
+        }
+        Delete(nId);
+    }
+
+    // Recount, as the above did not keep track
+    nNew = 0;
+    nTried = 0;
+    for (int nId : vRandom) {
+        if (m_infos[nId].fInTried) {
+            nTried++;
+        } else {
+            nNew++;
+        }
+    }
+
+    Check();
 }
 
 std::vector<bool> CAddrMan::DecodeAsmap(fs::path path)
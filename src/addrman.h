@@ -14,15 +14,18 @@
 #include <sync.h>
 #include <timedata.h>
 #include <tinyformat.h>
+#include <util/asmap.h>
 #include <util/system.h>
 
 #include <fs.h>
 #include <hash.h>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <set>
 #include <stdint.h>
 #include <streams.h>
+#include <utility>
 #include <vector>
 
 /**
@@ -75,13 +78,13 @@ public:
     }
 
     //! Calculate in which "tried" bucket this entry belongs
-    int GetTriedBucket(const uint256 &nKey, const std::vector<bool> &asmap) const;
+    int GetTriedBucket(const uint256 &nKey, const ASMap& asmap) const;
 
     //! Calculate in which "new" bucket this entry belongs, given a certain source
-    int GetNewBucket(const uint256 &nKey, const CNetAddr& src, const std::vector<bool> &asmap) const;
+    int GetNewBucket(const uint256 &nKey, const CNetAddr& src, const ASMap& asmap) const;
 
     //! Calculate in which "new" bucket this entry belongs, using its default source
-    int GetNewBucket(const uint256 &nKey, const std::vector<bool> &asmap) const
+    int GetNewBucket(const uint256 &nKey, const ASMap& asmap) const
     {
         return GetNewBucket(nKey, source, asmap);
     }
@@ -96,10 +99,40 @@ public:
     double GetChance(int64_t nNow = GetAdjustedTime()) const;
 };
 
+/**
+ * Changes to the address tables since the last CAddrMan::TakeChanges(). CAddrDB
+ * appends these to the peers.dat journal instead of rewriting the whole file.
+ */
+struct CAddrManChanges
+{
+    //! Entries that were added or whose stored fields changed
+    std::vector<CAddrInfo> entries;
+
+    //! Changed bucket positions, as (position, index into entries or -1 if emptied).
+    //! Positions number the "new" buckets first and then the "tried" ones.
+    std::vector<std::pair<int32_t, int32_t>> positions;
+
+    bool empty() const { return entries.empty() && positions.empty(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s_) const
+    {
+        OverrideStream<Stream> s(&s_, s_.GetType(), s_.GetVersion() | ADDRV2_FORMAT);
+        s << entries << positions;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s_)
+    {
+        OverrideStream<Stream> s(&s_, s_.GetType(), s_.GetVersion() | ADDRV2_FORMAT);
+        s >> entries >> positions;
+    }
+};
+
 /** Stochastic address manager
  *
  * Design goals:
- *  * Keep the address tables in-memory, and asynchronously dump the entire table to peers.dat.
+ *  * Keep the address tables in-memory, and asynchronously persist them to peers.dat and its journal.
  *  * Make sure no (localized) attacker can fill the entire table with his nodes/addresses.
  *
  * To that end:
@@ -160,6 +193,10 @@ public:
 #define ADDRMAN_NEW_BUCKET_COUNT (1 << ADDRMAN_NEW_BUCKET_COUNT_LOG2)
 #define ADDRMAN_BUCKET_SIZE (1 << ADDRMAN_BUCKET_SIZE_LOG2)
 
+//! number of positions in all "new" buckets, and in all buckets, as numbered in CAddrManChanges
+#define ADDRMAN_NEW_POSITION_COUNT (ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE)
+#define ADDRMAN_POSITION_COUNT (ADDRMAN_NEW_POSITION_COUNT + ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE)
+
 //! the maximum number of tried addr collisions to store
 #define ADDRMAN_SET_TRIED_COLLISION_SIZE 10
 
@@ -199,18 +236,34 @@ private:
     //! @note Don't increment this. Increment `lowest_compatible` in `Serialize()` instead.
     static constexpr uint8_t INCOMPATIBILITY_BASE = 32;
 
-    //! last used nId
-    int nIdCount GUARDED_BY(cs);
+    //! information about all entries, indexed by nId. Slots of deleted entries have
+    //! nRandomPos -1 and are reused through m_free_ids.
+    std::vector<CAddrInfo> m_infos GUARDED_BY(cs);
+
+    //! nIds of deleted entries
+    std::vector<int> m_free_ids GUARDED_BY(cs);
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo GUARDED_BY(cs);
+    //! open addressing hash table of all nIds, keyed by network address, -1 in unused slots
+    std::vector<int> m_addr_index GUARDED_BY(cs);
 
-    //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr GUARDED_BY(cs);
+    //! salted hasher for m_addr_index
+    const CNetAddrHash m_addr_hasher{GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())};
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom GUARDED_BY(cs);
 
+    //! shuffled copy of vRandom that GetAddr_ answers from, to avoid reshuffling for every request
+    std::vector<int> m_addr_snapshot GUARDED_BY(cs);
+
+    //! position of the next unused nId in m_addr_snapshot
+    size_t m_addr_snapshot_pos GUARDED_BY(cs){0};
+
+    //! nIds whose stored fields changed since the last TakeChanges() (bits past the end are unset)
+    std::vector<bool> m_dirty_ids GUARDED_BY(cs);
+
+    //! bucket positions changed since the last TakeChanges(), numbered as in CAddrManChanges
+    std::vector<bool> m_dirty_positions GUARDED_BY(cs);
+
     // number of "tried" entries
     int nTried GUARDED_BY(cs);
 
@@ -236,6 +289,30 @@ protected:
     //! Source of random numbers for randomization in inner loops
     FastRandomContext insecure_rand;
 
+    //! Whether nId refers to an entry that has not been deleted.
+    bool IsValidId(int nId) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Slot of m_addr_index where the probe sequence for addr starts.
+    size_t IndexSlot(const CNetAddr& addr) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Add an entry to m_addr_index, growing it if needed. The entry must already be in vRandom.
+    void IndexInsert(int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Remove an entry from m_addr_index.
+    void IndexErase(int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Record that the stored fields of an entry changed.
+    void MarkDirty(int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Store nId (or -1) in a position of a "new" bucket, recording the change.
+    void SetNew(int nUBucket, int nUBucketPos, int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Store nId (or -1) in a position of a "tried" bucket, recording the change.
+    void SetTried(int nKBucket, int nKBucketPos, int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! The nId (or -1) in a position numbered as in CAddrManChanges.
+    int& AtPosition(int position) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int *pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -302,11 +379,21 @@ public:
     //
     // If a new asmap was provided, the existing records
     // would be re-bucketed accordingly.
-    std::vector<bool> m_asmap;
+    ASMap m_asmap;
 
     // Read asmap from provided binary file
     static std::vector<bool> DecodeAsmap(fs::path path);
 
+    //! Hash of the asmap used for bucketing, or null without one
+    uint256 GetAsmapVersion() const
+    {
+        uint256 asmap_version;
+        if (!m_asmap.empty()) {
+            asmap_version = SerializeHash(m_asmap.GetBits());
+        }
+        return asmap_version;
+    }
+
 
     /**
      * Serialized format.
@@ -335,7 +422,7 @@ public:
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
      *
-     * Notice that vvTried, mapAddr and vVector are never encoded explicitly;
+     * Notice that vvTried, m_addr_index and vRandom are never encoded explicitly;
      * they are instead reconstructed from the other information.
      *
      * vvNew is serialized, but only used if ADDRMAN_UNKNOWN_BUCKET_COUNT didn't change,
@@ -369,11 +456,11 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::vector<int> unk_ids(m_infos.size(), -1);
         int nIds = 0;
-        for (const auto& entry : mapInfo) {
-            mapUnkIds[entry.first] = nIds;
-            const CAddrInfo &info = entry.second;
+        for (size_t n = 0; n < m_infos.size(); n++) {
+            const CAddrInfo &info = m_infos[n];
+            unk_ids[n] = nIds;
             if (info.nRefCount) {
                 assert(nIds != nNew); // this means nNew was wrong, oh ow
                 s << info;
@@ -381,8 +468,7 @@ public:
             }
         }
         nIds = 0;
-        for (const auto& entry : mapInfo) {
-            const CAddrInfo &info = entry.second;
+        for (const CAddrInfo& info : m_infos) {
             if (info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
@@ -398,18 +484,14 @@ public:
             s << nSize;
             for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
                 if (vvNew[bucket][i] != -1) {
-                    int nIndex = mapUnkIds[vvNew[bucket][i]];
+                    int nIndex = unk_ids[vvNew[bucket][i]];
                     s << nIndex;
                 }
             }
         }
         // Store asmap version after bucket entries so that it
         // can be ignored by older clients for backward compatibility.
-        uint256 asmap_version;
-        if (m_asmap.size() != 0) {
-            asmap_version = SerializeHash(m_asmap);
-        }
-        s << asmap_version;
+        s << GetAsmapVersion();
     }
 
     template <typename Stream>
@@ -460,13 +542,13 @@ public:
 
         // Deserialize entries from the new table.
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            m_infos.emplace_back();
+            CAddrInfo &info = m_infos.back();
             s >> info;
-            mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
             vRandom.push_back(n);
+            IndexInsert(n);
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -476,13 +558,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey, m_asmap);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                const int nId = m_infos.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                m_infos.push_back(info);
+                IndexInsert(nId);
+                vvTried[nKBucket][nKBucketPos] = nId;
             } else {
                 nLost++;
             }
@@ -504,17 +586,14 @@ public:
             }
         }
 
-        uint256 supplied_asmap_version;
-        if (m_asmap.size() != 0) {
-            supplied_asmap_version = SerializeHash(m_asmap);
-        }
+        const uint256 supplied_asmap_version = GetAsmapVersion();
         uint256 serialized_asmap_version;
         if (format >= Format::V2_ASMAP) {
             s >> serialized_asmap_version;
         }
 
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = m_infos[n];
             int bucket = entryToBucket[n];
             int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
             if (format >= Format::V2_ASMAP && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 &&
@@ -537,13 +616,10 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (int n = 0; n < (int)m_infos.size(); n++) {
+            if (m_infos[n].fInTried == false && m_infos[n].nRefCount == 0) {
+                Delete(n);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -569,12 +645,16 @@ public:
             }
         }
 
-        nIdCount = 0;
         nTried = 0;
         nNew = 0;
         nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
-        mapInfo.clear();
-        mapAddr.clear();
+        m_infos.clear();
+        m_free_ids.clear();
+        m_addr_index.clear();
+        m_addr_snapshot.clear();
+        m_addr_snapshot_pos = 0;
+        m_dirty_ids.clear();
+        m_dirty_positions.assign(ADDRMAN_POSITION_COUNT, false);
     }
 
     CAddrMan()
@@ -721,6 +801,24 @@ public:
         Check();
     }
 
+    //! Return the changes since the last call, or since the tables were loaded or cleared, and forget them.
+    CAddrManChanges TakeChanges();
+
+    //! Forget the changes made so far, e.g. after writing a complete snapshot.
+    void ClearChanges()
+    {
+        LOCK(cs);
+        m_dirty_ids.clear();
+        m_dirty_positions.assign(ADDRMAN_POSITION_COUNT, false);
+    }
+
+    /**
+     * Apply changes returned by TakeChanges() on an address manager in the state they
+     * were taken from. If bucketing changed in between (a different asmap), the bucket
+     * positions are ignored and added entries are placed based on their primary source.
+     */
+    void ApplyChanges(const CAddrManChanges& changes, bool bucketing_unchanged);
+
 };
 
 #endif // BITCOIN_ADDRMAN_H
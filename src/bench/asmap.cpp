@@ -0,0 +1,81 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+#include <netaddress.h>
+#include <random.h>
+#include <util/asmap.h>
+
+#include <vector>
+
+static std::vector<bool> AsmapBits()
+{
+    std::vector<bool> bits;
+    for (uint8_t byte : benchmark::data::asmap) {
+        for (int bit = 0; bit < 8; ++bit) {
+            bits.push_back((byte >> bit) & 1);
+        }
+    }
+    return bits;
+}
+
+/** IPv4 addresses, half of them in the mapped 101.0.0.0/8 and 250.0.0.0/8 */
+static std::vector<CNetAddr> AsmapAddresses()
+{
+    FastRandomContext rng(true);
+    std::vector<CNetAddr> addrs;
+    for (int i = 0; i < 1000; ++i) {
+        in_addr ipv4;
+        uint32_t ip = rng.rand32();
+        if (i % 2) ip = (ip & 0x00ffffff) | (i % 4 == 1 ? 0x65000000 : 0xfa000000);
+        ipv4.s_addr = htonl(ip);
+        addrs.emplace_back(ipv4);
+    }
+    return addrs;
+}
+
+static void ASMapInterpret(benchmark::Bench& bench)
+{
+    const std::vector<bool> bits = AsmapBits();
+    std::vector<std::vector<bool>> ips;
+    for (const CNetAddr& addr : AsmapAddresses()) {
+        std::vector<bool> ip_bits(128);
+        for (int i = 0; i < 96; ++i) {
+            ip_bits[i] = (IPV4_IN_IPV6_PREFIX[i / 8] >> (7 - i % 8)) & 1;
+        }
+        const uint32_t ipv4 = addr.GetLinkedIPv4();
+        for (int i = 0; i < 32; ++i) {
+            ip_bits[96 + i] = (ipv4 >> (31 - i)) & 1;
+        }
+        ips.push_back(std::move(ip_bits));
+    }
+    size_t i = 0;
+    bench.run([&] {
+        ankerl::nanobench::doNotOptimizeAway(Interpret(bits, ips[i++ % ips.size()]));
+    });
+}
+
+static void ASMapLookup(benchmark::Bench& bench)
+{
+    const ASMap asmap(AsmapBits());
+    const std::vector<CNetAddr> addrs = AsmapAddresses();
+    size_t i = 0;
+    bench.run([&] {
+        ankerl::nanobench::doNotOptimizeAway(addrs[i++ % addrs.size()].GetMappedAS(asmap));
+    });
+}
+
+static void ASMapCompile(benchmark::Bench& bench)
+{
+    const std::vector<bool> bits = AsmapBits();
+    bench.run([&] {
+        ASMap asmap(bits);
+        ankerl::nanobench::doNotOptimizeAway(asmap.GetRangeCount());
+    });
+}
+
+BENCHMARK(ASMapInterpret);
+BENCHMARK(ASMapLookup);
+BENCHMARK(ASMapCompile);
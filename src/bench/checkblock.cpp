@@ -28,6 +28,21 @@ static void DeserializeBlockTest(benchmark::Bench& bench)
     });
 }
 
+//! Same as DeserializeBlockTest, with the transactions sharing a few allocations
+static void DeserializeBlockTxArenaTest(benchmark::Bench& bench)
+{
+    CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+
+    bench.unit("block").run([&] {
+        CBlock block;
+        stream >> Using<BlockTxArenaFormatter>(block);
+        bool rewound = stream.Rewind(benchmark::data::block413567.size());
+        assert(rewound);
+    });
+}
+
 static void DeserializeAndCheckBlockTest(benchmark::Bench& bench)
 {
     CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
@@ -50,4 +65,5 @@ static void DeserializeAndCheckBlockTest(benchmark::Bench& bench)
 }
 
 BENCHMARK(DeserializeBlockTest);
+BENCHMARK(DeserializeBlockTxArenaTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
@@ -7,6 +7,9 @@
 namespace benchmark {
 namespace data {
 
+#include <bench/data/asmap.raw.h>
+const std::vector<uint8_t> asmap{asmap_raw, asmap_raw + sizeof(asmap_raw) / sizeof(asmap_raw[0])};
+
 #include <bench/data/block413567.raw.h>
 const std::vector<uint8_t> block413567{block413567_raw, block413567_raw + sizeof(block413567_raw) / sizeof(block413567_raw[0])};
 
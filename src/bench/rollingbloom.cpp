@@ -5,6 +5,9 @@
 
 #include <bench/bench.h>
 #include <bloom.h>
+#include <uint256.h>
+
+#include <vector>
 
 static void RollingBloom(benchmark::Bench& bench)
 {
@@ -35,5 +38,63 @@ static void RollingBloomReset(benchmark::Bench& bench)
     });
 }
 
+/* The same inserts and lookups as RollingBloom, spread over 125 peers sharing one filter */
+static void RollingCuckoo(benchmark::Bench& bench)
+{
+    CRollingCuckooFilter filter(120000);
+    uint256 data;
+    uint32_t count = 0;
+    bench.run([&] {
+        count++;
+        const uint64_t peer = count % 125;
+        data.begin()[0] = count;
+        data.begin()[1] = count >> 8;
+        data.begin()[2] = count >> 16;
+        data.begin()[3] = count >> 24;
+        filter.insert(peer, data);
+
+        data.begin()[0] = count >> 24;
+        data.begin()[1] = count >> 16;
+        data.begin()[2] = count >> 8;
+        data.begin()[3] = count;
+        filter.contains(peer, data);
+    });
+}
+
+/* Checking an inventory trickle of 100 transactions, one lookup at a time */
+static void RollingBloomTrickle(benchmark::Bench& bench)
+{
+    CRollingBloomFilter filter(120000, 0.000001);
+    std::vector<uint256> invs(100);
+    for (size_t i = 0; i < invs.size(); i++) {
+        invs[i].begin()[0] = i;
+        if (i % 2) filter.insert(invs[i]);
+    }
+    bench.batch(invs.size()).unit("inv").run([&] {
+        for (const uint256& inv : invs) {
+            ankerl::nanobench::doNotOptimizeAway(filter.contains(inv));
+        }
+    });
+}
+
+/* Checking an inventory trickle of 100 transactions with a single batch lookup */
+static void RollingCuckooTrickle(benchmark::Bench& bench)
+{
+    CRollingCuckooFilter filter(120000);
+    std::vector<uint256> invs(100);
+    for (size_t i = 0; i < invs.size(); i++) {
+        invs[i].begin()[0] = i;
+        if (i % 2) filter.insert(7, invs[i]);
+    }
+    std::vector<bool> found;
+    bench.batch(invs.size()).unit("inv").run([&] {
+        filter.contains(7, invs, found);
+        ankerl::nanobench::doNotOptimizeAway(found);
+    });
+}
+
 BENCHMARK(RollingBloom);
 BENCHMARK(RollingBloomReset);
+BENCHMARK(RollingCuckoo);
+BENCHMARK(RollingBloomTrickle);
+BENCHMARK(RollingCuckooTrickle);
@@ -6,28 +6,64 @@
 #include <bench/data.h>
 
 #include <rpc/blockchain.h>
+#include <rpc/jsonwriter.h>
 #include <streams.h>
+#include <test/util/setup_common.h>
 #include <validation.h>
 
 #include <univalue.h>
 
+struct TestBlockAndIndex {
+    //! Chain parameters for the addresses of outputs
+    const BasicTestingSetup testing_setup{};
+    CBlock block;
+    uint256 blockHash;
+    CBlockIndex blockindex;
+
+    TestBlockAndIndex()
+    {
+        CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
+        char a = '\0';
+        stream.write(&a, 1); // Prevent compaction
+
+        stream >> block;
+
+        blockHash = block.GetHash();
+        blockindex.phashBlock = &blockHash;
+        blockindex.nBits = 403014710;
+    }
+};
+
 static void BlockToJsonVerbose(benchmark::Bench& bench)
 {
-    CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
-    char a = '\0';
-    stream.write(&a, 1); // Prevent compaction
-
-    CBlock block;
-    stream >> block;
+    TestBlockAndIndex data;
+    bench.run([&] {
+        (void)blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+    });
+}
 
-    CBlockIndex blockindex;
-    const uint256 blockHash = block.GetHash();
-    blockindex.phashBlock = &blockHash;
-    blockindex.nBits = 403014710;
+//! getblock <hash> 2 as the RPC server used to reply, through a UniValue
+static void BlockToJsonVerboseWrite(benchmark::Bench& bench)
+{
+    TestBlockAndIndex data;
+    bench.run([&] {
+        std::string json = blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true).write();
+        assert(!json.empty());
+    });
+}
 
+//! getblock <hash> 2 as the RPC server replies now, without a UniValue
+static void BlockToJsonVerboseStream(benchmark::Bench& bench)
+{
+    TestBlockAndIndex data;
     bench.run([&] {
-        (void)blockToJSON(block, &blockindex, &blockindex, /*verbose*/ true);
+        std::string json;
+        JSONWriter writer(json);
+        blockToJSON(writer, data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+        assert(!json.empty());
     });
 }
 
 BENCHMARK(BlockToJsonVerbose);
+BENCHMARK(BlockToJsonVerboseWrite);
+BENCHMARK(BlockToJsonVerboseStream);
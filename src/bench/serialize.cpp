@@ -0,0 +1,108 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <coins.h>
+#include <dbwrapper.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <script/script.h>
+#include <streams.h>
+#include <version.h>
+
+#include <memory>
+#include <vector>
+
+//! Coins written per chainstate batch
+static constexpr int BATCH_COINS = 10000;
+
+static void SerializeBlockTest(benchmark::Bench& bench)
+{
+    CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    CDataStream out(SER_NETWORK, PROTOCOL_VERSION);
+    out.reserve(benchmark::data::block413567.size());
+    bench.unit("block").run([&] {
+        out << block;
+        assert(out.size() == benchmark::data::block413567.size());
+        out.clear();
+    });
+}
+
+//! Deobfuscation of a megabyte of database values with an 8 byte key
+static void ObfuscateXor(benchmark::Bench& bench)
+{
+    FastRandomContext rng(true);
+    const std::vector<unsigned char> key = rng.randbytes(8);
+    const std::vector<unsigned char> data = rng.randbytes(1 << 20);
+    CDataStream stream(data, SER_DISK, 0);
+
+    bench.batch(data.size()).unit("byte").run([&] {
+        stream.Xor(key);
+    });
+}
+
+struct ChainstateSetup {
+    CDBWrapper db{"bench_chainstate", 8 << 20, /* fMemory */ true, /* fWipe */ false, /* obfuscate */ true};
+    std::vector<std::pair<COutPoint, Coin>> coins;
+
+    ChainstateSetup()
+    {
+        FastRandomContext rng(true);
+        coins.reserve(BATCH_COINS);
+        for (int i = 0; i < BATCH_COINS; ++i) {
+            const CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i % 256) << OP_EQUALVERIFY << OP_CHECKSIG;
+            coins.emplace_back(COutPoint(rng.rand256(), i % 4), Coin(CTxOut(rng.randrange(1000 * COIN), script), 100000 + i, false, false));
+        }
+    }
+
+    void Write(CDBBatch& batch) const
+    {
+        for (const auto& coin : coins) {
+            batch.Write(std::make_pair('C', coin.first), coin.second);
+        }
+    }
+};
+
+//! Serialization and obfuscation of a batch of coins, as done by a chainstate flush
+static void ChainstateBatchWrite(benchmark::Bench& bench)
+{
+    const ChainstateSetup setup;
+    CDBBatch batch(setup.db);
+
+    bench.batch(BATCH_COINS).unit("coin").run([&] {
+        setup.Write(batch);
+        batch.Clear();
+    });
+}
+
+//! Deobfuscation and deserialization of coins while iterating over a chainstate
+static void ChainstateIterate(benchmark::Bench& bench)
+{
+    ChainstateSetup setup;
+    CDBBatch batch(setup.db);
+    setup.Write(batch);
+    setup.db.WriteBatch(batch);
+
+    bench.batch(BATCH_COINS).unit("coin").run([&] {
+        std::unique_ptr<CDBIterator> it(setup.db.NewIterator());
+        int count = 0;
+        for (it->Seek(std::make_pair('C', COutPoint())); it->Valid(); it->Next()) {
+            Coin coin;
+            bool read = it->GetValue(coin);
+            assert(read);
+            ++count;
+        }
+        assert(count == BATCH_COINS);
+    });
+}
+
+BENCHMARK(SerializeBlockTest);
+BENCHMARK(ObfuscateXor);
+BENCHMARK(ChainstateBatchWrite);
+BENCHMARK(ChainstateIterate);
@@ -0,0 +1,95 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <key.h>
+#include <psbt.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
+#include <script/standard.h>
+
+#include <map>
+#include <vector>
+
+//! Inputs combined by a large coinstake or a consolidation of staking outputs
+static constexpr int NUM_INPUTS = 500;
+
+struct SigningSetup {
+    FillableSigningProvider keystore;
+    std::map<COutPoint, Coin> coins;
+    CMutableTransaction mtx;
+
+    //! Spend NUM_INPUTS P2WPKH outputs of num_keys keys into a single output
+    explicit SigningSetup(int num_keys)
+    {
+        std::vector<CScript> scripts;
+        for (int i = 0; i < num_keys; ++i) {
+            CKey key;
+            key.MakeNewKey(true);
+            keystore.AddKey(key);
+            scripts.push_back(GetScriptForDestination(WitnessV0KeyHash(key.GetPubKey())));
+        }
+        for (int i = 0; i < NUM_INPUTS; ++i) {
+            const COutPoint prevout(uint256(std::vector<unsigned char>(32, i % 256 + 1)), i);
+            mtx.vin.emplace_back(prevout);
+            coins[prevout] = Coin(CTxOut(1000 * COIN, scripts[i % num_keys]), 1, false, false);
+        }
+        mtx.vout.emplace_back(NUM_INPUTS * 1000 * COIN, scripts[0]);
+    }
+};
+
+static void SignTransactionInputs(benchmark::Bench& bench, int num_keys)
+{
+    ECC_Start();
+    {
+        const SigningSetup setup(num_keys);
+        bench.unit("tx").run([&] {
+            CMutableTransaction mtx = setup.mtx;
+            std::map<int, std::string> input_errors;
+            bool complete = SignTransaction(mtx, &setup.keystore, setup.coins, SIGHASH_ALL, input_errors);
+            assert(complete);
+        });
+    }
+    ECC_Stop();
+}
+
+//! A coinstake combining the outputs of a single staking key
+static void SignCoinStake500(benchmark::Bench& bench)
+{
+    SignTransactionInputs(bench, 1);
+}
+
+//! A consolidation of staking outputs received on many addresses
+static void SignConsolidation500(benchmark::Bench& bench)
+{
+    SignTransactionInputs(bench, NUM_INPUTS);
+}
+
+//! Sign a consolidation as a PSBT, then finalize and extract it
+static void SignFinalizePSBT500(benchmark::Bench& bench)
+{
+    ECC_Start();
+    {
+        const SigningSetup setup(NUM_INPUTS);
+        PartiallySignedTransaction unsigned_psbt(setup.mtx);
+        for (int i = 0; i < NUM_INPUTS; ++i) {
+            unsigned_psbt.inputs[i].witness_utxo = setup.coins.at(setup.mtx.vin[i].prevout).out;
+        }
+        bench.unit("tx").run([&] {
+            PartiallySignedTransaction psbt = unsigned_psbt;
+            const PrecomputedTransactionData txdata = PrecomputePSBTData(psbt);
+            ForEachInputParallel(psbt.tx->vin.size(), [&](size_t i) {
+                SignPSBTInput(setup.keystore, psbt, i, &txdata);
+            });
+            CMutableTransaction result;
+            bool complete = FinalizeAndExtractPSBT(psbt, result);
+            assert(complete);
+        });
+    }
+    ECC_Stop();
+}
+
+BENCHMARK(SignCoinStake500);
+BENCHMARK(SignConsolidation500);
+BENCHMARK(SignFinalizePSBT500);
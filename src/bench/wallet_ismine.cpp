@@ -0,0 +1,99 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <interfaces/chain.h>
+#include <node/context.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <wallet/wallet.h>
+
+#include <cassert>
+#include <set>
+#include <vector>
+
+//! Transactions in the connected block, and outputs per transaction
+static constexpr size_t NUM_BLOCK_TXS = 1000;
+static constexpr size_t NUM_TX_OUTPUTS = 5;
+//! Scripts watched by a descriptor wallet, spread over its active ScriptPubKeyMans
+static constexpr unsigned int NUM_WATCHED_SCRIPTS = 1000000;
+
+static CScript RandomScript(FastRandomContext& rng)
+{
+    return GetScriptForDestination(WitnessV0KeyHash(uint160(rng.randbytes(20))));
+}
+
+/** A block of transactions spending and paying to others, except for one output in a thousand paying the wallet */
+static CBlock BlockPayingWallet(CWallet& wallet)
+{
+    FastRandomContext rng(true);
+    CBlock block;
+    for (size_t i = 0; i < NUM_BLOCK_TXS; ++i) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+        for (size_t j = 0; j < NUM_TX_OUTPUTS; ++j) {
+            CScript script = RandomScript(rng);
+            if ((i * NUM_TX_OUTPUTS + j) % 1000 == 0) {
+                CTxDestination dest;
+                std::string error;
+                assert(wallet.GetNewDestination(OutputType::BECH32, "", dest, error));
+                script = GetScriptForDestination(dest);
+            }
+            tx.vout.emplace_back(COIN, script);
+        }
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    return block;
+}
+
+//! Every output of the block is checked with IsMine while the wallet syncs it
+static void WalletIsMineBlockConnected(benchmark::Bench& bench, bool descriptors, bool fingerprints)
+{
+    TestingSetup test_setup{
+        CBaseChainParams::REGTEST,
+        /* extra_args */ {
+            "-nodebuglogfile",
+            "-nodebug",
+        },
+    };
+
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(node);
+    CWallet wallet{chain.get(), "", CreateMockWalletDatabase()};
+    {
+        LOCK(wallet.cs_wallet);
+        if (descriptors) {
+            wallet.SetWalletFlag(WALLET_FLAG_DESCRIPTORS);
+            wallet.SetupDescriptorScriptPubKeyMans();
+            const std::set<ScriptPubKeyMan*> spk_mans = wallet.GetActiveScriptPubKeyMans();
+            for (ScriptPubKeyMan* spk_man : spk_mans) {
+                assert(spk_man->TopUp(NUM_WATCHED_SCRIPTS / spk_mans.size()));
+            }
+            wallet.m_use_script_pub_key_set = fingerprints;
+        } else {
+            wallet.SetMinVersion(FEATURE_LATEST);
+            LegacyScriptPubKeyMan& spk_man = *wallet.GetOrCreateLegacyScriptPubKeyMan();
+            spk_man.SetHDSeed(spk_man.GenerateNewSeed());
+            assert(spk_man.TopUp());
+        }
+    }
+
+    const CBlock block = BlockPayingWallet(wallet);
+    wallet.blockConnected(block, /* height */ 1);
+    assert(WITH_LOCK(wallet.cs_wallet, return wallet.mapWallet.size()) == NUM_BLOCK_TXS * NUM_TX_OUTPUTS / 1000);
+
+    bench.batch(NUM_BLOCK_TXS * NUM_TX_OUTPUTS).unit("output").run([&] {
+        wallet.blockConnected(block, /* height */ 1);
+    });
+}
+
+static void WalletIsMineBlockConnectedDescriptors(benchmark::Bench& bench) { WalletIsMineBlockConnected(bench, /* descriptors */ true, /* fingerprints */ true); }
+static void WalletIsMineBlockConnectedDescriptorsNoFingerprints(benchmark::Bench& bench) { WalletIsMineBlockConnected(bench, /* descriptors */ true, /* fingerprints */ false); }
+static void WalletIsMineBlockConnectedLegacy(benchmark::Bench& bench) { WalletIsMineBlockConnected(bench, /* descriptors */ false, /* fingerprints */ false); }
+
+BENCHMARK(WalletIsMineBlockConnectedDescriptors);
+BENCHMARK(WalletIsMineBlockConnectedDescriptorsNoFingerprints);
+BENCHMARK(WalletIsMineBlockConnectedLegacy);
@@ -4,6 +4,7 @@
 
 #include <bloom.h>
 
+#include <crypto/siphash.h>
 #include <primitives/transaction.h>
 #include <hash.h>
 #include <script/script.h>
@@ -274,3 +275,152 @@ void CRollingBloomFilter::reset()
     nGeneration = 1;
     std::fill(data.begin(), data.end(), 0);
 }
+
+//! Slots per bucket of CRollingCuckooFilter, four 32-bit slots share 16 bytes
+static constexpr uint64_t CUCKOO_BUCKET_SLOTS = 4;
+//! The lower 30 bits of a slot hold the fingerprint, the upper two its generation
+static constexpr uint32_t CUCKOO_FINGERPRINT_MASK = 0x3FFFFFFF;
+//! Fingerprints moved to make room for a new one before giving up
+static constexpr int MAX_CUCKOO_KICKS = 500;
+
+static inline uint32_t CuckooFingerprint(uint64_t h)
+{
+    /* The lower bits of h pick the bucket. Zero marks an empty slot. */
+    const uint32_t fp = h >> 34;
+    return fp ? fp : 1;
+}
+
+/* The other bucket a fingerprint may be stored in, which only depends on the fingerprint and the current bucket */
+static inline uint64_t CuckooAltBucket(uint64_t bucket, uint32_t fp, uint64_t mask)
+{
+    return (bucket ^ ((fp * 0x9E3779B97F4A7C15ULL) >> 32)) & mask;
+}
+
+CRollingCuckooFilter::CRollingCuckooFilter(const unsigned int nElements, const unsigned int nTagQuotaIn) : nTagQuota(nTagQuotaIn)
+{
+    nEntriesPerGeneration = (nElements + 1) / 2;
+    /* At most three generations are stored. Keep them below 90% of the slots,
+     * beyond which finding room for a new fingerprint gets slow. */
+    const uint64_t nMaxElements = uint64_t{nEntriesPerGeneration} * 3;
+    const uint64_t nMinBuckets = (nMaxElements * 10 / 9 + CUCKOO_BUCKET_SLOTS - 1) / CUCKOO_BUCKET_SLOTS;
+    uint64_t nBuckets = 1;
+    while (nBuckets < nMinBuckets) nBuckets <<= 1;
+    nBucketMask = nBuckets - 1;
+    nKey0 = 0;
+    nKey1 = 0;
+    reset();
+}
+
+uint64_t CRollingCuckooFilter::Hash(uint64_t tag, const uint256& hash) const
+{
+    return SipHashUint256Extra(nKey0, nKey1 ^ (tag >> 32), hash, (uint32_t)tag);
+}
+
+bool CRollingCuckooFilter::Lookup(uint64_t h) const
+{
+    const uint32_t fp = CuckooFingerprint(h);
+    const uint64_t bucket1 = h & nBucketMask;
+    const uint64_t bucket2 = CuckooAltBucket(bucket1, fp, nBucketMask);
+    for (const uint64_t bucket : {bucket1, bucket2}) {
+        for (uint64_t i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+            if ((data[bucket * CUCKOO_BUCKET_SLOTS + i] & CUCKOO_FINGERPRINT_MASK) == fp) return true;
+        }
+    }
+    return false;
+}
+
+void CRollingCuckooFilter::insert(uint64_t tag, const uint256& hash)
+{
+    if (data.empty()) {
+        nKey0 = GetRand(std::numeric_limits<uint64_t>::max());
+        nKey1 = GetRand(std::numeric_limits<uint64_t>::max());
+        data.resize((nBucketMask + 1) * CUCKOO_BUCKET_SLOTS);
+    }
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        nEntriesThisGeneration = 0;
+        nGeneration++;
+        if (nGeneration == 4) {
+            nGeneration = 1;
+        }
+        /* Wipe old entries that used this generation number. */
+        for (uint32_t& slot : data) {
+            if ((slot >> 30) == nGeneration) slot = 0;
+        }
+        mapTagEntriesThisGeneration.clear();
+    }
+    if (nTagQuota) {
+        unsigned int& nTagEntries = mapTagEntriesThisGeneration[tag];
+        if (nTagEntries == nTagQuota) return;
+        nTagEntries++;
+    }
+    nEntriesThisGeneration++;
+
+    const uint64_t h = Hash(tag, hash);
+    uint32_t fp = CuckooFingerprint(h);
+    uint64_t bucket = h & nBucketMask;
+    const uint64_t buckets[2] = {bucket, CuckooAltBucket(bucket, fp, nBucketMask)};
+    uint32_t* empty_slot = nullptr;
+    for (const uint64_t b : buckets) {
+        for (uint64_t i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+            uint32_t& slot = data[b * CUCKOO_BUCKET_SLOTS + i];
+            if ((slot & CUCKOO_FINGERPRINT_MASK) == fp) {
+                /* Already present, move it to the current generation */
+                slot = fp | (nGeneration << 30);
+                return;
+            }
+            if (slot == 0 && !empty_slot) empty_slot = &slot;
+        }
+    }
+    uint32_t value = fp | (nGeneration << 30);
+    if (empty_slot) {
+        *empty_slot = value;
+        return;
+    }
+
+    /* Both buckets are full: evict a fingerprint to its other bucket, and so on until one lands in an empty slot. */
+    for (int n = 0; n < MAX_CUCKOO_KICKS; n++) {
+        std::swap(value, data[bucket * CUCKOO_BUCKET_SLOTS + (fp + n) % CUCKOO_BUCKET_SLOTS]);
+        fp = value & CUCKOO_FINGERPRINT_MASK;
+        bucket = CuckooAltBucket(bucket, fp, nBucketMask);
+        for (uint64_t i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+            uint32_t& slot = data[bucket * CUCKOO_BUCKET_SLOTS + i];
+            if (slot == 0) {
+                slot = value;
+                return;
+            }
+        }
+    }
+    /* The table is too full, forget the last evicted fingerprint. */
+}
+
+bool CRollingCuckooFilter::contains(uint64_t tag, const uint256& hash) const
+{
+    if (data.empty()) return false;
+    return Lookup(Hash(tag, hash));
+}
+
+void CRollingCuckooFilter::contains(uint64_t tag, Span<const uint256> hashes, std::vector<bool>& found) const
+{
+    found.assign(hashes.size(), false);
+    if (data.empty()) return;
+    /* Hash everything first, so that the table reads below do not depend on
+     * each other and their cache misses can overlap. */
+    std::vector<uint64_t> keys;
+    keys.reserve(hashes.size());
+    for (const uint256& hash : hashes) {
+        keys.push_back(Hash(tag, hash));
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        found[i] = Lookup(keys[i]);
+    }
+}
+
+void CRollingCuckooFilter::reset()
+{
+    /* The next insert() allocates a new table with new keys */
+    nEntriesThisGeneration = 0;
+    nGeneration = 1;
+    mapTagEntriesThisGeneration.clear();
+    data.clear();
+    data.shrink_to_fit();
+}
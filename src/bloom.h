@@ -6,7 +6,10 @@
 #define BITCOIN_BLOOM_H
 
 #include <serialize.h>
+#include <span.h>
 
+#include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 class COutPoint;
@@ -117,4 +120,54 @@ private:
     int nHashFuncs;
 };
 
+/**
+ * RollingCuckooFilter keeps track of the most recently inserted (tag, hash)
+ * pairs, like CRollingBloomFilter does for single items. It is meant to be
+ * shared by many tags, e.g. to remember which inventory each peer knows
+ * about with a single memory bound for all peers.
+ *
+ * Every pair is reduced to a 30-bit fingerprint stored in one of two buckets
+ * of four slots, both chosen by a salted SipHash of the pair, so contains()
+ * reads at most two adjacent cache lines. The slots also hold the generation
+ * of the fingerprint, which is rolled over as in CRollingBloomFilter:
+ * contains(tag, hash) will always return true if the pair was one of the last
+ * N to 1.5*N insert()'ed, except in the rare case the table had no room left
+ * for it, and returns true for other pairs with a probability below 1e-8.
+ *
+ * It needs 7 to 14 bytes per element, which are only allocated by the first
+ * insert() after construction or reset(). Unlike CRollingBloomFilter it does
+ * not use the random number generator until then, so it can be a global.
+ *
+ * With a nonzero nTagQuota, at most that many insert()s of one tag count in
+ * each generation of (N + 1) / 2 insert()s, and the tag's further pairs are
+ * ignored until the next one. A single tag then cannot roll the generations
+ * over by itself, and push the pairs of all other tags out.
+ */
+class CRollingCuckooFilter
+{
+public:
+    explicit CRollingCuckooFilter(const unsigned int nElements, const unsigned int nTagQuota = 0);
+
+    void insert(uint64_t tag, const uint256& hash);
+    bool contains(uint64_t tag, const uint256& hash) const;
+    /** Look up many hashes with the same tag at once, found[i] is set for hashes[i] */
+    void contains(uint64_t tag, Span<const uint256> hashes, std::vector<bool>& found) const;
+
+    void reset();
+
+private:
+    uint64_t Hash(uint64_t tag, const uint256& hash) const;
+    bool Lookup(uint64_t h) const;
+
+    unsigned int nEntriesPerGeneration;
+    unsigned int nEntriesThisGeneration;
+    uint32_t nGeneration;
+    unsigned int nTagQuota;
+    std::unordered_map<uint64_t, unsigned int> mapTagEntriesThisGeneration;
+    uint64_t nBucketMask;
+    uint64_t nKey0;
+    uint64_t nKey1;
+    std::vector<uint32_t> data;
+};
+
 #endif // BITCOIN_BLOOM_H
@@ -5,6 +5,33 @@
 
 #include <chain.h>
 
+#include <memusage.h>
+
+size_t CBlockIndex::DynamicMemoryUsage() const
+{
+    return m_rare_fields.Get() ? memusage::MallocUsage(sizeof(CBlockIndexRareFields)) : 0;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    if (m_chunk_used == CHUNK_ENTRIES) {
+        m_chunks.emplace_back(new CBlockIndex[CHUNK_ENTRIES]);
+        m_chunk_used = 0;
+    }
+    return &m_chunks.back()[m_chunk_used++];
+}
+
+void CBlockIndexArena::Clear()
+{
+    m_chunks.clear();
+    m_chunk_used = CHUNK_ENTRIES;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(m_chunks) + m_chunks.size() * memusage::MallocUsage(CHUNK_ENTRIES * sizeof(CBlockIndex));
+}
+
 /**
  * CChain implementation
  */
@@ -12,9 +12,11 @@
 #include <primitives/block.h>
 #include <tinyformat.h>
 #include <uint256.h>
+#include <util/memory.h>
 
 #include <util/moneystr.h>
 
+#include <memory>
 #include <vector>
 
 /**
@@ -131,6 +133,37 @@ enum BlockStatus: uint32_t {
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
 };
 
+/** Fields of a block index entry that only few blocks use, allocated on first use */
+struct CBlockIndexRareFields
+{
+    uint256 nStakeModifierV2{}; // hash modifier for proof-of-stake, with BLOCK_STAKE_MOD_V2
+    int64_t nTreasuryPayment{0}; // with BLOCK_TREASURY_AWARD
+};
+
+/** Owning pointer to the rare fields of a block index entry, copied along with the entry */
+class CBlockIndexRareFieldsPtr
+{
+    std::unique_ptr<CBlockIndexRareFields> m_fields;
+
+public:
+    CBlockIndexRareFieldsPtr() = default;
+    CBlockIndexRareFieldsPtr(CBlockIndexRareFieldsPtr&&) = default;
+    CBlockIndexRareFieldsPtr& operator=(CBlockIndexRareFieldsPtr&&) = default;
+    CBlockIndexRareFieldsPtr(const CBlockIndexRareFieldsPtr& other) : m_fields(other.m_fields ? MakeUnique<CBlockIndexRareFields>(*other.m_fields) : nullptr) {}
+    CBlockIndexRareFieldsPtr& operator=(const CBlockIndexRareFieldsPtr& other)
+    {
+        m_fields = other.m_fields ? MakeUnique<CBlockIndexRareFields>(*other.m_fields) : nullptr;
+        return *this;
+    }
+
+    const CBlockIndexRareFields* Get() const { return m_fields.get(); }
+    CBlockIndexRareFields& GetOrCreate()
+    {
+        if (!m_fields) m_fields = MakeUnique<CBlockIndexRareFields>();
+        return *m_fields;
+    }
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -189,11 +222,6 @@ public:
     unsigned int nTimeMax{0};
 
 // peercoin
-    // peercoin: money supply related block index fields
-    int64_t nMint{0};
-    int64_t nMoneySupply{0};
-    int64_t nTreasuryPayment{0};
-
     // peercoin: proof-of-stake related block index fields
     unsigned int nFlags{0};  // peercoin: block index flags
     enum
@@ -205,12 +233,21 @@ public:
         BLOCK_TREASURY_AWARD = (1 << 4), // is treasury payment block
     };
     uint64_t nStakeModifier{0}; // hash modifier for proof-of-stake
-    uint256 nStakeModifierV2{}; // hash modifier for proof-of-stake
     //unsigned int nStakeModifierChecksum{0}; // checksum of index; in-memory only
     //COutPoint prevoutStake{};
     //unsigned int nStakeTime{0};
     //uint256 hashProofOfStake{};
 
+    // peercoin: money supply related block index fields
+    int64_t nMint{0};
+    int64_t nMoneySupply{0};
+
+private:
+    //! nStakeModifierV2 and nTreasuryPayment, which are unset for most blocks
+    CBlockIndexRareFieldsPtr m_rare_fields;
+
+public:
+
     bool IsProofOfWork() const
     {
         return !(nFlags & BLOCK_PROOF_OF_STAKE);
@@ -256,14 +293,34 @@ public:
             nFlags |= BLOCK_STAKE_MODIFIER;
     }
 
+    uint256 GetStakeModifierV2() const
+    {
+        return m_rare_fields.Get() ? m_rare_fields.Get()->nStakeModifierV2 : uint256();
+    }
+
     void SetStakeModifierV2(uint256 nModifier, bool fGeneratedStakeModifier)
     {
-        nStakeModifierV2 = nModifier;
+        if (!nModifier.IsNull() || m_rare_fields.Get())
+            m_rare_fields.GetOrCreate().nStakeModifierV2 = nModifier;
         if (fGeneratedStakeModifier)
             nFlags |= BLOCK_STAKE_MODIFIER | BLOCK_STAKE_MOD_V2;
     }
 // peercoin end
 
+    int64_t GetTreasuryPayment() const
+    {
+        return m_rare_fields.Get() ? m_rare_fields.Get()->nTreasuryPayment : 0;
+    }
+
+    void SetTreasuryPayment(int64_t nPayment)
+    {
+        if (nPayment != 0 || m_rare_fields.Get())
+            m_rare_fields.GetOrCreate().nTreasuryPayment = nPayment;
+    }
+
+    //! Heap memory used by this entry besides the entry itself
+    size_t DynamicMemoryUsage() const;
+
     bool IsTreasuryBlock() const
     {
         return (nFlags & BLOCK_TREASURY_AWARD);
@@ -437,12 +494,18 @@ public:
         READWRITE(obj.nMoneySupply);
         READWRITE(obj.nFlags);
         if (obj.UsesStakeModifierV2()) {
-            READWRITE(obj.nStakeModifierV2);
+            uint256 modifier;
+            SER_WRITE(obj, modifier = obj.GetStakeModifierV2());
+            READWRITE(modifier);
+            SER_READ(obj, obj.SetStakeModifierV2(modifier, false));
         } else {
             READWRITE(obj.nStakeModifier);
         }
         if (obj.IsTreasuryBlock()) {
-            READWRITE(obj.nTreasuryPayment);
+            int64_t payment;
+            SER_WRITE(obj, payment = obj.GetTreasuryPayment());
+            READWRITE(payment);
+            SER_READ(obj, obj.SetTreasuryPayment(payment));
         }
         /*if (obj.IsProofOfStake()) {
             READWRITE(obj.prevoutStake);
@@ -459,7 +522,7 @@ public:
         READWRITE(obj.nNonce);
     }
 
-    uint256 GetBlockHash() const
+    CBlockHeader GetBlockHeader() const
     {
         CBlockHeader block;
         block.nVersion        = nVersion;
@@ -468,7 +531,12 @@ public:
         block.nTime           = nTime;
         block.nBits           = nBits;
         block.nNonce          = nNonce;
-        return block.GetHash();
+        return block;
+    }
+
+    uint256 GetBlockHash() const
+    {
+        return GetBlockHeader().GetHash();
     }
 
 
@@ -483,6 +551,25 @@ public:
     }
 };
 
+/**
+ * Owner of the block index entries. Entries are allocated in chunks, so that
+ * entries created one after another, such as when loading the block index in
+ * height order, are close in memory for pprev walks. They are only freed all
+ * at once.
+ */
+class CBlockIndexArena
+{
+    static constexpr size_t CHUNK_ENTRIES = 4096;
+
+    std::vector<std::unique_ptr<CBlockIndex[]>> m_chunks;
+    size_t m_chunk_used{CHUNK_ENTRIES};
+
+public:
+    CBlockIndex* Allocate();
+    void Clear();
+    size_t DynamicMemoryUsage() const;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -7,6 +7,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <key_io.h>
+#include <rpc/jsonwriter.h>
 #include <script/script.h>
 #include <script/standard.h>
 #include <serialize.h>
@@ -238,3 +239,88 @@ void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry,
         entry.pushKV("hex", EncodeHexTx(tx, serialize_flags)); // The hex-encoded transaction. Used the name "hex" to be consistent with the verbose output of "getrawtransaction".
     }
 }
+
+static void ScriptPubKeyToJSON(const CScript& scriptPubKey, JSONWriter& writer)
+{
+    TxoutType type;
+    std::vector<CTxDestination> addresses;
+    int nRequired;
+
+    writer.BeginObject();
+    writer.Key("asm").String(ScriptToAsmStr(scriptPubKey));
+    writer.Key("hex").String(HexStr(scriptPubKey));
+
+    if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
+        writer.Key("type").String(GetTxnOutputType(type));
+        writer.EndObject();
+        return;
+    }
+
+    writer.Key("reqSigs").Int(nRequired);
+    writer.Key("type").String(GetTxnOutputType(type));
+    writer.Key("addresses").BeginArray();
+    for (const CTxDestination& addr : addresses) {
+        writer.String(EncodeDestination(addr));
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+void TxToJSON(const CTransaction& tx, const uint256& hashBlock, JSONWriter& writer, bool include_hex, int serialize_flags)
+{
+    // Keep in sync with TxToUniv
+    writer.BeginObject();
+    writer.Key("txid").String(tx.GetHash().GetHex());
+    writer.Key("hash").String(tx.GetWitnessHash().GetHex());
+    writer.Key("version").Int(static_cast<uint32_t>(tx.nVersion));
+    writer.Key("size").Int(::GetSerializeSize(tx, PROTOCOL_VERSION));
+    writer.Key("vsize").Int((GetTransactionWeight(tx) + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR);
+    writer.Key("weight").Int(GetTransactionWeight(tx));
+    writer.Key("locktime").Int(tx.nLockTime);
+
+    writer.Key("vin").BeginArray();
+    for (const CTxIn& txin : tx.vin) {
+        writer.BeginObject();
+        if (tx.IsCoinBase()) {
+            writer.Key("coinbase").String(HexStr(txin.scriptSig));
+        } else {
+            writer.Key("txid").String(txin.prevout.hash.GetHex());
+            writer.Key("vout").Int(txin.prevout.n);
+            writer.Key("scriptSig").BeginObject();
+            writer.Key("asm").String(ScriptToAsmStr(txin.scriptSig, true));
+            writer.Key("hex").String(HexStr(txin.scriptSig));
+            writer.EndObject();
+        }
+        if (!txin.scriptWitness.IsNull()) {
+            writer.Key("txinwitness").BeginArray();
+            for (const auto& item : txin.scriptWitness.stack) {
+                writer.String(HexStr(item));
+            }
+            writer.EndArray();
+        }
+        writer.Key("sequence").Int(txin.nSequence);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("vout").BeginArray();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        writer.BeginObject();
+        writer.Key("value").Amount(txout.nValue);
+        writer.Key("n").Int(i);
+        writer.Key("scriptPubKey");
+        ScriptPubKeyToJSON(txout.scriptPubKey, writer);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    if (!hashBlock.IsNull()) {
+        writer.Key("blockhash").String(hashBlock.GetHex());
+    }
+
+    if (include_hex) {
+        writer.Key("hex").String(EncodeHexTx(tx, serialize_flags));
+    }
+    writer.EndObject();
+}
@@ -163,6 +163,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         LogPrintf("Wrote new obfuscate key for %s: %s\n", path.string(), HexStr(obfuscate_key));
     }
 
+    m_is_obfuscated = std::any_of(obfuscate_key.begin(), obfuscate_key.end(), [](unsigned char c) { return c != 0; });
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
 }
 
@@ -255,4 +256,9 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
     return w.obfuscate_key;
 }
 
+bool IsObfuscated(const CDBWrapper &w)
+{
+    return w.m_is_obfuscated;
+}
+
 } // namespace dbwrapper_private
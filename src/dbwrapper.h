@@ -40,6 +40,10 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Whether values of the database are obfuscated with a non-zero key.
+ */
+bool IsObfuscated(const CDBWrapper &w);
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -77,7 +81,9 @@ public:
 
         ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
         ssValue << value;
-        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        if (dbwrapper_private::IsObfuscated(parent)) {
+            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        }
         leveldb::Slice slValue(ssValue.data(), ssValue.size());
 
         batch.Put(slKey, slValue);
@@ -118,6 +124,8 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! deobfuscated copy of the current value, reused across values
+    std::vector<unsigned char> m_value;
 
 public:
 
@@ -146,7 +154,7 @@ public:
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            SpanReader ssKey(SER_DISK, CLIENT_VERSION, {UCharCast(slKey.data()), slKey.size()});
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -157,8 +165,13 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            Span<const unsigned char> data(UCharCast(slValue.data()), slValue.size());
+            if (dbwrapper_private::IsObfuscated(parent)) {
+                m_value.assign(data.begin(), data.end());
+                XorBytes(m_value, dbwrapper_private::GetObfuscateKey(parent));
+                data = m_value;
+            }
+            SpanReader ssValue(SER_DISK, CLIENT_VERSION, data);
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -175,6 +188,7 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend bool dbwrapper_private::IsObfuscated(const CDBWrapper &w);
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -203,6 +217,9 @@ private:
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
+    //! whether obfuscate_key has any non-zero byte
+    bool m_is_obfuscated{false};
+
     //! the key under which the obfuscation key is stored
     static const std::string OBFUSCATE_KEY_KEY;
 
@@ -243,8 +260,11 @@ public:
             dbwrapper_private::HandleError(status);
         }
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
+            // Deobfuscate in place and read straight from the returned buffer
+            if (m_is_obfuscated) {
+                XorBytes({UCharCast(&strValue[0]), strValue.size()}, obfuscate_key);
+            }
+            SpanReader ssValue(SER_DISK, CLIENT_VERSION, {UCharCast(strValue.data()), strValue.size()});
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <crypto/hmac_sha256.h>
 #include <httpserver.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <util/strencodings.h>
@@ -204,10 +205,19 @@ static bool HTTPReq_JSONRPC(const util::Ref& context, HTTPRequest* req)
                 req->WriteReply(HTTP_FORBIDDEN);
                 return false;
             }
+            // Send reply, the same as JSONRPCReply(result, NullUniValue, jreq.id).
+            // Handlers of large results write them straight into it.
+            JSONWriter writer(strReply);
+            writer.BeginObject().Key("result");
+            jreq.result_writer = &writer;
+            const size_t result_pos = strReply.size();
             UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            jreq.result_writer = nullptr;
+            if (strReply.size() == result_pos) writer.Value(result);
+            writer.Key("error").Null();
+            writer.Key("id").Value(jreq.id);
+            writer.EndObject();
+            strReply += "\n";
 
         // array of requests
         } else if (valRequest.isArray()) {
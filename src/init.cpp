@@ -57,6 +57,7 @@
 #include <util/string.h>
 #include <util/system.h>
 #include <util/threadnames.h>
+#include <util/trace.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <wallet/wallet.h>
@@ -226,6 +227,9 @@ void Shutdown(NodeContext& node)
     if (g_load_block.joinable()) g_load_block.join();
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    // Validation interface subscribers like peerman may be destroyed below, so
+    // no callbacks may be running from here on.
+    GetMainSignals().StopBackgroundWorkers();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
@@ -285,6 +289,9 @@ void Shutdown(NodeContext& node)
                 chainstate->ResetCoinsViews();
             }
         }
+        if (node.args->GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT)) {
+            DumpBlockIndexSnapshot(*node.chainman);
+        }
         pblocktree.reset();
     }
     for (const auto& client : node.chain_clients) {
@@ -318,6 +325,7 @@ void Shutdown(NodeContext& node)
 
     node.args = nullptr;
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopAsyncWriter();
 }
 
 /**
@@ -399,6 +407,7 @@ void SetupServerArgs(NodeContext& node)
 #endif
     argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockindexsnapshot", strprintf("Write the block index to %s on shutdown and load it from there on the next start, as long as it was not modified in between (default: %u)", BLOCK_INDEX_SNAPSHOT_FILENAME, DEFAULT_BLOCK_INDEX_SNAPSHOT), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
     argsman.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
@@ -533,7 +542,11 @@ void SetupServerArgs(NodeContext& node)
         "If <category> is not supplied or if <category> = 1, output all debugging information. <category> can be: " + LogInstance().LogCategoriesString() + ".",
         ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-debugexclude=<category>", strprintf("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories."), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-debuglogbinary=<file>", "Also append log messages as binary records to <file> for offline analysis. Relative paths will be prefixed by a net-specific datadir location. (default: disabled)", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-logasync", strprintf("Write debug output from a dedicated thread instead of the logging threads. Messages not yet written are lost on a crash (default: %u)", DEFAULT_LOGASYNC), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-lockstats", strprintf("Record how long locks are waited for and held for the getlockstats RPC (default: %u)", DEFAULT_LOCKSTATS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-lograte=<n>", strprintf("Log at most <n> messages per second for each debug category and report how many were dropped (0 = unlimited, default: %u)", DEFAULT_LOGRATELIMIT), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
 #ifdef HAVE_THREAD_LOCAL
     argsman.AddArg("-logthreadnames", strprintf("Prepend debug output with name of the originating thread (only available on platforms supporting thread_local) (default: %u)", DEFAULT_LOGTHREADNAMES), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
@@ -546,8 +559,12 @@ void SetupServerArgs(NodeContext& node)
     argsman.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-printtoconsole", "Send trace/debug info to console (default: 1 when no -daemon. To disable logging to file, set -nodebuglogfile)", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-schedulerthreads=<n>", strprintf("Number of threads running background jobs like database flushes, so they do not delay other scheduled jobs (0 = run them on the scheduler thread, default: %d)", DEFAULT_SCHEDULER_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-shrinkdebugfile", "Shrink debug.log file on client startup (default: 1 when no -debug)", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-tracespans=<n>", strprintf("Record the last <n> spans of hot code paths of each thread for the dumptrace RPC (0 = disabled, maximum: %u, default: %u)", tracing::MAX_SPAN_CAPACITY, tracing::DEFAULT_SPAN_CAPACITY), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-uacomment=<cmt>", "Append comment to the user agent string", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-validationqueuelimit=<n>", strprintf("Pause block validation while a validation notification subscriber, e.g. a wallet or index, has more than <n> notifications queued (0 = never, default: %u)", DEFAULT_VALIDATIONINTERFACE_QUEUE_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-validationqueuethreads=<n>", strprintf("Number of threads delivering validation notifications to subscribers (default: %d)", DEFAULT_VALIDATIONINTERFACE_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 
     SetupChainParamsBaseOptions(argsman);
 
@@ -892,6 +909,11 @@ void InitLogging(const ArgsManager& args)
 #ifdef HAVE_THREAD_LOCAL
     LogInstance().m_log_threadnames = args.GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
 #endif
+    LogInstance().m_log_async = args.GetBoolArg("-logasync", DEFAULT_LOGASYNC);
+    LogInstance().m_rate_limit = std::max<int64_t>(0, args.GetArg("-lograte", DEFAULT_LOGRATELIMIT));
+    if (args.IsArgSet("-debuglogbinary") && !args.IsArgNegated("-debuglogbinary")) {
+        LogInstance().m_binary_file_path = AbsPathForConfigVal(args.GetArg("-debuglogbinary", ""));
+    }
 
     fLogIPs = args.GetBoolArg("-logips", DEFAULT_LOGIPS);
 
@@ -1089,6 +1111,13 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         }
     }
 
+    const int64_t trace_spans = args.GetArg("-tracespans", tracing::DEFAULT_SPAN_CAPACITY);
+    if (trace_spans < 0 || trace_spans > (int64_t)tracing::MAX_SPAN_CAPACITY) {
+        return InitError(strprintf(Untranslated("Invalid -tracespans=%d, must be between 0 and %u"), trace_spans, tracing::MAX_SPAN_CAPACITY));
+    }
+    tracing::SetSpanCapacity(trace_spans);
+    g_lock_stats_enabled = args.GetBoolArg("-lockstats", DEFAULT_LOCKSTATS);
+
     fCheckBlockIndex = args.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = args.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
@@ -1291,6 +1320,10 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         }
     }
     if (!LogInstance().StartLogging()) {
+        if (!LogInstance().m_binary_file_path.empty()) {
+            return InitError(strprintf(Untranslated("Could not open debug log file %s or %s"),
+                LogInstance().m_file_path.string(), LogInstance().m_binary_file_path.string()));
+        }
             return InitError(strprintf(Untranslated("Could not open debug log file %s"),
                 LogInstance().m_file_path.string()));
     }
@@ -1355,13 +1388,19 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
 
     // Start the lightweight task scheduler thread
     threadGroup.create_thread([&] { TraceThread("scheduler", [&] { node.scheduler->serviceQueue(); }); });
+    // ... and the threads taking over its background jobs, like writing peers.dat
+    const int scheduler_threads = std::max<int64_t>(0, args.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS));
+    for (int i = 0; i < scheduler_threads; ++i) {
+        threadGroup.create_thread([&, i] { TraceThread(strprintf("schedbg.%i", i).c_str(), [&] { node.scheduler->serviceBackgroundQueue(); }); });
+    }
 
     // Gather some entropy once per minute.
     node.scheduler->scheduleEvery([]{
         RandAddPeriodic();
-    }, std::chrono::minutes{1});
+    }, std::chrono::minutes{1}, "RandAddPeriodic");
 
-    GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler);
+    GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler, args.GetArg("-validationqueuethreads", DEFAULT_VALIDATIONINTERFACE_THREADS));
+    GetMainSignals().SetQueueLimit(std::max<int64_t>(0, args.GetArg("-validationqueuelimit", DEFAULT_VALIDATIONINTERFACE_QUEUE_LIMIT)));
 
     /* Register RPC commands regardless of -server setting so they will be
      * available in the GUI RPC console even if external calls are disabled.
@@ -1419,7 +1458,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     ChainstateManager& chainman = *Assert(node.chainman);
 
     node.peerman.reset(new PeerManager(chainparams, *node.connman, node.banman.get(), *node.scheduler, chainman, *node.mempool));
-    RegisterValidationInterface(node.peerman.get());
+    RegisterValidationInterface(node.peerman.get(), "peerman");
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1536,7 +1575,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, "zmq");
     }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
@@ -2031,7 +2070,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     BanMan* banman = node.banman.get();
     node.scheduler->scheduleEvery([banman]{
         banman->DumpBanlist();
-    }, DUMP_BANS_INTERVAL);
+    }, DUMP_BANS_INTERVAL, "DumpBanlist", CScheduler::JobClass::BACKGROUND);
 
     std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
     for (unsigned int i = 0; i < wallets.size(); i++) {
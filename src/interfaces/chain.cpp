@@ -89,7 +89,7 @@ public:
     explicit NotificationsHandlerImpl(std::shared_ptr<Chain::Notifications> notifications)
         : m_proxy(std::make_shared<NotificationsProxy>(std::move(notifications)))
     {
-        RegisterSharedValidationInterface(m_proxy);
+        RegisterSharedValidationInterface(m_proxy, "wallet");
     }
     ~NotificationsHandlerImpl() override { disconnect(); }
     void disconnect() override
@@ -26,6 +26,7 @@
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
 
+#include <iterator>
 #include <memory>
 #include <string>
 #include <utility>
@@ -61,6 +62,7 @@ WalletTx MakeWalletTx(CWallet& wallet, const CWalletTx& wtx)
     result.value_map = wtx.mapValue;
     result.is_coinbase = wtx.IsCoinBase();
     result.is_coinstake = wtx.IsCoinStake();
+    result.is_in_main_chain = wtx.IsInMainChain();
     return result;
 }
 
@@ -304,6 +306,36 @@ public:
         }
         return result;
     }
+    std::vector<WalletTx> getWalletTxsPage(WalletTxsPagePos& pos, size_t count, const WalletTxsPageFilter& filter) override
+    {
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        if (pos.end) return result;
+        const CWallet::TxItems& ordered = m_wallet->wtxOrdered;
+        // Transactions sharing a position are looked at last to first, skip the ones already seen
+        auto it = ordered.upper_bound(pos.order_pos);
+        for (size_t seen = 0; seen < pos.count && it != ordered.begin() && std::prev(it)->first == pos.order_pos; ++seen) {
+            --it;
+        }
+        for (size_t scanned = 0; scanned < count && it != ordered.begin(); ++scanned) {
+            --it;
+            if (it->first == pos.order_pos) {
+                ++pos.count;
+            } else {
+                pos.order_pos = it->first;
+                pos.count = 1;
+            }
+            const CWalletTx& wtx = *it->second;
+            if (filter.skip_orphan_stakes && (wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetDepthInMainChain() <= 0 && !wtx.InMempool()) {
+                continue;
+            }
+            const int64_t time = wtx.GetTxTime();
+            if (time < filter.time_from || time > filter.time_to) continue;
+            result.push_back(MakeWalletTx(*m_wallet, wtx));
+        }
+        pos.end = it == ordered.begin();
+        return result;
+    }
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -14,6 +14,7 @@
 #include <util/ui_change_type.h>
 
 #include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <stdint.h>
@@ -44,6 +45,8 @@ struct WalletBalances;
 struct WalletTx;
 struct WalletTxOut;
 struct WalletTxStatus;
+struct WalletTxsPageFilter;
+struct WalletTxsPagePos;
 
 using WalletOrderForm = std::vector<std::pair<std::string, std::string>>;
 using WalletValueMap = std::map<std::string, std::string>;
@@ -182,6 +185,13 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Look at up to count wallet transactions, newest first, starting from
+    //! pos in the wallet's transaction order, and return the ones that pass
+    //! the filter. pos is advanced past them. The wallet is only locked while
+    //! those transactions are looked at, so callers looking for more matches
+    //! call again until pos.end is set.
+    virtual std::vector<WalletTx> getWalletTxsPage(WalletTxsPagePos& pos, size_t count, const WalletTxsPageFilter& filter) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
@@ -381,6 +391,27 @@ struct WalletTx
     std::map<std::string, std::string> value_map;
     bool is_coinbase;
     bool is_coinstake;
+    bool is_in_main_chain;
+};
+
+//! Position in the wallet's transaction order to continue getWalletTxsPage from.
+struct WalletTxsPagePos
+{
+    //! Order position of the transactions looked at last, or a position after the newest one
+    int64_t order_pos{std::numeric_limits<int64_t>::max()};
+    //! How many transactions at order_pos were looked at, since transactions can share a position
+    size_t count{0};
+    //! Whether all transactions have been looked at
+    bool end{false};
+};
+
+//! Conditions getWalletTxsPage checks, with the wallet locked, before it adds a transaction to a page.
+struct WalletTxsPageFilter
+{
+    //! Skip coinbase and coinstake transactions that are not in the main chain or the mempool
+    bool skip_orphan_stakes{false};
+    int64_t time_from{std::numeric_limits<int64_t>::min()};
+    int64_t time_to{std::numeric_limits<int64_t>::max()};
 };
 
 //! Updated transaction status.
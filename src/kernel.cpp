@@ -15,6 +15,7 @@
 #include <timedata.h>
 #include <txdb.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <validation.h>
 
 #include <boost/assign/list_of.hpp>
@@ -271,7 +272,7 @@ uint256 ComputeStakeModifierV2(const CBlockIndex* pindexPrev, const uint256& ker
     ss << kernel;
 
     if (pindexPrev->UsesStakeModifierV2())
-        ss << pindexPrev->nStakeModifierV2;
+        ss << pindexPrev->GetStakeModifierV2();
     else
         ss << pindexPrev->nStakeModifier;
 
@@ -296,7 +297,7 @@ uint64_t ComputeStakeModifierV3(const CBlockIndex* pindexPrev, const uint256& ke
     ss << kernel;
 
     if (pindexPrev->UsesStakeModifierV2())
-        ss << pindexPrev->nStakeModifierV2;
+        ss << pindexPrev->GetStakeModifierV2();
     else
         ss << pindexPrev->nStakeModifier;
 
@@ -442,7 +443,7 @@ bool GetKernelStakeModifier(const CBlockIndex* pindexPrev, const uint256& hashBl
         return true;
     } else {
         if (pindexPrev->UsesStakeModifierV2())
-            nStakeModifierV2 = pindexPrev->nStakeModifierV2;
+            nStakeModifierV2 = pindexPrev->GetStakeModifierV2();
         else
             nStakeModifier = pindexPrev->nStakeModifier;
         nStakeModifierHeight = pindexPrev->nHeight;
@@ -606,6 +607,8 @@ bool CheckStakeKernelHash(const unsigned int& nBits, const CBlockIndex* pindexPr
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(BlockValidationState& state, const CCoinsViewCache& view, const CBlockIndex* pindexPrev, const CTransactionRef& tx, const unsigned int& nBits, unsigned int nTimeTx, uint256& hashProofOfStake)
 {
+    TRACE_SPAN("CheckProofOfStake");
+    TRACE1(validation, check_proof_of_stake, tx->GetHash().data());
     if (!tx->IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString());
 
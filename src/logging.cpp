@@ -4,9 +4,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <logging.h>
+#include <crypto/common.h>
 #include <util/threadnames.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <chrono>
 #include <mutex>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
@@ -39,25 +42,51 @@ static int FileWriteStr(const std::string &str, FILE *fp)
     return fwrite(str.data(), 1, str.size(), fp);
 }
 
+static const char BINARY_LOG_MAGIC[8] = {'X', 'E', 'P', 'B', 'L', 'O', 'G', 1};
+
+/** Open a log file for appending. Files written by the async writer are flushed per batch instead of per message. */
+static FILE* OpenLogFile(const fs::path& path, bool unbuffered)
+{
+    FILE* file = fsbridge::fopen(path, "a");
+    if (file && unbuffered) setbuf(file, nullptr);
+    return file;
+}
+
+static FILE* OpenBinaryLogFile(const fs::path& path)
+{
+    FILE* file = fsbridge::fopen(path, "ab");
+    if (file && ftell(file) == 0) {
+        fwrite(BINARY_LOG_MAGIC, 1, sizeof(BINARY_LOG_MAGIC), file);
+    }
+    return file;
+}
+
 bool BCLog::Logger::StartLogging()
 {
     StdLockGuard scoped_lock(m_cs);
 
     assert(m_buffering);
     assert(m_fileout == nullptr);
+    assert(m_binary_fileout == nullptr);
 
     if (m_print_to_file) {
         assert(!m_file_path.empty());
-        m_fileout = fsbridge::fopen(m_file_path, "a");
+        m_fileout = OpenLogFile(m_file_path, !m_log_async);
         if (!m_fileout) {
             return false;
         }
 
-        setbuf(m_fileout, nullptr); // unbuffered
-
         // Add newlines to the logfile to distinguish this execution from the
         // last one.
         FileWriteStr("\n\n\n\n\n", m_fileout);
+        fflush(m_fileout);
+    }
+
+    if (!m_binary_file_path.empty()) {
+        m_binary_fileout = OpenBinaryLogFile(m_binary_file_path);
+        if (!m_binary_fileout) {
+            return false;
+        }
     }
 
     // dump buffered messages from before we opened the log
@@ -74,16 +103,43 @@ bool BCLog::Logger::StartLogging()
         m_msgs_before_open.pop_front();
     }
     if (m_print_to_console) fflush(stdout);
+    if (m_fileout) fflush(m_fileout);
+
+    if (m_log_async) {
+        if (!m_queue) m_queue.reset(new RingBuffer<LogRecord>(ASYNC_QUEUE_SIZE));
+        m_stop_writer = false;
+        m_writer_thread = std::thread(&BCLog::Logger::WriterThread, this);
+        m_async_running = true;
+    }
 
     return true;
 }
 
+void BCLog::Logger::StopAsyncWriter()
+{
+    if (!m_async_running.exchange(false)) return;
+    // Records of threads that saw m_async_running before it was cleared are
+    // still pushed, and the writer drains the queue before it exits.
+    while (m_async_producers.load() != 0) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_stop_writer = true;
+    }
+    m_writer_cv.notify_one();
+    m_writer_thread.join();
+}
+
 void BCLog::Logger::DisconnectTestLogger()
 {
+    StopAsyncWriter();
     StdLockGuard scoped_lock(m_cs);
     m_buffering = true;
     if (m_fileout != nullptr) fclose(m_fileout);
     m_fileout = nullptr;
+    if (m_binary_fileout != nullptr) fclose(m_binary_fileout);
+    m_binary_fileout = nullptr;
     m_print_callbacks.clear();
 }
 
@@ -189,7 +245,15 @@ std::vector<LogCategory> BCLog::Logger::LogCategoriesList()
     return ret;
 }
 
-std::string BCLog::Logger::LogTimestampStr(const std::string& str)
+static std::string LogCategoryToStr(BCLog::LogFlags category)
+{
+    for (const CLogCategoryDesc& category_desc : LogCategories) {
+        if (category_desc.flag == category) return category_desc.category;
+    }
+    return "";
+}
+
+std::string BCLog::Logger::LogTimestampStr(const std::string& str, int64_t time_micros, int64_t mocktime)
 {
     std::string strStamped;
 
@@ -197,13 +261,11 @@ std::string BCLog::Logger::LogTimestampStr(const std::string& str)
         return str;
 
     if (m_started_new_line) {
-        int64_t nTimeMicros = GetTimeMicros();
-        strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
+        strStamped = FormatISO8601DateTime(time_micros/1000000);
         if (m_log_time_micros) {
             strStamped.pop_back();
-            strStamped += strprintf(".%06dZ", nTimeMicros%1000000);
+            strStamped += strprintf(".%06dZ", time_micros%1000000);
         }
-        int64_t mocktime = GetMockTime();
         if (mocktime) {
             strStamped += " (mocktime: " + FormatISO8601DateTime(mocktime) + ")";
         }
@@ -236,16 +298,63 @@ namespace BCLog {
     }
 }
 
-void BCLog::Logger::LogPrintStr(const std::string& str)
+void BCLog::Logger::StampRecord(LogRecord& record) const
+{
+    record.time_micros = GetTimeMicros();
+    record.mocktime = GetMockTime();
+    if (m_log_threadnames || !m_binary_file_path.empty()) {
+        record.thread_name = util::ThreadGetInternalName();
+    }
+}
+
+void BCLog::Logger::LogPrintStr(const std::string& str, LogFlags category)
 {
+    LogRecord record;
+    record.category = category;
+    record.msg = str;
+    if (PushRecord(record)) return;
+
     StdLockGuard scoped_lock(m_cs);
+    WriteRecord(record);
+    if (!m_buffering) {
+        if (m_print_to_console) fflush(stdout);
+        if (m_fileout) fflush(m_fileout);
+        if (m_binary_fileout) fflush(m_binary_fileout);
+    }
+}
+
+void BCLog::Logger::ReopenFiles()
+{
+    m_reopen_file = false;
+    if (m_fileout) {
+        FILE* new_fileout = OpenLogFile(m_file_path, !m_async_running);
+        if (new_fileout) {
+            fclose(m_fileout);
+            m_fileout = new_fileout;
+        }
+    }
+    if (m_binary_fileout) {
+        FILE* new_fileout = OpenBinaryLogFile(m_binary_file_path);
+        if (new_fileout) {
+            fclose(m_binary_fileout);
+            m_binary_fileout = new_fileout;
+        }
+    }
+}
+
+void BCLog::Logger::WriteRecord(LogRecord& record)
+{
+    if (record.format) record.msg = record.format();
+    if (record.time_micros == 0) StampRecord(record);
+    const std::string& str = record.msg;
+
     std::string str_prefixed = LogEscapeMessage(str);
 
     if (m_log_threadnames && m_started_new_line) {
-        str_prefixed.insert(0, "[" + util::ThreadGetInternalName() + "] ");
+        str_prefixed.insert(0, "[" + record.thread_name + "] ");
     }
 
-    str_prefixed = LogTimestampStr(str_prefixed);
+    str_prefixed = LogTimestampStr(str_prefixed, record.time_micros, record.mocktime);
 
     m_started_new_line = !str.empty() && str[str.size()-1] == '\n';
 
@@ -258,26 +367,127 @@ void BCLog::Logger::LogPrintStr(const std::string& str)
     if (m_print_to_console) {
         // print to console
         fwrite(str_prefixed.data(), 1, str_prefixed.size(), stdout);
-        fflush(stdout);
     }
     for (const auto& cb : m_print_callbacks) {
         cb(str_prefixed);
     }
+    // reopen the log files, if requested
+    if (m_reopen_file) ReopenFiles();
     if (m_print_to_file) {
         assert(m_fileout != nullptr);
+        FileWriteStr(str_prefixed, m_fileout);
+    }
+    if (m_binary_fileout) WriteBinaryRecord(record, str);
+}
 
-        // reopen the log file, if requested
-        if (m_reopen_file) {
-            m_reopen_file = false;
-            FILE* new_fileout = fsbridge::fopen(m_file_path, "a");
-            if (new_fileout) {
-                setbuf(new_fileout, nullptr); // unbuffered
-                fclose(m_fileout);
-                m_fileout = new_fileout;
+void BCLog::Logger::WriteBinaryRecord(const LogRecord& record, const std::string& msg)
+{
+    const size_t name_size = std::min<size_t>(record.thread_name.size(), 0xffff);
+    const size_t size = 8 + 8 + 4 + 2 + name_size + 4 + msg.size();
+    std::string buf(4 + size - msg.size(), '\0');
+    unsigned char* p = (unsigned char*)&buf[0];
+    WriteLE32(p, size);
+    WriteLE64(p + 4, record.time_micros);
+    WriteLE64(p + 12, record.mocktime);
+    WriteLE32(p + 20, record.category);
+    WriteLE16(p + 24, name_size);
+    std::copy(record.thread_name.begin(), record.thread_name.begin() + name_size, p + 26);
+    WriteLE32(p + 26 + name_size, msg.size());
+    FileWriteStr(buf, m_binary_fileout);
+    FileWriteStr(msg, m_binary_fileout);
+}
+
+bool BCLog::Logger::PushRecord(LogRecord& record)
+{
+    ++m_async_producers;
+    if (!m_async_running) {
+        --m_async_producers;
+        return false;
+    }
+    StampRecord(record);
+    while (!m_queue->TryPush(record)) {
+        // The writer fell behind by a full queue; wait for it instead of
+        // dropping messages.
+        WakeWriter();
+        std::this_thread::yield();
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writer_waiting) WakeWriter();
+    --m_async_producers;
+    return true;
+}
+
+void BCLog::Logger::WakeWriter()
+{
+    std::lock_guard<std::mutex> lock(m_writer_mutex);
+    m_writer_cv.notify_one();
+}
+
+void BCLog::Logger::WriterThread()
+{
+    util::ThreadRename("logwriter");
+    // Records are written in batches so that the file and console are
+    // flushed once per batch rather than once per message.
+    static const int MAX_BATCH = 1024;
+    LogRecord record;
+    while (true) {
+        int count = 0;
+        {
+            StdLockGuard scoped_lock(m_cs);
+            while (count < MAX_BATCH && m_queue->TryPop(record)) {
+                WriteRecord(record);
+                record = LogRecord();
+                ++count;
+            }
+            if (count > 0) {
+                if (m_print_to_console) fflush(stdout);
+                if (m_fileout) fflush(m_fileout);
+                if (m_binary_fileout) fflush(m_binary_fileout);
             }
         }
-        FileWriteStr(str_prefixed, m_fileout);
+        if (count == MAX_BATCH) continue;
+
+        std::unique_lock<std::mutex> lock(m_writer_mutex);
+        if (m_stop_writer && m_queue->Empty()) break;
+        m_writer_waiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // A producer that pushed before seeing m_writer_waiting did not wake
+        // us, so look at the queue again before sleeping.
+        if (m_queue->Empty() && !m_stop_writer) {
+            m_writer_cv.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        m_writer_waiting = false;
+    }
+}
+
+bool BCLog::Logger::ConsumeRateToken(LogFlags category)
+{
+    int bucket_index = 0;
+    while (bucket_index < 31 && !((uint32_t)category & (1U << bucket_index))) ++bucket_index;
+
+    const unsigned int limit = m_rate_limit.load(std::memory_order_relaxed);
+    const int64_t now = GetTimeMicros();
+    uint64_t suppressed = 0;
+    {
+        StdLockGuard scoped_lock(m_rate_cs);
+        RateBucket& bucket = m_rate_buckets[bucket_index];
+        if (bucket.last_micros == 0) {
+            bucket.tokens = limit;
+        } else {
+            bucket.tokens = std::min<double>(limit, bucket.tokens + (now - bucket.last_micros) * 1e-6 * limit);
+        }
+        bucket.last_micros = now;
+        if (bucket.tokens < 1) {
+            ++bucket.suppressed;
+            return false;
+        }
+        bucket.tokens -= 1;
+        std::swap(suppressed, bucket.suppressed);
     }
+    if (suppressed > 0) {
+        LogPrintStr(strprintf("Suppressed %u messages of log category %s exceeding %u per second\n", suppressed, LogCategoryToStr(category), limit), category);
+    }
+    return true;
 }
 
 void BCLog::Logger::ShrinkDebugFile()
@@ -7,21 +7,28 @@
 #define BITCOIN_LOGGING_H
 
 #include <fs.h>
+#include <logging/ringbuffer.h>
 #include <tinyformat.h>
 #include <threadsafety.h>
 #include <util/string.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_LOGASYNC = false;
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fLogIPs;
@@ -59,6 +66,59 @@ namespace BCLog {
         ALL         = ~(uint32_t)0,
     };
 
+    /** Number of records the asynchronous writer can fall behind before logging threads wait for it */
+    static const size_t ASYNC_QUEUE_SIZE = 1 << 14;
+
+    /**
+     * A message together with what was known about it when it was logged. When
+     * logging asynchronously, format produces the message on the writer thread.
+     */
+    struct LogRecord {
+        int64_t time_micros{0};
+        int64_t mocktime{0};
+        LogFlags category{NONE};
+        std::string thread_name;
+        std::string msg;
+        std::function<std::string()> format;
+    };
+
+    /** Copy of a log argument that stays valid until the writer thread formats it */
+    template <typename T>
+    const T& DeferredArg(const T& arg) { return arg; }
+    inline std::string DeferredArg(const char* arg) { return arg ? arg : ""; }
+    //! Otherwise const T& would be the better match and only copy the pointer, e.g. to strerror's buffer
+    inline std::string DeferredArg(char* arg) { return arg ? arg : ""; }
+    template <typename T>
+    T DeferredArg(const std::atomic<T>& arg) { return arg.load(); }
+
+    template <typename T>
+    struct DeferredArgType { using type = T; };
+    template <>
+    struct DeferredArgType<const char*> { using type = std::string; };
+    template <>
+    struct DeferredArgType<char*> { using type = std::string; };
+    template <size_t N>
+    struct DeferredArgType<char[N]> { using type = std::string; };
+    template <typename T>
+    struct DeferredArgType<std::atomic<T>> { using type = T; };
+
+    template <typename... Args>
+    std::string FormatLogMessage(const char* fmt, const Args&... args)
+    {
+        try {
+            return tfm::format(fmt, args...);
+        } catch (tinyformat::format_error& fmterr) {
+            /* Original format string will have newline so don't add one here */
+            return "Error \"" + std::string(fmterr.what()) + "\" while formatting log message: " + fmt;
+        }
+    }
+
+    template <typename... Args>
+    std::string FormatDeferredLogMessage(const std::string& fmt, const Args&... args)
+    {
+        return FormatLogMessage(fmt.c_str(), args...);
+    }
+
     class Logger
     {
     private:
@@ -78,11 +138,48 @@ namespace BCLog {
         /** Log categories bitfield. */
         std::atomic<uint32_t> m_categories{0};
 
-        std::string LogTimestampStr(const std::string& str);
+        /** Binary record log, see m_binary_file_path */
+        FILE* m_binary_fileout GUARDED_BY(m_cs) = nullptr;
+
+        std::string LogTimestampStr(const std::string& str, int64_t time_micros, int64_t mocktime);
 
         /** Slots that connect to the print signal */
         std::list<std::function<void(const std::string&)>> m_print_callbacks GUARDED_BY(m_cs) {};
 
+        /** Records waiting for the writer thread, only allocated when logging asynchronously */
+        std::unique_ptr<RingBuffer<LogRecord>> m_queue;
+        std::thread m_writer_thread;
+        /** Whether logging threads hand their records to the writer thread */
+        std::atomic<bool> m_async_running{false};
+        /** Logging threads currently pushing to m_queue */
+        std::atomic<int> m_async_producers{0};
+        /** Set while the writer thread is about to sleep, so producers know to wake it */
+        std::atomic<bool> m_writer_waiting{false};
+        std::mutex m_writer_mutex;
+        std::condition_variable m_writer_cv;
+        bool m_stop_writer = false; // guarded by m_writer_mutex
+
+        /** Token bucket limiting the messages of one category */
+        struct RateBucket {
+            double tokens{0};
+            int64_t last_micros{0};
+            uint64_t suppressed{0};
+        };
+        StdMutex m_rate_cs;
+        RateBucket m_rate_buckets[32] GUARDED_BY(m_rate_cs);
+
+        /** Write a record to all outputs, or buffer it if logging was not started yet */
+        void WriteRecord(LogRecord& record) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+        void WriteBinaryRecord(const LogRecord& record, const std::string& msg) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+        void ReopenFiles() EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+        /** Fill in time and thread of a record at the moment it is logged */
+        void StampRecord(LogRecord& record) const;
+        /** Hand a record to the writer thread. Returns false if it is not running. */
+        bool PushRecord(LogRecord& record);
+        void WakeWriter();
+        void WriterThread();
+        bool ConsumeRateToken(LogFlags category);
+
     public:
         bool m_print_to_console = false;
         bool m_print_to_file = false;
@@ -94,12 +191,59 @@ namespace BCLog {
         fs::path m_file_path;
         std::atomic<bool> m_reopen_file{false};
 
+        /**
+         * Hand messages to a dedicated writer thread once logging started,
+         * instead of writing them from the logging thread. Arguments are then
+         * copied and formatted by the writer thread as well. Messages still
+         * queued when the process crashes are lost.
+         */
+        bool m_log_async = DEFAULT_LOGASYNC;
+
+        /** Maximum number of messages per second logged for each category (0 = unlimited) */
+        std::atomic<unsigned int> m_rate_limit{DEFAULT_LOGRATELIMIT};
+
+        /**
+         * If set, all messages are additionally appended to this file as
+         * binary records for offline analysis. The file starts with the 8 byte
+         * magic "XEPBLOG" followed by a version byte (1). Every record is
+         *
+         *   uint32 size of the rest of the record
+         *   int64  time in microseconds since the epoch
+         *   int64  mock time in seconds (0 if not mocked)
+         *   uint32 category (a single LogFlags bit, or 0 for LogPrintf)
+         *   uint16 thread name size, followed by the thread name
+         *   uint32 message size, followed by the unescaped message
+         *
+         * with all integers little endian. Messages logged before logging was
+         * started are not included.
+         */
+        fs::path m_binary_file_path;
+
         /** Send a string to the log output */
-        void LogPrintStr(const std::string& str);
+        void LogPrintStr(const std::string& str, LogFlags category = NONE);
+
+        /** Format and log a message, possibly on the writer thread */
+        template <typename... Args>
+        void LogFormat(LogFlags category, const char* fmt, const Args&... args)
+        {
+            if (category != NONE && m_rate_limit.load(std::memory_order_relaxed) != 0 && !ConsumeRateToken(category)) return;
+            if (m_async_running.load(std::memory_order_relaxed)) {
+                LogRecord record;
+                record.category = category;
+                record.format = std::bind(&FormatDeferredLogMessage<typename DeferredArgType<Args>::type...>, std::string(fmt), DeferredArg(args)...);
+                if (PushRecord(record)) return;
+                LogPrintStr(record.format(), category);
+                return;
+            }
+            if (Enabled()) {
+                LogPrintStr(FormatLogMessage(fmt, args...), category);
+            }
+        }
 
         /** Returns whether logs will be written to any output */
         bool Enabled() const
         {
+            if (m_async_running.load(std::memory_order_relaxed)) return true;
             StdLockGuard scoped_lock(m_cs);
             return m_buffering || m_print_to_console || m_print_to_file || !m_print_callbacks.empty();
         }
@@ -121,6 +265,8 @@ namespace BCLog {
 
         /** Start logging (and flush all buffered messages) */
         bool StartLogging();
+        /** Write out all queued messages and log synchronously from now on */
+        void StopAsyncWriter();
         /** Only for testing */
         void DisconnectTestLogger();
 
@@ -165,25 +311,16 @@ bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str);
 template <typename... Args>
 static inline void LogPrintf(const char* fmt, const Args&... args)
 {
-    if (LogInstance().Enabled()) {
-        std::string log_msg;
-        try {
-            log_msg = tfm::format(fmt, args...);
-        } catch (tinyformat::format_error& fmterr) {
-            /* Original format string will have newline so don't add one here */
-            log_msg = "Error \"" + std::string(fmterr.what()) + "\" while formatting log message: " + fmt;
-        }
-        LogInstance().LogPrintStr(log_msg);
-    }
+    LogInstance().LogFormat(BCLog::NONE, fmt, args...);
 }
 
 // Use a macro instead of a function for conditional logging to prevent
 // evaluating arguments when logging for the category is not enabled.
-#define LogPrint(category, ...)              \
-    do {                                     \
-        if (LogAcceptCategory((category))) { \
-            LogPrintf(__VA_ARGS__);          \
-        }                                    \
+#define LogPrint(category, ...)                                  \
+    do {                                                         \
+        if (LogAcceptCategory((category))) {                     \
+            LogInstance().LogFormat((category), __VA_ARGS__);    \
+        }                                                        \
     } while (0)
 
 #endif // BITCOIN_LOGGING_H
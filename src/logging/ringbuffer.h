@@ -0,0 +1,98 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LOGGING_RINGBUFFER_H
+#define BITCOIN_LOGGING_RINGBUFFER_H
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace BCLog {
+
+/**
+ * Bounded lock-free queue for many producers and a single consumer.
+ *
+ * Every slot carries a sequence number telling whether it is free for the
+ * producer that claimed position pos (seq == pos) or holds the value written
+ * at position pos for the consumer (seq == pos + 1). Producers claim
+ * positions with a compare-and-swap on the enqueue counter, so values pushed
+ * by the same thread are popped in the order they were pushed.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+    //! capacity must be a power of two
+    explicit RingBuffer(size_t capacity) : m_slots(new Slot[capacity]), m_mask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & m_mask) == 0);
+        for (size_t i = 0; i < capacity; ++i) {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /** Move value into the queue. Returns false, leaving value untouched, when the queue is full. */
+    bool TryPush(T& value)
+    {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &m_slots[pos & m_mask];
+            const size_t seq = slot->seq.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Move the oldest value out of the queue. Must only be called by the consumer. */
+    bool TryPop(T& value)
+    {
+        Slot& slot = m_slots[m_dequeue_pos & m_mask];
+        const size_t seq = slot.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(m_dequeue_pos + 1) < 0) return false;
+        value = std::move(slot.value);
+        slot.seq.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+        ++m_dequeue_pos;
+        return true;
+    }
+
+    /** Whether no value is ready to be popped. Must only be called by the consumer. */
+    bool Empty() const
+    {
+        const size_t seq = m_slots[m_dequeue_pos & m_mask].seq.load(std::memory_order_acquire);
+        return (intptr_t)seq - (intptr_t)(m_dequeue_pos + 1) < 0;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    const std::unique_ptr<Slot[]> m_slots;
+    const size_t m_mask;
+    std::atomic<size_t> m_enqueue_pos{0};
+    //! Only touched by the consumer
+    size_t m_dequeue_pos{0};
+};
+
+} // namespace BCLog
+
+#endif // BITCOIN_LOGGING_RINGBUFFER_H
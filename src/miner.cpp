@@ -21,6 +21,7 @@
 #include <timedata.h>
 #include <util/moneystr.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <util/translation.h>
 #include <kernel.h>
 #include <net.h>
@@ -539,6 +540,7 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
 bool CreateCoinStake(CMutableTransaction& coinstakeTx, CBlock* pblock, std::shared_ptr<CWallet> pwallet, const CAmount& nFees, const int& nHeight, const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams)
 {
     AssertLockHeld(pwallet->cs_wallet);
+    TRACE_SPAN("CreateCoinStake");
 
     const int nTargetStakeInputs = gArgs.GetArg("-targetstakeinputs", DEFAULT_TARGET_STAKE_INPUTS);
     const CAmount nAutomaticInputSize = 2000000 * COIN;
@@ -745,6 +747,7 @@ bool CreateCoinStake(CMutableTransaction& coinstakeTx, CBlock* pblock, std::shar
         }
     }
 
+    TRACE2(miner, create_coinstake, nHeight, fKernelFound);
     return fKernelFound;
 }
 
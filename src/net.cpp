@@ -118,6 +118,8 @@ bool fListen = true;
 bool g_relay_txes = !DEFAULT_BLOCKSONLY;
 RecursiveMutex cs_mapLocalHost;
 std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
+Mutex g_known_inventory_mutex;
+CRollingCuckooFilter g_known_inventory GUARDED_BY(g_known_inventory_mutex){KNOWN_INVENTORY_SIZE, KNOWN_INVENTORY_PEER_QUOTA};
 static bool vfLimited[NET_MAX] GUARDED_BY(cs_mapLocalHost) = {};
 std::string strSubVersion;
 
@@ -561,7 +563,7 @@ Network CNode::ConnectedThroughNetwork() const
 
 #undef X
 #define X(name) stats.name = name
-void CNode::copyStats(CNodeStats &stats, const std::vector<bool> &m_asmap)
+void CNode::copyStats(CNodeStats &stats, const ASMap& m_asmap)
 {
     stats.nodeid = this->GetId();
     X(nServices);
@@ -1803,7 +1805,7 @@ void CConnman::DumpAddresses()
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    adb.Update(addrman);
 
     LogPrint(BCLog::NET, "Flushed %d addresses to peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
@@ -2490,7 +2492,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         else {
             addrman.Clear(); // Addrman can be in an inconsistent state after failure, reset it
             LogPrintf("Invalid or missing peers.dat; recreating\n");
-            DumpAddresses();
+            adb.Write(addrman);
         }
     }
 
@@ -2555,7 +2557,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
     // Dump network addresses
-    scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL);
+    scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL, "DumpAddresses", CScheduler::JobClass::BACKGROUND);
 
     return true;
 }
@@ -78,6 +78,10 @@ static const bool DEFAULT_UPNP = false;
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 /** The default for -maxuploadtarget. 0 = Unlimited */
 static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
+/** Number of (peer, transaction) pairs g_known_inventory remembers for all peers together, using 16 MB */
+static const unsigned int KNOWN_INVENTORY_SIZE = 2000000;
+/** Pairs of one peer counted in each generation of KNOWN_INVENTORY_SIZE / 2, so that a flood of inventory from one peer cannot push out what the others know */
+static const unsigned int KNOWN_INVENTORY_PEER_QUOTA = KNOWN_INVENTORY_SIZE / 16;
 /** The default timeframe for -maxuploadtarget. 1 day. */
 static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 /** Default for blocks only*/
@@ -401,7 +405,7 @@ public:
     */
     int64_t PoissonNextSendInbound(int64_t now, int average_interval_seconds);
 
-    void SetAsmap(std::vector<bool> asmap) { addrman.m_asmap = std::move(asmap); }
+    void SetAsmap(std::vector<bool> asmap) { addrman.m_asmap = ASMap(std::move(asmap)); }
 
     CThreadInterrupt interruptNet;
 
@@ -682,6 +686,14 @@ struct LocalServiceInfo {
 extern RecursiveMutex cs_mapLocalHost;
 extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
 
+/**
+ * Transactions that peers are known to have, tagged with their NodeId, so we
+ * don't announce them back. A single filter serves all peers so its memory
+ * does not grow with the number of connections.
+ */
+extern Mutex g_known_inventory_mutex;
+extern CRollingCuckooFilter g_known_inventory GUARDED_BY(g_known_inventory_mutex);
+
 extern const std::string NET_MESSAGE_COMMAND_OTHER;
 typedef std::map<std::string, uint64_t> mapMsgCmdSize; //command, total bytes
 
@@ -1008,7 +1020,6 @@ public:
         std::unique_ptr<CBloomFilter> pfilter PT_GUARDED_BY(cs_filter) GUARDED_BY(cs_filter){nullptr};
 
         mutable RecursiveMutex cs_tx_inventory;
-        CRollingBloomFilter filterInventoryKnown GUARDED_BY(cs_tx_inventory){50000, 0.000001};
         // Set of transaction ids we still have to announce.
         // They are sorted by the mempool before relay, so the order is not important.
         std::set<uint256> setInventoryTxToSend;
@@ -1176,8 +1187,8 @@ public:
     void AddKnownTx(const uint256& hash)
     {
         if (m_tx_relay != nullptr) {
-            LOCK(m_tx_relay->cs_tx_inventory);
-            m_tx_relay->filterInventoryKnown.insert(hash);
+            LOCK(g_known_inventory_mutex);
+            g_known_inventory.insert(GetId(), hash);
         }
     }
 
@@ -1185,14 +1196,14 @@ public:
     {
         if (m_tx_relay == nullptr) return;
         LOCK(m_tx_relay->cs_tx_inventory);
-        if (!m_tx_relay->filterInventoryKnown.contains(hash)) {
+        if (!WITH_LOCK(g_known_inventory_mutex, return g_known_inventory.contains(GetId(), hash))) {
             m_tx_relay->setInventoryTxToSend.insert(hash);
         }
     }
 
     void CloseSocketDisconnect();
 
-    void copyStats(CNodeStats &stats, const std::vector<bool> &m_asmap);
+    void copyStats(CNodeStats &stats, const ASMap& m_asmap);
 
     ServiceFlags GetLocalServices() const
     {
@@ -29,6 +29,7 @@
 #include <util/check.h> // For NDEBUG compile time check
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <validation.h>
 
 #include <memory>
@@ -38,6 +39,8 @@
 static constexpr int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static constexpr int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** Maximum number of orphan transactions reconsidered together in one ProcessOrphanTx call */
+static constexpr size_t MAX_ORPHAN_BATCH_SIZE = 32;
 /** How long to cache transactions in mapRelay for normal relay */
 static constexpr std::chrono::seconds RELAY_TX_CACHE_TIME = std::chrono::minutes{15};
 /** How long a transaction has to be in the mempool before it can unconditionally be relayed (even when not in mapRelay). */
@@ -836,7 +839,7 @@ void PeerManager::ReattemptInitialBroadcast(CScheduler& scheduler) const
     // Schedule next run for 10-15 minutes in the future.
     // We add randomness on every cycle to avoid the possibility of P2P fingerprinting.
     const std::chrono::milliseconds delta = std::chrono::minutes{10} + GetRandMillis(std::chrono::minutes{5});
-    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta);
+    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta, "ReattemptInitialBroadcast");
 }
 
 void PeerManager::FinalizeNode(const CNode& node, bool& fUpdateConnectionTime) {
@@ -1188,11 +1191,11 @@ PeerManager::PeerManager(const CChainParams& chainparams, CConnman& connman, Ban
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery([this] { this->CheckForStaleTipAndEvictPeers(); }, std::chrono::seconds{EXTRA_PEER_CHECK_INTERVAL});
+    scheduler.scheduleEvery([this] { this->CheckForStaleTipAndEvictPeers(); }, std::chrono::seconds{EXTRA_PEER_CHECK_INTERVAL}, "CheckForStaleTipAndEvictPeers");
 
     // schedule next run for 10-15 minutes in the future
     const std::chrono::milliseconds delta = std::chrono::minutes{10} + GetRandMillis(std::chrono::minutes{5});
-    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta);
+    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta, "ReattemptInitialBroadcast");
 }
 
 /**
@@ -1571,7 +1574,7 @@ void static ProcessGetBlockData(CNode& pfrom, const CChainParams& chainparams, c
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams, /* tx_arena */ true))
                 assert(!"cannot load block from disk");
             pblock = pblockRead;
         }
@@ -1718,7 +1721,7 @@ void static ProcessGetData(CNode& pfrom, Peer& peer, const CChainParams& chainpa
             }
             for (const uint256& parent_txid : parent_ids_to_add) {
                 // Relaying a transaction with a recent but unconfirmed parent.
-                if (WITH_LOCK(pfrom.m_tx_relay->cs_tx_inventory, return !pfrom.m_tx_relay->filterInventoryKnown.contains(parent_txid))) {
+                if (WITH_LOCK(g_known_inventory_mutex, return !g_known_inventory.contains(pfrom.GetId(), parent_txid))) {
                     LOCK(cs_main);
                     State(pfrom.GetId())->m_recently_announced_invs.insert(parent_txid);
                 }
@@ -1969,32 +1972,41 @@ void PeerManager::ProcessHeadersMessage(CNode& pfrom, const std::vector<CBlockHe
 /**
  * Reconsider orphan transactions after a parent has been accepted to the mempool.
  *
- * @param[in/out]  orphan_work_set  The set of orphan transactions to reconsider. Generally only one
- *                                  orphan will be reconsidered on each call of this function. This set
- *                                  may be added to if accepting an orphan causes its children to be
- *                                  reconsidered.
+ * @param[in/out]  orphan_work_set  The set of orphan transactions to reconsider. Up to
+ *                                  MAX_ORPHAN_BATCH_SIZE orphans are reconsidered together on each
+ *                                  call of this function. This set may be added to if accepting an
+ *                                  orphan causes its children to be reconsidered.
  */
 void PeerManager::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(g_cs_orphans);
 
-    while (!orphan_work_set.empty()) {
+    std::vector<CTransactionRef> batch;
+    std::vector<NodeId> from_peers;
+    while (!orphan_work_set.empty() && batch.size() < MAX_ORPHAN_BATCH_SIZE) {
         const uint256 orphanHash = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
 
         auto orphan_it = mapOrphanTransactions.find(orphanHash);
         if (orphan_it == mapOrphanTransactions.end()) continue;
+        batch.push_back(orphan_it->second.tx);
+        from_peers.push_back(orphan_it->second.fromPeer);
+    }
+    if (batch.empty()) return;
 
-        const CTransactionRef porphanTx = orphan_it->second.tx;
-        TxValidationState state;
-        std::list<CTransactionRef> removed_txn;
+    std::vector<MempoolBatchResult> results = AcceptToMemoryPoolBatch(m_mempool, batch);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const CTransactionRef& porphanTx = batch[i];
+        const uint256& orphanHash = porphanTx->GetHash();
+        const TxValidationState& state = results[i].m_state;
+        const std::list<CTransactionRef>& removed_txn = results[i].m_replaced_transactions;
 
-        if (AcceptToMemoryPool(m_mempool, state, porphanTx, &removed_txn, false /* bypass_limits */)) {
+        if (state.IsValid()) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
             RelayTransaction(orphanHash, porphanTx->GetWitnessHash(), m_connman);
-            for (unsigned int i = 0; i < porphanTx->vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
+            for (unsigned int n = 0; n < porphanTx->vout.size(); n++) {
+                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, n));
                 if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
                     for (const auto& elem : it_by_prev->second) {
                         orphan_work_set.insert(elem->first);
@@ -2005,15 +2017,14 @@ void PeerManager::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
             for (const CTransactionRef& removedTx : removed_txn) {
                 AddToCompactExtraTransactions(removedTx);
             }
-            break;
         } else if (state.GetResult() != TxValidationResult::TX_MISSING_INPUTS) {
             if (state.IsInvalid()) {
                 LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s from peer=%d. %s\n",
                     orphanHash.ToString(),
-                    orphan_it->second.fromPeer,
+                    from_peers[i],
                     state.ToString());
                 // Maybe punish peer that gave us an invalid orphan tx
-                MaybePunishNodeForTx(orphan_it->second.fromPeer, state);
+                MaybePunishNodeForTx(from_peers[i], state);
             }
             // Has inputs but not accepted to mempool
             // Probably non-standard or insufficient fee
@@ -2049,7 +2060,6 @@ void PeerManager::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
                 }
             }
             EraseOrphanTx(orphanHash);
-            break;
         }
     }
     m_mempool.check(&::ChainstateActive().CoinsTip());
@@ -2275,6 +2285,8 @@ void PeerManager::ProcessMessage(CNode& pfrom, const std::string& msg_type, CDat
                                          const std::chrono::microseconds time_received,
                                          const std::atomic<bool>& interruptMsgProc)
 {
+    TRACE_SPAN("ProcessMessage", msg_type);
+    TRACE3(net, inbound_message, pfrom.GetId(), msg_type.c_str(), vRecv.size());
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(msg_type), vRecv.size(), pfrom.GetId());
     if (gArgs.IsArgSet("-dropmessagestest") && GetRand(gArgs.GetArg("-dropmessagestest", 0)) == 0)
     {
@@ -2965,7 +2977,7 @@ void PeerManager::ProcessMessage(CNode& pfrom, const std::string& msg_type, CDat
         const uint256& hash = nodestate->m_wtxid_relay ? wtxid : txid;
         pfrom.AddKnownTx(hash);
         if (nodestate->m_wtxid_relay && txid != wtxid) {
-            // Insert txid into filterInventoryKnown, even for
+            // Insert txid into g_known_inventory, even for
             // wtxidrelay peers. This prevents re-adding of
             // unconfirmed parents to the recently_announced
             // filter, when a child tx is requested. See
@@ -4364,7 +4376,7 @@ bool PeerManager::SendMessages(CNode* pto)
                         if (pto->m_tx_relay->pfilter) {
                             if (!pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                         }
-                        pto->m_tx_relay->filterInventoryKnown.insert(hash);
+                        WITH_LOCK(g_known_inventory_mutex, g_known_inventory.insert(pto->GetId(), hash));
                         // Responses to MEMPOOL requests bypass the m_recently_announced_invs filter.
                         vInv.push_back(inv);
                         if (vInv.size() == MAX_INV_SZ) {
@@ -4377,11 +4389,21 @@ bool PeerManager::SendMessages(CNode* pto)
 
                 // Determine transactions to relay
                 if (fSendTrickle) {
-                    // Produce a vector with all candidates for sending
+                    // Produce a vector with all candidates for sending, dropping
+                    // the ones the peer already knows about with a single probe
+                    // of the known inventory filter
+                    const std::vector<uint256> vCandidates(pto->m_tx_relay->setInventoryTxToSend.begin(), pto->m_tx_relay->setInventoryTxToSend.end());
+                    std::vector<bool> vKnown;
+                    WITH_LOCK(g_known_inventory_mutex, g_known_inventory.contains(pto->GetId(), vCandidates, vKnown));
                     std::vector<std::set<uint256>::iterator> vInvTx;
-                    vInvTx.reserve(pto->m_tx_relay->setInventoryTxToSend.size());
-                    for (std::set<uint256>::iterator it = pto->m_tx_relay->setInventoryTxToSend.begin(); it != pto->m_tx_relay->setInventoryTxToSend.end(); it++) {
-                        vInvTx.push_back(it);
+                    vInvTx.reserve(vCandidates.size());
+                    std::set<uint256>::iterator candidate_it = pto->m_tx_relay->setInventoryTxToSend.begin();
+                    for (size_t i = 0; i < vCandidates.size(); i++) {
+                        if (vKnown[i]) {
+                            candidate_it = pto->m_tx_relay->setInventoryTxToSend.erase(candidate_it);
+                        } else {
+                            vInvTx.push_back(candidate_it++);
+                        }
                     }
                     CFeeRate filterrate;
                     {
@@ -4395,6 +4417,7 @@ bool PeerManager::SendMessages(CNode* pto)
                     // No reason to drain out at many times the network's capacity,
                     // especially since we have many peers and some will draw much shorter delays.
                     unsigned int nRelayedTransactions = 0;
+                    std::vector<uint256> vNowKnown;
                     LOCK(pto->m_tx_relay->cs_filter);
                     while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
                         // Fetch the top element from the heap
@@ -4405,10 +4428,6 @@ bool PeerManager::SendMessages(CNode* pto)
                         CInv inv(state.m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
                         // Remove it from the to-be-sent set
                         pto->m_tx_relay->setInventoryTxToSend.erase(it);
-                        // Check if not in the filter already
-                        if (pto->m_tx_relay->filterInventoryKnown.contains(hash)) {
-                            continue;
-                        }
                         // Not in the mempool anymore? don't bother sending it.
                         auto txinfo = m_mempool.info(ToGenTxid(inv));
                         if (!txinfo.tx) {
@@ -4447,16 +4466,20 @@ bool PeerManager::SendMessages(CNode* pto)
                             m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
                             vInv.clear();
                         }
-                        pto->m_tx_relay->filterInventoryKnown.insert(hash);
+                        vNowKnown.push_back(hash);
                         if (hash != txid) {
-                            // Insert txid into filterInventoryKnown, even for
+                            // Insert txid into g_known_inventory, even for
                             // wtxidrelay peers. This prevents re-adding of
                             // unconfirmed parents to the recently_announced
                             // filter, when a child tx is requested. See
                             // ProcessGetData().
-                            pto->m_tx_relay->filterInventoryKnown.insert(txid);
+                            vNowKnown.push_back(txid);
                         }
                     }
+                    LOCK(g_known_inventory_mutex);
+                    for (const uint256& known : vNowKnown) {
+                        g_known_inventory.insert(pto->GetId(), known);
+                    }
                 }
             }
         }
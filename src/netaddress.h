@@ -11,10 +11,12 @@
 
 #include <attributes.h>
 #include <compat.h>
+#include <crypto/siphash.h>
 #include <prevector.h>
 #include <serialize.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
+#include <util/asmap.h>
 #include <util/string.h>
 
 #include <array>
@@ -198,9 +200,9 @@ class CNetAddr
         // The AS on the BGP path to the node we use to diversify
         // peers in AddrMan bucketing based on the AS infrastructure.
         // The ip->AS mapping depends on how asmap is constructed.
-        uint32_t GetMappedAS(const std::vector<bool> &asmap) const;
+        uint32_t GetMappedAS(const ASMap& asmap) const;
 
-        std::vector<unsigned char> GetGroup(const std::vector<bool> &asmap) const;
+        std::vector<unsigned char> GetGroup(const ASMap& asmap) const;
         std::vector<unsigned char> GetAddrBytes() const;
         int GetReachabilityFrom(const CNetAddr *paddrPartner = nullptr) const;
 
@@ -246,6 +248,7 @@ class CNetAddr
         }
 
         friend class CSubNet;
+        friend class CNetAddrHash;
 
     private:
         /**
@@ -551,6 +554,25 @@ class CService : public CNetAddr
         }
 };
 
+/** Salted hasher for keying hash tables by CNetAddr, consistent with its operator== */
+class CNetAddrHash
+{
+public:
+    CNetAddrHash(uint64_t salt_k0, uint64_t salt_k1) : m_salt_k0(salt_k0), m_salt_k1(salt_k1) {}
+
+    size_t operator()(const CNetAddr& a) const noexcept
+    {
+        CSipHasher hasher(m_salt_k0, m_salt_k1);
+        hasher.Write(a.m_net);
+        hasher.Write(a.m_addr.data(), a.m_addr.size());
+        return static_cast<size_t>(hasher.Finalize());
+    }
+
+private:
+    const uint64_t m_salt_k0;
+    const uint64_t m_salt_k1;
+};
+
 bool SanityCheckASMap(const std::vector<bool>& asmap);
 
 #endif // BITCOIN_NETADDRESS_H
@@ -12,6 +12,9 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <algorithm>
+#include <memory>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -135,10 +138,14 @@ public:
         *(static_cast<CBlockHeader*>(this)) = header;
     }
 
-    SERIALIZE_METHODS(CBlock, obj)
+    SERIALIZE_METHODS(CBlock, obj) { SerializeFields<DefaultFormatter>(obj, s, ser_action); }
+
+    //! The fields of a block, with the transactions (de)serialized by TxFormatter
+    template <typename TxFormatter, typename Type, typename Stream, typename Operation>
+    static void SerializeFields(Type& obj, Stream& s, Operation ser_action)
     {
         READWRITEAS(CBlockHeader, obj);
-        READWRITE(obj.vtx);
+        READWRITE(Using<TxFormatter>(obj.vtx));
         if (obj.vtx.size() > 1 && obj.vtx[1]->IsCoinStake())
             READWRITE(obj.vchBlockSig);
     }
@@ -177,6 +184,59 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * Formatter for the transactions of a block that deserializes them into a few
+ * shared chunks, rather than making one allocation per transaction. Every
+ * CTransactionRef shares ownership of its whole chunk, so a transaction that
+ * is kept around keeps the rest of its chunk alive: only use this for blocks
+ * whose transactions are dropped along with the block.
+ */
+struct TransactionArenaFormatter
+{
+    //! Transactions per chunk, which also bounds what a bogus transaction count can allocate up front
+    static constexpr size_t CHUNK_TRANSACTIONS = 1024;
+
+    template <typename Stream>
+    void Ser(Stream& s, const std::vector<CTransactionRef>& vtx)
+    {
+        s << vtx;
+    }
+
+    template <typename Stream>
+    void Unser(Stream& s, std::vector<CTransactionRef>& vtx)
+    {
+        const size_t count = ReadCompactSize(s);
+        vtx.clear();
+        vtx.reserve(std::min(count, size_t{CHUNK_TRANSACTIONS}));
+        std::shared_ptr<std::vector<CTransaction>> chunk;
+        for (size_t i = 0; i < count; ++i) {
+            if (!chunk || chunk->size() == chunk->capacity()) {
+                chunk = std::make_shared<std::vector<CTransaction>>();
+                chunk->reserve(std::min(count - i, size_t{CHUNK_TRANSACTIONS}));
+            }
+            // Never reallocates, so the pointers handed out stay valid
+            chunk->emplace_back(deserialize, s);
+            vtx.emplace_back(chunk, &chunk->back());
+        }
+    }
+};
+
+/** Formatter for a block whose transactions are deserialized with TransactionArenaFormatter */
+struct BlockTxArenaFormatter
+{
+    template <typename Stream>
+    void Ser(Stream& s, const CBlock& block)
+    {
+        CBlock::SerializeFields<TransactionArenaFormatter>(block, s, CSerActionSerialize());
+    }
+
+    template <typename Stream>
+    void Unser(Stream& s, CBlock& block)
+    {
+        CBlock::SerializeFields<TransactionArenaFormatter>(block, s, CSerActionUnserialize());
+    }
+};
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
@@ -569,8 +569,15 @@ std::string PSBTRoleName(PSBTRole role);
 /** Checks whether a PSBTInput is already signed. */
 bool PSBTInputSigned(const PSBTInput& input);
 
-/** Signs a PSBTInput, verifying that all provided data matches what is being signed. */
-bool SignPSBTInput(const SigningProvider& provider, PartiallySignedTransaction& psbt, int index, int sighash = SIGHASH_ALL, SignatureData* out_sigdata = nullptr, bool use_dummy = false);
+/** Compute the sighash midstates shared by all inputs of a PSBT, to be passed to SignPSBTInput. */
+PrecomputedTransactionData PrecomputePSBTData(const PartiallySignedTransaction& psbt);
+
+/** Signs a PSBTInput, verifying that all provided data matches what is being signed.
+ *
+ * txdata should be the result of PrecomputePSBTData on psbt; it may be nullptr when no signature
+ * is created, e.g. when only filling in scripts and key paths.
+ */
+bool SignPSBTInput(const SigningProvider& provider, PartiallySignedTransaction& psbt, int index, const PrecomputedTransactionData* txdata, int sighash = SIGHASH_ALL, SignatureData* out_sigdata = nullptr, bool use_dummy = false);
 
 /** Counts the unsigned inputs of a PSBT. */
 size_t CountPSBTUnsignedInputs(const PartiallySignedTransaction& psbt);
@@ -582,7 +589,8 @@ size_t CountPSBTUnsignedInputs(const PartiallySignedTransaction& psbt);
 void UpdatePSBTOutput(const SigningProvider& provider, PartiallySignedTransaction& psbt, int index);
 
 /**
- * Finalizes a PSBT if possible, combining partial signatures.
+ * Finalizes a PSBT if possible, combining partial signatures. The inputs are
+ * finalized in parallel with shared sighash midstates.
  *
  * @param[in,out] psbtx PartiallySignedTransaction to finalize
  * return True if the PSBT is now complete, false otherwise
@@ -10,6 +10,9 @@
 /* Milliseconds between model updates */
 static const int MODEL_UPDATE_DELAY = 250;
 
+/* TransactionTableModel -- Number of wallet transactions fetched at a time */
+static const int TRANSACTION_PAGE_SIZE = 1000;
+
 /* AskPassphraseDialog -- Maximum passphrase length */
 static const int MAX_PASSPHRASE_SIZE = 1024;
 
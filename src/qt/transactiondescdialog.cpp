@@ -8,6 +8,7 @@
 #include <qt/guiutil.h>
 #include <qt/transactiontablemodel.h>
 
+#include <QDateTime>
 #include <QModelIndex>
 
 TransactionDescDialog::TransactionDescDialog(const QModelIndex &idx, QWidget *parent) :
@@ -15,7 +16,11 @@ TransactionDescDialog::TransactionDescDialog(const QModelIndex &idx, QWidget *pa
     ui(new Ui::TransactionDescDialog)
 {
     ui->setupUi(this);
-    setWindowTitle(tr("Details for %1").arg(idx.data(TransactionTableModel::TxHashRole).toString()));
+    if (idx.data(TransactionTableModel::StakeGroupSizeRole).toInt() > 0) {
+        setWindowTitle(tr("Details for stakes of %1").arg(idx.data(TransactionTableModel::DateRole).toDate().toString(Qt::SystemLocaleShortDate)));
+    } else {
+        setWindowTitle(tr("Details for %1").arg(idx.data(TransactionTableModel::TxHashRole).toString()));
+    }
     QString desc = idx.data(TransactionTableModel::LongDescriptionRole).toString();
     ui->detailText->setHtml(desc);
 
@@ -39,8 +39,6 @@ bool TransactionFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &
     int type = index.data(TransactionTableModel::TypeRole).toInt();
     if (fHideOrphans && isOrphan(status, type))
         return false;
-    if (!(TYPE(type) & typeFilter))
-        return false;
 
     bool involvesWatchAddress = index.data(TransactionTableModel::WatchonlyRole).toBool();
     if (involvesWatchAddress && watchOnlyFilter == WatchOnlyFilter_No)
@@ -49,17 +47,11 @@ bool TransactionFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &
         return false;
 
     QDateTime datetime = index.data(TransactionTableModel::DateRole).toDateTime();
-    if (datetime < dateFrom || datetime > dateTo)
-        return false;
-
     QString address = index.data(TransactionTableModel::AddressRole).toString();
     QString label = index.data(TransactionTableModel::LabelRole).toString();
     QString txid = index.data(TransactionTableModel::TxHashRole).toString();
-    if (!address.contains(m_search_string, Qt::CaseInsensitive) &&
-        !  label.contains(m_search_string, Qt::CaseInsensitive) &&
-        !   txid.contains(m_search_string, Qt::CaseInsensitive)) {
+    if (!filterAcceptsRecord(type, datetime, address, label, txid))
         return false;
-    }
 
     qint64 amount = llabs(index.data(TransactionTableModel::AmountRole).toLongLong());
     if (amount < minAmount)
@@ -68,6 +60,33 @@ bool TransactionFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &
     return true;
 }
 
+bool TransactionFilterProxy::filterAcceptsRecord(int type, const QDateTime& datetime, const QString& address, const QString& label, const QString& txid) const
+{
+    if (!(TYPE(type) & typeFilter))
+        return false;
+
+    if (datetime < dateFrom || datetime > dateTo)
+        return false;
+
+    return address.contains(m_search_string, Qt::CaseInsensitive) ||
+             label.contains(m_search_string, Qt::CaseInsensitive) ||
+              txid.contains(m_search_string, Qt::CaseInsensitive);
+}
+
+void TransactionFilterProxy::setFilters(const TransactionFilterProxy& other)
+{
+    dateFrom = other.dateFrom;
+    dateTo = other.dateTo;
+    m_search_string = other.m_search_string;
+    typeFilter = other.typeFilter;
+    watchOnlyFilter = other.watchOnlyFilter;
+    minAmount = other.minAmount;
+    limitRows = other.limitRows;
+    showInactive = other.showInactive;
+    fHideOrphans = other.fHideOrphans;
+    invalidateFilter();
+}
+
 void TransactionFilterProxy::setDateRange(const QDateTime &from, const QDateTime &to)
 {
     this->dateFrom = from;
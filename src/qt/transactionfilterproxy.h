@@ -35,6 +35,8 @@ public:
     };
 
     void setDateRange(const QDateTime &from, const QDateTime &to);
+    QDateTime getDateFrom() const { return dateFrom; }
+    QDateTime getDateTo() const { return dateTo; }
     void setSearchString(const QString &);
     /**
       @note Type filter takes a bit field created with TYPE() or ALL_TYPES
@@ -52,6 +54,12 @@ public:
     /** Set whether to hide orphan stakes. */
     void setHideOrphans(bool fHide);
 
+    /** Take over the filters of another proxy, e.g. to apply them to a different model */
+    void setFilters(const TransactionFilterProxy& other);
+
+    /** Date, type and search filters, which are also run in the wallet query when exporting */
+    bool filterAcceptsRecord(int type, const QDateTime& datetime, const QString& address, const QString& label, const QString& txid) const;
+
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     static bool isOrphan(const int status, const int type);
 
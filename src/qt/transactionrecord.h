@@ -130,6 +130,9 @@ public:
     /** Whether the transaction was sent/received with a watch-only address */
     bool involvesWatchAddress;
 
+    /** Number of stakes of one day this record sums up, 0 for a single transaction */
+    int stakeGroupSize{0};
+
     /** Return the unique identifier for this transaction (part) */
     QString getTxHash() const;
 
@@ -19,12 +19,15 @@
 #include <uint256.h>
 
 #include <algorithm>
+#include <map>
+#include <utility>
 
 #include <QColor>
 #include <QDateTime>
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QSettings>
 
 
 // Amount column is right-aligned it contains numbers
@@ -95,25 +98,243 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
+    /* Transactions are loaded from the wallet newest first, one page at a time
+     * as the view scrolls. Position in the wallet's transaction order to
+     * continue from.
+     */
+    interfaces::WalletTxsPagePos pagePos;
+
+    /* Conditions the wallet checks when fetching pages, e.g. to skip orphaned
+     * stakes instead of filtering them in the view. Transactions must also have
+     * a record recordFilter accepts, if set, which is checked here without
+     * locking the wallet.
+     */
+    interfaces::WalletTxsPageFilter pageFilter;
+    std::function<bool(const TransactionRecord&)> recordFilter;
+
+    /* Set while rows of transactions already known are inserted, e.g. of a
+     * fetched page or of a stake group that changed
+     */
+    bool fInsertingKnownRows = false;
+
+    /* Stakes in the main chain are grouped by day into one row summing them
+     * up, which can be expanded to show the stakes one by one. The group row
+     * has the hash of the newest stake of the day. A day with a single stake
+     * just shows that stake.
+     */
+    struct StakeGroup
+    {
+        QList<TransactionRecord> members;
+        uint256 anchor;
+        bool expanded = false;
+    };
+    bool fGroupStakes = true;
+    std::map<qint64, StakeGroup> stakeGroups; // by Julian day
+    std::map<uint256, qint64> stakeGroupDays; // day of each grouped stake
+
     bool fQueueNotifications = false;
     std::vector< TransactionNotification > vQueueNotifications;
 
     void NotifyTransactionChanged(const uint256 &hash, ChangeType status);
     void ShowProgress(const std::string &title, int nProgress);
 
-    /* Query entire wallet anew from core.
+    /* Query the newest page of the wallet anew from core.
      */
     void refreshWallet(interfaces::Wallet& wallet)
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
-        {
-            for (const auto& wtx : wallet.getWalletTxs()) {
-                if (TransactionRecord::showTransaction()) {
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
-                }
+        stakeGroups.clear();
+        stakeGroupDays.clear();
+        pagePos = interfaces::WalletTxsPagePos();
+        fetchPage(wallet, false);
+    }
+
+    /* Fetch the next page of older transactions from core, and insert their
+       records in hash order. The wallet is locked for one page worth of
+       transactions at a time, and filtered pages can come back short, so
+       keep asking until a page is filled or there is nothing left.
+     */
+    void fetchPage(interfaces::Wallet& wallet, bool notify)
+    {
+        fInsertingKnownRows = true;
+        int fetched = 0;
+        while (fetched < TRANSACTION_PAGE_SIZE && !pagePos.end) {
+            for (const auto& wtx : wallet.getWalletTxsPage(pagePos, TRANSACTION_PAGE_SIZE, pageFilter)) {
+                if (insertTransaction(wtx, notify)) ++fetched;
+            }
+        }
+        fInsertingKnownRows = false;
+    }
+
+    /* Insert the records of a transaction, or add it to the group of stakes
+       of its day, unless the transaction is already in the model or filtered
+       out.
+     */
+    bool insertTransaction(const interfaces::WalletTx& wtx, bool notify)
+    {
+        if (!TransactionRecord::showTransaction()) return false;
+        const uint256 hash = wtx.tx->GetHash();
+        QList<TransactionRecord>::iterator lower = std::lower_bound(
+            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+        // Already added by a notification since the previous page
+        if (lower != cachedWallet.end() && lower->hash == hash) return false;
+        if (stakeGroupDays.count(hash)) return false;
+        QList<TransactionRecord> toInsert = TransactionRecord::decomposeTransaction(wtx);
+        if (toInsert.isEmpty()) return false;
+        if (recordFilter && std::none_of(toInsert.begin(), toInsert.end(), recordFilter)) return false;
+        if (fGroupStakes && wtx.is_coinstake && wtx.is_in_main_chain && toInsert.size() == 1) {
+            addToStakeGroup(toInsert.front(), notify);
+            return true;
+        }
+        int insert_idx = lower - cachedWallet.begin();
+        if (notify) parent->beginInsertRows(QModelIndex(), insert_idx, insert_idx + toInsert.size() - 1);
+        for (const TransactionRecord &rec : toInsert) {
+            cachedWallet.insert(insert_idx, rec);
+            insert_idx += 1;
+        }
+        if (notify) parent->endInsertRows();
+        return true;
+    }
+
+    /* Insert a record after the records with the same hash */
+    void insertRecord(const TransactionRecord& rec, bool notify)
+    {
+        const int idx = std::upper_bound(cachedWallet.begin(), cachedWallet.end(), rec.hash, TxLessThan()) - cachedWallet.begin();
+        if (notify) parent->beginInsertRows(QModelIndex(), idx, idx);
+        cachedWallet.insert(idx, rec);
+        if (notify) parent->endInsertRows();
+    }
+
+    /* Remove the stake group row, or else the single transaction row, with the given hash */
+    void removeRecord(const uint256& hash, bool group_row, bool notify)
+    {
+        QList<TransactionRecord>::iterator it = std::lower_bound(
+            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+        for (; it != cachedWallet.end() && it->hash == hash; ++it) {
+            if ((it->stakeGroupSize > 0) != group_row) continue;
+            const int idx = it - cachedWallet.begin();
+            if (notify) parent->beginRemoveRows(QModelIndex(), idx, idx);
+            cachedWallet.erase(it);
+            if (notify) parent->endRemoveRows();
+            return;
+        }
+    }
+
+    /* Rows shown for a group of stakes: a single stake as it is, otherwise a
+       row summing the stakes up, followed by the stakes when expanded. The
+       sum has the address of the stakes if they all share it.
+     */
+    QList<TransactionRecord> stakeGroupRows(const StakeGroup& group) const
+    {
+        if (group.members.size() == 1) return group.members;
+        TransactionRecord sum(group.anchor, 0, TransactionRecord::StakeMint, group.members.front().address, 0, 0);
+        sum.involvesWatchAddress = false;
+        sum.stakeGroupSize = group.members.size();
+        for (const TransactionRecord& rec : group.members) {
+            sum.debit += rec.debit;
+            sum.credit += rec.credit;
+            sum.involvesWatchAddress |= rec.involvesWatchAddress;
+            if (rec.address != sum.address) sum.address.clear();
+            if (rec.hash == group.anchor) {
+                sum.time = rec.time;
+                sum.idx = rec.idx;
+            }
+        }
+        QList<TransactionRecord> rows;
+        rows.append(sum);
+        if (group.expanded) rows.append(group.members);
+        return rows;
+    }
+
+    void insertStakeGroupRows(const StakeGroup& group, bool notify)
+    {
+        for (const TransactionRecord& rec : stakeGroupRows(group)) {
+            insertRecord(rec, notify);
+        }
+    }
+
+    void removeStakeGroupRows(const StakeGroup& group, bool notify)
+    {
+        for (const TransactionRecord& rec : stakeGroupRows(group)) {
+            removeRecord(rec.hash, rec.stakeGroupSize > 0, notify);
+        }
+    }
+
+    static void setStakeGroupAnchor(StakeGroup& group)
+    {
+        group.anchor = std::max_element(group.members.begin(), group.members.end(),
+            [](const TransactionRecord& a, const TransactionRecord& b) { return a.time < b.time; })->hash;
+    }
+
+    /* Add a stake to the group of its day. The group's rows are replaced, which
+       is not to be taken for new transactions.
+     */
+    void addToStakeGroup(const TransactionRecord& rec, bool notify)
+    {
+        const bool inserting_known_rows = fInsertingKnownRows;
+        fInsertingKnownRows = true;
+        const qint64 day = QDateTime::fromTime_t(static_cast<uint>(rec.time)).date().toJulianDay();
+        StakeGroup& group = stakeGroups[day];
+        if (!group.members.isEmpty()) removeStakeGroupRows(group, notify);
+        group.members.append(rec);
+        setStakeGroupAnchor(group);
+        stakeGroupDays[rec.hash] = day;
+        insertStakeGroupRows(group, notify);
+        fInsertingKnownRows = inserting_known_rows;
+    }
+
+    /* Take a stake out of its group, and out of the model */
+    void removeFromStakeGroup(std::map<uint256, qint64>::iterator grouped)
+    {
+        const uint256 hash = grouped->first;
+        const qint64 day = grouped->second;
+        stakeGroupDays.erase(grouped);
+        StakeGroup& group = stakeGroups[day];
+        fInsertingKnownRows = true;
+        removeStakeGroupRows(group, true);
+        for (int i = 0; i < group.members.size(); ++i) {
+            if (group.members[i].hash == hash) {
+                group.members.removeAt(i);
+                break;
             }
         }
+        if (group.members.isEmpty()) {
+            stakeGroups.erase(day);
+        } else {
+            setStakeGroupAnchor(group);
+            insertStakeGroupRows(group, true);
+        }
+        fInsertingKnownRows = false;
+    }
+
+    /* Show or hide the stakes of the group with the given anchor */
+    void toggleStakeGroup(const uint256& anchor)
+    {
+        auto grouped = stakeGroupDays.find(anchor);
+        if (grouped == stakeGroupDays.end()) return;
+        StakeGroup& group = stakeGroups[grouped->second];
+        if (group.anchor != anchor || group.members.size() < 2) return;
+        fInsertingKnownRows = true;
+        for (const TransactionRecord& rec : group.members) {
+            if (group.expanded) {
+                removeRecord(rec.hash, false, true);
+            } else {
+                insertRecord(rec, true);
+            }
+        }
+        group.expanded = !group.expanded;
+        fInsertingKnownRows = false;
+    }
+
+    /* Stakes of the group with the given anchor, if there is one */
+    const QList<TransactionRecord>* stakeGroupMembers(const uint256& anchor) const
+    {
+        auto grouped = stakeGroupDays.find(anchor);
+        if (grouped == stakeGroupDays.end()) return nullptr;
+        const StakeGroup& group = stakeGroups.at(grouped->second);
+        if (group.anchor != anchor) return nullptr;
+        return &group.members;
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -125,6 +346,19 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        // A grouped stake stays in its group while it is in the main chain. Otherwise it
+        // is taken out of the group, and handled like any other transaction from here on.
+        auto grouped = stakeGroupDays.find(hash);
+        if (grouped != stakeGroupDays.end()) {
+            if (status == CT_NEW) return;
+            if (status == CT_UPDATED && showTransaction && wallet.getWalletTx(hash).is_in_main_chain) {
+                markNeedsUpdate(hash);
+                return;
+            }
+            removeFromStakeGroup(grouped);
+            if (status == CT_DELETED) return;
+        }
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = std::lower_bound(
             cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -164,19 +398,7 @@ public:
                     break;
                 }
                 // Added -- insert at the right position
-                QList<TransactionRecord> toInsert =
-                        TransactionRecord::decomposeTransaction(wtx);
-                if(!toInsert.isEmpty()) /* only if something to insert */
-                {
-                    parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
-                    int insert_idx = lowerIndex;
-                    for (const TransactionRecord &rec : toInsert)
-                    {
-                        cachedWallet.insert(insert_idx, rec);
-                        insert_idx += 1;
-                    }
-                    parent->endInsertRows();
-                }
+                insertTransaction(wtx, true);
             }
             break;
         case CT_DELETED:
@@ -191,16 +413,33 @@ public:
             parent->endRemoveRows();
             break;
         case CT_UPDATED:
+            // A stake that made it into the main chain joins the group of its day
+            if (fGroupStakes && inModel && lower->type == TransactionRecord::StakeMint) {
+                interfaces::WalletTx wtx = wallet.getWalletTx(hash);
+                if (wtx.tx && wtx.is_in_main_chain) {
+                    parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
+                    cachedWallet.erase(lower, upper);
+                    parent->endRemoveRows();
+                    insertTransaction(wtx, true);
+                    break;
+                }
+            }
             // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
             // visible transactions.
-            for (int i = lowerIndex; i < upperIndex; i++) {
-                TransactionRecord *rec = &cachedWallet[i];
-                rec->status.needsUpdate = true;
-            }
+            markNeedsUpdate(hash);
             break;
         }
     }
 
+    void markNeedsUpdate(const uint256& hash)
+    {
+        QList<TransactionRecord>::iterator it = std::lower_bound(
+            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+        for (; it != cachedWallet.end() && it->hash == hash; ++it) {
+            it->status.needsUpdate = true;
+        }
+    }
+
     int size()
     {
         return cachedWallet.size();
@@ -241,7 +480,7 @@ public:
     }
 };
 
-TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle, WalletModel *parent):
+TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle, WalletModel *parent, bool group_stakes):
         QAbstractTableModel(parent),
         walletModel(parent),
         priv(new TransactionTablePriv(this)),
@@ -249,6 +488,8 @@ TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle
         platformStyle(_platformStyle)
 {
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Label") << XEPUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
+    priv->pageFilter.skip_orphan_stakes = QSettings().value("fHideOrphans", true).toBool();
+    priv->fGroupStakes = group_stakes;
     priv->refreshWallet(walletModel->wallet());
 
     connect(walletModel->getOptionsModel(), &OptionsModel::displayUnitChanged, this, &TransactionTableModel::updateDisplayUnit);
@@ -287,6 +528,52 @@ void TransactionTableModel::updateConfirmations()
     Q_EMIT dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !priv->pagePos.end;
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid()) return;
+    priv->fetchPage(walletModel->wallet(), true);
+}
+
+void TransactionTableModel::setHideOrphans(bool fHide)
+{
+    if (priv->pageFilter.skip_orphan_stakes == fHide) return;
+    // Orphans are skipped when pages are fetched, so start over from the newest page
+    beginResetModel();
+    priv->pageFilter.skip_orphan_stakes = fHide;
+    priv->refreshWallet(walletModel->wallet());
+    endResetModel();
+}
+
+void TransactionTableModel::setFetchFilter(int64_t time_from, int64_t time_to, std::function<bool(const TransactionRecord&)> filter)
+{
+    beginResetModel();
+    priv->pageFilter.time_from = time_from;
+    priv->pageFilter.time_to = time_to;
+    priv->recordFilter = std::move(filter);
+    priv->refreshWallet(walletModel->wallet());
+    endResetModel();
+}
+
+bool TransactionTableModel::insertingKnownRows() const
+{
+    return priv->fInsertingKnownRows;
+}
+
+void TransactionTableModel::toggleStakeGroup(const QModelIndex &index)
+{
+    if (!index.isValid()) return;
+    const TransactionRecord *rec = static_cast<TransactionRecord*>(index.internalPointer());
+    if (rec->stakeGroupSize > 0) {
+        const uint256 hash = rec->hash;
+        priv->toggleStakeGroup(hash);
+    }
+}
+
 int TransactionTableModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -380,6 +667,9 @@ QString TransactionTableModel::formatTxType(const TransactionRecord *wtx) const
     case TransactionRecord::Generated:
         return tr("Mined");
     case TransactionRecord::StakeMint:
+        if (wtx->stakeGroupSize > 0) {
+            return tr("Mint by stake (%1)").arg(wtx->stakeGroupSize);
+        }
         return tr("Mint by stake");
     default:
         return QString();
@@ -415,10 +705,15 @@ QString TransactionTableModel::formatTxToAddress(const TransactionRecord *wtx, b
     {
     case TransactionRecord::RecvFromOther:
         return QString::fromStdString(wtx->address) + watchAddress;
+    case TransactionRecord::StakeMint:
+        // Stakes of a group can go to different addresses
+        if (wtx->address.empty()) {
+            return tr("(n/a)") + watchAddress;
+        }
+        return lookupAddress(wtx->address, tooltip) + watchAddress;
     case TransactionRecord::RecvWithAddress:
     case TransactionRecord::SendToAddress:
     case TransactionRecord::Generated:
-    case TransactionRecord::StakeMint:
         return lookupAddress(wtx->address, tooltip) + watchAddress;
     case TransactionRecord::SendToOther:
         return QString::fromStdString(wtx->address) + watchAddress;
@@ -516,9 +811,31 @@ QString TransactionTableModel::formatTooltip(const TransactionRecord *rec) const
     {
         tooltip += QString(" ") + formatTxToAddress(rec, true);
     }
+    if (rec->stakeGroupSize > 0) {
+        tooltip += QString("\n") + tr("Double-click to show or hide the stakes of this day");
+    }
     return tooltip;
 }
 
+QString TransactionTableModel::describeStakeGroup(const TransactionRecord *rec) const
+{
+    const int unit = walletModel->getOptionsModel()->getDisplayUnit();
+    QString strHTML;
+    strHTML += "<html><font face='verdana, arial, helvetica, sans-serif'>";
+    strHTML += "<b>" + tr("Date") + ":</b> " + QDateTime::fromTime_t(static_cast<uint>(rec->time)).date().toString(Qt::SystemLocaleLongDate) + "<br>";
+    strHTML += "<b>" + tr("Stakes") + ":</b> " + QString::number(rec->stakeGroupSize) + "<br>";
+    strHTML += "<b>" + tr("Net amount") + ":</b> " + XEPUnits::formatHtmlWithUnit(unit, rec->credit + rec->debit, true) + "<br>";
+    const QList<TransactionRecord>* members = priv->stakeGroupMembers(rec->hash);
+    if (members) {
+        strHTML += "<br><b>" + tr("Transaction IDs") + ":</b><br>";
+        for (const TransactionRecord& member : *members) {
+            strHTML += GUIUtil::dateTimeStr(member.time) + " " + member.getTxHash() + " " + XEPUnits::formatHtmlWithUnit(unit, member.credit + member.debit, true) + "<br>";
+        }
+    }
+    strHTML += "</font></html>";
+    return strHTML;
+}
+
 QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
 {
     if(!index.isValid())
@@ -607,6 +924,9 @@ QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
     case WatchonlyDecorationRole:
         return txWatchonlyDecoration(rec);
     case LongDescriptionRole:
+        if (rec->stakeGroupSize > 0) {
+            return describeStakeGroup(rec);
+        }
         return priv->describe(walletModel->node(), walletModel->wallet(), rec, walletModel->getOptionsModel()->getDisplayUnit());
     case AddressRole:
         return QString::fromStdString(rec->address);
@@ -615,8 +935,15 @@ QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
     case AmountRole:
         return qint64(rec->credit + rec->debit);
     case TxHashRole:
+        // A stake group row stands for several transactions
+        if (rec->stakeGroupSize > 0) {
+            return QString();
+        }
         return rec->getTxHash();
     case TxHexRole:
+        if (rec->stakeGroupSize > 0) {
+            return QString();
+        }
         return priv->getTxHex(walletModel->wallet(), rec);
     case TxPlainTextRole:
         {
@@ -653,6 +980,8 @@ QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
         return formatTxAmount(rec, false, XEPUnits::SeparatorStyle::NEVER);
     case StatusRole:
         return rec->status.status;
+    case StakeGroupSizeRole:
+        return rec->stakeGroupSize;
     }
     return QVariant();
 }
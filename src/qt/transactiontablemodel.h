@@ -5,11 +5,13 @@
 #ifndef BITCOIN_QT_TRANSACTIONTABLEMODEL_H
 #define BITCOIN_QT_TRANSACTIONTABLEMODEL_H
 
+#include <interfaces/wallet.h>
 #include <qt/xepunits.h>
 
 #include <QAbstractTableModel>
 #include <QStringList>
 
+#include <functional>
 #include <memory>
 
 namespace interfaces {
@@ -28,7 +30,8 @@ class TransactionTableModel : public QAbstractTableModel
     Q_OBJECT
 
 public:
-    explicit TransactionTableModel(const PlatformStyle *platformStyle, WalletModel *parent = nullptr);
+    /** Stakes are grouped by day into collapsible rows unless group_stakes is false */
+    explicit TransactionTableModel(const PlatformStyle *platformStyle, WalletModel *parent = nullptr, bool group_stakes = true);
     ~TransactionTableModel();
 
     enum ColumnIndex {
@@ -74,6 +77,8 @@ public:
         StatusRole,
         /** Unprocessed icon */
         RawDecorationRole,
+        /** Number of stakes of one day a row sums up, 0 for a single transaction */
+        StakeGroupSizeRole,
     };
 
     int rowCount(const QModelIndex &parent) const override;
@@ -81,7 +86,20 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const override;
+    /** Transactions are fetched from the wallet in pages, newest first, as the view scrolls */
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
     bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
+    /** Whether rows being inserted are for transactions already known, e.g. of an older page or
+        of a stake group that changed, rather than for new transactions */
+    bool insertingKnownRows() const;
+    /** Show or hide the stakes summed up by a stake group row */
+    void toggleStakeGroup(const QModelIndex &index);
+    /** Set whether orphaned stakes are skipped when fetching transactions from the wallet */
+    void setHideOrphans(bool fHide);
+    /** Only fetch wallet transactions with times from time_from to time_to and, if filter is set,
+        a record it accepts, and start over from the newest page */
+    void setFetchFilter(int64_t time_from, int64_t time_to, std::function<bool(const TransactionRecord&)> filter);
 
 private:
     WalletModel *walletModel;
@@ -103,6 +121,7 @@ private:
     QString formatTxToAddress(const TransactionRecord *wtx, bool tooltip) const;
     QString formatTxAmount(const TransactionRecord *wtx, bool showUnconfirmed=true, XEPUnits::SeparatorStyle separators=XEPUnits::SeparatorStyle::STANDARD) const;
     QString formatTooltip(const TransactionRecord *rec) const;
+    QString describeStakeGroup(const TransactionRecord *rec) const;
     QVariant txStatusDecoration(const TransactionRecord *wtx) const;
     QVariant txWatchonlyDecoration(const TransactionRecord *wtx) const;
     QVariant txAddressDecoration(const TransactionRecord *wtx) const;
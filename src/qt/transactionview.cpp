@@ -37,7 +37,7 @@
 #include <QVBoxLayout>
 
 TransactionView::TransactionView(const PlatformStyle *platformStyle, QWidget *parent) :
-    QWidget(parent)
+    QWidget(parent), m_platform_style(platformStyle)
 {
     // Build filter row
     setContentsMargins(0,0,0,0);
@@ -163,6 +163,7 @@ TransactionView::TransactionView(const PlatformStyle *platformStyle, QWidget *pa
     QAction *copyTxPlainText = new QAction(tr("Copy full transaction details"), this);
     QAction *editLabelAction = new QAction(tr("Edit label"), this);
     QAction *showDetailsAction = new QAction(tr("Show transaction details"), this);
+    toggleStakeGroupAction = new QAction(tr("Show or hide the stakes of this day"), this);
 
     contextMenu = new QMenu(this);
     contextMenu->setObjectName("contextMenu");
@@ -173,6 +174,7 @@ TransactionView::TransactionView(const PlatformStyle *platformStyle, QWidget *pa
     contextMenu->addAction(copyTxHexAction);
     contextMenu->addAction(copyTxPlainText);
     contextMenu->addAction(showDetailsAction);
+    contextMenu->addAction(toggleStakeGroupAction);
     contextMenu->addSeparator();
     contextMenu->addAction(bumpFeeAction);
     contextMenu->addAction(abandonAction);
@@ -199,8 +201,16 @@ TransactionView::TransactionView(const PlatformStyle *platformStyle, QWidget *pa
     connect(copyTxPlainText, &QAction::triggered, this, &TransactionView::copyTxPlainText);
     connect(editLabelAction, &QAction::triggered, this, &TransactionView::editLabel);
     connect(showDetailsAction, &QAction::triggered, this, &TransactionView::showDetails);
-    // Double-clicking on a transaction on the transaction history page shows details
-    connect(this, &TransactionView::doubleClicked, this, &TransactionView::showDetails);
+    connect(toggleStakeGroupAction, &QAction::triggered, this, &TransactionView::toggleStakeGroup);
+    // Double-clicking on a transaction on the transaction history page shows details,
+    // and on a group of stakes shows or hides the stakes
+    connect(this, &TransactionView::doubleClicked, [this](const QModelIndex& index) {
+        if (index.data(TransactionTableModel::StakeGroupSizeRole).toInt() > 0) {
+            toggleStakeGroup();
+        } else {
+            showDetails();
+        }
+    });
     // Highlight transaction after fee bump
     connect(this, &TransactionView::bumpedFee, [this](const uint256& txid) {
       focusTransaction(txid);
@@ -323,6 +333,7 @@ void TransactionView::setOrphansHidden(bool hidden)
 {
     if (!transactionProxyModel)
         return;
+    model->getTransactionTableModel()->setHideOrphans(hidden);
     transactionProxyModel->setHideOrphans(hidden);
 }
 
@@ -369,10 +380,36 @@ void TransactionView::exportClicked()
     if (filename.isNull())
         return;
 
+    // The history only holds the pages loaded so far, so export from a model
+    // of its own. The wallet returns the transactions in the date range, of
+    // which the model keeps the ones matching the type and search filters,
+    // without the wallet locked. The remaining filters are applied by the proxy.
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    TransactionFilterProxy* filter = transactionProxyModel;
+    AddressTableModel* addresses = model->getAddressTableModel();
+    TransactionTableModel export_model(m_platform_style, model, /* group_stakes */ false);
+    export_model.setFetchFilter(filter->getDateFrom().toMSecsSinceEpoch() / 1000, filter->getDateTo().toMSecsSinceEpoch() / 1000,
+        [filter, addresses](const TransactionRecord& rec) {
+            const QString address = QString::fromStdString(rec.address);
+            return filter->filterAcceptsRecord(rec.type, QDateTime::fromTime_t(static_cast<uint>(rec.time)),
+                address, addresses->labelForAddress(address), rec.getTxHash());
+        });
+    while (export_model.canFetchMore(QModelIndex())) {
+        export_model.fetchMore(QModelIndex());
+    }
+
+    TransactionFilterProxy export_proxy;
+    export_proxy.setFilters(*transactionProxyModel);
+    export_proxy.setSourceModel(&export_model);
+    export_proxy.setSortCaseSensitivity(Qt::CaseInsensitive);
+    export_proxy.setSortRole(Qt::EditRole);
+    export_proxy.sort(transactionProxyModel->sortColumn(), transactionProxyModel->sortOrder());
+    QApplication::restoreOverrideCursor();
+
     CSVModelWriter writer(filename);
 
     // name, column, role
-    writer.setModel(transactionProxyModel);
+    writer.setModel(&export_proxy);
     writer.addColumn(tr("Confirmed"), 0, TransactionTableModel::ConfirmedRole);
     if (model->wallet().haveWatchOnly())
         writer.addColumn(tr("Watch-only"), TransactionTableModel::Watchonly);
@@ -407,6 +444,7 @@ void TransactionView::contextualMenu(const QPoint &point)
     bumpFeeAction->setEnabled(model->wallet().transactionCanBeBumped(hash));
     copyAddressAction->setEnabled(GUIUtil::hasEntryData(transactionView, 0, TransactionTableModel::AddressRole));
     copyLabelAction->setEnabled(GUIUtil::hasEntryData(transactionView, 0, TransactionTableModel::LabelRole));
+    toggleStakeGroupAction->setVisible(selection.at(0).data(TransactionTableModel::StakeGroupSizeRole).toInt() > 0);
 
     if (index.isValid()) {
         GUIUtil::PopupMenu(contextMenu, transactionView->viewport()->mapToGlobal(point));
@@ -543,6 +581,17 @@ void TransactionView::showDetails()
     }
 }
 
+void TransactionView::toggleStakeGroup()
+{
+    if(!transactionView->selectionModel())
+        return;
+    QModelIndexList selection = transactionView->selectionModel()->selectedRows();
+    if(!selection.isEmpty())
+    {
+        model->getTransactionTableModel()->toggleStakeGroup(transactionProxyModel->mapToSource(selection.at(0)));
+    }
+}
+
 void TransactionView::openThirdPartyTxUrl(QString url)
 {
     if(!transactionView || !transactionView->selectionModel())
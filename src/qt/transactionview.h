@@ -60,6 +60,7 @@ public:
     };
 
 private:
+    const PlatformStyle *m_platform_style;
     WalletModel *model{nullptr};
     TransactionFilterProxy *transactionProxyModel{nullptr};
     QTableView *transactionView{nullptr};
@@ -79,6 +80,7 @@ private:
     QAction *bumpFeeAction{nullptr};
     QAction *copyAddressAction{nullptr};
     QAction *copyLabelAction{nullptr};
+    QAction *toggleStakeGroupAction{nullptr};
 
     QWidget *createDateRangeWidget();
 
@@ -92,6 +94,7 @@ private Q_SLOTS:
     void contextualMenu(const QPoint &);
     void dateRangeChanged();
     void showDetails();
+    void toggleStakeGroup();
     void copyAddress();
     void editLabel();
     void copyLabel();
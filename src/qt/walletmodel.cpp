@@ -25,6 +25,7 @@
 #include <node/ui_interface.h>
 #include <psbt.h>
 #include <util/system.h> // for GetBoolArg
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <wallet/coincontrol.h>
 #include <wallet/wallet.h> // for CRecipient
@@ -34,6 +35,7 @@
 #include <QDebug>
 #include <QMessageBox>
 #include <QSet>
+#include <QThread>
 #include <QTimer>
 
 
@@ -47,32 +49,57 @@ WalletModel::WalletModel(std::unique_ptr<interfaces::Wallet> wallet, ClientModel
     transactionTableModel(nullptr),
     recentRequestsTableModel(nullptr),
     cachedEncryptionStatus(Unencrypted),
-    timer(new QTimer(this))
+    m_thread(new QThread(this))
 {
     fHaveWatchOnly = m_wallet->haveWatchOnly();
     addressTableModel = new AddressTableModel(this);
     transactionTableModel = new TransactionTableModel(platformStyle, this);
     recentRequestsTableModel = new RecentRequestsTableModel(this);
 
+    // Balances are recomputed on m_thread, so that waiting for the wallet lock
+    // never blocks the GUI. Requests arriving while one is pending are coalesced.
+    m_balance_timer = new QTimer;
+    m_balance_timer->setSingleShot(true);
+    m_balance_timer->setInterval(MODEL_UPDATE_DELAY);
+    connect(m_balance_timer, &QTimer::timeout, [this] {
+        m_balance_update_pending = false;
+        Q_EMIT balancesComputed(m_wallet->getBalances());
+    });
+    connect(this, &WalletModel::balancesComputed, this, &WalletModel::updateBalances, Qt::QueuedConnection);
+    connect(m_thread, &QThread::finished, m_balance_timer, &QObject::deleteLater);
+    m_balance_timer->moveToThread(m_thread);
+
     subscribeToCoreSignals();
 }
 
 WalletModel::~WalletModel()
 {
     unsubscribeFromCoreSignals();
+
+    m_thread->quit();
+    m_thread->wait();
+    // Nothing runs on m_thread any more; the timer is still here if it never started
+    delete m_balance_timer.data();
 }
 
-void WalletModel::startPollBalance()
+void WalletModel::startBalanceUpdates()
 {
-    // This timer will be fired repeatedly to update the balance
-    connect(timer, &QTimer::timeout, this, &WalletModel::pollBalanceChanged);
-    timer->start(MODEL_UPDATE_DELAY);
+    m_thread->start();
+    QTimer::singleShot(0, m_balance_timer, []() {
+        util::ThreadRename("qt-walletmodl");
+    });
+    // Balances change with wallet transactions (see updateTransaction) and with the tip
+    connect(m_client_model, &ClientModel::numBlocksChanged, this, &WalletModel::scheduleBalanceUpdate);
+    scheduleBalanceUpdate();
 }
 
 void WalletModel::setClientModel(ClientModel* client_model)
 {
     m_client_model = client_model;
-    if (!m_client_model) timer->stop();
+    if (!m_client_model) {
+        m_thread->quit();
+        m_thread->wait();
+    }
 }
 
 void WalletModel::updateStatus()
@@ -84,30 +111,23 @@ void WalletModel::updateStatus()
     }
 }
 
-void WalletModel::pollBalanceChanged()
+void WalletModel::scheduleBalanceUpdate()
 {
-    // Avoid recomputing wallet balances unless a TransactionChanged or
-    // BlockTip notification was received.
-    if (!fForceCheckBalanceChanged && m_cached_last_update_tip == getLastBlockProcessed()) return;
-
-    // Try to get balances and return early if locks can't be acquired. This
-    // avoids the GUI from getting stuck on periodical polls if the core is
-    // holding the locks for a longer time - for example, during a wallet
-    // rescan.
-    interfaces::WalletBalances new_balances;
-    uint256 block_hash;
-    if (!m_wallet->tryGetBalances(new_balances, block_hash)) {
-        return;
-    }
-
-    if (fForceCheckBalanceChanged || block_hash != m_cached_last_update_tip) {
-        fForceCheckBalanceChanged = false;
+    if (!m_client_model || m_balance_update_pending.exchange(true)) return;
+    // The timer lives on m_thread, so it has to be started from there
+    bool invoked = QMetaObject::invokeMethod(m_balance_timer, "start", Qt::QueuedConnection);
+    assert(invoked);
+}
 
-        // Balance and number of transactions might have changed
-        m_cached_last_update_tip = block_hash;
+void WalletModel::updateBalances(const interfaces::WalletBalances& new_balances)
+{
+    checkBalanceChanged(new_balances);
 
-        checkBalanceChanged(new_balances);
-        if(transactionTableModel)
+    // Number of confirmations might have changed
+    const uint256 tip = getLastBlockProcessed();
+    if (tip != m_cached_last_update_tip) {
+        m_cached_last_update_tip = tip;
+        if (transactionTableModel)
             transactionTableModel->updateConfirmations();
     }
 }
@@ -123,7 +143,7 @@ void WalletModel::checkBalanceChanged(const interfaces::WalletBalances& new_bala
 void WalletModel::updateTransaction()
 {
     // Balance and number of transactions might have changed
-    fForceCheckBalanceChanged = true;
+    scheduleBalanceUpdate();
 }
 
 void WalletModel::updateAddressBook(const QString &address, const QString &label,
@@ -287,7 +307,7 @@ WalletModel::SendCoinsReturn WalletModel::sendCoins(WalletModelTransaction &tran
         Q_EMIT coinsSent(this, rcp, transaction_array);
     }
 
-    checkBalanceChanged(m_wallet->getBalances()); // update balance immediately, otherwise there could be a short noticeable delay until pollBalanceChanged hits
+    scheduleBalanceUpdate();
 
     return SendCoinsReturn(OK);
 }
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include <QObject>
+#include <QPointer>
 
 enum class OutputType;
 
@@ -84,6 +85,9 @@ public:
 
     EncryptionStatus getEncryptionStatus() const;
 
+    // Balances as last computed on the balance thread, so the GUI thread never locks the wallet for them
+    interfaces::WalletBalances getCachedBalances() const { return m_cached_balances; }
+
     // Check address for validity
     bool validateAddress(const QString &address);
 
@@ -176,7 +180,6 @@ private:
     interfaces::Node& m_node;
 
     bool fHaveWatchOnly;
-    bool fForceCheckBalanceChanged{false};
 
     std::atomic<bool> fLastPasswordEnteredValid{false};
 
@@ -191,7 +194,12 @@ private:
     // Cache some values to be able to detect changes
     interfaces::WalletBalances m_cached_balances;
     EncryptionStatus cachedEncryptionStatus;
-    QTimer* timer;
+
+    // Thread that recomputes balances, and single shot timer on it coalescing balance updates.
+    // The timer is deleted on m_thread when it finishes, or by the destructor if it never ran.
+    QThread* const m_thread;
+    QPointer<QTimer> m_balance_timer;
+    std::atomic<bool> m_balance_update_pending{false};
 
     // Block hash denoting when the last balance update was done.
     uint256 m_cached_last_update_tip{};
@@ -199,11 +207,15 @@ private:
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
     void checkBalanceChanged(const interfaces::WalletBalances& new_balances);
+    void updateBalances(const interfaces::WalletBalances& new_balances);
 
 Q_SIGNALS:
     // Signal that balance in wallet changed
     void balanceChanged(const interfaces::WalletBalances& balances);
 
+    // Balances were recomputed off the GUI thread
+    void balancesComputed(const interfaces::WalletBalances& balances);
+
     // Encryption status of wallet changed
     void encryptionStatusChanged();
 
@@ -231,8 +243,8 @@ Q_SIGNALS:
     void canGetAddressesChanged();
 
 public Q_SLOTS:
-    /* Starts a timer to periodically update the balance */
-    void startPollBalance();
+    /* Starts updating the balance on wallet and chain tip changes */
+    void startBalanceUpdates();
 
     /* Wallet status might have changed */
     void updateStatus();
@@ -242,8 +254,10 @@ public Q_SLOTS:
     void updateAddressBook(const QString &address, const QString &label, bool isMine, const QString &purpose, int status);
     /* Watch-only added */
     void updateWatchOnlyFlag(bool fHaveWatchonly);
-    /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
-    void pollBalanceChanged();
+    /* Current, immature or unconfirmed balance might have changed - recompute it and emit 'balanceChanged' if so */
+    void scheduleBalanceUpdate();
 };
 
+Q_DECLARE_METATYPE(interfaces::WalletBalances)
+
 #endif // BITCOIN_QT_WALLETMODEL_H
@@ -147,7 +147,8 @@ void WalletView::processNewTransaction(const QModelIndex& parent, int start, int
         return;
 
     TransactionTableModel *ttm = walletModel->getTransactionTableModel();
-    if (!ttm || ttm->processingQueuedTransactions())
+    // Older transactions loaded as the history scrolls, or regrouped stakes, are not new
+    if (!ttm || ttm->processingQueuedTransactions() || ttm->insertingKnownRows())
         return;
 
     QString date = ttm->index(start, TransactionTableModel::Date, parent).data().toString();
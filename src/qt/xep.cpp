@@ -77,6 +77,7 @@ static void RegisterMetaTypes()
     qRegisterMetaType<SynchronizationState>();
   #ifdef ENABLE_WALLET
     qRegisterMetaType<WalletModel*>();
+    qRegisterMetaType<interfaces::WalletBalances>("interfaces::WalletBalances");
   #endif
     // Register typedefs (see http://qt-project.org/doc/qt-5/qmetatype.html#qRegisterMetaType)
     // IMPORTANT: if CAmount is no longer a typedef use the normal variant above (see https://doc.qt.io/qt-5/qmetatype.html#qRegisterMetaType-1)
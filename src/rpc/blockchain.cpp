@@ -22,6 +22,7 @@
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -145,58 +146,47 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+//! Fields of blockToJSON preceding (head) and following (tail) the transactions
+static void BlockFieldsToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, UniValue& head, UniValue& tail)
 {
     // Serialize passed information without accessing chain state of the active chain!
     AssertLockNotHeld(cs_main); // For performance reasons
 
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    head.setObject();
+    head.pushKV("hash", blockindex->GetBlockHash().GetHex());
     const CBlockIndex* pnext;
     int confirmations = ComputeNextBlockAndDepth(tip, blockindex, pnext);
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    result.pushKV("weight", (int)::GetBlockWeight(block));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", (uint64_t)block.nVersion);
-    result.pushKV("versionHex", strprintf("%08x", block.nVersion));
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
-    result.pushKV("tx", txs);
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-    result.pushKV("nTx", (uint64_t)blockindex->nTx);
+    head.pushKV("confirmations", confirmations);
+    head.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    head.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    head.pushKV("weight", (int)::GetBlockWeight(block));
+    head.pushKV("height", blockindex->nHeight);
+    head.pushKV("version", (uint64_t)block.nVersion);
+    head.pushKV("versionHex", strprintf("%08x", block.nVersion));
+    head.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    tail.setObject();
+    tail.pushKV("time", block.GetBlockTime());
+    tail.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    tail.pushKV("nonce", (uint64_t)block.nNonce);
+    tail.pushKV("bits", strprintf("%08x", block.nBits));
+    tail.pushKV("difficulty", GetDifficulty(blockindex));
+    tail.pushKV("chainwork", blockindex->nChainWork.GetHex());
+    tail.pushKV("nTx", (uint64_t)blockindex->nTx);
 
     if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+        tail.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+        tail.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
 
-    result.pushKV("type", CBlockHeader::GetAlgo(blockindex->nVersion) == -1 ? blockindex->IsProofOfWork() : CBlockHeader::GetAlgo(blockindex->nVersion));
-    result.pushKV("modifier", strprintf("%016x", blockindex->nStakeModifier));
-    result.pushKV("modifierV2", blockindex->nStakeModifierV2.GetHex());
-    result.pushKV("mint", ValueFromAmount(blockindex->nMint));
-    result.pushKV("moneysupply", ValueFromAmount(blockindex->nMoneySupply));
-    result.pushKV("treasurypayment", ValueFromAmount(blockindex->nTreasuryPayment));
+    tail.pushKV("type", CBlockHeader::GetAlgo(blockindex->nVersion) == -1 ? blockindex->IsProofOfWork() : CBlockHeader::GetAlgo(blockindex->nVersion));
+    tail.pushKV("modifier", strprintf("%016x", blockindex->nStakeModifier));
+    tail.pushKV("modifierV2", blockindex->GetStakeModifierV2().GetHex());
+    tail.pushKV("mint", ValueFromAmount(blockindex->nMint));
+    tail.pushKV("moneysupply", ValueFromAmount(blockindex->nMoneySupply));
+    tail.pushKV("treasurypayment", ValueFromAmount(blockindex->GetTreasuryPayment()));
 
     if (blockindex->IsProofOfStake()) {
-        result.pushKV("proof", "stake");
+        tail.pushKV("proof", "stake");
         const COutPoint& prevout = block.vtx[1]->vin[0].prevout;
 
         const Consensus::Params& params = Params().GetConsensus();
@@ -231,18 +221,55 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
                     stakeData.pushKV("blockfromhash", hashBlock.GetHex());
                     stakeData.pushKV("blockfromheight", nHeightBlockFrom);
                     stakeData.pushKV("stakemodifierheight", nStakeModifierHeight);
-                    result.pushKV("coinstake", stakeData);
+                    tail.pushKV("coinstake", stakeData);
                 }
             }
         }
     } else {
-        result.pushKV("proof", "work");
-        result.pushKV("proofhash", block.GetPoWHash().GetHex());
+        tail.pushKV("proof", "work");
+        tail.pushKV("proofhash", block.GetPoWHash().GetHex());
     }
 
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue result, tail;
+    BlockFieldsToJSON(block, tip, blockindex, result, tail);
+    UniValue txs(UniValue::VARR);
+    for(const auto& tx : block.vtx)
+    {
+        if(txDetails)
+        {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
+            txs.push_back(objTx);
+        }
+        else
+            txs.push_back(tx->GetHash().GetHex());
+    }
+    result.pushKV("tx", txs);
+    result.pushKVs(tail);
     return result;
 }
 
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue head, tail;
+    BlockFieldsToJSON(block, tip, blockindex, head, tail);
+    writer.BeginObject().Members(head);
+    writer.Key("tx").BeginArray();
+    for (const auto& tx : block.vtx) {
+        if (txDetails) {
+            TxToJSON(*tx, uint256(), writer, true, RPCSerializationFlags());
+        } else {
+            writer.String(tx->GetHash().GetHex());
+        }
+    }
+    writer.EndArray();
+    writer.Members(tail).EndObject();
+}
+
 static RPCHelpMan getblockcount()
 {
     return RPCHelpMan{"getblockcount",
@@ -595,6 +622,39 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempoo
     }
 }
 
+void MempoolToJSON(JSONWriter& writer, const CTxMemPool& pool, bool verbose, bool include_mempool_sequence)
+{
+    if (verbose) {
+        if (include_mempool_sequence) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbose results cannot contain mempool sequence values.");
+        }
+        LOCK(pool.cs);
+        writer.BeginObject();
+        for (const CTxMemPoolEntry& e : pool.mapTx) {
+            // Only one entry is held as a UniValue at a time
+            UniValue info(UniValue::VOBJ);
+            entryToJSON(pool, info, e);
+            writer.Key(e.GetTx().GetHash().ToString()).Value(info);
+        }
+        writer.EndObject();
+    } else {
+        uint64_t mempool_sequence;
+        std::vector<uint256> vtxid;
+        {
+            LOCK(pool.cs);
+            pool.queryHashes(vtxid);
+            mempool_sequence = pool.GetSequence();
+        }
+        if (include_mempool_sequence) writer.BeginObject().Key("txids");
+        writer.BeginArray();
+        for (const uint256& hash : vtxid) {
+            writer.String(hash.ToString());
+        }
+        writer.EndArray();
+        if (include_mempool_sequence) writer.Key("mempool_sequence").UInt(mempool_sequence).EndObject();
+    }
+}
+
 static RPCHelpMan getrawmempool()
 {
     return RPCHelpMan{"getrawmempool",
@@ -640,6 +700,10 @@ static RPCHelpMan getrawmempool()
         include_mempool_sequence = request.params[1].get_bool();
     }
 
+    if (request.result_writer) {
+        MempoolToJSON(*request.result_writer, EnsureMemPool(request.context), fVerbose, include_mempool_sequence);
+        return NullUniValue;
+    }
     return MempoolToJSON(EnsureMemPool(request.context), fVerbose, include_mempool_sequence);
 },
     };
@@ -910,7 +974,7 @@ static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
     }
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(), /* tx_arena */ true)) {
         // Block not found on disk. This could be because we have the block
         // header in our index but not yet have the block or did not accept the
         // block.
@@ -1023,6 +1087,10 @@ static RPCHelpMan getblock()
         return strHex;
     }
 
+    if (request.result_writer) {
+        blockToJSON(*request.result_writer, block, tip, pblockindex, verbosity >= 2);
+        return NullUniValue;
+    }
     return blockToJSON(block, tip, pblockindex, verbosity >= 2);
 },
     };
@@ -170,6 +170,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "psbtbumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
+    { "settracespans", 0, "spans_per_thread" },
+    { "dumptrace", 0, "clear" },
+    { "getlockstats", 1, "reset" },
+    { "getvalidationqueueinfo", 0, "reset" },
     { "disconnectnode", 1, "nodeid" },
     { "upgradewallet", 0, "version" },
     // Echo with conversion (For testing only)
@@ -0,0 +1,188 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonwriter.h>
+
+#include <tinyformat.h>
+#include <univalue.h>
+
+#include <assert.h>
+#include <cinttypes>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+void JSONWriter::Separate()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_first) m_out += ',';
+    m_first = false;
+}
+
+JSONWriter& JSONWriter::BeginObject()
+{
+    Separate();
+    m_out += '{';
+    m_first = true;
+    return *this;
+}
+
+JSONWriter& JSONWriter::EndObject()
+{
+    m_out += '}';
+    m_first = false;
+    return *this;
+}
+
+JSONWriter& JSONWriter::BeginArray()
+{
+    Separate();
+    m_out += '[';
+    m_first = true;
+    return *this;
+}
+
+JSONWriter& JSONWriter::EndArray()
+{
+    m_out += ']';
+    m_first = false;
+    return *this;
+}
+
+JSONWriter& JSONWriter::Key(const std::string& key)
+{
+    Separate();
+    AppendString(key);
+    m_out += ':';
+    m_after_key = true;
+    return *this;
+}
+
+JSONWriter& JSONWriter::Null()
+{
+    Separate();
+    m_out += "null";
+    return *this;
+}
+
+JSONWriter& JSONWriter::Bool(bool value)
+{
+    Separate();
+    m_out += value ? "true" : "false";
+    return *this;
+}
+
+JSONWriter& JSONWriter::Int(int64_t value)
+{
+    Separate();
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%" PRId64, value);
+    m_out.append(buf, len);
+    return *this;
+}
+
+JSONWriter& JSONWriter::UInt(uint64_t value)
+{
+    Separate();
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%" PRIu64, value);
+    m_out.append(buf, len);
+    return *this;
+}
+
+JSONWriter& JSONWriter::Float(double value)
+{
+    Separate();
+    std::ostringstream oss;
+    oss << std::setprecision(16) << value;
+    m_out += oss.str();
+    return *this;
+}
+
+JSONWriter& JSONWriter::Amount(CAmount amount)
+{
+    Separate();
+    bool sign = amount < 0;
+    int64_t n_abs = (sign ? -amount : amount);
+    int64_t quotient = n_abs / COIN;
+    int64_t remainder = n_abs % COIN;
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%s%" PRId64 ".%08" PRId64, sign ? "-" : "", quotient, remainder);
+    m_out.append(buf, len);
+    return *this;
+}
+
+JSONWriter& JSONWriter::String(const std::string& str)
+{
+    Separate();
+    AppendString(str);
+    return *this;
+}
+
+JSONWriter& JSONWriter::Value(const UniValue& value)
+{
+    switch (value.getType()) {
+    case UniValue::VNULL:
+        return Null();
+    case UniValue::VBOOL:
+        return Bool(value.isTrue());
+    case UniValue::VNUM:
+        Separate();
+        m_out += value.getValStr();
+        return *this;
+    case UniValue::VSTR:
+        return String(value.getValStr());
+    case UniValue::VARR:
+        BeginArray();
+        for (const UniValue& element : value.getValues()) {
+            Value(element);
+        }
+        return EndArray();
+    case UniValue::VOBJ:
+        BeginObject();
+        Members(value);
+        return EndObject();
+    }
+    assert(false);
+    return *this;
+}
+
+JSONWriter& JSONWriter::Members(const UniValue& object)
+{
+    const std::vector<std::string>& keys = object.getKeys();
+    const std::vector<UniValue>& values = object.getValues();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Key(keys[i]);
+        Value(values[i]);
+    }
+    return *this;
+}
+
+void JSONWriter::AppendString(const std::string& str)
+{
+    // Same escapes as UniValue: quotes, backslashes and control characters
+    m_out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        const unsigned char ch = str[i];
+        if (ch >= 0x20 && ch != '"' && ch != '\\' && ch != 0x7f) continue;
+        m_out.append(str, start, i - start);
+        start = i + 1;
+        switch (ch) {
+        case '"': m_out += "\\\""; break;
+        case '\\': m_out += "\\\\"; break;
+        case '\b': m_out += "\\b"; break;
+        case '\t': m_out += "\\t"; break;
+        case '\n': m_out += "\\n"; break;
+        case '\f': m_out += "\\f"; break;
+        case '\r': m_out += "\\r"; break;
+        default: m_out += strprintf("\\u%04x", ch); break;
+        }
+    }
+    m_out.append(str, start, std::string::npos);
+    m_out += '"';
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONWRITER_H
+#define BITCOIN_RPC_JSONWRITER_H
+
+#include <amount.h>
+
+#include <cstdint>
+#include <string>
+
+class UniValue;
+
+/**
+ * Appends compact JSON to a string as it is produced, without building a
+ * UniValue tree first. The output is identical to UniValue::write() without
+ * indentation of the equivalent tree.
+ *
+ * Commas are inserted automatically: inside an object, every value must be
+ * preceded by a Key().
+ */
+class JSONWriter
+{
+public:
+    explicit JSONWriter(std::string& out) : m_out(out) {}
+
+    JSONWriter& BeginObject();
+    JSONWriter& EndObject();
+    JSONWriter& BeginArray();
+    JSONWriter& EndArray();
+    JSONWriter& Key(const std::string& key);
+
+    JSONWriter& Null();
+    JSONWriter& Bool(bool value);
+    JSONWriter& Int(int64_t value);
+    JSONWriter& UInt(uint64_t value);
+    //! Formatted like UniValue(double)
+    JSONWriter& Float(double value);
+    //! Formatted like ValueFromAmount()
+    JSONWriter& Amount(CAmount amount);
+    JSONWriter& String(const std::string& str);
+
+    //! Write a UniValue of any type
+    JSONWriter& Value(const UniValue& value);
+    //! Write the members of a UniValue object into the current object
+    JSONWriter& Members(const UniValue& object);
+
+private:
+    std::string& m_out;
+    //! No value was written yet in the current object or array
+    bool m_first{true};
+    //! A key was written and awaits its value
+    bool m_after_key{false};
+
+    void Separate();
+    void AppendString(const std::string& str);
+};
+
+#endif // BITCOIN_RPC_JSONWRITER_H
@@ -11,16 +11,22 @@
 #include <node/context.h>
 #include <outputtype.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <scheduler.h>
 #include <script/descriptor.h>
+#include <sync.h>
 #include <util/check.h>
 #include <util/message.h> // For MessageSign(), MessageVerify()
 #include <util/ref.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
+#include <validation.h>
+#include <validationinterface.h>
 
+#include <algorithm>
 #include <stdint.h>
 #include <tuple>
 #ifdef HAVE_MALLOC_INFO
@@ -443,6 +449,18 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCBlockIndexMemoryInfo(ChainstateManager& chainman)
+{
+    LOCK(cs_main);
+    const size_t entries = chainman.BlockIndex().size();
+    const size_t usage = chainman.m_blockman.DynamicMemoryUsage();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(entries));
+    obj.pushKV("usage", uint64_t(usage));
+    obj.pushKV("usage_per_entry", uint64_t(entries ? usage / entries : 0));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -487,6 +505,12 @@ static RPCHelpMan getmemoryinfo()
                                 {RPCResult::Type::NUM, "chunks_used", "Number allocated chunks"},
                                 {RPCResult::Type::NUM, "chunks_free", "Number unused chunks"},
                             }},
+                            {RPCResult::Type::OBJ, "blockindex", "Information about the in-memory block index",
+                            {
+                                {RPCResult::Type::NUM, "entries", "Number of block index entries"},
+                                {RPCResult::Type::NUM, "usage", "Number of bytes used by the entries and the map from block hashes to them"},
+                                {RPCResult::Type::NUM, "usage_per_entry", "Average number of bytes used per entry"},
+                            }},
                         }
                     },
                     RPCResult{"mode \"mallocinfo\"",
@@ -503,6 +527,7 @@ static RPCHelpMan getmemoryinfo()
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("blockindex", RPCBlockIndexMemoryInfo(EnsureChainman(request.context)));
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -517,6 +542,331 @@ static RPCHelpMan getmemoryinfo()
     };
 }
 
+static RPCHelpMan settracespans()
+{
+    return RPCHelpMan{"settracespans",
+                "\nStarts or stops recording spans of hot code paths for dumptrace.\n"
+                "The last spans_per_thread spans of every thread are kept. Changing it drops the spans recorded so far.\n",
+                {
+                    {"spans_per_thread", RPCArg::Type::NUM, RPCArg::Optional::NO, "Number of spans to keep for each thread, or 0 to stop recording"},
+                },
+                RPCResult{RPCResult::Type::NONE, "", ""},
+                RPCExamples{
+                    HelpExampleCli("settracespans", "100000")
+            + HelpExampleRpc("settracespans", "100000")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const int64_t spans = request.params[0].get_int64();
+    if (spans < 0 || spans > (int64_t)tracing::MAX_SPAN_CAPACITY) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("spans_per_thread must be between 0 and %u", tracing::MAX_SPAN_CAPACITY));
+    }
+    tracing::SetSpanCapacity(spans);
+    return NullUniValue;
+},
+    };
+}
+
+/** Write the recorded spans as a Chrome trace, which chrome://tracing and Perfetto can load */
+static void TraceToJSON(JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.Key("traceEvents").BeginArray();
+    for (const tracing::ThreadSpans& thread : tracing::CollectSpans()) {
+        writer.BeginObject();
+        writer.Key("name").String("thread_name");
+        writer.Key("ph").String("M");
+        writer.Key("pid").Int(1);
+        writer.Key("tid").Int(thread.thread_id);
+        writer.Key("args").BeginObject().Key("name").String(thread.thread_name).EndObject();
+        writer.EndObject();
+        for (const tracing::SpanRecord& span : thread.spans) {
+            writer.BeginObject();
+            writer.Key("name").String(span.name);
+            writer.Key("ph").String("X");
+            writer.Key("ts").Int(span.begin_micros);
+            writer.Key("dur").Int(span.end_micros - span.begin_micros);
+            writer.Key("pid").Int(1);
+            writer.Key("tid").Int(thread.thread_id);
+            if (span.detail[0] != '\0') {
+                writer.Key("args").BeginObject().Key("detail").String(span.detail).EndObject();
+            }
+            writer.EndObject();
+        }
+    }
+    writer.EndArray();
+    writer.Key("displayTimeUnit").String("ms");
+    writer.EndObject();
+}
+
+static RPCHelpMan dumptrace()
+{
+    return RPCHelpMan{"dumptrace",
+                "\nReturns the spans recorded since settracespans in Chrome trace event format.\n"
+                "Save the result to a file and open it with chrome://tracing or https://ui.perfetto.dev.\n"
+                "Spans are recorded for block processing and connection, proof of stake checks, coinstake creation,\n"
+                "mempool acceptance and P2P message handling.\n",
+                {
+                    {"clear", RPCArg::Type::BOOL, /* default */ "false", "Drop the returned spans afterwards"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::ARR, "traceEvents", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "A span, or the name of a thread",
+                            {
+                                {RPCResult::Type::STR, "name", "The name of the span, or \"thread_name\""},
+                                {RPCResult::Type::STR, "ph", "\"X\" for spans, \"M\" for thread names"},
+                                {RPCResult::Type::NUM, "ts", /* optional */ true, "Start of the span in microseconds of a monotonic clock"},
+                                {RPCResult::Type::NUM, "dur", /* optional */ true, "Duration of the span in microseconds"},
+                                {RPCResult::Type::NUM, "pid", "Always 1"},
+                                {RPCResult::Type::NUM, "tid", "Identifies the thread"},
+                                {RPCResult::Type::OBJ, "args", /* optional */ true, "The thread name, or details of the span such as the P2P message type",
+                                {
+                                    {RPCResult::Type::ELISION, "", ""},
+                                }},
+                            }},
+                        }},
+                        {RPCResult::Type::STR, "displayTimeUnit", "Always \"ms\""},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptrace", "") + " > trace.json\n"
+            + HelpExampleRpc("dumptrace", "true")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const bool clear = !request.params[0].isNull() && request.params[0].get_bool();
+    UniValue result;
+    if (request.result_writer) {
+        TraceToJSON(*request.result_writer);
+    } else {
+        // Only callers that need a UniValue, like the GUI console, pay for parsing it back
+        std::string json;
+        JSONWriter writer(json);
+        TraceToJSON(writer);
+        if (!result.read(json)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to write trace");
+        }
+    }
+    if (clear) tracing::ClearSpans();
+    return result;
+},
+    };
+}
+
+static UniValue LockHistogramToJSON(const std::atomic<uint64_t> (&histogram)[LockSiteStats::HISTOGRAM_BUCKETS])
+{
+    int size = LockSiteStats::HISTOGRAM_BUCKETS;
+    while (size > 0 && histogram[size - 1] == 0) --size;
+    UniValue result(UniValue::VARR);
+    for (int i = 0; i < size; ++i) {
+        result.push_back(histogram[i].load());
+    }
+    return result;
+}
+
+static RPCHelpMan getlockstats()
+{
+    return RPCHelpMan{"getlockstats",
+                "\nReturns how long the locks taken at each LOCK site in the code were waited for and held, most waited for first.\n"
+                "Only acquisitions since startup or the last reset while -lockstats was enabled are counted.\n"
+                "Bucket 0 of the histograms counts times below 1 microsecond, bucket i times from 2^(i-1) to 2^i microseconds,\n"
+                "and bucket " + ToString(LockSiteStats::HISTOGRAM_BUCKETS - 1) + " everything longer. Trailing empty buckets are omitted.\n",
+                {
+                    {"lock", RPCArg::Type::STR, /* default */ "all locks", "Only return sites whose lock expression ends with this, e.g. \"cs_main\", \"cs_wallet\" or \"mempool.cs\""},
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Reset the stats of all sites afterwards"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::BOOL, "enabled", "Whether lock stats are being recorded"},
+                        {RPCResult::Type::ARR, "sites", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::STR, "lock", "The lock as written at the site"},
+                                {RPCResult::Type::STR, "site", "The source file and line"},
+                                {RPCResult::Type::NUM, "acquisitions", "How often the lock was taken"},
+                                {RPCResult::Type::NUM, "contentions", "How often the lock was held by another thread"},
+                                {RPCResult::Type::NUM, "wait_us", "Total microseconds spent waiting for the lock"},
+                                {RPCResult::Type::NUM, "max_wait_us", "Longest wait in microseconds"},
+                                {RPCResult::Type::NUM, "hold_us", "Total microseconds the lock was held, including waits on condition variables"},
+                                {RPCResult::Type::NUM, "max_hold_us", "Longest hold in microseconds"},
+                                {RPCResult::Type::ARR, "wait_histogram", "Number of contended waits per bucket", {{RPCResult::Type::NUM, "", ""}}},
+                                {RPCResult::Type::ARR, "hold_histogram", "Number of holds per bucket", {{RPCResult::Type::NUM, "", ""}}},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "cs_main true")
+            + HelpExampleRpc("getlockstats", "\"cs_main\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const std::string lock = request.params[0].isNull() ? "" : request.params[0].get_str();
+    const bool reset = !request.params[1].isNull() && request.params[1].get_bool();
+
+    std::vector<const LockSiteStats*> sites;
+    for (const LockSiteStats* stats : GetAllLockSiteStats()) {
+        if (stats->acquisitions == 0) continue;
+        const std::string name = stats->name;
+        if (name.size() < lock.size() || name.compare(name.size() - lock.size(), lock.size(), lock) != 0) continue;
+        sites.push_back(stats);
+    }
+    std::sort(sites.begin(), sites.end(), [](const LockSiteStats* a, const LockSiteStats* b) {
+        return std::make_tuple(a->wait_nanos.load(), a->hold_nanos.load()) > std::make_tuple(b->wait_nanos.load(), b->hold_nanos.load());
+    });
+
+    UniValue result_sites(UniValue::VARR);
+    for (const LockSiteStats* stats : sites) {
+        UniValue site(UniValue::VOBJ);
+        site.pushKV("lock", stats->name);
+        site.pushKV("site", strprintf("%s:%d", stats->file, stats->line));
+        site.pushKV("acquisitions", stats->acquisitions.load());
+        site.pushKV("contentions", stats->contentions.load());
+        site.pushKV("wait_us", stats->wait_nanos / 1000);
+        site.pushKV("max_wait_us", stats->max_wait_nanos / 1000);
+        site.pushKV("hold_us", stats->hold_nanos / 1000);
+        site.pushKV("max_hold_us", stats->max_hold_nanos / 1000);
+        site.pushKV("wait_histogram", LockHistogramToJSON(stats->wait_histogram));
+        site.pushKV("hold_histogram", LockHistogramToJSON(stats->hold_histogram));
+        result_sites.push_back(site);
+    }
+    if (reset) ResetLockSiteStats();
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("enabled", g_lock_stats_enabled.load());
+    result.pushKV("sites", result_sites);
+    return result;
+},
+    };
+}
+
+static RPCHelpMan getvalidationqueueinfo()
+{
+    return RPCHelpMan{"getvalidationqueueinfo",
+                "\nReturns the queue of block and transaction notifications of every validation interface subscriber,\n"
+                "such as wallets, indexes and the P2P logic. Block validation waits for subscribers with more than\n"
+                "-validationqueuelimit notifications queued. Counters are kept since registration or the last reset.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Reset the counters afterwards"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "limit", "The -validationqueuelimit in effect"},
+                        {RPCResult::Type::ARR, "subscribers", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::STR, "name", "The subscriber, empty if it was registered without a name"},
+                                {RPCResult::Type::NUM, "pending", "Notifications waiting to be delivered"},
+                                {RPCResult::Type::NUM, "max_pending", "Most notifications that were waiting at once"},
+                                {RPCResult::Type::NUM, "delivered", "Notifications delivered"},
+                                {RPCResult::Type::NUM, "avg_latency_us", "Average microseconds from queueing a notification to having handled it"},
+                                {RPCResult::Type::NUM, "max_latency_us", "Longest such time in microseconds"},
+                                {RPCResult::Type::NUM, "busy_us", "Total microseconds spent handling notifications"},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "true")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const bool reset = !request.params[0].isNull() && request.params[0].get_bool();
+
+    UniValue subscribers(UniValue::VARR);
+    for (const ValidationInterfaceQueueInfo& info : GetMainSignals().GetQueueInfo()) {
+        UniValue subscriber(UniValue::VOBJ);
+        subscriber.pushKV("name", info.name);
+        subscriber.pushKV("pending", (uint64_t)info.pending);
+        subscriber.pushKV("max_pending", (uint64_t)info.max_pending);
+        subscriber.pushKV("delivered", info.delivered);
+        subscriber.pushKV("avg_latency_us", info.delivered ? info.total_latency_micros / (int64_t)info.delivered : 0);
+        subscriber.pushKV("max_latency_us", info.max_latency_micros);
+        subscriber.pushKV("busy_us", info.busy_micros);
+        subscribers.push_back(subscriber);
+    }
+    if (reset) GetMainSignals().ResetQueueInfo();
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("limit", (uint64_t)GetMainSignals().GetQueueLimit());
+    result.pushKV("subscribers", subscribers);
+    return result;
+},
+    };
+}
+
+static RPCHelpMan getschedulerinfo()
+{
+    return RPCHelpMan{"getschedulerinfo",
+                "\nReturns the jobs waiting in the scheduler and how long the jobs that ran so far took, longest total run time first.\n"
+                "Background jobs such as database flushes run on -schedulerthreads threads of their own.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "queued", "Jobs waiting for their time to come"},
+                        {RPCResult::Type::NUM, "background_queued", "Due background jobs waiting for a background thread"},
+                        {RPCResult::Type::ARR, "jobs", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::STR, "name", "The job, empty for jobs scheduled without a name"},
+                                {RPCResult::Type::STR, "class", "\"latency\" or \"background\""},
+                                {RPCResult::Type::NUM, "runs", "How often the job ran"},
+                                {RPCResult::Type::NUM, "total_us", "Total run time in microseconds"},
+                                {RPCResult::Type::NUM, "max_us", "Longest run time in microseconds"},
+                                {RPCResult::Type::NUM, "avg_delay_us", "Average microseconds the job started after its scheduled time"},
+                                {RPCResult::Type::NUM, "max_delay_us", "Longest such delay in microseconds"},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getschedulerinfo", "")
+            + HelpExampleRpc("getschedulerinfo", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    CHECK_NONFATAL(request.context.Has<NodeContext>());
+    NodeContext& node = request.context.Get<NodeContext>();
+    CHECK_NONFATAL(node.scheduler);
+
+    std::vector<CScheduler::JobStats> stats = node.scheduler->GetJobStats();
+    std::sort(stats.begin(), stats.end(), [](const CScheduler::JobStats& a, const CScheduler::JobStats& b) {
+        return a.total_micros > b.total_micros;
+    });
+    UniValue jobs(UniValue::VARR);
+    for (const CScheduler::JobStats& job : stats) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", job.name);
+        entry.pushKV("class", job.job_class == CScheduler::JobClass::BACKGROUND ? "background" : "latency");
+        entry.pushKV("runs", job.runs);
+        entry.pushKV("total_us", job.total_micros);
+        entry.pushKV("max_us", job.max_micros);
+        entry.pushKV("avg_delay_us", job.runs ? job.total_delay_micros / (int64_t)job.runs : 0);
+        entry.pushKV("max_delay_us", job.max_delay_micros);
+        jobs.push_back(entry);
+    }
+
+    std::chrono::system_clock::time_point first, last;
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("queued", (uint64_t)node.scheduler->getQueueInfo(first, last));
+    result.pushKV("background_queued", (uint64_t)node.scheduler->BackgroundJobsPending());
+    result.pushKV("jobs", jobs);
+    return result;
+},
+    };
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -703,6 +1053,11 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
+    { "control",            "settracespans",          &settracespans,          {"spans_per_thread"}},
+    { "control",            "dumptrace",              &dumptrace,              {"clear"}},
+    { "control",            "getlockstats",           &getlockstats,           {"lock", "reset"}},
+    { "control",            "getvalidationqueueinfo", &getvalidationqueueinfo, {"reset"}},
+    { "control",            "getschedulerinfo",       &getschedulerinfo,       {}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
     { "util",               "deriveaddresses",        &deriveaddresses,        {"descriptor", "range"} },
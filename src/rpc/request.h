@@ -10,6 +10,8 @@
 
 #include <univalue.h>
 
+class JSONWriter;
+
 namespace util {
 class Ref;
 } // namespace util
@@ -39,6 +41,9 @@ public:
     std::string authUser;
     std::string peerAddr;
     const util::Ref& context;
+    //! If set, handlers of large results may write their result here instead
+    //! of returning it, in which case the returned value is ignored.
+    JSONWriter* result_writer{nullptr};
 
     JSONRPCRequest(const util::Ref& context) : id(NullUniValue), params(NullUniValue), fHelp(false), context(context) {}
 
@@ -47,7 +52,7 @@ public:
     //! added or removed above.
     JSONRPCRequest(const JSONRPCRequest& other, const util::Ref& context)
         : id(other.id), strMethod(other.strMethod), params(other.params), fHelp(other.fHelp), URI(other.URI),
-          authUser(other.authUser), peerAddr(other.peerAddr), context(context)
+          authUser(other.authUser), peerAddr(other.peerAddr), context(context), result_writer(other.result_writer)
     {
     }
 
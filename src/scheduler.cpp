@@ -4,21 +4,187 @@
 
 #include <scheduler.h>
 
+#include <crypto/common.h>
 #include <random.h>
 
+#include <algorithm>
 #include <assert.h>
+#include <limits>
+#include <tuple>
 #include <utility>
 
-CScheduler::CScheduler()
+namespace {
+
+int64_t MicrosSince(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+//! Index of the lowest set bit, x must not be 0
+int LowestBit(uint64_t x)
+{
+    return CountBits(x & (~x + 1)) - 1;
+}
+
+//! Milliseconds since the epoch, rounded down. duration_cast rounds toward zero.
+int64_t FloorMillis(std::chrono::system_clock::time_point time)
+{
+    const std::chrono::system_clock::duration since_epoch = time.time_since_epoch();
+    std::chrono::milliseconds millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch);
+    if (millis > since_epoch) --millis;
+    return millis.count();
+}
+
+//! Milliseconds since the epoch, rounded up
+int64_t CeilMillis(std::chrono::system_clock::time_point time)
+{
+    const std::chrono::system_clock::duration since_epoch = time.time_since_epoch();
+    std::chrono::milliseconds millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch);
+    if (millis < since_epoch) ++millis;
+    return millis.count();
+}
+
+} // namespace
+
+CScheduler::TimerWheel::TimerWheel(std::chrono::system_clock::time_point now)
+    : m_tick(FloorMillis(now))
+{
+}
+
+void CScheduler::TimerWheel::Insert(Task task)
+{
+    static const auto later = [](const Task& a, const Task& b) {
+        return std::tie(a.time, a.sequence) > std::tie(b.time, b.sequence);
+    };
+
+    ++m_size;
+    const int64_t tick = CeilMillis(task.time);
+    if (tick <= m_tick) {
+        m_ready.push_back(std::move(task));
+        std::push_heap(m_ready.begin(), m_ready.end(), later);
+        return;
+    }
+
+    // The lowest level on which the task is less than a full turn ahead
+    int level = 0;
+    while (level < LEVELS - 1 && (tick >> (level * SLOT_BITS)) - (m_tick >> (level * SLOT_BITS)) >= SLOTS) ++level;
+    // Tasks beyond the top level wait in its last slot and are placed again from there
+    const int64_t index = std::min(tick >> (level * SLOT_BITS), (m_tick >> (level * SLOT_BITS)) + SLOTS - 1);
+    const int slot = index & (SLOTS - 1);
+    m_slots[level][slot].push_back(std::move(task));
+    m_occupied[level] |= uint64_t{1} << slot;
+}
+
+int64_t CScheduler::TimerWheel::NextEventTick(int level) const
+{
+    if (!m_occupied[level]) return std::numeric_limits<int64_t>::max();
+    // Occupied slots are 1 to SLOTS - 1 slots ahead of the current one
+    const int shift = level * SLOT_BITS;
+    const int64_t current = m_tick >> shift;
+    const int rotation = (current + 1) & (SLOTS - 1);
+    const uint64_t rotated = rotation ? (m_occupied[level] >> rotation) | (m_occupied[level] << (SLOTS - rotation)) : m_occupied[level];
+    return (current + 1 + LowestBit(rotated)) << shift;
+}
+
+void CScheduler::TimerWheel::Advance(std::chrono::system_clock::time_point now)
+{
+    const int64_t now_tick = FloorMillis(now);
+    if (now_tick < m_tick) {
+        // The clock was set back, place everything relative to the new time
+        std::vector<Task> tasks = TakeAll();
+        m_tick = now_tick;
+        for (Task& task : tasks) Insert(std::move(task));
+        return;
+    }
+
+    while (true) {
+        std::array<int64_t, LEVELS> events;
+        int64_t next = std::numeric_limits<int64_t>::max();
+        for (int level = 0; level < LEVELS; ++level) {
+            events[level] = NextEventTick(level);
+            next = std::min(next, events[level]);
+        }
+        if (next > now_tick) break;
+
+        m_tick = next;
+        for (int level = 0; level < LEVELS; ++level) {
+            if (events[level] != next) continue;
+            const int slot = (next >> (level * SLOT_BITS)) & (SLOTS - 1);
+            std::vector<Task> tasks;
+            tasks.swap(m_slots[level][slot]);
+            m_occupied[level] &= ~(uint64_t{1} << slot);
+            m_size -= tasks.size();
+            for (Task& task : tasks) Insert(std::move(task));
+            // Keep the slot's capacity around for the next tasks
+            tasks.clear();
+            if (m_slots[level][slot].empty()) m_slots[level][slot].swap(tasks);
+        }
+    }
+    m_tick = now_tick;
+}
+
+CScheduler::Task CScheduler::TimerWheel::PopReady()
+{
+    std::pop_heap(m_ready.begin(), m_ready.end(), [](const Task& a, const Task& b) {
+        return std::tie(a.time, a.sequence) > std::tie(b.time, b.sequence);
+    });
+    Task task = std::move(m_ready.back());
+    m_ready.pop_back();
+    --m_size;
+    return task;
+}
+
+std::chrono::system_clock::time_point CScheduler::TimerWheel::NextEvent() const
+{
+    int64_t next = std::numeric_limits<int64_t>::max();
+    for (int level = 0; level < LEVELS; ++level) next = std::min(next, NextEventTick(level));
+    if (next == std::numeric_limits<int64_t>::max()) return std::chrono::system_clock::time_point::max();
+    return std::chrono::system_clock::time_point{std::chrono::milliseconds{next}};
+}
+
+std::vector<CScheduler::Task> CScheduler::TimerWheel::TakeAll()
+{
+    std::vector<Task> tasks = std::move(m_ready);
+    m_ready.clear();
+    for (auto& level : m_slots) {
+        for (auto& slot : level) {
+            for (Task& task : slot) tasks.push_back(std::move(task));
+            slot.clear();
+        }
+    }
+    m_occupied.fill(0);
+    m_size = 0;
+    return tasks;
+}
+
+CScheduler::CScheduler() : taskQueue(std::chrono::system_clock::now())
 {
 }
 
 CScheduler::~CScheduler()
 {
     assert(nThreadsServicingQueue == 0);
-    if (stopWhenEmpty) assert(taskQueue.empty());
+    assert(nThreadsServicingBackground == 0);
+    if (stopWhenEmpty) assert(taskQueue.empty() && backgroundQueue.empty());
 }
 
+void CScheduler::RunTask(Task& task)
+{
+    const int64_t delay = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - task.time).count());
+    const auto begin = std::chrono::steady_clock::now();
+    task.f();
+    const int64_t runtime = MicrosSince(begin);
+
+    LOCK(m_stats_mutex);
+    JobStats& stats = m_job_stats[task.name];
+    stats.name = task.name;
+    stats.job_class = task.job_class;
+    ++stats.runs;
+    stats.total_micros += runtime;
+    stats.max_micros = std::max(stats.max_micros, runtime);
+    stats.total_delay_micros += delay;
+    stats.max_delay_micros = std::max(stats.max_delay_micros, delay);
+}
 
 void CScheduler::serviceQueue()
 {
@@ -30,34 +196,36 @@ void CScheduler::serviceQueue()
     // is called.
     while (!shouldStop()) {
         try {
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
-
-            while (!shouldStop() && !taskQueue.empty()) {
-                std::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until(lock, timeToWaitFor) == std::cv_status::timeout) {
-                    break; // Exit loop after timeout, it means we reached the time of the event
+            // Wait until the first task is due, or until there is a new task
+            // that may be due earlier.
+            taskQueue.Advance(std::chrono::system_clock::now());
+            while (!shouldStop() && !taskQueue.HasReady()) {
+                const std::chrono::system_clock::time_point next = taskQueue.NextEvent();
+                if (next == std::chrono::system_clock::time_point::max()) {
+                    newTaskScheduled.wait(lock);
+                } else {
+                    newTaskScheduled.wait_until(lock, next);
                 }
+                taskQueue.Advance(std::chrono::system_clock::now());
             }
 
             // If there are multiple threads, the queue can empty while we're waiting (another
             // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            if (shouldStop() || !taskQueue.HasReady())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            Task task = taskQueue.PopReady();
+            if (task.job_class == JobClass::BACKGROUND && nThreadsServicingBackground > 0) {
+                backgroundQueue.push_back(std::move(task));
+                backgroundTaskReady.notify_one();
+                continue;
+            }
 
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 REVERSE_LOCK(lock);
-                f();
+                RunTask(task);
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -66,13 +234,51 @@ void CScheduler::serviceQueue()
     }
     --nThreadsServicingQueue;
     newTaskScheduled.notify_one();
+    backgroundTaskReady.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t)
+void CScheduler::serviceBackgroundQueue()
+{
+    WAIT_LOCK(newTaskMutex, lock);
+    ++nThreadsServicingBackground;
+
+    while (!shouldStop()) {
+        bool running = false;
+        try {
+            while (!shouldStop() && backgroundQueue.empty()) {
+                backgroundTaskReady.wait(lock);
+            }
+            if (shouldStop()) continue;
+
+            Task task = std::move(backgroundQueue.front());
+            backgroundQueue.pop_front();
+            ++nBackgroundTasksRunning;
+            running = true;
+            {
+                REVERSE_LOCK(lock);
+                RunTask(task);
+            }
+            --nBackgroundTasksRunning;
+            // Threads waiting for the queues to drain may be done now
+            if (stopWhenEmpty) {
+                newTaskScheduled.notify_all();
+                backgroundTaskReady.notify_all();
+            }
+        } catch (...) {
+            if (running) --nBackgroundTasksRunning;
+            --nThreadsServicingBackground;
+            throw;
+        }
+    }
+    --nThreadsServicingBackground;
+    backgroundTaskReady.notify_one();
+}
+
+void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t, std::string name, JobClass job_class)
 {
     {
         LOCK(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.Insert({t, nextTaskSequence++, std::move(f), std::move(name), job_class});
     }
     newTaskScheduled.notify_one();
 }
@@ -84,30 +290,27 @@ void CScheduler::MockForward(std::chrono::seconds delta_seconds)
     {
         LOCK(newTaskMutex);
 
-        // use temp_queue to maintain updated schedule
-        std::multimap<std::chrono::system_clock::time_point, Function> temp_queue;
-
-        for (const auto& element : taskQueue) {
-            temp_queue.emplace_hint(temp_queue.cend(), element.first - delta_seconds, element.second);
+        // Place every task again at its updated time
+        std::vector<Task> tasks = taskQueue.TakeAll();
+        for (Task& task : tasks) {
+            task.time -= delta_seconds;
+            taskQueue.Insert(std::move(task));
         }
-
-        // point taskQueue to temp_queue
-        taskQueue = std::move(temp_queue);
     }
 
     // notify that the taskQueue needs to be processed
     newTaskScheduled.notify_one();
 }
 
-static void Repeat(CScheduler& s, CScheduler::Function f, std::chrono::milliseconds delta)
+static void Repeat(CScheduler& s, CScheduler::Function f, std::chrono::milliseconds delta, const std::string& name, CScheduler::JobClass job_class)
 {
     f();
-    s.scheduleFromNow([=, &s] { Repeat(s, f, delta); }, delta);
+    s.scheduleFromNow([=, &s] { Repeat(s, f, delta, name, job_class); }, delta, name, job_class);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, std::chrono::milliseconds delta)
+void CScheduler::scheduleEvery(CScheduler::Function f, std::chrono::milliseconds delta, std::string name, JobClass job_class)
 {
-    scheduleFromNow([=] { Repeat(*this, f, delta); }, delta);
+    scheduleFromNow([=] { Repeat(*this, f, delta, name, job_class); }, delta, name, job_class);
 }
 
 size_t CScheduler::getQueueInfo(std::chrono::system_clock::time_point& first,
@@ -116,16 +319,34 @@ size_t CScheduler::getQueueInfo(std::chrono::system_clock::time_point& first,
     LOCK(newTaskMutex);
     size_t result = taskQueue.size();
     if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+        first = std::chrono::system_clock::time_point::max();
+        last = std::chrono::system_clock::time_point::min();
+        taskQueue.ForEach([&](const Task& task) {
+            first = std::min(first, task.time);
+            last = std::max(last, task.time);
+        });
     }
     return result;
 }
 
+size_t CScheduler::BackgroundJobsPending() const
+{
+    LOCK(newTaskMutex);
+    return backgroundQueue.size();
+}
+
 bool CScheduler::AreThreadsServicingQueue() const
 {
     LOCK(newTaskMutex);
-    return nThreadsServicingQueue;
+    return nThreadsServicingQueue || nThreadsServicingBackground;
+}
+
+std::vector<CScheduler::JobStats> CScheduler::GetJobStats() const
+{
+    LOCK(m_stats_mutex);
+    std::vector<JobStats> result;
+    for (const auto& entry : m_job_stats) result.push_back(entry.second);
+    return result;
 }
 
 
@@ -139,7 +360,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), std::chrono::system_clock::now());
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), std::chrono::system_clock::now(), "SingleThreadedSchedulerClient");
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue()
@@ -5,13 +5,21 @@
 #ifndef BITCOIN_SCHEDULER_H
 #define BITCOIN_SCHEDULER_H
 
+#include <array>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <sync.h>
 
+//! Threads running background jobs such as database flushes
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+
 /**
  * Simple class for background tasks that should be run
  * periodically or once "after a while"
@@ -28,6 +36,10 @@
  * t->join();
  * delete t;
  * delete s; // Must be done after thread is interrupted/joined.
+ *
+ * Jobs that may take long, like flushing a database to disk, should be
+ * scheduled as JobClass::BACKGROUND. Threads running serviceBackgroundQueue
+ * take those over, so they do not delay the other jobs.
  */
 class CScheduler
 {
@@ -37,13 +49,30 @@ public:
 
     typedef std::function<void()> Function;
 
-    /** Call func at/after time t */
-    void schedule(Function f, std::chrono::system_clock::time_point t);
+    enum class JobClass {
+        LATENCY,    //!< Runs on the threads servicing the queue
+        BACKGROUND, //!< Runs on the background threads, if there are any
+    };
+
+    /** Run time statistics of the jobs scheduled with one name */
+    struct JobStats {
+        std::string name;
+        JobClass job_class{JobClass::LATENCY};
+        uint64_t runs{0};
+        int64_t total_micros{0};
+        int64_t max_micros{0};
+        //! How late the jobs started
+        int64_t total_delay_micros{0};
+        int64_t max_delay_micros{0};
+    };
+
+    /** Call func at/after time t. Jobs are accounted under name in GetJobStats. */
+    void schedule(Function f, std::chrono::system_clock::time_point t, std::string name = "", JobClass job_class = JobClass::LATENCY);
 
     /** Call f once after the delta has passed */
-    void scheduleFromNow(Function f, std::chrono::milliseconds delta)
+    void scheduleFromNow(Function f, std::chrono::milliseconds delta, std::string name = "", JobClass job_class = JobClass::LATENCY)
     {
-        schedule(std::move(f), std::chrono::system_clock::now() + delta);
+        schedule(std::move(f), std::chrono::system_clock::now() + delta, std::move(name), job_class);
     }
 
     /**
@@ -52,7 +81,7 @@ public:
      * The timing is not exact: Every time f is finished, it is rescheduled to run again after delta. If you need more
      * accurate scheduling, don't use this method.
      */
-    void scheduleEvery(Function f, std::chrono::milliseconds delta);
+    void scheduleEvery(Function f, std::chrono::milliseconds delta, std::string name = "", JobClass job_class = JobClass::LATENCY);
 
     /**
      * Mock the scheduler to fast forward in time.
@@ -67,17 +96,25 @@ public:
      */
     void serviceQueue();
 
+    /**
+     * Runs the background jobs that are due. Should be run in threads of its
+     * own, next to serviceQueue. Without any, serviceQueue runs them itself.
+     */
+    void serviceBackgroundQueue();
+
     /** Tell any threads running serviceQueue to stop as soon as the current task is done */
     void stop()
     {
         WITH_LOCK(newTaskMutex, stopRequested = true);
         newTaskScheduled.notify_all();
+        backgroundTaskReady.notify_all();
     }
     /** Tell any threads running serviceQueue to stop when there is no work left to be done */
     void StopWhenDrained()
     {
         WITH_LOCK(newTaskMutex, stopWhenEmpty = true);
         newTaskScheduled.notify_all();
+        backgroundTaskReady.notify_all();
     }
 
     /**
@@ -87,17 +124,95 @@ public:
     size_t getQueueInfo(std::chrono::system_clock::time_point& first,
                         std::chrono::system_clock::time_point& last) const;
 
-    /** Returns true if there are threads actively running in serviceQueue() */
+    /** Returns the number of due background jobs waiting for a background thread */
+    size_t BackgroundJobsPending() const;
+
+    /** Returns true if there are threads actively running in serviceQueue() or serviceBackgroundQueue() */
     bool AreThreadsServicingQueue() const;
 
+    /** Returns the statistics of every job name that ran so far, ordered by name */
+    std::vector<JobStats> GetJobStats() const;
+
 private:
+    struct Task {
+        std::chrono::system_clock::time_point time;
+        //! Orders tasks with the same time
+        uint64_t sequence;
+        Function f;
+        std::string name;
+        JobClass job_class;
+    };
+
+    /**
+     * Hierarchical timer wheel holding the tasks that are not due yet.
+     *
+     * Level k has 64 slots of 64^k milliseconds each, so inserting a task
+     * and finding the next one to become due take constant time. A slot is
+     * visited when the clock reaches its start, and its tasks, which keep
+     * their exact time, move to the lower levels or become ready.
+     */
+    class TimerWheel
+    {
+    public:
+        explicit TimerWheel(std::chrono::system_clock::time_point now);
+
+        void Insert(Task task);
+        /** Make the tasks due at now ready */
+        void Advance(std::chrono::system_clock::time_point now);
+        bool HasReady() const { return !m_ready.empty(); }
+        /** Remove the ready task with the earliest time */
+        Task PopReady();
+        /** When the next task may become ready, time_point::max() if there is none */
+        std::chrono::system_clock::time_point NextEvent() const;
+        /** Remove all tasks, ready or not */
+        std::vector<Task> TakeAll();
+        template <typename F>
+        void ForEach(F f) const
+        {
+            for (const Task& task : m_ready) f(task);
+            for (const auto& level : m_slots) {
+                for (const auto& slot : level) {
+                    for (const Task& task : slot) f(task);
+                }
+            }
+        }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+    private:
+        static constexpr int LEVELS = 6;
+        static constexpr int SLOT_BITS = 6;
+        static constexpr int SLOTS = 1 << SLOT_BITS;
+
+        //! Milliseconds since the epoch up to which tasks are ready
+        int64_t m_tick;
+        std::array<std::array<std::vector<Task>, SLOTS>, LEVELS> m_slots;
+        std::array<uint64_t, LEVELS> m_occupied{};
+        //! Heap of due tasks, earliest first
+        std::vector<Task> m_ready;
+        size_t m_size{0};
+
+        int64_t NextEventTick(int level) const;
+    };
+
     mutable Mutex newTaskMutex;
     std::condition_variable newTaskScheduled;
-    std::multimap<std::chrono::system_clock::time_point, Function> taskQueue GUARDED_BY(newTaskMutex);
+    std::condition_variable backgroundTaskReady;
+    TimerWheel taskQueue GUARDED_BY(newTaskMutex);
+    std::deque<Task> backgroundQueue GUARDED_BY(newTaskMutex);
+    uint64_t nextTaskSequence GUARDED_BY(newTaskMutex){0};
     int nThreadsServicingQueue GUARDED_BY(newTaskMutex){0};
+    int nThreadsServicingBackground GUARDED_BY(newTaskMutex){0};
+    //! Background tasks being run, which may still schedule new tasks
+    int nBackgroundTasksRunning GUARDED_BY(newTaskMutex){0};
     bool stopRequested GUARDED_BY(newTaskMutex){false};
     bool stopWhenEmpty GUARDED_BY(newTaskMutex){false};
-    bool shouldStop() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex) { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex) { return stopRequested || (stopWhenEmpty && taskQueue.empty() && backgroundQueue.empty() && nBackgroundTasksRunning == 0); }
+
+    mutable Mutex m_stats_mutex;
+    std::map<std::string, JobStats> m_job_stats GUARDED_BY(m_stats_mutex);
+
+    void RunTask(Task& task) LOCKS_EXCLUDED(newTaskMutex);
 };
 
 /**
@@ -172,8 +172,11 @@ struct PrecomputedTransactionData
 
     PrecomputedTransactionData() = default;
 
+    /** Precompute the sighash midstates of tx. Which ones are needed is inferred from
+     *  the witnesses of tx, unless force is set; signers set it because the witnesses
+     *  they are about to create are still empty. */
     template <class T>
-    void Init(const T& tx, std::vector<CTxOut>&& spent_outputs);
+    void Init(const T& tx, std::vector<CTxOut>&& spent_outputs, bool force = false);
 
     template <class T>
     explicit PrecomputedTransactionData(const T& tx);
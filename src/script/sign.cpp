@@ -11,10 +11,17 @@
 #include <script/signingprovider.h>
 #include <script/standard.h>
 #include <uint256.h>
+#include <util/parallel.h>
+#include <util/system.h>
+
+#include <algorithm>
 
 typedef std::vector<unsigned char> valtype;
 
-MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn) : txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), checker(txTo, nIn, amountIn, nullptr) {}
+MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn) : txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), m_txdata(nullptr), checker(txTo, nIn, amountIn, nullptr) {}
+MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, const PrecomputedTransactionData* txdata, int nHashTypeIn)
+    : txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), m_txdata(txdata),
+      checker(txdata ? MutableTransactionSignatureChecker(txTo, nIn, amountIn, nullptr, *txdata) : MutableTransactionSignatureChecker(txTo, nIn, amountIn, nullptr)) {}
 
 bool MutableTransactionSignatureCreator::CreateSig(const SigningProvider& provider, std::vector<unsigned char>& vchSig, const CKeyID& address, const CScript& scriptCode, SigVersion sigversion) const
 {
@@ -26,7 +33,7 @@ bool MutableTransactionSignatureCreator::CreateSig(const SigningProvider& provid
     if (sigversion == SigVersion::WITNESS_V0 && !key.IsCompressed())
         return false;
 
-    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion);
+    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion, m_txdata);
     if (!key.Sign(hash, vchSig))
         return false;
     vchSig.push_back((unsigned char)nHashType);
@@ -476,6 +483,11 @@ bool IsSegWitOutput(const SigningProvider& provider, const CScript& script)
     return false;
 }
 
+void ForEachInputParallel(size_t count, const std::function<void(size_t)>& fn)
+{
+    ParallelFor(count, std::min(GetNumCores(), MAX_SIGNING_THREADS), MIN_INPUTS_PER_SIGNING_THREAD, fn);
+}
+
 bool SignTransaction(CMutableTransaction& mtx, const SigningProvider* keystore, const std::map<COutPoint, Coin>& coins, int nHashType, std::map<int, std::string>& input_errors)
 {
     bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
@@ -483,42 +495,66 @@ bool SignTransaction(CMutableTransaction& mtx, const SigningProvider* keystore,
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mtx);
-    // Sign what we can:
+
+    // Look up the spent coins first, so the sighash midstates are computed once for all inputs
+    std::vector<const Coin*> spent(mtx.vin.size(), nullptr);
+    std::vector<CTxOut> spent_outputs;
     for (unsigned int i = 0; i < mtx.vin.size(); i++) {
-        CTxIn& txin = mtx.vin[i];
-        auto coin = coins.find(txin.prevout);
+        auto coin = coins.find(mtx.vin[i].prevout);
         if (coin == coins.end() || coin->second.IsSpent()) {
             input_errors[i] = "Input not found or already spent";
             continue;
         }
-        const CScript& prevPubKey = coin->second.out.scriptPubKey;
-        const CAmount& amount = coin->second.out.nValue;
-
-        SignatureData sigdata = DataFromTransaction(mtx, i, coin->second.out);
+        spent[i] = &coin->second;
+        spent_outputs.push_back(coin->second.out);
+    }
+    // The spent outputs are only committed to when all of them are known
+    if (spent_outputs.size() != mtx.vin.size()) spent_outputs.clear();
+    PrecomputedTransactionData txdata;
+    txdata.Init(txConst, std::move(spent_outputs), /* force */ true);
+
+    // Sign what we can. Each input is signed into its own copy, so the workers only read mtx.
+    std::vector<CTxIn> signed_inputs(mtx.vin);
+    std::vector<std::string> errors(mtx.vin.size());
+    ForEachInputParallel(mtx.vin.size(), [&](size_t i) {
+        if (!spent[i]) return;
+        CTxIn& txin = signed_inputs[i];
+        const CScript& prevPubKey = spent[i]->out.scriptPubKey;
+        const CAmount& amount = spent[i]->out.nValue;
+
+        SignatureData sigdata = DataFromTransaction(mtx, i, spent[i]->out);
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
         if (!fHashSingle || (i < mtx.vout.size())) {
-            ProduceSignature(*keystore, MutableTransactionSignatureCreator(&mtx, i, amount, nHashType), prevPubKey, sigdata);
+            ProduceSignature(*keystore, MutableTransactionSignatureCreator(&mtx, i, amount, &txdata, nHashType), prevPubKey, sigdata);
         }
 
         UpdateInput(txin, sigdata);
 
         // amount must be specified for valid segwit signature
         if (amount == MAX_MONEY && !txin.scriptWitness.IsNull()) {
-            input_errors[i] = "Missing amount";
-            continue;
+            errors[i] = "Missing amount";
+            return;
         }
 
         ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_NONCONTEXTUAL_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount, nullptr), &serror)) {
+        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_NONCONTEXTUAL_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount, nullptr, txdata), &serror)) {
             if (serror == SCRIPT_ERR_INVALID_STACK_OPERATION) {
                 // Unable to sign input and verification failed (possible attempt to partially sign).
-                input_errors[i] = "Unable to sign input, invalid stack size (possibly missing key)";
+                errors[i] = "Unable to sign input, invalid stack size (possibly missing key)";
             } else if (serror == SCRIPT_ERR_SIG_NULLFAIL) {
                 // Verification failed (possibly due to insufficient signatures).
-                input_errors[i] = "CHECK(MULTI)SIG failing with non-zero signature (possibly need more signatures)";
+                errors[i] = "CHECK(MULTI)SIG failing with non-zero signature (possibly need more signatures)";
             } else {
-                input_errors[i] = ScriptErrorString(serror);
+                errors[i] = ScriptErrorString(serror);
             }
+        }
+    });
+
+    for (unsigned int i = 0; i < mtx.vin.size(); i++) {
+        if (!spent[i]) continue;
+        mtx.vin[i] = std::move(signed_inputs[i]);
+        if (!errors[i].empty()) {
+            input_errors[i] = errors[i];
         } else {
             // If this input succeeds, make sure there is no error set for it
             input_errors.erase(i);
@@ -14,6 +14,8 @@
 #include <span.h>
 #include <streams.h>
 
+#include <functional>
+
 class CKey;
 class CKeyID;
 class CScript;
@@ -39,10 +41,13 @@ class MutableTransactionSignatureCreator : public BaseSignatureCreator {
     unsigned int nIn;
     int nHashType;
     CAmount amount;
+    const PrecomputedTransactionData* m_txdata;
     const MutableTransactionSignatureChecker checker;
 
 public:
     MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn = SIGHASH_ALL);
+    /** Sign with sighash midstates shared by all inputs of txTo. txdata must outlive the creator. */
+    MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, const PrecomputedTransactionData* txdata, int nHashTypeIn = SIGHASH_ALL);
     const BaseSignatureChecker& Checker() const override { return checker; }
     bool CreateSig(const SigningProvider& provider, std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode, SigVersion sigversion) const override;
 };
@@ -170,7 +175,15 @@ bool IsSolvable(const SigningProvider& provider, const CScript& script);
 /** Check whether a scriptPubKey is known to be segwit. */
 bool IsSegWitOutput(const SigningProvider& provider, const CScript& script);
 
-/** Sign the CMutableTransaction */
+/** Maximum number of threads used to sign or finalize the inputs of one transaction */
+static constexpr int MAX_SIGNING_THREADS = 8;
+/** Minimum number of inputs per signing thread; smaller transactions are signed on the calling thread */
+static constexpr size_t MIN_INPUTS_PER_SIGNING_THREAD = 16;
+
+/** Call fn(i) for every input i in [0, count) through ParallelFor, with the signing thread limits. */
+void ForEachInputParallel(size_t count, const std::function<void(size_t)>& fn);
+
+/** Sign the CMutableTransaction. Inputs are signed in parallel with shared sighash midstates. */
 bool SignTransaction(CMutableTransaction& mtx, const SigningProvider* provider, const std::map<COutPoint, Coin>& coins, int sighash, std::map<int, std::string>& input_errors);
 
 #endif // BITCOIN_SCRIPT_SIGN_H
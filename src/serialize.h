@@ -18,6 +18,7 @@
 #include <set>
 #include <string>
 #include <string.h>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -286,26 +287,35 @@ inline void WriteCompactSize(CSizeComputer& os, uint64_t nSize);
 template<typename Stream>
 void WriteCompactSize(Stream& os, uint64_t nSize)
 {
+    // Encode into a local buffer so that the stream sees a single write
+    unsigned char buf[1 + sizeof(uint64_t)];
+    size_t len = 1;
     if (nSize < 253)
     {
-        ser_writedata8(os, nSize);
+        buf[0] = nSize;
     }
     else if (nSize <= std::numeric_limits<uint16_t>::max())
     {
-        ser_writedata8(os, 253);
-        ser_writedata16(os, nSize);
+        buf[0] = 253;
+        uint16_t v = htole16(nSize);
+        memcpy(buf + 1, &v, sizeof(v));
+        len += sizeof(v);
     }
     else if (nSize <= std::numeric_limits<unsigned int>::max())
     {
-        ser_writedata8(os, 254);
-        ser_writedata32(os, nSize);
+        buf[0] = 254;
+        uint32_t v = htole32(nSize);
+        memcpy(buf + 1, &v, sizeof(v));
+        len += sizeof(v);
     }
     else
     {
-        ser_writedata8(os, 255);
-        ser_writedata64(os, nSize);
+        buf[0] = 255;
+        uint64_t v = htole64(nSize);
+        memcpy(buf + 1, &v, sizeof(v));
+        len += sizeof(v);
     }
-    return;
+    os.write((char*)buf, len);
 }
 
 /**
@@ -642,6 +652,26 @@ struct VectorFormatter
 template<typename Stream, typename C> void Serialize(Stream& os, const std::basic_string<C>& str);
 template<typename Stream, typename C> void Unserialize(Stream& is, std::basic_string<C>& str);
 
+/**
+ * Integers are serialized little-endian with the same width as in memory, so
+ * on little-endian hosts vectors of them can be copied as a single blob, like
+ * vectors of unsigned char. VectorSerTag maps such element types to unsigned
+ * char to select that overload, and leaves every other type alone.
+ */
+template<typename T> struct IsBlobInteger : std::false_type {};
+template<> struct IsBlobInteger<char> : std::true_type {};
+template<> struct IsBlobInteger<int8_t> : std::true_type {};
+#if !defined(WORDS_BIGENDIAN)
+template<> struct IsBlobInteger<int16_t> : std::true_type {};
+template<> struct IsBlobInteger<uint16_t> : std::true_type {};
+template<> struct IsBlobInteger<int32_t> : std::true_type {};
+template<> struct IsBlobInteger<uint32_t> : std::true_type {};
+template<> struct IsBlobInteger<int64_t> : std::true_type {};
+template<> struct IsBlobInteger<uint64_t> : std::true_type {};
+#endif
+template<typename T>
+using VectorSerTag = typename std::conditional<IsBlobInteger<T>::value, unsigned char, T>::type;
+
 /**
  * prevector
  * prevectors of unsigned char are a special case and are intended to be serialized as a single opaque blob.
@@ -772,7 +802,7 @@ void Serialize_impl(Stream& os, const prevector<N, T>& v, const V&)
 template<typename Stream, unsigned int N, typename T>
 inline void Serialize(Stream& os, const prevector<N, T>& v)
 {
-    Serialize_impl(os, v, T());
+    Serialize_impl(os, v, VectorSerTag<T>());
 }
 
 
@@ -801,7 +831,7 @@ void Unserialize_impl(Stream& is, prevector<N, T>& v, const V&)
 template<typename Stream, unsigned int N, typename T>
 inline void Unserialize(Stream& is, prevector<N, T>& v)
 {
-    Unserialize_impl(is, v, T());
+    Unserialize_impl(is, v, VectorSerTag<T>());
 }
 
 
@@ -838,7 +868,7 @@ void Serialize_impl(Stream& os, const std::vector<T, A>& v, const V&)
 template<typename Stream, typename T, typename A>
 inline void Serialize(Stream& os, const std::vector<T, A>& v)
 {
-    Serialize_impl(os, v, T());
+    Serialize_impl(os, v, VectorSerTag<T>());
 }
 
 
@@ -867,7 +897,7 @@ void Unserialize_impl(Stream& is, std::vector<T, A>& v, const V&)
 template<typename Stream, typename T, typename A>
 inline void Unserialize(Stream& is, std::vector<T, A>& v)
 {
-    Unserialize_impl(is, v, T());
+    Unserialize_impl(is, v, VectorSerTag<T>());
 }
 
 
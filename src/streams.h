@@ -8,6 +8,7 @@
 
 #include <support/allocators/zeroafterfree.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -194,6 +195,96 @@ public:
     }
 };
 
+/** Minimal stream for reading from a span of bytes without copying them
+ */
+class SpanReader
+{
+private:
+    const int m_type;
+    const int m_version;
+    Span<const unsigned char> m_data;
+
+public:
+
+    /**
+     * @param[in]  type Serialization Type
+     * @param[in]  version Serialization Version (including any flags)
+     * @param[in]  data Referenced bytes, which must outlive the reader
+     */
+    SpanReader(int type, int version, Span<const unsigned char> data)
+        : m_type(type), m_version(version), m_data(data) {}
+
+    template<typename T>
+    SpanReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return m_version; }
+    int GetType() const { return m_type; }
+
+    size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        if (n > m_data.size()) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, m_data.data(), n);
+        m_data = m_data.subspan(n);
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > m_data.size()) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_data = m_data.subspan(n);
+    }
+};
+
+/**
+ * XOR bytes with a key that is repeated over their whole length.
+ *
+ * Keys whose length divides 8, like the database obfuscation key, are applied
+ * a 64-bit word at a time, which the compiler can further vectorize.
+ */
+inline void XorBytes(Span<unsigned char> data, Span<const unsigned char> key)
+{
+    if (key.size() == 0) {
+        return;
+    }
+
+    size_t i = 0;
+    if (8 % key.size() == 0) {
+        unsigned char key_bytes[8];
+        for (size_t k = 0; k < sizeof(key_bytes); ++k) {
+            key_bytes[k] = key[k % key.size()];
+        }
+        uint64_t key_word;
+        memcpy(&key_word, key_bytes, sizeof(key_word));
+        for (; i + 8 <= data.size(); i += 8) {
+            uint64_t word;
+            memcpy(&word, data.data() + i, sizeof(word));
+            word ^= key_word;
+            memcpy(data.data() + i, &word, sizeof(word));
+        }
+    }
+
+    // Any bytes left over after the words, starting at the matching key byte
+    for (size_t j = i % key.size(); i != data.size(); i++) {
+        data[i] ^= key[j++];
+        if (j == key.size())
+            j = 0;
+    }
+}
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -474,20 +565,7 @@ public:
      */
     void Xor(const std::vector<unsigned char>& key)
     {
-        if (key.size() == 0) {
-            return;
-        }
-
-        for (size_type i = 0, j = 0; i != size(); i++) {
-            vch[i] ^= key[j++];
-
-            // This potentially acts on very many bytes of data, so it's
-            // important that we calculate `j`, i.e. the `key` index in this
-            // way instead of doing a %, which would effectively be a division
-            // for each byte Xor'd -- much slower than need be.
-            if (j == key.size())
-                j = 0;
-        }
+        XorBytes(MakeUCharSpan(vch).first(size()), key);
     }
 };
 
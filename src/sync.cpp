@@ -13,6 +13,7 @@
 #include <util/strencodings.h>
 #include <util/threadnames.h>
 
+#include <chrono>
 #include <map>
 #include <set>
 #include <system_error>
@@ -32,6 +33,105 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> g_lock_stats_enabled{DEFAULT_LOCKSTATS};
+
+//! Open addressing table of LockSiteStats, never shrinks
+static const size_t LOCK_SITE_SLOTS = 1 << 13;
+static std::atomic<LockSiteStats*> g_lock_sites[LOCK_SITE_SLOTS];
+
+LockSiteStats::LockSiteStats(const char* name_in, const char* file_in, int line_in) : name(name_in), file(file_in), line(line_in)
+{
+    for (auto& bucket : wait_histogram) bucket = 0;
+    for (auto& bucket : hold_histogram) bucket = 0;
+}
+
+static int LockStatsBucket(int64_t nanos)
+{
+    int bucket = 0;
+    for (int64_t micros = nanos / 1000; micros > 0 && bucket < LockSiteStats::HISTOGRAM_BUCKETS - 1; micros >>= 1) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void LockSiteStats::RecordWait(int64_t nanos)
+{
+    if (nanos < 0) nanos = 0;
+    contentions.fetch_add(1, std::memory_order_relaxed);
+    wait_nanos.fetch_add(nanos, std::memory_order_relaxed);
+    UpdateMax(max_wait_nanos, nanos);
+    wait_histogram[LockStatsBucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockSiteStats::RecordHold(int64_t nanos)
+{
+    if (nanos < 0) nanos = 0;
+    hold_nanos.fetch_add(nanos, std::memory_order_relaxed);
+    UpdateMax(max_hold_nanos, nanos);
+    hold_histogram[LockStatsBucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockSiteStats::Reset()
+{
+    acquisitions = 0;
+    contentions = 0;
+    wait_nanos = 0;
+    max_wait_nanos = 0;
+    hold_nanos = 0;
+    max_hold_nanos = 0;
+    for (auto& bucket : wait_histogram) bucket = 0;
+    for (auto& bucket : hold_histogram) bucket = 0;
+}
+
+LockSiteStats* GetLockSiteStats(const char* name, const char* file, int line)
+{
+    // Sites are identified by their string literals, so this never compares strings
+    size_t hash = ((size_t)name * 31 + (size_t)file) * 31 + line;
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B97F4A7C15ULL;
+    for (size_t probe = 0; probe < 32; ++probe) {
+        std::atomic<LockSiteStats*>& slot = g_lock_sites[(hash + probe) & (LOCK_SITE_SLOTS - 1)];
+        LockSiteStats* stats = slot.load(std::memory_order_acquire);
+        if (stats == nullptr) {
+            LockSiteStats* new_stats = new LockSiteStats(name, file, line);
+            if (slot.compare_exchange_strong(stats, new_stats, std::memory_order_acq_rel)) return new_stats;
+            // Another thread filled the slot first
+            delete new_stats;
+        }
+        if (stats->name == name && stats->file == file && stats->line == line) return stats;
+    }
+    return nullptr;
+}
+
+std::vector<const LockSiteStats*> GetAllLockSiteStats()
+{
+    std::vector<const LockSiteStats*> result;
+    for (const auto& slot : g_lock_sites) {
+        const LockSiteStats* stats = slot.load(std::memory_order_acquire);
+        if (stats) result.push_back(stats);
+    }
+    return result;
+}
+
+void ResetLockSiteStats()
+{
+    for (const auto& slot : g_lock_sites) {
+        LockSiteStats* stats = slot.load(std::memory_order_acquire);
+        if (stats) stats->Reset();
+    }
+}
+
+int64_t LockStatsNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -9,10 +9,13 @@
 #include <threadsafety.h>
 #include <util/macros.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 ////////////////////////////////////////////////
 //                                            //
@@ -128,30 +131,91 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+static const bool DEFAULT_LOCKSTATS = true;
+
+/**
+ * How long the locks taken at one LOCK site were waited for and held, see the
+ * getlockstats RPC. Times are in nanoseconds. Bucket 0 of the histograms
+ * counts times below one microsecond, bucket i times in [2^(i-1), 2^i)
+ * microseconds, and the last bucket everything longer.
+ */
+struct LockSiteStats {
+    static constexpr int HISTOGRAM_BUCKETS = 24;
+
+    const char* const name;
+    const char* const file;
+    const int line;
+
+    std::atomic<uint64_t> acquisitions{0};
+    //! Acquisitions that had to wait because another thread held the lock
+    std::atomic<uint64_t> contentions{0};
+    std::atomic<uint64_t> wait_nanos{0};
+    std::atomic<uint64_t> max_wait_nanos{0};
+    std::atomic<uint64_t> hold_nanos{0};
+    std::atomic<uint64_t> max_hold_nanos{0};
+    std::atomic<uint64_t> wait_histogram[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> hold_histogram[HISTOGRAM_BUCKETS];
+
+    LockSiteStats(const char* name_in, const char* file_in, int line_in);
+    void RecordWait(int64_t nanos);
+    void RecordHold(int64_t nanos);
+    void Reset();
+};
+
+//! Whether UniqueLock records LockSiteStats, see -lockstats
+extern std::atomic<bool> g_lock_stats_enabled;
+/** Stats of a LOCK site, or nullptr if too many sites are tracked already */
+LockSiteStats* GetLockSiteStats(const char* name, const char* file, int line);
+/** All LOCK sites that were entered while stats were enabled */
+std::vector<const LockSiteStats*> GetAllLockSiteStats();
+void ResetLockSiteStats();
+int64_t LockStatsNanos();
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    //! Stats of the LOCK site while the lock is held, if stats are enabled
+    LockSiteStats* m_lock_stats{nullptr};
+    int64_t m_locked_nanos{0};
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+        LockSiteStats* stats = g_lock_stats_enabled.load(std::memory_order_relaxed) ? GetLockSiteStats(pszName, pszFile, nLine) : nullptr;
         if (!Base::try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
-            Base::lock();
-#ifdef DEBUG_LOCKCONTENTION
+            if (stats) {
+                const int64_t wait_start = LockStatsNanos();
+                Base::lock();
+                m_locked_nanos = LockStatsNanos();
+                stats->RecordWait(m_locked_nanos - wait_start);
+            } else {
+                Base::lock();
+            }
+        } else if (stats) {
+            m_locked_nanos = LockStatsNanos();
         }
-#endif
+        if (stats) stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        m_lock_stats = stats;
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()), true);
         Base::try_lock();
-        if (!Base::owns_lock())
+        if (!Base::owns_lock()) {
             LeaveCritical();
+        } else if (g_lock_stats_enabled.load(std::memory_order_relaxed)) {
+            m_lock_stats = GetLockSiteStats(pszName, pszFile, nLine);
+            if (m_lock_stats) {
+                m_locked_nanos = LockStatsNanos();
+                m_lock_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
         return Base::owns_lock();
     }
 
@@ -177,8 +241,11 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
+            // Includes the time spent waiting on a condition variable with this lock
+            if (m_lock_stats) m_lock_stats->RecordHold(LockStatsNanos() - m_locked_nanos);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -198,6 +265,7 @@ public:
     public:
         explicit reverse_lock(UniqueLock& _lock, const char* _guardname, const char* _file, int _line) : lock(_lock), file(_file), line(_line) {
             CheckLastCritical((void*)lock.mutex(), lockname, _guardname, _file, _line);
+            if (lock.m_lock_stats) lock.m_lock_stats->RecordHold(LockStatsNanos() - lock.m_locked_nanos);
             lock.unlock();
             LeaveCritical();
             lock.swap(templock);
@@ -207,6 +275,7 @@ public:
             templock.swap(lock);
             EnterCritical(lockname.c_str(), file.c_str(), line, (void*)lock.mutex());
             lock.lock();
+            if (lock.m_lock_stats) lock.m_locked_nanos = LockStatsNanos();
         }
 
      private:
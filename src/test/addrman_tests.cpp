@@ -1,6 +1,7 @@
 // Copyright (c) 2012-2020 The Bitcoin Core developers
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include <addrdb.h>
 #include <addrman.h>
 #include <test/data/asmap.raw.h>
 #include <test/util/setup_common.h>
@@ -12,7 +13,12 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <set>
 #include <string>
+#include <vector>
 
 class CAddrManTest : public CAddrMan
 {
@@ -27,7 +33,7 @@ public:
             MakeDeterministic();
         }
         deterministic = makeDeterministic;
-        m_asmap = asmap;
+        m_asmap = ASMap(std::move(asmap));
     }
 
     //! Ensure that bucket placement is always the same for testing purposes.
@@ -59,7 +65,10 @@ public:
     std::pair<int, int> GetBucketAndEntry(const CAddress& addr)
     {
         LOCK(cs);
-        int nId = mapAddr[addr];
+        int nId = -1;
+        if (!CAddrMan::Find(addr, &nId)) {
+            return std::pair<int, int>(-1, -1);
+        }
         for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; ++bucket) {
             for (int entry = 0; entry < ADDRMAN_BUCKET_SIZE; ++entry) {
                 if (nId == vvNew[bucket][entry]) {
@@ -70,6 +79,21 @@ public:
         return std::pair<int, int>(-1, -1);
     }
 
+    //! The occupied bucket positions and what is stored about their entries, for comparing address managers
+    std::set<std::pair<int, std::string>> GetPositions()
+    {
+        LOCK(cs);
+        std::set<std::pair<int, std::string>> positions;
+        for (int position = 0; position < ADDRMAN_POSITION_COUNT; ++position) {
+            const int nId = AtPosition(position);
+            if (nId != -1) {
+                const CAddrInfo& info = m_infos[nId];
+                positions.emplace(position, strprintf("%s %d %d", info.ToString(), info.nTime, info.nServices));
+            }
+        }
+        return positions;
+    }
+
     // Simulates connection failure so that we can test eviction of offline nodes
     void SimConnFail(CService& addr)
     {
@@ -445,6 +469,19 @@ BOOST_AUTO_TEST_CASE(addrman_getaddr)
     BOOST_CHECK_EQUAL(vAddr.size(), 461U);
     // (Addrman.size() < number of addresses added) due to address collisions.
     BOOST_CHECK_EQUAL(addrman.size(), 2006U);
+
+    // Test: Consecutive calls take different addresses from the same shuffled
+    //  snapshot, as long as it has enough left.
+    std::set<std::string> seen;
+    for (const CAddress& addr : vAddr) {
+        BOOST_CHECK(seen.insert(addr.ToString()).second);
+    }
+    for (int i = 0; i < 3; ++i) {
+        for (const CAddress& addr : addrman.GetAddr(/* max_addresses */ 2500, /* max_pct */ 23)) {
+            BOOST_CHECK(seen.insert(addr.ToString()).second);
+        }
+    }
+    BOOST_CHECK_EQUAL(seen.size(), 4 * 461U);
 }
 
 
@@ -463,7 +500,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket_legacy)
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap; // use /16
+    ASMap asmap; // use /16
 
     BOOST_CHECK_EQUAL(info1.GetTriedBucket(nKey1, asmap), 40);
 
@@ -517,7 +554,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket_legacy)
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap; // use /16
+    ASMap asmap; // use /16
 
     // Test: Make sure the buckets are what we expect
     BOOST_CHECK_EQUAL(info1.GetNewBucket(nKey1, asmap), 786);
@@ -596,7 +633,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket)
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    ASMap asmap(FromBytes(asmap_raw, sizeof(asmap_raw) * 8));
 
     BOOST_CHECK_EQUAL(info1.GetTriedBucket(nKey1, asmap), 236);
 
@@ -650,7 +687,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket)
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    std::vector<bool> asmap = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    ASMap asmap(FromBytes(asmap_raw, sizeof(asmap_raw) * 8));
 
     // Test: Make sure the buckets are what we expect
     BOOST_CHECK_EQUAL(info1.GetNewBucket(nKey1, asmap), 795);
@@ -782,6 +819,214 @@ BOOST_AUTO_TEST_CASE(addrman_serialization)
     BOOST_CHECK(bucketAndEntry_asmap1_deser_addr1.second != bucketAndEntry_asmap1_deser_addr2.second);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_changes)
+{
+    // Fill an addrman with enough addresses for collisions in the new and tried tables
+    CAddrManTest addrman_orig;
+    for (unsigned int i = 1; i < 1024; i++) {
+        CAddress addr = CAddress(ResolveService(strprintf("250.%d.%d.1", i % 4, i / 4)), NODE_NONE);
+        addr.nTime = GetAdjustedTime();
+        addrman_orig.Add(addr, ResolveIP(strprintf("251.%d.1.1", i % 16)));
+        if (i % 8 == 0) addrman_orig.Good(addr);
+    }
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << addrman_orig;
+
+    // Two addrmen loaded from the same snapshot
+    CAddrManTest addrman;
+    CAddrManTest addrman_replay;
+    CDataStream stream_copy(stream);
+    stream >> addrman;
+    stream_copy >> addrman_replay;
+    BOOST_CHECK(addrman.TakeChanges().empty());
+    BOOST_CHECK(addrman.GetPositions() == addrman_replay.GetPositions());
+
+    for (int round = 0; round < 2; ++round) {
+        // Add, update, evict and move addresses between the tables
+        for (unsigned int i = 1; i < 1024; i++) {
+            CAddress addr = CAddress(ResolveService(strprintf("250.%d.%d.%d", i % 8, i / 8, round + 2)), NODE_NETWORK);
+            addr.nTime = GetAdjustedTime() + round;
+            addrman.Add(addr, ResolveIP(strprintf("251.%d.1.1", i % 32)));
+            if (i % 5 == 0) addrman.Good(addr, /* test_before_evict */ false);
+            if (i % 7 == 0) addrman.Attempt(addr, /* fCountFailure */ true);
+        }
+        for (unsigned int i = 1; i < 1024; i += 3) {
+            addrman.Good(CService(ResolveService(strprintf("250.%d.%d.1", i % 4, i / 4))), /* test_before_evict */ false);
+        }
+
+        CAddrManChanges changes = addrman.TakeChanges();
+        BOOST_CHECK(!changes.empty());
+        BOOST_CHECK(addrman.TakeChanges().empty());
+
+        // Replaying the serialized changes brings the other addrman into the same state
+        CDataStream stream_changes(SER_DISK, CLIENT_VERSION);
+        stream_changes << changes;
+        CAddrManChanges changes_read;
+        stream_changes >> changes_read;
+        addrman_replay.ApplyChanges(changes_read, /* bucketing_unchanged */ true);
+        BOOST_CHECK_EQUAL(addrman_replay.size(), addrman.size());
+        BOOST_CHECK(addrman.GetPositions() == addrman_replay.GetPositions());
+    }
+}
+
+static std::vector<CAddress> AddAddresses(CAddrMan& addrman, int round, int count)
+{
+    std::vector<CAddress> addrs;
+    for (int i = 1; i <= count; i++) {
+        CAddress addr = CAddress(ResolveService(strprintf("250.%d.%d.%d", round, i % 256, i / 256 + 1)), NODE_NETWORK);
+        addr.nTime = GetAdjustedTime();
+        addrman.Add(addr, ResolveIP(strprintf("251.%d.1.1", i % 16)));
+        if (i % 4 == 0) addrman.Good(addr, /* test_before_evict */ false);
+        addrs.push_back(addr);
+    }
+    return addrs;
+}
+
+static std::string FileContents(const fs::path& path)
+{
+    fsbridge::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_CASE(caddrdb_journal)
+{
+    const fs::path snapshot_path = GetDataDir() / "peers.dat";
+    const fs::path journal_path = GetDataDir() / "peers_journal.dat";
+    CAddrDB adb;
+
+    CAddrManTest addrman;
+    AddAddresses(addrman, 0, 200);
+    BOOST_REQUIRE(adb.Write(addrman));
+    const std::string snapshot = FileContents(snapshot_path);
+    const uint64_t header_size = fs::file_size(journal_path);
+
+    // Changes are appended to the journal, and peers.dat is left alone
+    AddAddresses(addrman, 1, 10);
+    BOOST_CHECK(adb.Update(addrman));
+    const uint64_t one_record_size = fs::file_size(journal_path);
+    BOOST_CHECK(one_record_size > header_size);
+    AddAddresses(addrman, 2, 10);
+    BOOST_CHECK(adb.Update(addrman));
+    const uint64_t journal_size = fs::file_size(journal_path);
+    BOOST_CHECK(journal_size > one_record_size);
+    BOOST_CHECK(FileContents(snapshot_path) == snapshot);
+    {
+        CAddrManTest addrman_read;
+        BOOST_CHECK(adb.Read(addrman_read));
+        BOOST_CHECK(addrman_read.GetPositions() == addrman.GetPositions());
+    }
+
+    // A record cut short by a crash is dropped, and appending continues after the good ones
+    {
+        FILE* file = fsbridge::fopen(journal_path, "ab");
+        BOOST_REQUIRE(file);
+        const std::string torn = FileContents(journal_path).substr(header_size, 40);
+        BOOST_REQUIRE_EQUAL(fwrite(torn.data(), 1, torn.size(), file), torn.size());
+        fclose(file);
+    }
+    BOOST_CHECK(fs::file_size(journal_path) > journal_size);
+    {
+        CAddrManTest addrman_read;
+        BOOST_CHECK(adb.Read(addrman_read));
+        BOOST_CHECK(addrman_read.GetPositions() == addrman.GetPositions());
+    }
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), journal_size);
+    AddAddresses(addrman, 3, 10);
+    BOOST_CHECK(adb.Update(addrman));
+    BOOST_CHECK(fs::file_size(journal_path) > journal_size);
+    {
+        CAddrManTest addrman_read;
+        BOOST_CHECK(adb.Read(addrman_read));
+        BOOST_CHECK(addrman_read.GetPositions() == addrman.GetPositions());
+    }
+
+    // Once the journal outgrows peers.dat, it is folded into a new snapshot
+    AddAddresses(addrman, 4, 1000);
+    BOOST_CHECK(adb.Update(addrman));
+    BOOST_CHECK(FileContents(snapshot_path) == snapshot);
+    BOOST_CHECK(fs::file_size(journal_path) > fs::file_size(snapshot_path));
+    BOOST_CHECK(adb.Update(addrman));
+    BOOST_CHECK(FileContents(snapshot_path) != snapshot);
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), header_size);
+    {
+        CAddrManTest addrman_read;
+        BOOST_CHECK(adb.Read(addrman_read));
+        BOOST_CHECK(addrman_read.GetPositions() == addrman.GetPositions());
+    }
+
+    // A journal of an earlier peers.dat is ignored by Read, and replaced by Update
+    AddAddresses(addrman, 5, 10);
+    BOOST_CHECK(adb.Update(addrman));
+    const std::string stale_journal = FileContents(journal_path);
+    CAddrManTest addrman_other;
+    AddAddresses(addrman_other, 6, 10);
+    BOOST_REQUIRE(adb.Write(addrman_other));
+    {
+        fsbridge::ofstream file(journal_path, std::ios::binary | std::ios::trunc);
+        file << stale_journal;
+    }
+    {
+        CAddrManTest addrman_read;
+        BOOST_CHECK(adb.Read(addrman_read));
+        BOOST_CHECK(addrman_read.GetPositions() == addrman_other.GetPositions());
+    }
+    const std::string other_snapshot = FileContents(snapshot_path);
+    AddAddresses(addrman_other, 7, 10);
+    BOOST_CHECK(adb.Update(addrman_other));
+    BOOST_CHECK(FileContents(snapshot_path) != other_snapshot);
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), header_size);
+
+    // A journal written without an asmap is still applied with one, but
+    // Update replaces it, as the entries have to be bucketed again. Entries
+    // that collide in their new buckets are dropped, as for peers.dat alone.
+    const std::vector<bool> asmap = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    size_t snapshot_asmap_size;
+    {
+        CAddrManTest addrman_read(true, asmap);
+        BOOST_CHECK(adb.Read(addrman_read));
+        snapshot_asmap_size = addrman_read.size();
+    }
+    const std::vector<CAddress> addrs8 = AddAddresses(addrman_other, 8, 10);
+    BOOST_CHECK(adb.Update(addrman_other));
+    BOOST_CHECK(fs::file_size(journal_path) > header_size);
+    CAddrManTest addrman_asmap(true, asmap);
+    BOOST_CHECK(adb.Read(addrman_asmap));
+    BOOST_CHECK(addrman_asmap.size() > snapshot_asmap_size);
+    BOOST_CHECK(std::any_of(addrs8.begin(), addrs8.end(), [&](const CAddress& addr) { return addrman_asmap.Find(addr) != nullptr; }));
+    const std::string asmap_snapshot = FileContents(snapshot_path);
+    BOOST_CHECK(adb.Update(addrman_asmap));
+    BOOST_CHECK(FileContents(snapshot_path) != asmap_snapshot);
+    BOOST_CHECK_EQUAL(fs::file_size(journal_path), header_size);
+}
+
+BOOST_AUTO_TEST_CASE(asmap_compiled_lookup)
+{
+    const std::vector<bool> bits = FromBytes(asmap_raw, sizeof(asmap_raw) * 8);
+    const ASMap asmap(bits);
+    BOOST_CHECK(asmap.GetRangeCount() > 1);
+    BOOST_CHECK_EQUAL(ResolveIP("250.1.2.3").GetMappedAS(asmap), 1000U);
+    BOOST_CHECK_EQUAL(ResolveIP("101.3.4.5").GetMappedAS(asmap), 3U);
+
+    // Lookups in the compiled table agree with interpreting the asmap
+    FastRandomContext rng(true);
+    for (int i = 0; i < 10000; ++i) {
+        uint8_t ip[16];
+        const std::vector<unsigned char> random_bytes = rng.randbytes(16);
+        std::copy(random_bytes.begin(), random_bytes.end(), ip);
+        if (rng.randbool()) {
+            // IPv4, mostly close to the mapped prefixes
+            std::copy(IPV4_IN_IPV6_PREFIX.begin(), IPV4_IN_IPV6_PREFIX.end(), ip);
+            if (rng.randbool()) ip[12] = rng.randbool() ? 101 : 250;
+            if (rng.randbool()) ip[13] = rng.randrange(10);
+        }
+        std::vector<bool> ip_bits(128);
+        for (int bit = 0; bit < 128; ++bit) {
+            ip_bits[bit] = (ip[bit / 8] >> (7 - bit % 8)) & 1;
+        }
+        BOOST_CHECK_EQUAL(asmap.Lookup(ip), Interpret(bits, ip_bits));
+    }
+}
+
 
 BOOST_AUTO_TEST_CASE(addrman_selecttriedcollision)
 {
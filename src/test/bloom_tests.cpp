@@ -530,4 +530,109 @@ BOOST_AUTO_TEST_CASE(rolling_bloom)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(rolling_cuckoo)
+{
+    SeedInsecureRand(SeedRand::ZEROS);
+    g_mock_deterministic_tests = true;
+
+    // last-100-pair filter, shared by two tags:
+    CRollingCuckooFilter rc1(100);
+    static const int DATASIZE=399;
+    uint256 data[DATASIZE];
+    for (int i = 0; i < DATASIZE; i++) {
+        data[i] = InsecureRand256();
+    }
+    BOOST_CHECK(!rc1.contains(0, data[0]));
+
+    // Overfill:
+    for (int i = 0; i < DATASIZE; i++) {
+        rc1.insert(i % 2, data[i]);
+    }
+    // Last 100 guaranteed to be remembered, under their own tag only:
+    for (int i = 299; i < DATASIZE; i++) {
+        BOOST_CHECK(rc1.contains(i % 2, data[i]));
+        BOOST_CHECK(!rc1.contains((i + 1) % 2, data[i]));
+    }
+    // Anything older than the last 150 is forgotten:
+    for (int i = 0; i < 249; i++) {
+        BOOST_CHECK(!rc1.contains(i % 2, data[i]));
+    }
+    // Batch lookups agree with single ones:
+    std::vector<bool> found;
+    rc1.contains(1, MakeSpan(data), found);
+    BOOST_CHECK_EQUAL(found.size(), (size_t)DATASIZE);
+    for (int i = 0; i < DATASIZE; i++) {
+        BOOST_CHECK_EQUAL(found[i], rc1.contains(1, data[i]));
+    }
+
+    // The false positive rate is below 1e-8, so testing 10,000 random
+    // pairs should not hit:
+    unsigned int nHits = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (rc1.contains(InsecureRandBits(1), InsecureRand256()))
+            ++nHits;
+    }
+    BOOST_CHECK_EQUAL(nHits, 0U);
+
+    BOOST_CHECK(rc1.contains(0, data[DATASIZE-1]));
+    rc1.reset();
+    BOOST_CHECK(!rc1.contains(0, data[DATASIZE-1]));
+
+    // Now roll through data, make sure last 100 entries
+    // are always remembered:
+    for (int i = 0; i < DATASIZE; i++) {
+        if (i >= 100)
+            BOOST_CHECK(rc1.contains(0, data[i-100]));
+        rc1.insert(0, data[i]);
+        BOOST_CHECK(rc1.contains(0, data[i]));
+    }
+
+    // Inserting a pair again keeps it remembered:
+    for (int i = 0; i < DATASIZE; i++) {
+        rc1.insert(0, data[0]);
+        rc1.insert(1, data[i]);
+    }
+    BOOST_CHECK(rc1.contains(0, data[0]));
+
+    // Many tags filling the table up to its maximum load:
+    CRollingCuckooFilter rc2(10000);
+    std::vector<std::pair<uint64_t, uint256>> pairs;
+    for (int i = 0; i < 30000; i++) {
+        pairs.emplace_back(InsecureRand32(), InsecureRand256());
+        rc2.insert(pairs.back().first, pairs.back().second);
+    }
+    nHits = 0;
+    for (int i = 20000; i < 30000; i++) {
+        if (rc2.contains(pairs[i].first, pairs[i].second))
+            ++nHits;
+    }
+    BOOST_CHECK_EQUAL(nHits, 10000U);
+
+    // One tag flooding a filter with a quota of 25 per generation of 50
+    // cannot push out the pairs of another tag:
+    CRollingCuckooFilter rc3(100, 25);
+    for (int i = 0; i < 20; i++) {
+        rc3.insert(0, data[i]);
+    }
+    for (int i = 100; i < DATASIZE; i++) {
+        rc3.insert(1, data[i]);
+    }
+    for (int i = 0; i < 20; i++) {
+        BOOST_CHECK(rc3.contains(0, data[i]));
+    }
+    // Only the flood up to the quota is remembered:
+    for (int i = 100; i < DATASIZE; i++) {
+        BOOST_CHECK_EQUAL(rc3.contains(1, data[i]), i < 125);
+    }
+    // Other tags can still insert, and once the generation rolls over
+    // the flooding tag can too:
+    for (int i = 20; i < 25; i++) {
+        rc3.insert(2, data[i]);
+        BOOST_CHECK(rc3.contains(2, data[i]));
+    }
+    rc3.insert(1, data[DATASIZE - 1]);
+    BOOST_CHECK(rc3.contains(1, data[DATASIZE - 1]));
+    g_mock_deterministic_tests = false;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
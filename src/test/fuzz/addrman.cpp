@@ -29,13 +29,13 @@ void test_one_input(const std::vector<uint8_t>& buffer)
     SetMockTime(ConsumeTime(fuzzed_data_provider));
     CAddrMan addr_man;
     if (fuzzed_data_provider.ConsumeBool()) {
-        addr_man.m_asmap = ConsumeRandomLengthBitVector(fuzzed_data_provider);
-        if (!SanityCheckASMap(addr_man.m_asmap)) {
-            addr_man.m_asmap.clear();
+        std::vector<bool> asmap = ConsumeRandomLengthBitVector(fuzzed_data_provider);
+        if (SanityCheckASMap(asmap)) {
+            addr_man.m_asmap = ASMap(std::move(asmap));
         }
     }
     while (fuzzed_data_provider.ConsumeBool()) {
-        switch (fuzzed_data_provider.ConsumeIntegralInRange<int>(0, 11)) {
+        switch (fuzzed_data_provider.ConsumeIntegralInRange<int>(0, 12)) {
         case 0: {
             addr_man.Clear();
             break;
@@ -111,9 +111,15 @@ void test_one_input(const std::vector<uint8_t>& buffer)
             (void)addr_man.Check();
             break;
         }
+        case 12: {
+            (void)addr_man.TakeChanges();
+            break;
+        }
         }
     }
     (void)addr_man.size();
     CDataStream data_stream(SER_NETWORK, PROTOCOL_VERSION);
     data_stream << addr_man;
+    CAddrMan addr_man_replay;
+    addr_man_replay.ApplyChanges(addr_man.TakeChanges(), fuzzed_data_provider.ConsumeBool());
 }
@@ -4,7 +4,9 @@
 
 #include <netaddress.h>
 #include <test/fuzz/fuzz.h>
+#include <util/asmap.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 
@@ -55,5 +57,20 @@ void test_one_input(const std::vector<uint8_t>& buffer)
         memcpy(&ipv4, addr_data, addr_size);
         net_addr.SetIP(CNetAddr{ipv4});
     }
-    (void)net_addr.GetMappedAS(asmap);
+    const ASMap compiled(asmap);
+    (void)net_addr.GetMappedAS(compiled);
+
+    // The compiled table must agree with the interpreter
+    uint8_t ip[16];
+    if (ipv6) {
+        std::copy(addr_data, addr_data + ADDR_IPV6_SIZE, ip);
+    } else {
+        std::copy(IPV4_IN_IPV6_PREFIX.begin(), IPV4_IN_IPV6_PREFIX.end(), ip);
+        std::copy(addr_data, addr_data + ADDR_IPV4_SIZE, ip + 12);
+    }
+    std::vector<bool> ip_bits(128);
+    for (int bit = 0; bit < 128; ++bit) {
+        ip_bits[bit] = (ip[bit / 8] >> (7 - bit % 8)) & 1;
+    }
+    assert(compiled.Lookup(ip) == Interpret(asmap, ip_bits));
 }
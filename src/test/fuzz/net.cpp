@@ -68,7 +68,7 @@ void test_one_input(const std::vector<uint8_t>& buffer)
                 break;
             }
             CNodeStats stats;
-            node.copyStats(stats, asmap);
+            node.copyStats(stats, ASMap(asmap));
             break;
         }
         case 4: {
@@ -2,11 +2,20 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/common.h>
+#include <fs.h>
 #include <logging.h>
 #include <logging/timer.h>
 #include <test/util/setup_common.h>
+#include <util/system.h>
+#include <util/time.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -33,4 +42,155 @@ BOOST_AUTO_TEST_CASE(logging_timer)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(logging_ringbuffer)
+{
+    BCLog::RingBuffer<std::string> queue(4);
+    BOOST_CHECK(queue.Empty());
+    for (int i = 0; i < 4; ++i) {
+        std::string value = strprintf("%d", i);
+        BOOST_CHECK(queue.TryPush(value));
+        BOOST_CHECK(value.empty());
+    }
+    std::string value = "full";
+    BOOST_CHECK(!queue.TryPush(value));
+    BOOST_CHECK_EQUAL(value, "full");
+    for (int i = 0; i < 4; ++i) {
+        BOOST_CHECK(queue.TryPop(value));
+        BOOST_CHECK_EQUAL(value, strprintf("%d", i));
+    }
+    BOOST_CHECK(queue.Empty());
+    BOOST_CHECK(!queue.TryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(logging_async)
+{
+    BCLog::Logger logger;
+    logger.m_log_async = true;
+    logger.m_log_timestamps = false;
+    std::vector<std::string> lines;
+    logger.PushBackCallback([&](const std::string& s) { lines.push_back(s); });
+    BOOST_REQUIRE(logger.StartLogging());
+
+    // Arguments are formatted after the logging call returned
+    {
+        std::string temporary = "temporary\x01";
+        logger.LogFormat(BCLog::NONE, "%s %d\n", temporary.c_str(), 1);
+        temporary.assign(temporary.size(), 'x');
+    }
+    {
+        char buffer[] = "buffer";
+        char* pointer = buffer;
+        logger.LogFormat(BCLog::NONE, "%s\n", pointer);
+        memset(buffer, 'x', sizeof(buffer) - 1);
+    }
+    logger.LogFormat(BCLog::NONE, "literal %s", "partial ");
+    logger.LogFormat(BCLog::NONE, "line\n");
+    logger.LogFormat(BCLog::NONE, "%s %s\n", "bad format");
+
+    static const int THREADS = 4;
+    static const int MESSAGES = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < MESSAGES; ++i) {
+                logger.LogFormat(BCLog::NET, "thread %d message %d\n", t, i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    logger.StopAsyncWriter();
+
+    BOOST_REQUIRE_EQUAL(lines.size(), 5U + THREADS * MESSAGES);
+    BOOST_CHECK_EQUAL(lines[0], "temporary\\x01 1\n");
+    BOOST_CHECK_EQUAL(lines[1], "buffer\n");
+    BOOST_CHECK_EQUAL(lines[2], "literal partial ");
+    BOOST_CHECK_EQUAL(lines[3], "line\n");
+    BOOST_CHECK_EQUAL(lines[4].substr(0, 5), "Error");
+    // Messages of each thread keep their order
+    std::vector<int> next(THREADS, 0);
+    for (size_t i = 5; i < lines.size(); ++i) {
+        int t, n;
+        BOOST_REQUIRE(sscanf(lines[i].c_str(), "thread %d message %d", &t, &n) == 2);
+        BOOST_CHECK_EQUAL(n, next[t]++);
+    }
+
+    // After stopping, messages are written synchronously again
+    logger.LogFormat(BCLog::NONE, "sync\n");
+    BOOST_CHECK_EQUAL(lines.back(), "sync\n");
+    logger.DisconnectTestLogger();
+}
+
+BOOST_AUTO_TEST_CASE(logging_rate_limit)
+{
+    BCLog::Logger logger;
+    logger.m_log_timestamps = false;
+    logger.m_rate_limit = 4;
+    std::vector<std::string> lines;
+    logger.PushBackCallback([&](const std::string& s) { lines.push_back(s); });
+    BOOST_REQUIRE(logger.StartLogging());
+
+    for (int i = 0; i < 10; ++i) {
+        logger.LogFormat(BCLog::NET, "net %d\n", i);
+        logger.LogFormat(BCLog::NONE, "unconditional %d\n", i);
+    }
+    logger.LogFormat(BCLog::MEMPOOL, "mempool\n");
+    // Each category has its own budget, messages without category are never dropped
+    BOOST_CHECK_EQUAL(std::count_if(lines.begin(), lines.end(), [](const std::string& s) { return s.substr(0, 4) == "net "; }), 4);
+    BOOST_CHECK_EQUAL(std::count_if(lines.begin(), lines.end(), [](const std::string& s) { return s.substr(0, 4) == "unco"; }), 10);
+    BOOST_CHECK_EQUAL(lines.back(), "mempool\n");
+
+    // Refilled at four tokens per second; the first message reports the dropped ones
+    UninterruptibleSleep(std::chrono::milliseconds{300});
+    lines.clear();
+    logger.LogFormat(BCLog::NET, "net again\n");
+    BOOST_REQUIRE_EQUAL(lines.size(), 2U);
+    BOOST_CHECK_EQUAL(lines[0], "Suppressed 6 messages of log category net exceeding 4 per second\n");
+    BOOST_CHECK_EQUAL(lines[1], "net again\n");
+    logger.DisconnectTestLogger();
+}
+
+BOOST_AUTO_TEST_CASE(logging_binary)
+{
+    const fs::path path = GetDataDir() / "debug.bin";
+    BCLog::Logger logger;
+    logger.m_binary_file_path = path;
+    logger.m_log_async = true;
+    BOOST_REQUIRE(logger.StartLogging());
+    SetMockTime(1600000000);
+    logger.LogFormat(BCLog::VALIDATION, "block %d\n", 7);
+    SetMockTime(0);
+    logger.LogPrintStr("raw \x01\n");
+    logger.DisconnectTestLogger();
+
+    FILE* file = fsbridge::fopen(path, "rb");
+    BOOST_REQUIRE(file);
+    std::vector<unsigned char> data(1024);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+
+    BOOST_REQUIRE(data.size() > 8);
+    BOOST_CHECK_EQUAL(std::string(data.begin(), data.begin() + 7), "XEPBLOG");
+    BOOST_CHECK_EQUAL(data[7], 1);
+    size_t pos = 8;
+    std::vector<std::string> messages;
+    while (pos < data.size()) {
+        const uint32_t size = ReadLE32(&data[pos]);
+        BOOST_REQUIRE(pos + 4 + size <= data.size());
+        const unsigned char* p = &data[pos + 4];
+        BOOST_CHECK(ReadLE64(p) > 0);
+        const uint16_t name_size = ReadLE16(p + 20);
+        const uint32_t msg_size = ReadLE32(p + 22 + name_size);
+        BOOST_CHECK_EQUAL(size, 26U + name_size + msg_size);
+        if (messages.empty()) {
+            BOOST_CHECK_EQUAL(ReadLE64(p + 8), 1600000000);
+            BOOST_CHECK_EQUAL(ReadLE32(p + 16), BCLog::VALIDATION);
+        }
+        messages.emplace_back(p + 26 + name_size, p + 26 + name_size + msg_size);
+        pos += 4 + size;
+    }
+    BOOST_REQUIRE_EQUAL(messages.size(), 2U);
+    BOOST_CHECK_EQUAL(messages[0], "block 7\n");
+    BOOST_CHECK_EQUAL(messages[1], "raw \x01\n");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
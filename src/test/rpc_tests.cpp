@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <rpc/client.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 
+#include <chain.h>
 #include <core_io.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
+#include <txmempool.h>
 #include <test/util/setup_common.h>
 #include <util/ref.h>
 #include <util/time.h>
@@ -237,6 +240,120 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(json_writer)
+{
+    UniValue expected(UniValue::VOBJ);
+    std::string json;
+    JSONWriter writer(json);
+    writer.BeginObject();
+
+    // Every byte value, escaped like UniValue does
+    UniValue strings(UniValue::VARR);
+    writer.Key("strings").BeginArray();
+    for (int c = 0; c < 256; ++c) {
+        const std::string str = std::string("a") + char(c) + "b";
+        strings.push_back(str);
+        writer.String(str);
+    }
+    writer.EndArray();
+    expected.pushKV("strings", strings);
+
+    UniValue numbers(UniValue::VARR);
+    writer.Key("numbers").BeginArray();
+    for (int64_t n : {std::numeric_limits<int64_t>::min(), int64_t{-1}, int64_t{0}, std::numeric_limits<int64_t>::max()}) {
+        numbers.push_back(n);
+        writer.Int(n);
+    }
+    numbers.push_back(std::numeric_limits<uint64_t>::max());
+    writer.UInt(std::numeric_limits<uint64_t>::max());
+    for (double d : {0.0, 0.1, -1.5, 1e300, 123456.78901234567}) {
+        numbers.push_back(d);
+        writer.Float(d);
+    }
+    for (CAmount amount : {CAmount{0}, CAmount{1}, -COIN - 1, MAX_MONEY}) {
+        numbers.push_back(ValueFromAmount(amount));
+        writer.Amount(amount);
+    }
+    writer.EndArray();
+    expected.pushKV("numbers", numbers);
+
+    UniValue nested(UniValue::VOBJ);
+    nested.pushKV("empty_array", UniValue(UniValue::VARR));
+    nested.pushKV("empty_object", UniValue(UniValue::VOBJ));
+    nested.pushKV("null", NullUniValue);
+    nested.pushKV("true", true);
+    nested.pushKV("false", false);
+    writer.Key("nested").Value(nested);
+    expected.pushKV("nested", nested);
+    writer.Members(nested);
+    expected.pushKVs(nested);
+    writer.EndObject();
+
+    BOOST_CHECK_EQUAL(json, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(json_writer_block)
+{
+    const CBlock block = getBlock13b8a();
+    const uint256 hash = block.GetHash();
+    CBlockIndex blockindex;
+    blockindex.phashBlock = &hash;
+    blockindex.nBits = block.nBits;
+
+    for (bool tx_details : {false, true}) {
+        std::string json;
+        JSONWriter writer(json);
+        blockToJSON(writer, block, &blockindex, &blockindex, tx_details);
+        BOOST_CHECK_EQUAL(json, blockToJSON(block, &blockindex, &blockindex, tx_details).write());
+    }
+
+    // A transaction with witnesses and a block hash
+    CMutableTransaction mtx(*block.vtx[1]);
+    mtx.vin[0].scriptWitness.stack = {{}, {0x01, 0x02}};
+    const CTransaction tx(mtx);
+    UniValue expected(UniValue::VOBJ);
+    TxToUniv(tx, hash, expected);
+    std::string json;
+    JSONWriter writer(json);
+    TxToJSON(tx, hash, writer);
+    BOOST_CHECK_EQUAL(json, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(json_writer_mempool)
+{
+    // A parent and a child, so that depends and spentby are not empty
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].scriptSig = CScript() << OP_1;
+    parent.vout.resize(2);
+    for (CTxOut& out : parent.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = COIN;
+    }
+    CMutableTransaction child;
+    child.vin.resize(1);
+    child.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    child.vout = {parent.vout[0]};
+
+    CTxMemPool& pool = *m_node.mempool;
+    TestMemPoolEntryHelper entry;
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000).FromTx(parent));
+        pool.addUnchecked(entry.Fee(2000).FromTx(child));
+    }
+
+    for (bool verbose : {false, true}) {
+        for (bool sequence : {false, true}) {
+            if (verbose && sequence) continue;
+            std::string json;
+            JSONWriter writer(json);
+            MempoolToJSON(writer, pool, verbose, sequence);
+            BOOST_CHECK_EQUAL(json, MempoolToJSON(pool, verbose, sequence).write());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(std::string("clearbanned")));
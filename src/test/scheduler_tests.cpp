@@ -9,7 +9,11 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <mutex>
+#include <thread>
 
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
@@ -203,4 +207,77 @@ BOOST_AUTO_TEST_CASE(mockforward)
     BOOST_CHECK(delta > 2*60 && delta < 3*60);
 }
 
+BOOST_AUTO_TEST_CASE(timer_wheel_order)
+{
+    CScheduler scheduler;
+    FastRandomContext rng{/* fDeterministic */ true};
+
+    // Spread over several wheel levels, including some in the past
+    std::mutex mutex;
+    std::vector<std::chrono::system_clock::time_point> ran;
+    std::atomic<bool> early{false};
+    const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    for (int i = 0; i < 200; ++i) {
+        const std::chrono::system_clock::time_point t = now + std::chrono::microseconds{(int64_t)rng.randrange(300000) - 10000};
+        scheduler.schedule([&mutex, &ran, &early, t] {
+            if (std::chrono::system_clock::now() < t) early = true;
+            std::lock_guard<std::mutex> lock(mutex);
+            ran.push_back(t);
+        }, t);
+    }
+    // Far ahead, beyond the top level of the wheel
+    scheduler.scheduleFromNow([] {}, std::chrono::hours{24 * 400});
+
+    std::chrono::system_clock::time_point first, last;
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 201U);
+    BOOST_CHECK(first < now);
+    BOOST_CHECK(last > now + std::chrono::hours{24 * 399});
+
+    std::thread scheduler_thread([&] { scheduler.serviceQueue(); });
+    scheduler.scheduleFromNow([&scheduler] { scheduler.stop(); }, std::chrono::milliseconds{400});
+    scheduler_thread.join();
+
+    // A single thread runs the tasks in the order of their time
+    BOOST_CHECK(!early);
+    BOOST_CHECK_EQUAL(ran.size(), 200U);
+    BOOST_CHECK(std::is_sorted(ran.begin(), ran.end()));
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(background_jobs)
+{
+    CScheduler scheduler;
+    std::thread scheduler_thread([&] { scheduler.serviceQueue(); });
+    std::thread background_thread([&] { scheduler.serviceBackgroundQueue(); });
+
+    // A background job that takes long does not hold up the other jobs
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<bool> background_done{false};
+    scheduler.scheduleFromNow([&] {
+        released.wait();
+        background_done = true;
+    }, std::chrono::milliseconds{0}, "slow flush", CScheduler::JobClass::BACKGROUND);
+
+    std::promise<void> latency_ran;
+    scheduler.scheduleFromNow([&] { latency_ran.set_value(); }, std::chrono::milliseconds{5}, "quick");
+    latency_ran.get_future().wait();
+    BOOST_CHECK(!background_done);
+
+    release.set_value();
+    scheduler.StopWhenDrained();
+    scheduler_thread.join();
+    background_thread.join();
+    BOOST_CHECK(background_done);
+
+    const std::vector<CScheduler::JobStats> stats = scheduler.GetJobStats();
+    BOOST_REQUIRE_EQUAL(stats.size(), 2U);
+    BOOST_CHECK_EQUAL(stats[0].name, "quick");
+    BOOST_CHECK(stats[0].job_class == CScheduler::JobClass::LATENCY);
+    BOOST_CHECK_EQUAL(stats[0].runs, 1U);
+    BOOST_CHECK_EQUAL(stats[1].name, "slow flush");
+    BOOST_CHECK(stats[1].job_class == CScheduler::JobClass::BACKGROUND);
+    BOOST_CHECK_EQUAL(stats[1].runs, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
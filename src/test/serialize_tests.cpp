@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <hash.h>
+#include <primitives/block.h>
 #include <serialize.h>
 #include <streams.h>
 #include <test/util/setup_common.h>
@@ -264,6 +265,35 @@ BOOST_AUTO_TEST_CASE(vector_bool)
     BOOST_CHECK(SerializeHash(vec1) == SerializeHash(vec2));
 }
 
+BOOST_AUTO_TEST_CASE(vector_integers)
+{
+    // Vectors of integers copied as a single blob must keep the encoding of
+    // their elements.
+    const std::vector<uint32_t> v32{0, 1, 0x01020304, 0xffffffff};
+    const std::vector<int64_t> v64{-1, 0, 0x0102030405060708};
+    const std::vector<char> vchar{'a', '\0', 'z'};
+    CDataStream ss(SER_DISK, 0);
+    ss << v32 << v64 << vchar;
+
+    CDataStream expected(SER_DISK, 0);
+    WriteCompactSize(expected, v32.size());
+    for (uint32_t n : v32) ser_writedata32(expected, n);
+    WriteCompactSize(expected, v64.size());
+    for (int64_t n : v64) ser_writedata64(expected, n);
+    WriteCompactSize(expected, vchar.size());
+    for (char c : vchar) ser_writedata8(expected, c);
+    BOOST_CHECK_EQUAL(HexStr(ss), HexStr(expected));
+
+    std::vector<uint32_t> v32_read;
+    std::vector<int64_t> v64_read;
+    std::vector<char> vchar_read;
+    ss >> v32_read >> v64_read >> vchar_read;
+    BOOST_CHECK(v32_read == v32);
+    BOOST_CHECK(v64_read == v64);
+    BOOST_CHECK(vchar_read == vchar);
+    BOOST_CHECK(ss.empty());
+}
+
 BOOST_AUTO_TEST_CASE(noncanonical)
 {
     // Write some non-canonical CompactSize encodings, and
@@ -376,4 +406,50 @@ BOOST_AUTO_TEST_CASE(class_methods)
     BOOST_CHECK(methodtest3 == methodtest4);
 }
 
+BOOST_AUTO_TEST_CASE(block_tx_arena)
+{
+    // Enough transactions to spill over into a second chunk
+    CBlock block;
+    block.nVersion = 1;
+    block.nTime = 1234567890;
+    for (size_t i = 0; i < TransactionArenaFormatter::CHUNK_TRANSACTIONS + 10; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(InsecureRand256(), i));
+        mtx.vin[0].scriptWitness.stack.emplace_back(i % 100, 0x42);
+        if (i == 1) {
+            // A coinstake, so that the block signature is serialized too
+            mtx.vout.emplace_back();
+            mtx.vout[0].SetEmpty();
+        }
+        mtx.vout.emplace_back(i, CScript() << OP_RETURN << std::vector<unsigned char>(i % 50, 0x23));
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    BOOST_REQUIRE(block.vtx[1]->IsCoinStake());
+    block.vchBlockSig = {0x30, 0x01, 0x02};
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    CDataStream ss_arena(ss);
+
+    CBlock expected;
+    ss >> expected;
+    CBlock block_arena;
+    ss_arena >> Using<BlockTxArenaFormatter>(block_arena);
+    BOOST_CHECK(ss_arena.empty());
+
+    BOOST_CHECK(block_arena.GetHash() == expected.GetHash());
+    BOOST_CHECK(block_arena.vchBlockSig == block.vchBlockSig);
+    BOOST_REQUIRE_EQUAL(block_arena.vtx.size(), expected.vtx.size());
+    for (size_t i = 0; i < expected.vtx.size(); ++i) {
+        BOOST_CHECK(block_arena.vtx[i]->GetWitnessHash() == expected.vtx[i]->GetWitnessHash());
+    }
+    // The transactions only go away along with their whole chunk
+    block_arena.vtx.resize(1);
+    BOOST_CHECK(block_arena.vtx[0]->GetHash() == expected.vtx[0]->GetHash());
+
+    CDataStream reserialized(SER_NETWORK, PROTOCOL_VERSION);
+    reserialized << Using<BlockTxArenaFormatter>(expected);
+    BOOST_CHECK(reserialized.str() == CDataStream(SER_NETWORK, PROTOCOL_VERSION, expected).str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
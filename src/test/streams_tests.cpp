@@ -202,6 +202,49 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));
 }
 
+BOOST_AUTO_TEST_CASE(streams_xor_words)
+{
+    // Compare against a byte at a time XOR for key lengths that are and are
+    // not applied by word, and for lengths around the word size.
+    FastRandomContext rng(true);
+    for (size_t key_size : {1, 2, 3, 4, 5, 8, 9}) {
+        const std::vector<unsigned char> key = rng.randbytes(key_size);
+        for (size_t size : {0, 1, 7, 8, 9, 31, 64, 1000}) {
+            const std::vector<unsigned char> in = rng.randbytes(size);
+            std::vector<unsigned char> expected(in);
+            for (size_t i = 0; i < size; ++i) {
+                expected[i] ^= key[i % key_size];
+            }
+            std::vector<unsigned char> out(in);
+            XorBytes(out, key);
+            BOOST_CHECK(out == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const std::vector<unsigned char> vch = {1, 255, 3, 4, 5, 6};
+    uint8_t a;
+    uint16_t b;
+    uint32_t c;
+
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, vch);
+    BOOST_CHECK_EQUAL(reader.size(), 6U);
+    reader >> a >> b;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(b, 0x03ff);
+    BOOST_CHECK_EQUAL(reader.size(), 3U);
+    BOOST_CHECK_THROW(reader >> c, std::ios_base::failure);
+
+    // A failed read leaves the reader where it was
+    reader.ignore(1);
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, 0x0605);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader.ignore(1), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(streams_buffered_file)
 {
     FILE* file = fsbridge::fopen("streams_test_tmp", "w+b");
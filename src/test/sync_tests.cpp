@@ -5,6 +5,11 @@
 #include <sync.h>
 #include <test/util/setup_common.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 namespace {
@@ -29,6 +34,19 @@ void TestPotentialDeadLockDetected(MutexType& mutex1, MutexType& mutex2)
     BOOST_CHECK(!error_thrown);
     #endif
 }
+
+void TakeStatsLock(Mutex& stats_mutex)
+{
+    LOCK(stats_mutex);
+}
+
+const LockSiteStats* FindStatsLockSite()
+{
+    for (const LockSiteStats* stats : GetAllLockSiteStats()) {
+        if (strcmp(stats->name, "stats_mutex") == 0 && strcmp(stats->file, __FILE__) == 0) return stats;
+    }
+    return nullptr;
+}
 } // namespace
 
 BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
@@ -55,4 +73,52 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_site_stats)
+{
+    const bool prev = g_lock_stats_enabled;
+    g_lock_stats_enabled = true;
+    ResetLockSiteStats();
+
+    Mutex mutex;
+    TakeStatsLock(mutex);
+    const LockSiteStats* stats = FindStatsLockSite();
+    BOOST_REQUIRE(stats);
+    BOOST_CHECK_EQUAL(stats->acquisitions, 1U);
+    BOOST_CHECK_EQUAL(stats->contentions, 0U);
+
+    // Another thread has to wait while the lock is held here
+    std::atomic<bool> started{false};
+    std::thread waiter;
+    {
+        LOCK(mutex);
+        waiter = std::thread([&] {
+            started = true;
+            TakeStatsLock(mutex);
+        });
+        while (!started) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    }
+    waiter.join();
+    BOOST_CHECK_EQUAL(stats->acquisitions, 2U);
+    BOOST_CHECK_EQUAL(stats->contentions, 1U);
+    BOOST_CHECK(stats->wait_nanos >= 1000U);
+    BOOST_CHECK(stats->max_wait_nanos <= stats->wait_nanos);
+    uint64_t waits = 0;
+    for (const auto& bucket : stats->wait_histogram) waits += bucket;
+    BOOST_CHECK_EQUAL(waits, 1U);
+    uint64_t holds = 0;
+    for (const auto& bucket : stats->hold_histogram) holds += bucket;
+    BOOST_CHECK_EQUAL(holds, 2U);
+
+    ResetLockSiteStats();
+    BOOST_CHECK_EQUAL(stats->acquisitions, 0U);
+    BOOST_CHECK_EQUAL(stats->wait_nanos, 0U);
+
+    // Nothing is recorded while disabled
+    g_lock_stats_enabled = false;
+    TakeStatsLock(mutex);
+    BOOST_CHECK_EQUAL(stats->acquisitions, 0U);
+    g_lock_stats_enabled = prev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
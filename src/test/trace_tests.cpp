@@ -0,0 +1,59 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/util/setup_common.h>
+#include <util/threadnames.h>
+#include <util/trace.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(trace_tests, BasicTestingSetup)
+
+static std::vector<tracing::SpanRecord> SpansOfThread(const std::string& thread_name)
+{
+    for (const tracing::ThreadSpans& thread : tracing::CollectSpans()) {
+        if (thread.thread_name == thread_name) return thread.spans;
+    }
+    return {};
+}
+
+BOOST_AUTO_TEST_CASE(trace_spans)
+{
+    // Nothing is recorded while disabled
+    tracing::SetSpanCapacity(0);
+    std::thread([] {
+        util::ThreadRename("trace_disabled");
+        TRACE_SPAN("disabled");
+    }).join();
+    BOOST_CHECK(SpansOfThread("trace_disabled").empty());
+
+    // Only the last spans are kept, oldest first, and nested spans end first
+    tracing::SetSpanCapacity(3);
+    std::thread([] {
+        util::ThreadRename("trace_test");
+        for (int i = 0; i < 3; ++i) {
+            TRACE_SPAN("outer");
+            TRACE_SPAN("inner", std::string("a very long message type"));
+        }
+    }).join();
+    std::vector<tracing::SpanRecord> spans = SpansOfThread("trace_test");
+    BOOST_REQUIRE_EQUAL(spans.size(), 3U);
+    BOOST_CHECK_EQUAL(std::string(spans[0].name), "outer");
+    BOOST_CHECK_EQUAL(std::string(spans[1].name), "inner");
+    BOOST_CHECK_EQUAL(std::string(spans[1].detail), std::string("a very long message type").substr(0, tracing::SPAN_DETAIL_SIZE));
+    BOOST_CHECK_EQUAL(std::string(spans[2].name), "outer");
+    BOOST_CHECK_EQUAL(spans[2].detail[0], '\0');
+    BOOST_CHECK(spans[2].begin_micros <= spans[1].begin_micros);
+    BOOST_CHECK(spans[1].end_micros <= spans[2].end_micros);
+
+    tracing::ClearSpans();
+    BOOST_CHECK(SpansOfThread("trace_test").empty());
+    tracing::SetSpanCapacity(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <map>
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestChain100Setup)
+
+/** A block index loaded from disk, kept apart from the one of the node */
+struct LoadedBlockIndex {
+    std::map<uint256, std::unique_ptr<CBlockIndex>> entries;
+
+    CBlockIndex* Insert(const uint256& hash)
+    {
+        if (hash.IsNull()) return nullptr;
+        std::unique_ptr<CBlockIndex>& entry = entries[hash];
+        if (!entry) entry = MakeUnique<CBlockIndex>();
+        return entry.get();
+    }
+
+    std::function<CBlockIndex*(const uint256&)> Inserter()
+    {
+        return [this](const uint256& hash) { return Insert(hash); };
+    }
+
+    void Check(const CChain& chain) const
+    {
+        BOOST_REQUIRE_EQUAL(entries.size(), size_t(chain.Height() + 1));
+        for (const CBlockIndex* pindex = chain.Tip(); pindex; pindex = pindex->pprev) {
+            const CBlockIndex& loaded = *entries.at(pindex->GetBlockHash());
+            BOOST_CHECK_EQUAL(loaded.nHeight, pindex->nHeight);
+            BOOST_CHECK(loaded.pprev == (pindex->pprev ? entries.at(pindex->pprev->GetBlockHash()).get() : nullptr));
+            BOOST_CHECK_EQUAL(loaded.nStatus, pindex->nStatus);
+            BOOST_CHECK_EQUAL(loaded.nTx, pindex->nTx);
+            BOOST_CHECK_EQUAL(loaded.nTime, pindex->nTime);
+            BOOST_CHECK_EQUAL(loaded.nFlags, pindex->nFlags);
+            BOOST_CHECK_EQUAL(loaded.nMoneySupply, pindex->nMoneySupply);
+            BOOST_CHECK_EQUAL(loaded.nStakeModifier, pindex->nStakeModifier);
+            BOOST_CHECK(loaded.GetStakeModifierV2() == pindex->GetStakeModifierV2());
+            BOOST_CHECK_EQUAL(loaded.GetTreasuryPayment(), pindex->GetTreasuryPayment());
+            BOOST_CHECK(loaded.hashMerkleRoot == pindex->hashMerkleRoot);
+        }
+    }
+};
+
+BOOST_AUTO_TEST_CASE(block_index_load)
+{
+    LOCK(cs_main);
+    ::ChainstateActive().ForceFlushStateToDisk();
+    const CChain& chain = ::ChainActive();
+
+    LoadedBlockIndex from_db;
+    BOOST_REQUIRE(pblocktree->LoadBlockIndexGuts(Params().GetConsensus(), from_db.Inserter()));
+    from_db.Check(chain);
+
+    // No snapshot has been written yet
+    const fs::path path = GetDataDir() / BLOCK_INDEX_SNAPSHOT_FILENAME;
+    LoadedBlockIndex from_snapshot;
+    BOOST_CHECK(!pblocktree->LoadBlockIndexSnapshot(path, from_snapshot.Inserter()));
+
+    BOOST_REQUIRE(DumpBlockIndexSnapshot(*m_node.chainman));
+    BOOST_REQUIRE(pblocktree->LoadBlockIndexSnapshot(path, from_snapshot.Inserter()));
+    from_snapshot.Check(chain);
+
+    // Changing the block index in the database invalidates the snapshot
+    BOOST_REQUIRE(pblocktree->WriteBatchSync({}, 0, {chain.Tip()}));
+    LoadedBlockIndex stale;
+    BOOST_CHECK(!pblocktree->LoadBlockIndexSnapshot(path, stale.Inserter()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,8 @@
 
 #include <consensus/validation.h>
 #include <primitives/transaction.h>
+#include <key.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
@@ -51,4 +53,43 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK(state.GetResult() == TxValidationResult::TX_CONSENSUS);
 }
 
+/**
+ * Ensure that a batch is accepted parents first, and that transactions in it
+ * spending the same outputs are not both accepted.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_batch, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const auto MakeSpend = [&](const uint256& prev_hash, CAmount value) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prev_hash, 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = value;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(tx);
+    };
+
+    const CTransactionRef parent = MakeSpend(m_coinbase_txns[0]->GetHash(), 11 * CENT);
+    const CTransactionRef child = MakeSpend(parent->GetHash(), 10 * CENT);
+    const CTransactionRef double_spend = MakeSpend(m_coinbase_txns[0]->GetHash(), 12 * CENT);
+
+    LOCK(cs_main);
+    const std::vector<MempoolBatchResult> results = AcceptToMemoryPoolBatch(*m_node.mempool, {child, parent, double_spend});
+    BOOST_REQUIRE_EQUAL(results.size(), 3U);
+    BOOST_CHECK(results[0].m_state.IsValid());
+    BOOST_CHECK(results[1].m_state.IsValid());
+    BOOST_CHECK(results[2].m_state.IsInvalid());
+    BOOST_CHECK_EQUAL(results[2].m_state.GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), 2U);
+    BOOST_CHECK(m_node.mempool->exists(child->GetHash()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
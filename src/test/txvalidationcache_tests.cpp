@@ -3,12 +3,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <consensus/validation.h>
+#include <fs.h>
 #include <key.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
@@ -371,4 +375,91 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     }
 }
 
+BOOST_AUTO_TEST_CASE(mempool_load_sort)
+{
+    // A chain of three transactions, where the last one also spends the
+    // first, and an unrelated transaction, listed children first
+    CMutableTransaction parent, child, grandchild, unrelated;
+    parent.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    parent.vout.resize(2);
+    child.vin.emplace_back(COutPoint(parent.GetHash(), 0));
+    child.vout.resize(1);
+    grandchild.vin.emplace_back(COutPoint(child.GetHash(), 0));
+    grandchild.vin.emplace_back(COutPoint(parent.GetHash(), 1));
+    grandchild.vout.resize(1);
+    unrelated.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    unrelated.vout.resize(1);
+
+    std::vector<MempoolLoadEntry> entries;
+    for (const CMutableTransaction* tx : {&grandchild, &unrelated, &child, &parent}) {
+        entries.push_back({MakeTransactionRef(*tx), 0, 0});
+    }
+    SortMempoolLoadEntries(entries);
+
+    // Parents come first, and otherwise the order is kept
+    BOOST_REQUIRE_EQUAL(entries.size(), 4U);
+    BOOST_CHECK(entries[0].tx->GetHash() == unrelated.GetHash());
+    BOOST_CHECK(entries[1].tx->GetHash() == parent.GetHash());
+    BOOST_CHECK(entries[2].tx->GetHash() == child.GetHash());
+    BOOST_CHECK(entries[3].tx->GetHash() == grandchild.GetHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(mempool_load_batches, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const auto Sign = [&](CMutableTransaction& tx, CAmount amount) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, amount, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig = CScript() << vchSig;
+    };
+
+    // Independent chains of transactions, more than fit in one batch
+    const int num_chains = 10;
+    const int chain_length = 15;
+    BOOST_REQUIRE(num_chains * chain_length > int(MEMPOOL_LOAD_BATCH_SIZE));
+
+    CMutableTransaction split;
+    split.nVersion = 1;
+    split.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    for (int i = 0; i < num_chains; ++i) split.vout.emplace_back(COIN, scriptPubKey);
+    Sign(split, m_coinbase_txns[0]->vout[0].nValue);
+    CreateAndProcessBlock({split}, scriptPubKey);
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < num_chains; ++i) {
+        COutPoint prevout(split.GetHash(), i);
+        CAmount value = COIN;
+        for (int j = 0; j < chain_length; ++j) {
+            CMutableTransaction tx;
+            tx.nVersion = 1;
+            tx.vin.emplace_back(prevout);
+            tx.vout.emplace_back(value - CENT, scriptPubKey);
+            Sign(tx, value);
+            txs.push_back(MakeTransactionRef(tx));
+            prevout = COutPoint(tx.GetHash(), 0);
+            value -= CENT;
+        }
+    }
+
+    // Children come before their parents in the file, so loading it in
+    // batches only works if the transactions are sorted first
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file << uint64_t{1} << uint64_t(txs.size());
+        for (auto it = txs.rbegin(); it != txs.rend(); ++it) {
+            file << *it << GetTime() << int64_t{0};
+        }
+        file << std::map<uint256, CAmount>() << std::set<uint256>();
+    }
+
+    BOOST_CHECK(LoadMempool(*m_node.mempool));
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), txs.size());
+    for (const CTransactionRef& tx : txs) {
+        BOOST_CHECK(m_node.mempool->exists(tx->GetHash()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,11 +5,14 @@
 #include <boost/test/unit_test.hpp>
 #include <consensus/validation.h>
 #include <primitives/block.h>
+#include <primitives/transaction.h>
 #include <scheduler.h>
 #include <test/util/setup_common.h>
 #include <util/check.h>
 #include <validationinterface.h>
 
+#include <future>
+
 BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
 
 struct TestSubscriberNoop final : public CValidationInterface {
@@ -91,4 +94,72 @@ BOOST_AUTO_TEST_CASE(unregister_all_during_call)
     BOOST_CHECK(destroyed);
 }
 
+class SequenceSubscriber : public CValidationInterface
+{
+public:
+    explicit SequenceSubscriber(std::shared_future<void> blocker = {}) : m_blocker(std::move(blocker)) {}
+    void TransactionAddedToMempool(const CTransactionRef&, uint64_t mempool_sequence) override
+    {
+        if (m_blocker.valid()) m_blocker.wait();
+        LOCK(m_mutex);
+        m_sequences.push_back(mempool_sequence);
+    }
+    std::vector<uint64_t> Sequences() { return WITH_LOCK(m_mutex, return m_sequences); }
+
+private:
+    std::shared_future<void> m_blocker;
+    Mutex m_mutex;
+    std::vector<uint64_t> m_sequences GUARDED_BY(m_mutex);
+};
+
+// A subscriber that is stuck in a callback must not hold up the others, and
+// every subscriber must still see its notifications in order.
+BOOST_AUTO_TEST_CASE(independent_subscriber_queues)
+{
+    std::promise<void> release;
+    auto slow = std::make_shared<SequenceSubscriber>(release.get_future().share());
+    auto fast = std::make_shared<SequenceSubscriber>();
+    RegisterSharedValidationInterface(slow, "slow");
+    RegisterSharedValidationInterface(fast, "fast");
+
+    const CTransactionRef tx = MakeTransactionRef(CMutableTransaction{});
+    std::vector<uint64_t> expected;
+    for (uint64_t i = 0; i < 50; ++i) {
+        GetMainSignals().TransactionAddedToMempool(tx, i);
+        expected.push_back(i);
+    }
+
+    SyncWithValidationInterfaceQueue(*fast);
+    BOOST_CHECK(fast->Sequences() == expected);
+    BOOST_CHECK(slow->Sequences().empty());
+    BOOST_CHECK(GetMainSignals().CallbacksPending() >= 49);
+
+    bool found_slow = false, found_fast = false;
+    for (const ValidationInterfaceQueueInfo& info : GetMainSignals().GetQueueInfo()) {
+        if (info.name == "fast") {
+            found_fast = true;
+            BOOST_CHECK_EQUAL(info.pending, 0U);
+            BOOST_CHECK_EQUAL(info.delivered, 50U);
+        } else if (info.name == "slow") {
+            found_slow = true;
+            BOOST_CHECK(info.pending >= 49);
+            BOOST_CHECK_EQUAL(info.delivered, 0U);
+        }
+    }
+    BOOST_CHECK(found_slow && found_fast);
+
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(slow->Sequences() == expected);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+
+    // Unregistered subscribers get nothing queued after that
+    UnregisterSharedValidationInterface(slow);
+    GetMainSignals().TransactionAddedToMempool(tx, 50);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow->Sequences().size(), 50U);
+    BOOST_CHECK_EQUAL(fast->Sequences().size(), 51U);
+    UnregisterSharedValidationInterface(fast);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,17 +5,22 @@
 
 #include <txdb.h>
 
+#include <crypto/sha256.h>
 #include <node/ui_interface.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
 #include <uint256.h>
 #include <util/memory.h>
+#include <util/parallel.h>
 #include <util/system.h>
 #include <util/translation.h>
 #include <util/vector.h>
 
+#include <algorithm>
+#include <atomic>
 #include <stdint.h>
+#include <string.h>
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
@@ -27,6 +32,9 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_INDEX_SNAPSHOT = 'S';
+
+static const uint64_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
 
 namespace {
 
@@ -228,6 +236,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    // Any block index snapshot no longer matches the database
+    if (!blockinfo.empty()) batch.Erase(DB_INDEX_SNAPSHOT);
     return WriteBatch(batch, true);
 }
 
@@ -243,58 +253,178 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/** Copy the fields stored on disk, other than the hash of the previous block, to a block index entry */
+static void CopyDiskBlockIndex(CBlockIndex* pindexNew, const CDiskBlockIndex& diskindex)
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pindexNew->nHeight        = diskindex.nHeight;
+    pindexNew->nFile          = diskindex.nFile;
+    pindexNew->nDataPos       = diskindex.nDataPos;
+    pindexNew->nUndoPos       = diskindex.nUndoPos;
+    pindexNew->nVersion       = diskindex.nVersion;
+    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+    pindexNew->nTime          = diskindex.nTime;
+    pindexNew->nBits          = diskindex.nBits;
+    pindexNew->nNonce         = diskindex.nNonce;
+    pindexNew->nStatus        = diskindex.nStatus;
+    pindexNew->nTx            = diskindex.nTx;
+
+    // peercoin related block index fields
+    pindexNew->nMint          = diskindex.nMint;
+    pindexNew->nMoneySupply   = diskindex.nMoneySupply;
+    pindexNew->nFlags         = diskindex.nFlags;
+    pindexNew->nStakeModifier = diskindex.nStakeModifier;
+    pindexNew->SetStakeModifierV2(diskindex.GetStakeModifierV2(), false);
+    pindexNew->SetTreasuryPayment(diskindex.GetTreasuryPayment());
+    //pindexNew->prevoutStake   = diskindex.prevoutStake;
+    //pindexNew->nStakeTime     = diskindex.nStakeTime;
+    //pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+}
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+using DiskBlockIndexEntries = std::vector<std::pair<uint256, CDiskBlockIndex>>;
+
+/** Decode the block index entries whose hash starts with a byte in the given range, and check their proof of work */
+static bool ReadBlockIndexRange(CDBWrapper& db, size_t range, const Consensus::Params& consensusParams, DiskBlockIndexEntries& entries)
+{
+    const unsigned int range_end = (range + 1) * 256 / BLOCK_INDEX_LOAD_RANGES;
+    uint256 range_start;
+    *range_start.begin() = range * 256 / BLOCK_INDEX_LOAD_RANGES;
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, range_start));
 
-    // Load m_block_index
     while (pcursor->Valid()) {
         if (ShutdownRequested()) return false;
         std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                // peercoin related block index fields
-                pindexNew->nMint          = diskindex.nMint;
-                pindexNew->nMoneySupply   = diskindex.nMoneySupply;
-                pindexNew->nFlags         = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->nStakeModifierV2 = diskindex.nStakeModifierV2;
-                pindexNew->nTreasuryPayment = diskindex.nTreasuryPayment;
-                //pindexNew->prevoutStake   = diskindex.prevoutStake;
-                //pindexNew->nStakeTime     = diskindex.nStakeTime;
-                //pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                const int algo = CBlockHeader::GetAlgo(pindexNew->nVersion);
-                if (pindexNew->IsProofOfWork() && !CheckProofOfWork(pindexNew->GetBlockHeader().GetPoWHash(), pindexNew->nBits, algo, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
-            }
-        } else {
-            break;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= range_end) break;
+        CDiskBlockIndex diskindex;
+        if (!pcursor->GetValue(diskindex)) {
+            return error("%s: failed to read value", __func__);
+        }
+        const CBlockHeader header = diskindex.GetBlockHeader();
+        const uint256 hash = header.GetHash();
+        const int algo = CBlockHeader::GetAlgo(diskindex.nVersion);
+        if (diskindex.IsProofOfWork() && !CheckProofOfWork(header.GetPoWHash(), diskindex.nBits, algo, consensusParams))
+            return error("%s: CheckProofOfWork failed: %s", __func__, hash.ToString());
+        entries.emplace_back(hash, diskindex);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    // Decoding and hashing the headers dominates, so do it for separate key
+    // ranges in parallel and only link the entries up on this thread.
+    std::vector<DiskBlockIndexEntries> ranges(BLOCK_INDEX_LOAD_RANGES);
+    std::atomic<bool> failed{false};
+    ParallelFor(ranges.size(), std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS), 1, [&](size_t range) {
+        if (!ReadBlockIndexRange(*this, range, consensusParams, ranges[range])) failed = true;
+    });
+    if (failed) return false;
+
+    // Load m_block_index in height order, so that entries are allocated next
+    // to their parents
+    std::vector<const std::pair<uint256, CDiskBlockIndex>*> sorted;
+    for (const DiskBlockIndexEntries& entries : ranges) {
+        for (const auto& entry : entries) sorted.push_back(&entry);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<uint256, CDiskBlockIndex>* a, const std::pair<uint256, CDiskBlockIndex>* b) {
+        return a->second.nHeight < b->second.nHeight;
+    });
+    for (const auto* entry : sorted) {
+        // Construct block index object
+        CBlockIndex* pindexNew = insertBlockIndex(entry->first);
+        pindexNew->pprev = insertBlockIndex(entry->second.hashPrev);
+        CopyDiskBlockIndex(pindexNew, entry->second);
+    }
+
+    return !ShutdownRequested();
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const fs::path& path, const std::vector<const CBlockIndex*>& blockinfo)
+{
+    const uint256 id = GetRandHash();
+    const fs::path path_new = path.string() + ".new";
+    try {
+        CAutoFile file(fsbridge::fopen(path_new, "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return error("%s: failed to open %s", __func__, path_new.string());
+        }
+
+        // The snapshot is only ever read back as a whole, so a checksum over
+        // everything written guards it instead of re-hashing the headers.
+        CSHA256 hasher;
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        auto flush = [&] {
+            hasher.Write(UCharCast(ss.data()), ss.size());
+            file.write(ss.data(), ss.size());
+            ss.clear();
+        };
+        ss << BLOCK_INDEX_SNAPSHOT_VERSION << id << uint64_t(blockinfo.size());
+        for (const CBlockIndex* pindex : blockinfo) {
+            ss << pindex->GetBlockHash() << CDiskBlockIndex(pindex);
+            if (ss.size() >= (1 << 20)) flush();
         }
+        flush();
+        uint256 checksum;
+        hasher.Finalize(checksum.begin());
+        file << checksum;
+
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        if (!RenameOver(path_new, path))
+            throw std::runtime_error("Rename failed");
+    } catch (const std::exception& e) {
+        return error("%s: failed to write %s: %s", __func__, path.string(), e.what());
     }
+    // Only mark the snapshot as current once it is safely on disk
+    return Write(DB_INDEX_SNAPSHOT, id, true);
+}
 
+bool CBlockTreeDB::LoadBlockIndexSnapshot(const fs::path& path, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    uint256 id;
+    if (!Read(DB_INDEX_SNAPSHOT, id)) return false;
+
+    try {
+        std::vector<unsigned char> data;
+        {
+            CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+            if (file.IsNull()) return false;
+            data.resize(fs::file_size(path));
+            file.read(reinterpret_cast<char*>(data.data()), data.size());
+        }
+        if (data.size() < CSHA256::OUTPUT_SIZE) {
+            return error("%s: %s is truncated", __func__, path.string());
+        }
+        const size_t body_size = data.size() - CSHA256::OUTPUT_SIZE;
+        unsigned char checksum[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(data.data(), body_size).Finalize(checksum);
+        if (memcmp(checksum, data.data() + body_size, sizeof(checksum)) != 0) {
+            return error("%s: %s is corrupt", __func__, path.string());
+        }
+
+        VectorReader reader(SER_DISK, CLIENT_VERSION, data, 0);
+        uint64_t version;
+        uint256 snapshot_id;
+        uint64_t count;
+        reader >> version >> snapshot_id >> count;
+        if (version != BLOCK_INDEX_SNAPSHOT_VERSION || snapshot_id != id) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            uint256 hash;
+            CDiskBlockIndex diskindex;
+            reader >> hash >> diskindex;
+            CBlockIndex* pindexNew = insertBlockIndex(hash);
+            pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
+            CopyDiskBlockIndex(pindexNew, diskindex);
+        }
+        LogPrintf("Loaded %u block index entries from %s\n", count, path.string());
+    } catch (const std::exception& e) {
+        return error("%s: failed to read %s: %s", __func__, path.string(), e.what());
+    }
     return true;
 }
 
@@ -8,6 +8,7 @@
 
 #include <coins.h>
 #include <dbwrapper.h>
+#include <fs.h>
 #include <chain.h>
 #include <primitives/block.h>
 
@@ -28,6 +29,10 @@ static const int64_t nDefaultDbBatchSize = 16 << 20;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
+//! Number of key ranges the block index is split into when loading it
+static const int BLOCK_INDEX_LOAD_RANGES = 16;
+//! Maximum number of threads decoding the block index at startup
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
 //! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
 static const int64_t nMaxBlockDBCache = 2;
 //! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
@@ -106,6 +111,10 @@ public:
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /** Write the whole block index to a snapshot file. It stays valid until the block index in this database changes. */
+    bool WriteBlockIndexSnapshot(const fs::path& path, const std::vector<const CBlockIndex*>& blockinfo);
+    /** Load the block index from a snapshot file, without re-hashing the headers. Fails if the snapshot does not match this database. */
+    bool LoadBlockIndexSnapshot(const fs::path& path, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
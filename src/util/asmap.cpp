@@ -2,6 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <util/asmap.h>
+
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <assert.h>
@@ -185,3 +188,78 @@ bool SanityCheckASMap(const std::vector<bool>& asmap, int bits)
     }
     return false; // Reached EOF without RETURN instruction
 }
+
+namespace {
+
+using Address = std::pair<uint64_t, uint64_t>;
+
+Address SetAddressBit(Address addr, int bit, bool value)
+{
+    uint64_t& half = bit < 64 ? addr.first : addr.second;
+    const uint64_t mask = uint64_t{1} << (63 - bit % 64);
+    half = value ? (half | mask) : (half & ~mask);
+    return addr;
+}
+
+/**
+ * Follow every path through the asmap from pos, with bits address bits
+ * already consumed into prefix, and record where each range starts.
+ */
+void CompileRanges(std::vector<bool>::const_iterator pos, const std::vector<bool>::const_iterator& endpos, int bits, Address prefix,
+                   uint32_t default_asn, std::vector<std::pair<Address, uint32_t>>& ranges)
+{
+    while (true) {
+        Instruction opcode = DecodeType(pos, endpos);
+        if (opcode == Instruction::RETURN) {
+            ranges.emplace_back(prefix, DecodeASN(pos, endpos));
+            return;
+        } else if (opcode == Instruction::JUMP) {
+            uint32_t jump = DecodeJump(pos, endpos);
+            CompileRanges(pos + jump, endpos, bits + 1, SetAddressBit(prefix, bits, true), default_asn, ranges);
+            ++bits;
+        } else if (opcode == Instruction::MATCH) {
+            uint32_t match = DecodeMatch(pos, endpos);
+            uint32_t matchlen = CountBits(match) - 1;
+            for (uint32_t bit = 0; bit < matchlen; bit++) {
+                const bool expected = (match >> (matchlen - 1 - bit)) & 1;
+                // Addresses that do not match get the default
+                ranges.emplace_back(SetAddressBit(prefix, bits, !expected), default_asn);
+                prefix = SetAddressBit(prefix, bits, expected);
+                ++bits;
+            }
+        } else {
+            assert(opcode == Instruction::DEFAULT);
+            default_asn = DecodeASN(pos, endpos);
+        }
+    }
+}
+
+} // namespace
+
+ASMap::ASMap(std::vector<bool> asmap) : m_bits(std::move(asmap))
+{
+    if (m_bits.empty()) return;
+    assert(SanityCheckASMap(m_bits, 128));
+
+    // The ranges of a sane asmap cover all addresses without overlapping
+    std::vector<std::pair<Address, uint32_t>> ranges;
+    CompileRanges(m_bits.begin(), m_bits.end(), 0, Address{0, 0}, 0, ranges);
+    std::sort(ranges.begin(), ranges.end());
+    assert(ranges.front().first == Address(0, 0));
+    for (const auto& range : ranges) {
+        // Neighbours with the same ASN are one range
+        if (!m_range_asns.empty() && m_range_asns.back() == range.second) continue;
+        m_range_starts.push_back(range.first);
+        m_range_asns.push_back(range.second);
+    }
+    m_range_starts.shrink_to_fit();
+    m_range_asns.shrink_to_fit();
+}
+
+uint32_t ASMap::Lookup(const uint8_t (&ip)[16]) const
+{
+    if (m_range_asns.empty()) return 0;
+    const Address addr{ReadBE64(ip), ReadBE64(ip + 8)};
+    auto it = std::upper_bound(m_range_starts.begin(), m_range_starts.end(), addr);
+    return m_range_asns[it - m_range_starts.begin() - 1];
+}
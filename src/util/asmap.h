@@ -5,11 +5,41 @@
 #ifndef BITCOIN_UTIL_ASMAP_H
 #define BITCOIN_UTIL_ASMAP_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <utility>
 #include <vector>
 
 uint32_t Interpret(const std::vector<bool> &asmap, const std::vector<bool> &ip);
 
 bool SanityCheckASMap(const std::vector<bool>& asmap, int bits);
 
+/**
+ * An asmap for 128-bit addresses, compiled into a sorted table of the address
+ * ranges it maps to the same ASN. Looking up an address is a binary search
+ * over that table instead of a walk over the asmap bytecode.
+ */
+class ASMap
+{
+public:
+    ASMap() = default;
+    //! asmap must pass SanityCheckASMap(asmap, 128)
+    explicit ASMap(std::vector<bool> asmap);
+
+    //! The asmap bytecode this was compiled from
+    const std::vector<bool>& GetBits() const { return m_bits; }
+    bool empty() const { return m_bits.empty(); }
+    //! Number of ranges in the table
+    size_t GetRangeCount() const { return m_range_asns.size(); }
+
+    /** Same as Interpret(GetBits(), ip) for a 128-bit address in network byte order */
+    uint32_t Lookup(const uint8_t (&ip)[16]) const;
+
+private:
+    std::vector<bool> m_bits;
+    //! First address of every range, as (high, low) 64-bit halves, ascending
+    std::vector<std::pair<uint64_t, uint64_t>> m_range_starts;
+    std::vector<uint32_t> m_range_asns;
+};
+
 #endif // BITCOIN_UTIL_ASMAP_H
@@ -0,0 +1,42 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+void ParallelFor(size_t count, int max_threads, size_t min_per_thread, const std::function<void(size_t)>& fn)
+{
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(std::max(max_threads, 1), count / std::max<size_t>(min_per_thread, 1)));
+    if (threads == 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors(threads);
+    auto work = [&](size_t t) {
+        try {
+            for (size_t i = next++; i < count; i = next++) fn(i);
+        } catch (...) {
+            errors[t] = std::current_exception();
+            next = count;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
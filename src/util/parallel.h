@@ -0,0 +1,21 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_PARALLEL_H
+#define BITCOIN_UTIL_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Call fn(i) for every i in [0, count), spread over up to max_threads threads
+ * including the calling thread, with at least min_per_thread items for each
+ * thread. Items are handed out one at a time, so uneven items do not hold up
+ * a whole range. fn must only touch state of item i besides shared read-only
+ * data. An exception thrown by fn is rethrown on the calling thread once all
+ * threads have finished.
+ */
+void ParallelFor(size_t count, int max_threads, size_t min_per_thread, const std::function<void(size_t)>& fn);
+
+#endif // BITCOIN_UTIL_PARALLEL_H
@@ -0,0 +1,179 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/trace.h>
+
+#include <threadsafety.h>
+#include <util/threadnames.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace tracing {
+
+std::atomic<bool> g_spans_enabled{false};
+
+namespace {
+
+//! Buffers of exited threads kept around so their spans can still be dumped
+static const size_t MAX_EXITED_THREADS = 64;
+
+/** Ring buffer of the spans of one thread */
+struct SpanBuffer {
+    int thread_id;
+    std::string thread_name;
+    //! Only held briefly by the owning thread, and while collecting
+    StdMutex mutex;
+    std::vector<SpanRecord> ring GUARDED_BY(mutex);
+    size_t next GUARDED_BY(mutex){0};
+    size_t count GUARDED_BY(mutex){0};
+    //! Capacity generation the ring was sized for
+    uint64_t generation GUARDED_BY(mutex){0};
+    std::atomic<bool> exited{false};
+};
+
+StdMutex g_buffers_mutex;
+std::vector<std::shared_ptr<SpanBuffer>> g_buffers GUARDED_BY(g_buffers_mutex);
+int g_next_thread_id GUARDED_BY(g_buffers_mutex){1};
+//! Changed together under g_buffers_mutex, g_capacity first
+std::atomic<size_t> g_capacity{0};
+std::atomic<uint64_t> g_generation{0};
+
+/** Registers the buffer of a thread on first use and marks it exited when the thread ends */
+class ThreadBufferHolder
+{
+public:
+    std::shared_ptr<SpanBuffer> buffer;
+
+    SpanBuffer& Get()
+    {
+        if (!buffer) {
+            buffer = std::make_shared<SpanBuffer>();
+            buffer->thread_name = util::ThreadGetInternalName();
+            StdLockGuard lock(g_buffers_mutex);
+            buffer->thread_id = g_next_thread_id++;
+            g_buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    ~ThreadBufferHolder()
+    {
+        if (!buffer) return;
+        bool empty;
+        {
+            StdLockGuard lock(buffer->mutex);
+            empty = buffer->count == 0;
+        }
+        // Under g_buffers_mutex, so that threads exiting at the same time
+        // cannot prune this buffer before it is looked up below
+        StdLockGuard lock(g_buffers_mutex);
+        buffer->exited = true;
+        if (empty) {
+            const auto it = std::find(g_buffers.begin(), g_buffers.end(), buffer);
+            if (it != g_buffers.end()) g_buffers.erase(it);
+            return;
+        }
+        // Short-lived worker threads would otherwise accumulate forever
+        size_t exited = 0;
+        for (auto it = g_buffers.end(); it != g_buffers.begin();) {
+            --it;
+            if ((*it)->exited && ++exited > MAX_EXITED_THREADS) it = g_buffers.erase(it);
+        }
+    }
+};
+
+#ifdef HAVE_THREAD_LOCAL
+thread_local ThreadBufferHolder g_thread_buffer;
+#endif
+
+} // namespace
+
+void SetSpanCapacity(size_t capacity)
+{
+    StdLockGuard lock(g_buffers_mutex);
+#ifndef HAVE_THREAD_LOCAL
+    // Spans are kept per thread
+    capacity = 0;
+#endif
+    g_capacity = capacity;
+    ++g_generation;
+    g_spans_enabled = capacity > 0;
+}
+
+size_t GetSpanCapacity()
+{
+    return g_capacity;
+}
+
+int64_t SpanClockMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RecordSpan(const char* name, const char* detail, size_t detail_size, int64_t begin_micros, int64_t end_micros)
+{
+#ifdef HAVE_THREAD_LOCAL
+    SpanBuffer& buffer = g_thread_buffer.Get();
+    const uint64_t generation = g_generation.load();
+    StdLockGuard lock(buffer.mutex);
+    if (buffer.generation != generation) {
+        // Loaded after the generation, so it is at least as new
+        buffer.ring.assign(g_capacity.load(), SpanRecord{});
+        buffer.next = 0;
+        buffer.count = 0;
+        buffer.generation = generation;
+    }
+    if (buffer.ring.empty()) return;
+
+    SpanRecord& record = buffer.ring[buffer.next];
+    record.name = name;
+    detail_size = std::min(detail_size, SPAN_DETAIL_SIZE);
+    memcpy(record.detail, detail, detail_size);
+    record.detail[detail_size] = '\0';
+    record.begin_micros = begin_micros;
+    record.end_micros = end_micros;
+    buffer.next = (buffer.next + 1) % buffer.ring.size();
+    buffer.count = std::min(buffer.count + 1, buffer.ring.size());
+#endif
+}
+
+std::vector<ThreadSpans> CollectSpans()
+{
+    std::vector<std::shared_ptr<SpanBuffer>> buffers;
+    {
+        StdLockGuard lock(g_buffers_mutex);
+        buffers = g_buffers;
+    }
+    const uint64_t generation = g_generation.load();
+    std::vector<ThreadSpans> result;
+    for (const auto& buffer : buffers) {
+        ThreadSpans thread_spans;
+        thread_spans.thread_id = buffer->thread_id;
+        thread_spans.thread_name = buffer->thread_name;
+        {
+            StdLockGuard lock(buffer->mutex);
+            if (buffer->generation != generation || buffer->count == 0) continue;
+            const size_t size = buffer->ring.size();
+            const size_t first = (buffer->next + size - buffer->count) % size;
+            thread_spans.spans.reserve(buffer->count);
+            for (size_t i = 0; i < buffer->count; ++i) {
+                thread_spans.spans.push_back(buffer->ring[(first + i) % size]);
+            }
+        }
+        result.push_back(std::move(thread_spans));
+    }
+    return result;
+}
+
+void ClearSpans()
+{
+    StdLockGuard lock(g_buffers_mutex);
+    ++g_generation;
+}
+
+} // namespace tracing
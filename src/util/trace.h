@@ -0,0 +1,123 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_TRACE_H
+#define BITCOIN_UTIL_TRACE_H
+
+#if defined(HAVE_CONFIG_H)
+#include <config/xep-config.h>
+#endif
+
+#include <util/macros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Userspace, statically defined tracepoints. They compile to a single nop when
+// built with --enable-usdt and to nothing otherwise, and can be attached to
+// with bpftrace, bcc or SystemTap without restarting the node.
+#ifdef ENABLE_TRACING
+
+#include <sys/sdt.h>
+
+#define TRACE(context, event) DTRACE_PROBE(context, event)
+#define TRACE1(context, event, a) DTRACE_PROBE1(context, event, a)
+#define TRACE2(context, event, a, b) DTRACE_PROBE2(context, event, a, b)
+#define TRACE3(context, event, a, b, c) DTRACE_PROBE3(context, event, a, b, c)
+#define TRACE4(context, event, a, b, c, d) DTRACE_PROBE4(context, event, a, b, c, d)
+
+#else
+
+#define TRACE(context, event)
+#define TRACE1(context, event, a)
+#define TRACE2(context, event, a, b)
+#define TRACE3(context, event, a, b, c)
+#define TRACE4(context, event, a, b, c, d)
+
+#endif
+
+namespace tracing {
+
+//! Spans kept per thread by default, see -tracespans
+static const size_t DEFAULT_SPAN_CAPACITY = 0;
+//! Upper bound for the spans kept per thread, about 40 MB
+static const size_t MAX_SPAN_CAPACITY = 1 << 20;
+//! Maximum length of the detail recorded with a span, e.g. a message type
+static constexpr size_t SPAN_DETAIL_SIZE = 15;
+
+/** A finished span as returned by CollectSpans. Times are steady clock microseconds. */
+struct SpanRecord {
+    const char* name;
+    char detail[SPAN_DETAIL_SIZE + 1];
+    int64_t begin_micros;
+    int64_t end_micros;
+};
+
+/** The spans of one thread, oldest first */
+struct ThreadSpans {
+    int thread_id;
+    std::string thread_name;
+    std::vector<SpanRecord> spans;
+};
+
+//! Whether ScopedSpan records anything, see SetSpanCapacity
+extern std::atomic<bool> g_spans_enabled;
+
+/**
+ * Keep the last capacity spans of every thread, or stop recording spans if
+ * capacity is 0. Spans recorded so far are dropped when the capacity changes.
+ */
+void SetSpanCapacity(size_t capacity);
+size_t GetSpanCapacity();
+
+/** Copy the recorded spans of all threads, including threads that exited since */
+std::vector<ThreadSpans> CollectSpans();
+/** Drop all recorded spans */
+void ClearSpans();
+
+int64_t SpanClockMicros();
+void RecordSpan(const char* name, const char* detail, size_t detail_size, int64_t begin_micros, int64_t end_micros);
+
+/**
+ * Records the time between its construction and destruction in a per-thread
+ * ring buffer while span recording is enabled. Costs a relaxed atomic load
+ * otherwise. name must be a string literal.
+ */
+class ScopedSpan
+{
+public:
+    explicit ScopedSpan(const char* name, const std::string& detail = {})
+    {
+        if (!g_spans_enabled.load(std::memory_order_relaxed)) return;
+        m_name = name;
+        m_detail_size = std::min(detail.size(), SPAN_DETAIL_SIZE);
+        std::copy(detail.begin(), detail.begin() + m_detail_size, m_detail);
+        m_begin = SpanClockMicros();
+    }
+
+    ~ScopedSpan()
+    {
+        if (m_name) RecordSpan(m_name, m_detail, m_detail_size, m_begin, SpanClockMicros());
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    const char* m_name{nullptr};
+    char m_detail[SPAN_DETAIL_SIZE];
+    size_t m_detail_size{0};
+    int64_t m_begin{0};
+};
+
+} // namespace tracing
+
+//! Record the rest of the enclosing scope as a span, see tracing::ScopedSpan
+#define TRACE_SPAN(...) tracing::ScopedSpan PASTE2(trace_span_, __COUNTER__)(__VA_ARGS__)
+
+#endif // BITCOIN_UTIL_TRACE_H
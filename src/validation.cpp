@@ -20,6 +20,7 @@
 #include <index/txindex.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <memusage.h>
 #include <node/ui_interface.h>
 #include <optional.h>
 #include <policy/fees.h>
@@ -35,6 +36,7 @@
 #include <script/sigcache.h>
 #include <shutdown.h>
 #include <signet.h>
+#include <span.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -46,13 +48,16 @@
 #include <util/rbf.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
 #include <util/translation.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
 #include <kernel.h>
 
+#include <queue>
 #include <string>
+#include <unordered_map>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -202,6 +207,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
 bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const CCoinsViewCache &inputs, const CChain& chain, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+static bool RunScriptChecks(std::vector<CScriptCheck>& checks) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
@@ -481,6 +487,12 @@ public:
     // Single transaction acceptance
     bool AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    // Acceptance of transactions that neither spend each other nor conflict
+    // with each other or the mempool, with one ATMPArgs per transaction. The
+    // scripts of all of them are verified together on the script check
+    // threads, and the valid ones are added before the mempool is trimmed.
+    void AcceptIndependentTransactions(const std::vector<CTransactionRef>& txns, std::vector<ATMPArgs>& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
 private:
     // All the intermediate state that gets passed between the various levels
     // of checking a given transaction.
@@ -506,6 +518,10 @@ private:
     // only tests that are fast should be done here (to avoid CPU DoS).
     bool PreChecks(ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Calculate the in-mempool ancestors of ws.m_entry, failing if adding it
+    // would exceed the package limits.
+    bool CalculateAncestors(ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Run the script checks using our policy flags. As this can be slow, we should
     // only invoke this on transactions that have otherwise passed policy checks.
     bool PolicyScriptChecks(ATMPArgs& args, Workspace& ws, PrecomputedTransactionData& txdata) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -521,6 +537,10 @@ private:
     // limiting is performed, false otherwise.
     bool Finalize(ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Add the transaction to the mempool, removing any conflicts first, but
+    // without limiting the mempool size.
+    void AddToMempool(ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Compare a package's feerate against minimum allowed.
     bool CheckFeeRate(size_t package_size, CAmount package_fee, TxValidationState& state)
     {
@@ -803,27 +823,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         m_limit_descendant_size += conflict->GetSizeWithDescendants();
     }
 
-    std::string errString;
-    if (!m_pool.CalculateMemPoolAncestors(*entry, setAncestors, m_limit_ancestors, m_limit_ancestor_size, m_limit_descendants, m_limit_descendant_size, errString)) {
-        setAncestors.clear();
-        // If CalculateMemPoolAncestors fails second time, we want the original error string.
-        std::string dummy_err_string;
-        // Contracting/payment channels CPFP carve-out:
-        // If the new transaction is relatively small (up to 40k weight)
-        // and has at most one ancestor (ie ancestor limit of 2, including
-        // the new transaction), allow it if its parent has exactly the
-        // descendant limit descendants.
-        //
-        // This allows protocols which rely on distrusting counterparties
-        // being able to broadcast descendants of an unconfirmed transaction
-        // to be secure by simply only having two immediately-spendable
-        // outputs - one for each counterparty. For more info on the uses for
-        // this, see https://lists.linuxfoundation.org/pipermail/xep-dev/2018-November/016518.html
-        if (nSize >  EXTRA_DESCENDANT_TX_SIZE_LIMIT ||
-                !m_pool.CalculateMemPoolAncestors(*entry, setAncestors, 2, m_limit_ancestor_size, m_limit_descendants + 1, m_limit_descendant_size + EXTRA_DESCENDANT_TX_SIZE_LIMIT, dummy_err_string)) {
-            return state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "too-long-mempool-chain", errString);
-        }
-    }
+    if (!CalculateAncestors(args, ws)) return false;
 
     // A transaction that spends outputs that would be replaced by it is invalid. Now
     // that we have the set of all ancestors we can detect this
@@ -958,6 +958,38 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+bool MemPoolAccept::CalculateAncestors(ATMPArgs& args, Workspace& ws)
+{
+    TxValidationState &state = args.m_state;
+    CTxMemPool::setEntries& setAncestors = ws.m_ancestors;
+    const CTxMemPoolEntry& entry = *ws.m_entry;
+    const unsigned int nSize = entry.GetTxSize();
+
+    std::string errString;
+    if (!m_pool.CalculateMemPoolAncestors(entry, setAncestors, m_limit_ancestors, m_limit_ancestor_size, m_limit_descendants, m_limit_descendant_size, errString)) {
+        setAncestors.clear();
+        // If CalculateMemPoolAncestors fails second time, we want the original error string.
+        std::string dummy_err_string;
+        // Contracting/payment channels CPFP carve-out:
+        // If the new transaction is relatively small (up to 40k weight)
+        // and has at most one ancestor (ie ancestor limit of 2, including
+        // the new transaction), allow it if its parent has exactly the
+        // descendant limit descendants.
+        //
+        // This allows protocols which rely on distrusting counterparties
+        // being able to broadcast descendants of an unconfirmed transaction
+        // to be secure by simply only having two immediately-spendable
+        // outputs - one for each counterparty. For more info on the uses for
+        // this, see https://lists.linuxfoundation.org/pipermail/xep-dev/2018-November/016518.html
+        if (nSize >  EXTRA_DESCENDANT_TX_SIZE_LIMIT ||
+                !m_pool.CalculateMemPoolAncestors(entry, setAncestors, 2, m_limit_ancestor_size, m_limit_descendants + 1, m_limit_descendant_size + EXTRA_DESCENDANT_TX_SIZE_LIMIT, dummy_err_string)) {
+            return state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "too-long-mempool-chain", errString);
+        }
+    }
+
+    return true;
+}
+
 bool MemPoolAccept::PolicyScriptChecks(ATMPArgs& args, Workspace& ws, PrecomputedTransactionData& txdata)
 {
     const CTransaction& tx = *ws.m_ptx;
@@ -1017,11 +1049,10 @@ bool MemPoolAccept::ConsensusScriptChecks(ATMPArgs& args, Workspace& ws, Precomp
     return true;
 }
 
-bool MemPoolAccept::Finalize(ATMPArgs& args, Workspace& ws)
+void MemPoolAccept::AddToMempool(ATMPArgs& args, Workspace& ws)
 {
     const CTransaction& tx = *ws.m_ptx;
     const uint256& hash = ws.m_hash;
-    TxValidationState &state = args.m_state;
     const bool bypass_limits = args.m_bypass_limits;
 
     CTxMemPool::setEntries& allConflicting = ws.m_all_conflicting;
@@ -1054,6 +1085,15 @@ bool MemPoolAccept::Finalize(ATMPArgs& args, Workspace& ws)
 
     // Store transaction in memory
     m_pool.addUnchecked(*entry, setAncestors, validForFeeEstimation);
+}
+
+bool MemPoolAccept::Finalize(ATMPArgs& args, Workspace& ws)
+{
+    const uint256& hash = ws.m_hash;
+    TxValidationState &state = args.m_state;
+    const bool bypass_limits = args.m_bypass_limits;
+
+    AddToMempool(args, ws);
 
     // trim mempool and check if tx was trimmed
     if (!bypass_limits) {
@@ -1093,6 +1133,67 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
     return true;
 }
 
+void MemPoolAccept::AcceptIndependentTransactions(const std::vector<CTransactionRef>& txns, std::vector<ATMPArgs>& args)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+    assert(txns.size() == args.size());
+
+    // Resolve the inputs of all transactions first; they all stay in m_view
+    std::vector<Workspace> workspaces;
+    workspaces.reserve(txns.size());
+    std::vector<size_t> prechecked;
+    for (size_t i = 0; i < txns.size(); ++i) {
+        workspaces.emplace_back(txns[i]);
+        if (PreChecks(args[i], workspaces.back())) prechecked.push_back(i);
+    }
+
+    std::vector<PrecomputedTransactionData> txdata(txns.size());
+    std::vector<CScriptCheck> checks;
+    for (size_t i : prechecked) {
+        TxValidationState state_dummy; // Only fails when run inline
+        CheckInputScripts(*txns[i], state_dummy, m_view, ::ChainActive(), STANDARD_CONTEXTUAL_SCRIPT_VERIFY_FLAGS, true, false, txdata[i], &checks);
+    }
+    // If any script failed, verify the transactions one by one to find out
+    // which, and why.
+    const bool all_scripts_valid = RunScriptChecks(checks);
+
+    std::vector<size_t> valid;
+    for (size_t i : prechecked) {
+        if (!all_scripts_valid && !PolicyScriptChecks(args[i], workspaces[i], txdata[i])) continue;
+        if (!ConsensusScriptChecks(args[i], workspaces[i], txdata[i])) continue;
+        if (args[i].m_test_accept) continue;
+        valid.push_back(i);
+    }
+
+    bool limit_size = false;
+    std::vector<size_t> added;
+    for (size_t i : valid) {
+        Workspace& ws = workspaces[i];
+        // Transactions added before may share ancestors with this one, so
+        // the descendant limits of those have to be checked again
+        if (!ws.m_ancestors.empty()) {
+            ws.m_ancestors.clear();
+            if (!CalculateAncestors(args[i], ws)) continue;
+        }
+        AddToMempool(args[i], ws);
+        added.push_back(i);
+        limit_size |= !args[i].m_bypass_limits;
+    }
+
+    // Trim the mempool once for all of them
+    if (limit_size) {
+        LimitMempoolSize(m_pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, std::chrono::hours{gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
+    }
+    for (size_t i : added) {
+        if (!m_pool.exists(workspaces[i].m_hash)) {
+            args[i].m_state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full");
+            continue;
+        }
+        GetMainSignals().TransactionAddedToMempool(txns[i], m_pool.GetAndIncrementSequence());
+    }
+}
+
 } // anon namespace
 
 /** (try to) add transaction to memory pool with a specified acceptance time **/
@@ -1100,9 +1201,11 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
                         int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, bool test_accept, CAmount* fee_out=nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
+    TRACE_SPAN("AcceptToMemoryPool");
     std::vector<COutPoint> coins_to_uncache;
     MemPoolAccept::ATMPArgs args { chainparams, state, nAcceptTime, plTxnReplaced, bypass_limits, coins_to_uncache, test_accept, fee_out };
     bool res = MemPoolAccept(pool).AcceptSingleTransaction(tx, args);
+    TRACE2(mempool, accept_tx, tx->GetHash().data(), res);
     if (!res) {
         // Remove coins that were not present in the coins cache before calling ATMPW;
         // this is to prevent memory DoS in case we receive a large number of
@@ -1126,6 +1229,87 @@ bool AcceptToMemoryPool(CTxMemPool& pool, TxValidationState &state, const CTrans
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, GetTime(), plTxnReplaced, bypass_limits, test_accept, fee_out);
 }
 
+std::vector<MempoolBatchResult> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& txns)
+{
+    AssertLockHeld(cs_main);
+    TRACE_SPAN("AcceptToMemoryPoolBatch");
+    const CChainParams& chainparams = Params();
+    const int64_t accept_time = GetTime();
+
+    std::vector<MempoolBatchResult> results(txns.size());
+    std::vector<std::vector<COutPoint>> coins_to_uncache(txns.size());
+    std::vector<MemPoolAccept::ATMPArgs> args;
+    args.reserve(txns.size());
+    for (size_t i = 0; i < txns.size(); ++i) {
+        args.push_back({chainparams, results[i].m_state, accept_time, &results[i].m_replaced_transactions,
+                        false /* bypass_limits */, coins_to_uncache[i], false /* test_accept */, nullptr /* fee_out */});
+    }
+
+    // Parents of each transaction within the batch
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> index;
+    for (size_t i = 0; i < txns.size(); ++i) index.emplace(txns[i]->GetHash(), i);
+    std::vector<std::vector<size_t>> parents(txns.size());
+    for (size_t i = 0; i < txns.size(); ++i) {
+        for (const CTxIn& txin : txns[i]->vin) {
+            auto it = index.find(txin.prevout.hash);
+            if (it != index.end() && it->second != i) parents[i].push_back(it->second);
+        }
+    }
+
+    {
+        // Nobody sees the mempool until the whole batch is in
+        LOCK(pool.cs);
+        std::vector<bool> done(txns.size(), false);
+        size_t remaining = txns.size();
+        while (remaining > 0) {
+            // Take every transaction whose parents are done, leaving those
+            // that spend the same outputs as one taken for the next round.
+            // Replacements change the mempool in ways the others do not see,
+            // so they are accepted one by one after the round.
+            std::vector<CTransactionRef> round_txns;
+            std::vector<MemPoolAccept::ATMPArgs> round_args;
+            std::vector<size_t> round, replacements;
+            std::set<COutPoint> spent;
+            for (size_t i = 0; i < txns.size(); ++i) {
+                if (done[i] || std::any_of(parents[i].begin(), parents[i].end(), [&](size_t parent) { return !done[parent]; })) continue;
+                const std::vector<CTxIn>& vin = txns[i]->vin;
+                if (std::any_of(vin.begin(), vin.end(), [&](const CTxIn& txin) { return spent.count(txin.prevout); })) continue;
+                for (const CTxIn& txin : vin) spent.insert(txin.prevout);
+                if (std::any_of(vin.begin(), vin.end(), [&](const CTxIn& txin) { return pool.GetConflictTx(txin.prevout); })) {
+                    replacements.push_back(i);
+                    continue;
+                }
+                round.push_back(i);
+                round_txns.push_back(txns[i]);
+                round_args.push_back(args[i]);
+            }
+            // Transaction ids commit to the parents, so there can be no cycles
+            assert(!round.empty() || !replacements.empty());
+
+            if (!round.empty()) MemPoolAccept(pool).AcceptIndependentTransactions(round_txns, round_args);
+            for (size_t i : replacements) {
+                MemPoolAccept(pool).AcceptSingleTransaction(txns[i], args[i]);
+            }
+            for (size_t i : round) done[i] = true;
+            for (size_t i : replacements) done[i] = true;
+            remaining -= round.size() + replacements.size();
+        }
+    }
+
+    for (size_t i = 0; i < txns.size(); ++i) {
+        const bool accepted = results[i].m_state.IsValid();
+        TRACE2(mempool, accept_tx, txns[i]->GetHash().data(), accepted);
+        if (accepted) continue;
+        // See AcceptToMemoryPoolWithTime
+        for (const COutPoint& outpoint : coins_to_uncache[i]) {
+            ::ChainstateActive().CoinsTip().Uncache(outpoint);
+        }
+    }
+    BlockValidationState state_dummy;
+    ::ChainstateActive().FlushStateToDisk(chainparams, state_dummy, FlushStateMode::PERIODIC);
+    return results;
+}
+
 CTransactionRef GetTransaction(const CBlockIndex* const block_index, const CTxMemPool* const mempool, const uint256& hash, const Consensus::Params& consensusParams, uint256& hashBlock)
 {
     LOCK(cs_main);
@@ -1179,7 +1363,7 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool tx_arena)
 {
     block.SetNull();
 
@@ -1190,7 +1374,11 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
 
     // Read block
     try {
-        filein >> block;
+        if (tx_arena) {
+            filein >> Using<BlockTxArenaFormatter>(block);
+        } else {
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1209,7 +1397,7 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool tx_arena)
 {
     FlatFilePos blockPos;
     {
@@ -1217,7 +1405,7 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, tx_arena))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1335,7 +1523,7 @@ CAmount GetTreasuryPayment(int nHeight, const Consensus::Params& consensusParams
                     GetCoinAge(*block.vtx[1], ::ChainstateActive().CoinsTip(), block.nTime, i, nCoinAge);
                 }
                 blockValue += GetBlockSubsidy(i, pindex->IsProofOfStake(), nCoinAge, consensusParams, false);*/
-                blockValue += pindex->nMint - pindex->nTreasuryPayment;
+                blockValue += pindex->nMint - pindex->GetTreasuryPayment();
             }
         }
         return blockValue * consensusParams.nTreasuryRewardPercentage / std::max(100 - consensusParams.nTreasuryRewardPercentage, 1u); // 10% of block value paid to treasury
@@ -1576,6 +1764,15 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 static CuckooCache::cache<uint256, SignatureCacheHasher> g_scriptExecutionCache;
 static CSHA256 g_scriptExecutionCacheHasher;
 
+/** Key of a transaction in g_scriptExecutionCache */
+static uint256 ScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 entry;
+    CSHA256 hasher = g_scriptExecutionCacheHasher;
+    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(entry.begin());
+    return entry;
+}
+
 void InitScriptExecutionCache() {
     // Setup the salted hasher
     uint256 nonce = GetRandHash();
@@ -1624,9 +1821,7 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState &state, const C
     // correct (ie that the transaction hash which is in tx's prevouts
     // properly commits to the scriptPubKey in the inputs view of that
     // transaction).
-    uint256 hashCacheEntry;
-    CSHA256 hasher = g_scriptExecutionCacheHasher;
-    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    const uint256 hashCacheEntry = ScriptExecutionCacheEntry(tx, flags);
     AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
     if (g_scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
         return true;
@@ -1933,6 +2128,17 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+/** Run script checks outside of block validation, on the script check threads if there are any */
+static bool RunScriptChecks(std::vector<CScriptCheck>& checks)
+{
+    if (!g_parallel_script_checks) {
+        return std::all_of(checks.begin(), checks.end(), [](CScriptCheck& check) { return check(); });
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(checks);
+    return control.Wait();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, int algo, const Consensus::Params& params)
@@ -2481,7 +2687,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // peercoin: track money supply and mint amount info
     pindex->nMint = nActualBlockReward;
     pindex->nMoneySupply = (pindex->pprev ? pindex->pprev->nMoneySupply : 0) + pindex->nMint - nAmountBurned - nFees; // Fees are not added to nMoneySupply because they are already part of the circulating supply
-    pindex->nTreasuryPayment = nTreasuryPayment;
+    pindex->SetTreasuryPayment(nTreasuryPayment);
     //LogPrintf("ConnectBlock(): INFO: nValueOut: %s, nValueIn: %s, nFees: %s, nMint: %s\n", FormatMoney(nValueOut), FormatMoney(nValueIn), FormatMoney(nFees), FormatMoney(pindex->nMint));
 
     // peercoin: fees are not collected by miners as in xep
@@ -2873,6 +3079,7 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(m_mempool.cs);
+    TRACE_SPAN("ConnectTip");
 
     assert(pindexNew->pprev == m_chain.Tip());
     // Read block from disk.
@@ -2923,6 +3130,7 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    TRACE3(validation, block_connected, pindexNew->GetBlockHash().data(), pindexNew->nHeight, nTime6 - nTime1);
 
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
@@ -3126,9 +3334,8 @@ static bool NotifyHeaderTip() LOCKS_EXCLUDED(cs_main) {
 static void LimitValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main) {
     AssertLockNotHeld(cs_main);
 
-    if (GetMainSignals().CallbacksPending() > 10) {
-        SyncWithValidationInterfaceQueue();
-    }
+    // Only wait for the subscribers that fell behind, see -validationqueuelimit
+    GetMainSignals().WaitForSlowSubscribers();
 }
 
 bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock) {
@@ -3454,7 +3661,8 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = m_block_index_arena.Allocate();
+    *pindexNew = CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -4214,6 +4422,8 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
 bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock)
 {
     AssertLockNotHeld(cs_main);
+    TRACE_SPAN("ProcessNewBlock");
+    TRACE1(validation, process_new_block, pblock->GetHash().data());
 
     {
         CBlockIndex *pindex = nullptr;
@@ -4462,7 +4672,7 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = m_block_index_arena.Allocate();
     mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4474,22 +4684,30 @@ bool BlockManager::LoadBlockIndex(
     CBlockTreeDB& blocktree,
     std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    const auto insert_block_index = [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); };
+    const bool loaded_snapshot = gArgs.GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT) &&
+        blocktree.LoadBlockIndexSnapshot(GetDataDir() / BLOCK_INDEX_SNAPSHOT_FILENAME, insert_block_index);
+    if (!loaded_snapshot && !blocktree.LoadBlockIndexGuts(consensus_params, insert_block_index))
         return false;
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(m_block_index.size());
+    // Calculate nChainWork, visiting parents before their children. Heights
+    // are dense, so bucket the entries by height instead of sorting them.
+    std::vector<size_t> height_offsets;
     for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index)
     {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        const size_t height = item.second->nHeight;
+        if (height_offsets.size() < height + 2) height_offsets.resize(height + 2);
+        ++height_offsets[height + 1];
+    }
+    for (size_t i = 1; i < height_offsets.size(); ++i) height_offsets[i] += height_offsets[i - 1];
+    std::vector<CBlockIndex*> vSortedByHeight(m_block_index.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index)
+    {
+        vSortedByHeight[height_offsets[item.second->nHeight]++] = item.second;
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+    for (CBlockIndex* pindex : vSortedByHeight)
     {
         if (ShutdownRequested()) return false;
-        CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
@@ -4534,11 +4752,18 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
+    m_block_index.clear();
+    m_block_index_arena.Clear();
+}
+
+size_t BlockManager::DynamicMemoryUsage() const
+{
+    AssertLockHeld(cs_main);
+    size_t usage = m_block_index_arena.DynamicMemoryUsage() + memusage::DynamicUsage(m_block_index);
     for (const BlockMap::value_type& entry : m_block_index) {
-        delete entry.second;
+        usage += entry.second->DynamicMemoryUsage();
     }
-
-    m_block_index.clear();
+    return usage;
 }
 
 bool static LoadBlockIndexDB(ChainstateManager& chainman, const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
@@ -4677,7 +4902,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         }
         CBlock block;
         // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus(), /* tx_arena */ true))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         // check level 1: verify block validity
         if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
@@ -4726,7 +4951,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             uiInterface.ShowProgress(_("Verifying blocks...").translated, percentageDone, false);
             pindex = ::ChainActive().Next(pindex);
             CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus(), /* tx_arena */ true))
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             if (!::ChainstateActive().ConnectBlock(block, state, pindex, coins, chainparams))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), state.ToString());
@@ -5422,6 +5647,102 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+void SortMempoolLoadEntries(std::vector<MempoolLoadEntry>& entries)
+{
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> index;
+    for (size_t i = 0; i < entries.size(); ++i) index.emplace(entries[i].tx->GetHash(), i);
+
+    std::vector<std::vector<size_t>> children(entries.size());
+    std::vector<size_t> parents_left(entries.size(), 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        std::vector<size_t> parents;
+        for (const CTxIn& txin : entries[i].tx->vin) {
+            auto it = index.find(txin.prevout.hash);
+            if (it != index.end() && it->second != i) parents.push_back(it->second);
+        }
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+        for (size_t parent : parents) children[parent].push_back(i);
+        parents_left[i] = parents.size();
+    }
+
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (parents_left[i] == 0) ready.push(i);
+    }
+    std::vector<MempoolLoadEntry> sorted;
+    sorted.reserve(entries.size());
+    while (!ready.empty()) {
+        const size_t i = ready.top();
+        ready.pop();
+        sorted.push_back(std::move(entries[i]));
+        for (size_t child : children[i]) {
+            if (--parents_left[child] == 0) ready.push(child);
+        }
+    }
+    // Transaction ids commit to the parents, so there can be no cycles
+    assert(sorted.size() == entries.size());
+    entries = std::move(sorted);
+}
+
+namespace {
+
+/**
+ * Verify the scripts of a batch of transactions from mempool.dat on the script
+ * check threads and record the result in the script execution cache, so that
+ * the policy script checks of AcceptToMemoryPool afterwards do not verify them
+ * again one by one. Only the entry for the policy flags is recorded, which
+ * those checks consume; the consensus script checks still run as usual. If
+ * any script fails, nothing is recorded and AcceptToMemoryPool reports the
+ * failure as usual.
+ */
+void PrecheckMempoolLoadScripts(CTxMemPool& pool, Span<const MempoolLoadEntry> batch) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const unsigned int policy_flags = STANDARD_CONTEXTUAL_SCRIPT_VERIFY_FLAGS;
+
+    std::vector<PrecomputedTransactionData> txdata(batch.size());
+    std::vector<CScriptCheck> checks;
+    std::vector<const CTransaction*> checked;
+    {
+        LOCK(pool.cs);
+        CCoinsViewMemPool view(&::ChainstateActive().CoinsTip(), pool);
+        std::unordered_map<uint256, const CTransaction*, SaltedTxidHasher> batch_txs;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const CTransaction& tx = *batch[i].tx;
+            std::vector<CTxOut> spent_outputs;
+            spent_outputs.reserve(tx.vin.size());
+            for (const CTxIn& txin : tx.vin) {
+                // Parents in the same batch are not in the mempool yet
+                auto parent = batch_txs.find(txin.prevout.hash);
+                Coin coin;
+                if (parent != batch_txs.end() && txin.prevout.n < parent->second->vout.size()) {
+                    spent_outputs.push_back(parent->second->vout[txin.prevout.n]);
+                } else if (view.GetCoin(txin.prevout, coin) && !coin.IsSpent()) {
+                    spent_outputs.push_back(coin.out);
+                } else {
+                    break;
+                }
+            }
+            batch_txs.emplace(tx.GetHash(), &tx);
+            if (tx.IsCoinBase() || tx.IsCoinStake() || spent_outputs.size() != tx.vin.size()) continue;
+
+            txdata[i].Init(tx, std::move(spent_outputs));
+            for (unsigned int n = 0; n < tx.vin.size(); ++n) {
+                checks.emplace_back(txdata[i].m_spent_outputs[n], tx, n, &::ChainActive(), policy_flags, /* cacheIn */ true, &txdata[i]);
+            }
+            checked.push_back(&tx);
+        }
+    }
+
+    if (!RunScriptChecks(checks)) return;
+
+    for (const CTransaction* tx : checked) {
+        g_scriptExecutionCache.insert(ScriptExecutionCacheEntry(*tx, policy_flags));
+    }
+}
+
+} // namespace
+
 bool LoadMempool(CTxMemPool& pool)
 {
     const CChainParams& chainparams = Params();
@@ -5440,6 +5761,11 @@ bool LoadMempool(CTxMemPool& pool)
     int64_t unbroadcast = 0;
     int64_t nNow = GetTime();
 
+    // Read everything first, so the transactions can be verified in batches
+    std::vector<MempoolLoadEntry> entries;
+    std::map<uint256, CAmount> mapDeltas;
+    std::set<uint256> unbroadcast_txids;
+    bool read_ok = true;
     try {
         uint64_t version;
         file >> version;
@@ -5456,44 +5782,15 @@ bool LoadMempool(CTxMemPool& pool)
             file >> nTime;
             file >> nFeeDelta;
 
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
-            }
-            TxValidationState state;
             if (nTime > nNow - nExpiryTimeout) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */,
-                                           false /* test_accept */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
-                }
+                entries.push_back({std::move(tx), nTime, nFeeDelta});
             } else {
                 ++expired;
             }
-            if (ShutdownRequested())
-                return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
-        for (const auto& i : mapDeltas) {
-            pool.PrioritiseTransaction(i.first, i.second);
-        }
-
         // TODO: remove this try except in v0.22
-        std::set<uint256> unbroadcast_txids;
         try {
           file >> unbroadcast_txids;
           unbroadcast = unbroadcast_txids.size();
@@ -5501,14 +5798,57 @@ bool LoadMempool(CTxMemPool& pool)
           // mempool.dat files created prior to v0.21 will not have an
           // unbroadcast set. No need to log a failure if parsing fails here.
         }
-        for (const auto& txid : unbroadcast_txids) {
-            // Ensure transactions were accepted to mempool then add to
-            // unbroadcast set.
-            if (pool.get(txid) != nullptr) pool.AddUnbroadcastTx(txid);
-        }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+        // Still accept the transactions read so far
+        read_ok = false;
+    }
+
+    SortMempoolLoadEntries(entries);
+    for (size_t begin = 0; begin < entries.size(); begin += MEMPOOL_LOAD_BATCH_SIZE) {
+        const Span<const MempoolLoadEntry> batch = Span<const MempoolLoadEntry>(entries).subspan(begin, std::min(MEMPOOL_LOAD_BATCH_SIZE, entries.size() - begin));
+        for (const MempoolLoadEntry& entry : batch) {
+            CAmount amountdelta = entry.fee_delta;
+            if (amountdelta) {
+                pool.PrioritiseTransaction(entry.tx->GetHash(), amountdelta);
+            }
+        }
+
+        // cs_main is released between batches, so block validation and the
+        // staker can use the part of the mempool loaded so far
+        LOCK(cs_main);
+        PrecheckMempoolLoadScripts(pool, batch);
+        for (const MempoolLoadEntry& entry : batch) {
+            TxValidationState state;
+            AcceptToMemoryPoolWithTime(chainparams, pool, state, entry.tx, entry.time,
+                                       nullptr /* plTxnReplaced */, false /* bypass_limits */,
+                                       false /* test_accept */);
+            if (state.IsValid()) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(entry.tx->GetHash())) {
+                    ++already_there;
+                } else {
+                    ++failed;
+                }
+            }
+        }
+        if (ShutdownRequested())
+            return false;
+    }
+    if (!read_ok) return false;
+
+    for (const auto& i : mapDeltas) {
+        pool.PrioritiseTransaction(i.first, i.second);
+    }
+    for (const auto& txid : unbroadcast_txids) {
+        // Ensure transactions were accepted to mempool then add to
+        // unbroadcast set.
+        if (pool.get(txid) != nullptr) pool.AddUnbroadcastTx(txid);
     }
 
     LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
@@ -5574,6 +5914,26 @@ bool DumpMempool(const CTxMemPool& pool)
     return true;
 }
 
+bool DumpBlockIndexSnapshot(ChainstateManager& chainman)
+{
+    AssertLockHeld(cs_main);
+    int64_t start = GetTimeMicros();
+
+    std::vector<const CBlockIndex*> entries;
+    entries.reserve(chainman.BlockIndex().size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : chainman.BlockIndex()) {
+        entries.push_back(item.second);
+    }
+    // Loading allocates the entries in the order of the snapshot
+    std::sort(entries.begin(), entries.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+    if (!pblocktree->WriteBlockIndexSnapshot(GetDataDir() / BLOCK_INDEX_SNAPSHOT_FILENAME, entries)) {
+        LogPrintf("Failed to dump block index snapshot. Continuing anyway.\n");
+        return false;
+    }
+    LogPrintf("Dumped block index snapshot of %u entries: %gs\n", entries.size(), (GetTimeMicros() - start) * MICRO);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
@@ -12,6 +12,7 @@
 
 #include <amount.h>
 #include <coins.h>
+#include <consensus/validation.h>
 #include <crypto/common.h> // for ReadLE64
 #include <fs.h>
 #include <optional.h>
@@ -25,6 +26,7 @@
 #include <serialize.h>
 
 #include <atomic>
+#include <list>
 #include <map>
 #include <memory>
 #include <set>
@@ -45,7 +47,6 @@ class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class ChainstateManager;
-class TxValidationState;
 struct ChainTxData;
 
 struct DisconnectedBlockTransactions;
@@ -76,6 +77,10 @@ static const bool DEFAULT_TXINDEX = false;
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = false;
+/** File in the data directory holding the block index snapshot */
+static const char* const BLOCK_INDEX_SNAPSHOT_FILENAME = "blockindex.dat";
 /** Default for using fee filter */
 static const bool DEFAULT_FEEFILTER = true;
 /** Default for -stopatheight */
@@ -206,6 +211,22 @@ bool AcceptToMemoryPool(CTxMemPool& pool, TxValidationState &state, const CTrans
                         std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, bool test_accept=false, CAmount* fee_out=nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Outcome of one transaction passed to AcceptToMemoryPoolBatch */
+struct MempoolBatchResult {
+    //! Valid if the transaction was added to the mempool
+    TxValidationState m_state;
+    //! Transactions it replaced in the mempool
+    std::list<CTransactionRef> m_replaced_transactions;
+};
+
+/** (try to) add several transactions to memory pool at once
+ * In-batch parents are accepted before their children, whatever the order of
+ * txns. Each round of transactions that do not depend on each other has its
+ * inputs resolved together and its scripts verified on the script check
+ * threads. The mempool lock is held until the whole batch is in.
+ * @returns one result per transaction, in the order of txns **/
+std::vector<MempoolBatchResult> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& txns) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Get the BIP9 state for a given deployment at the current tip. */
 ThresholdState VersionBitsTipState(const Consensus::Params& params, Consensus::DeploymentPos pos);
 
@@ -289,9 +310,10 @@ public:
 void InitScriptExecutionCache();
 
 
-/** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Functions for disk access for blocks. With tx_arena, the transactions of the block share their storage (see
+ *  TransactionArenaFormatter), which is only suitable for blocks none of whose transactions are kept around. */
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool tx_arena = false);
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool tx_arena = false);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
@@ -382,6 +404,9 @@ private:
      */
     void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight, int chain_tip_height, bool is_ibd);
 
+    //! Owner of the entries of m_block_index
+    CBlockIndexArena m_block_index_arena GUARDED_BY(cs_main);
+
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
@@ -432,6 +457,9 @@ public:
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /** Memory used by the block index, including the map from block hashes to entries */
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     //! Mark one block file as pruned (modify associated database entries)
     void PruneOneBlockFile(const int fileNumber) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -977,9 +1005,25 @@ CBlockFileInfo* GetBlockFileInfo(size_t n);
 /** Dump the mempool to disk. */
 bool DumpMempool(const CTxMemPool& pool);
 
+//! Transactions from mempool.dat that are verified and accepted under one cs_main lock
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 128;
+
+/** A transaction read from mempool.dat */
+struct MempoolLoadEntry {
+    CTransactionRef tx;
+    int64_t time;
+    CAmount fee_delta;
+};
+
+/** Order the entries so that parents come before their children, keeping the file order otherwise */
+void SortMempoolLoadEntries(std::vector<MempoolLoadEntry>& entries);
+
 /** Load the mempool from disk. */
 bool LoadMempool(CTxMemPool& pool);
 
+/** Dump the block index to a snapshot file, to be loaded on the next start instead of the block index database */
+bool DumpBlockIndexSnapshot(ChainstateManager& chainman) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 // peercoin:
 bool GetCoinAge(const CTransaction& tx, const CCoinsViewCache& view, unsigned int nTimeTx, int nHeightCurrent, uint64_t& nCoinAge, const CBlockIndex* pindexFrom = nullptr); // peercoin: get transaction coin age
 bool CheckBlockSignature(const CBlock& block);
@@ -12,42 +12,261 @@
 #include <primitives/transaction.h>
 #include <scheduler.h>
 
+#include <util/system.h>
+#include <util/threadnames.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
-//! The MainSignalsInstance manages a list of shared_ptr<CValidationInterface>
-//! callbacks.
+namespace {
+
+using Event = std::function<void(CValidationInterface&)>;
+
+//! Upper bound for the worker threads
+static const int MAX_VALIDATIONINTERFACE_THREADS = 16;
+
+/**
+ * A CallFunctionInValidationInterfaceQueue call waiting for the subscriber
+ * queues it was pushed to. func is handed to the scheduler once the last of
+ * them has reached it.
+ */
+struct Barrier {
+    std::atomic<size_t> remaining;
+    std::function<void()> func;
+};
+
+/** An event or barrier in a subscriber queue */
+struct QueuedCallback {
+    std::shared_ptr<const Event> event;
+    std::shared_ptr<Barrier> barrier;
+    std::chrono::steady_clock::time_point queued;
+};
+
+/**
+ * The notifications not yet delivered to one subscriber. Each queue is worked
+ * on by at most one thread at a time, so every subscriber sees its
+ * notifications in order, while different subscribers proceed independently.
+ */
+struct SubscriberQueue {
+    const std::shared_ptr<CValidationInterface> callbacks;
+    const std::string name;
+
+    Mutex m_mutex;
+    std::deque<QueuedCallback> m_queue GUARDED_BY(m_mutex);
+    //! Events (not barriers) in m_queue
+    size_t m_pending GUARDED_BY(m_mutex){0};
+    //! Unregistered subscribers only get their outstanding barriers
+    bool m_registered GUARDED_BY(m_mutex){true};
+    //! Queued for, or being processed by, a worker
+    bool m_scheduled GUARDED_BY(m_mutex){false};
+
+    size_t m_max_pending GUARDED_BY(m_mutex){0};
+    uint64_t m_delivered GUARDED_BY(m_mutex){0};
+    int64_t m_total_latency GUARDED_BY(m_mutex){0};
+    int64_t m_max_latency GUARDED_BY(m_mutex){0};
+    int64_t m_busy GUARDED_BY(m_mutex){0};
+
+    SubscriberQueue(std::shared_ptr<CValidationInterface> callbacks_in, std::string name_in)
+        : callbacks(std::move(callbacks_in)), name(std::move(name_in)) {}
+};
+
+int64_t ElapsedMicros(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+}
+
+} // namespace
+
+//! The MainSignalsInstance keeps a queue per registered subscriber.
 //!
-//! A std::unordered_map is used to track what callbacks are currently
-//! registered, and a std::list is to used to store the callbacks that are
-//! currently registered as well as any callbacks that are just unregistered
-//! and about to be deleted when they are done executing.
+//! Asynchronous events are appended to the queue of every registered
+//! subscriber and delivered by a small pool of worker threads, so a subscriber
+//! that is slow to handle them (a wallet rescanning, an index writing to disk)
+//! only delays itself. Unregistered subscribers are destroyed once the last
+//! reference to their queue, held by a worker or a synchronous call in
+//! progress, is gone.
+//!
+//! Lock order is m_mutex before SubscriberQueue::m_mutex.
 struct MainSignalsInstance {
 private:
     Mutex m_mutex;
-    //! List entries consist of a callback pointer and reference count. The
-    //! count is equal to the number of current executions of that entry, plus 1
-    //! if it's registered. It cannot be 0 because that would imply it is
-    //! unregistered and also not being executed (so shouldn't exist).
-    struct ListEntry { std::shared_ptr<CValidationInterface> callbacks; int count = 1; };
-    std::list<ListEntry> m_list GUARDED_BY(m_mutex);
-    std::unordered_map<CValidationInterface*, std::list<ListEntry>::iterator> m_map GUARDED_BY(m_mutex);
+    std::unordered_map<CValidationInterface*, std::shared_ptr<SubscriberQueue>> m_map GUARDED_BY(m_mutex);
+    //! Queues with callbacks waiting for a worker
+    std::deque<std::shared_ptr<SubscriberQueue>> m_ready GUARDED_BY(m_mutex);
+    std::condition_variable m_ready_cond;
+    bool m_stop_workers GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_workers;
+    Mutex m_workers_mutex;
+
+    //! Caller must have set queue.m_scheduled
+    void Schedule(std::shared_ptr<SubscriberQueue> queue) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        m_ready.push_back(std::move(queue));
+        m_ready_cond.notify_one();
+    }
+
+    void FinishBarrier(Barrier& barrier)
+    {
+        if (--barrier.remaining == 0) m_schedulerClient.AddToProcessQueue(std::move(barrier.func));
+    }
+
+    //! Run the callback at the front of a scheduled queue. Returns whether
+    //! the queue is still scheduled, i.e. has more callbacks.
+    bool ProcessOne(SubscriberQueue& queue) LOCKS_EXCLUDED(m_mutex)
+    {
+        QueuedCallback item;
+        {
+            LOCK(queue.m_mutex);
+            if (queue.m_queue.empty()) {
+                queue.m_scheduled = false;
+                return false;
+            }
+            item = std::move(queue.m_queue.front());
+            queue.m_queue.pop_front();
+            if (item.event) --queue.m_pending;
+        }
+
+        if (item.barrier) {
+            FinishBarrier(*item.barrier);
+        } else {
+            const auto begin = std::chrono::steady_clock::now();
+            (*item.event)(*queue.callbacks);
+            const auto end = std::chrono::steady_clock::now();
+            const int64_t latency = ElapsedMicros(item.queued, end);
+            LOCK(queue.m_mutex);
+            ++queue.m_delivered;
+            queue.m_total_latency += latency;
+            queue.m_max_latency = std::max(queue.m_max_latency, latency);
+            queue.m_busy += ElapsedMicros(begin, end);
+        }
+
+        LOCK(queue.m_mutex);
+        if (queue.m_queue.empty()) queue.m_scheduled = false;
+        return queue.m_scheduled;
+    }
+
+    void WorkerThread()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            while (!m_stop_workers && m_ready.empty()) m_ready_cond.wait(lock);
+            if (m_stop_workers) return;
+            std::shared_ptr<SubscriberQueue> queue = std::move(m_ready.front());
+            m_ready.pop_front();
+            bool more;
+            {
+                REVERSE_LOCK(lock);
+                more = ProcessOne(*queue);
+            }
+            // Taking turns keeps one busy subscriber from starving the others
+            if (more) Schedule(std::move(queue));
+        }
+    }
+
+    //! Append to a queue and hand it to a worker if it is idle
+    void Push(const std::shared_ptr<SubscriberQueue>& queue, QueuedCallback item) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        bool schedule;
+        {
+            LOCK(queue->m_mutex);
+            if (item.event) {
+                if (!queue->m_registered) return;
+                queue->m_max_pending = std::max(queue->m_max_pending, ++queue->m_pending);
+            }
+            queue->m_queue.push_back(std::move(item));
+            schedule = !queue->m_scheduled;
+            queue->m_scheduled = true;
+        }
+        if (schedule) Schedule(queue);
+    }
+
+    void PushBarrier(const std::vector<std::shared_ptr<SubscriberQueue>>& queues, std::function<void()> func) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        // The extra count is only released after pushing to every queue
+        auto barrier = std::make_shared<Barrier>();
+        barrier->remaining = queues.size() + 1;
+        barrier->func = std::move(func);
+        for (const auto& queue : queues) {
+            Push(queue, {nullptr, barrier, std::chrono::steady_clock::now()});
+        }
+        FinishBarrier(*barrier);
+    }
 
 public:
-    // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
+    // Functions passed to CallFunctionInValidationInterfaceQueue run on the
+    // scheduler once every subscriber has caught up with them, in the order
+    // in which that happens.
     SingleThreadedSchedulerClient m_schedulerClient;
 
     explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
 
-    void Register(std::shared_ptr<CValidationInterface> callbacks)
+    ~MainSignalsInstance()
+    {
+        StopWorkers();
+    }
+
+    void StartWorkers(int count)
+    {
+        LOCK(m_workers_mutex);
+        for (int i = 0; i < count; ++i) {
+            m_workers.emplace_back([this, i] {
+                util::ThreadRename(strprintf("valqueue.%i", i));
+                WorkerThread();
+            });
+        }
+    }
+
+    void StopWorkers()
+    {
+        LOCK(m_workers_mutex);
+        {
+            LOCK(m_mutex);
+            m_stop_workers = true;
+        }
+        m_ready_cond.notify_all();
+        for (std::thread& worker : m_workers) worker.join();
+        m_workers.clear();
+    }
+
+    //! Deliver everything queued on the calling thread. Only to be used once
+    //! the workers are stopped.
+    void Drain()
+    {
+        while (true) {
+            std::shared_ptr<SubscriberQueue> queue;
+            {
+                LOCK(m_mutex);
+                if (m_ready.empty()) return;
+                queue = std::move(m_ready.front());
+                m_ready.pop_front();
+            }
+            while (ProcessOne(*queue)) {}
+        }
+    }
+
+    void Register(std::shared_ptr<CValidationInterface> callbacks, const std::string& name)
     {
         LOCK(m_mutex);
-        auto inserted = m_map.emplace(callbacks.get(), m_list.end());
-        if (inserted.second) inserted.first->second = m_list.emplace(m_list.end());
-        inserted.first->second->callbacks = std::move(callbacks);
+        auto& queue = m_map[callbacks.get()];
+        if (queue) Unregister(*queue);
+        queue = std::make_shared<SubscriberQueue>(std::move(callbacks), name);
+    }
+
+    //! Drop the events still queued for a subscriber, keeping the barriers
+    static void Unregister(SubscriberQueue& queue)
+    {
+        LOCK(queue.m_mutex);
+        queue.m_registered = false;
+        queue.m_queue.erase(std::remove_if(queue.m_queue.begin(), queue.m_queue.end(),
+                                           [](const QueuedCallback& item) { return item.event != nullptr; }),
+                            queue.m_queue.end());
+        queue.m_pending = 0;
     }
 
     void Unregister(CValidationInterface* callbacks)
@@ -55,44 +274,146 @@ public:
         LOCK(m_mutex);
         auto it = m_map.find(callbacks);
         if (it != m_map.end()) {
-            if (!--it->second->count) m_list.erase(it->second);
+            Unregister(*it->second);
             m_map.erase(it);
         }
     }
 
-    //! Clear unregisters every previously registered callback, erasing every
-    //! map entry. After this call, the list may still contain callbacks that
-    //! are currently executing, but it will be cleared when they are done
-    //! executing.
+    //! Clear unregisters every previously registered callback. Callbacks
+    //! that are currently executing are destroyed when they are done.
     void Clear()
     {
         LOCK(m_mutex);
         for (const auto& entry : m_map) {
-            if (!--entry.second->count) m_list.erase(entry.second);
+            Unregister(*entry.second);
         }
         m_map.clear();
     }
 
+    //! Call f for every registered subscriber on the calling thread
     template<typename F> void Iterate(F&& f)
     {
-        WAIT_LOCK(m_mutex, lock);
-        for (auto it = m_list.begin(); it != m_list.end();) {
-            ++it->count;
+        std::vector<std::shared_ptr<SubscriberQueue>> queues;
+        {
+            LOCK(m_mutex);
+            queues.reserve(m_map.size());
+            for (const auto& entry : m_map) queues.push_back(entry.second);
+        }
+        for (const auto& queue : queues) {
             {
-                REVERSE_LOCK(lock);
-                f(*it->callbacks);
+                LOCK(queue->m_mutex);
+                if (!queue->m_registered) continue;
             }
-            it = --it->count ? std::next(it) : m_list.erase(it);
+            f(*queue->callbacks);
+        }
+    }
+
+    //! Queue an event for every registered subscriber
+    void Enqueue(Event event)
+    {
+        auto shared_event = std::make_shared<const Event>(std::move(event));
+        const auto now = std::chrono::steady_clock::now();
+        LOCK(m_mutex);
+        for (const auto& entry : m_map) {
+            Push(entry.second, {shared_event, nullptr, now});
+        }
+    }
+
+    void CallFunction(std::function<void()> func)
+    {
+        LOCK(m_mutex);
+        std::vector<std::shared_ptr<SubscriberQueue>> queues;
+        queues.reserve(m_map.size());
+        for (const auto& entry : m_map) queues.push_back(entry.second);
+        PushBarrier(queues, std::move(func));
+    }
+
+    void CallFunction(const CValidationInterface& subscriber, std::function<void()> func)
+    {
+        LOCK(m_mutex);
+        std::vector<std::shared_ptr<SubscriberQueue>> queues;
+        auto it = m_map.find(const_cast<CValidationInterface*>(&subscriber));
+        if (it != m_map.end()) queues.push_back(it->second);
+        PushBarrier(queues, std::move(func));
+    }
+
+    size_t MaxPending()
+    {
+        LOCK(m_mutex);
+        size_t result = 0;
+        for (const auto& entry : m_map) {
+            LOCK(entry.second->m_mutex);
+            result = std::max(result, entry.second->m_pending);
+        }
+        return result;
+    }
+
+    //! Block until every subscriber with more than limit events queued has
+    //! caught up with the events queued so far
+    void WaitForSlowSubscribers(size_t limit)
+    {
+        std::promise<void> promise;
+        {
+            LOCK(m_mutex);
+            std::vector<std::shared_ptr<SubscriberQueue>> slow;
+            for (const auto& entry : m_map) {
+                LOCK(entry.second->m_mutex);
+                if (entry.second->m_pending > limit) slow.push_back(entry.second);
+            }
+            if (slow.empty()) return;
+            for (const auto& queue : slow) {
+                LogPrint(BCLog::VALIDATION, "Waiting for validation interface subscriber %s (%u events queued)\n",
+                         queue->name.empty() ? "unnamed" : queue->name, WITH_LOCK(queue->m_mutex, return queue->m_pending));
+            }
+            PushBarrier(slow, [&promise] { promise.set_value(); });
+        }
+        promise.get_future().wait();
+    }
+
+    std::vector<ValidationInterfaceQueueInfo> GetQueueInfo()
+    {
+        LOCK(m_mutex);
+        std::vector<ValidationInterfaceQueueInfo> result;
+        for (const auto& entry : m_map) {
+            SubscriberQueue& queue = *entry.second;
+            LOCK(queue.m_mutex);
+            ValidationInterfaceQueueInfo info;
+            info.name = queue.name;
+            info.pending = queue.m_pending;
+            info.max_pending = queue.m_max_pending;
+            info.delivered = queue.m_delivered;
+            info.total_latency_micros = queue.m_total_latency;
+            info.max_latency_micros = queue.m_max_latency;
+            info.busy_micros = queue.m_busy;
+            result.push_back(std::move(info));
+        }
+        return result;
+    }
+
+    void ResetQueueInfo()
+    {
+        LOCK(m_mutex);
+        for (const auto& entry : m_map) {
+            SubscriberQueue& queue = *entry.second;
+            LOCK(queue.m_mutex);
+            queue.m_max_pending = queue.m_pending;
+            queue.m_delivered = 0;
+            queue.m_total_latency = 0;
+            queue.m_max_latency = 0;
+            queue.m_busy = 0;
         }
     }
 };
 
 static CMainSignals g_signals;
+//! See CMainSignals::SetQueueLimit
+static std::atomic<size_t> g_queue_limit{DEFAULT_VALIDATIONINTERFACE_QUEUE_LIMIT};
 
-void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler)
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler, int worker_threads)
 {
     assert(!m_internals);
     m_internals.reset(new MainSignalsInstance(&scheduler));
+    m_internals->StartWorkers(std::max(1, std::min(worker_threads, MAX_VALIDATIONINTERFACE_THREADS)));
 }
 
 void CMainSignals::UnregisterBackgroundSignalScheduler()
@@ -100,9 +421,18 @@ void CMainSignals::UnregisterBackgroundSignalScheduler()
     m_internals.reset(nullptr);
 }
 
+void CMainSignals::StopBackgroundWorkers()
+{
+    if (m_internals) {
+        m_internals->StopWorkers();
+    }
+}
+
 void CMainSignals::FlushBackgroundCallbacks()
 {
     if (m_internals) {
+        m_internals->StopWorkers();
+        m_internals->Drain();
         m_internals->m_schedulerClient.EmptyQueue();
     }
 }
@@ -110,7 +440,36 @@ void CMainSignals::FlushBackgroundCallbacks()
 size_t CMainSignals::CallbacksPending()
 {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    return m_internals->MaxPending();
+}
+
+void CMainSignals::SetQueueLimit(size_t limit)
+{
+    g_queue_limit = limit;
+}
+
+size_t CMainSignals::GetQueueLimit() const
+{
+    return g_queue_limit;
+}
+
+void CMainSignals::WaitForSlowSubscribers()
+{
+    AssertLockNotHeld(cs_main);
+    const size_t limit = g_queue_limit;
+    if (!m_internals || limit == 0) return;
+    m_internals->WaitForSlowSubscribers(limit);
+}
+
+std::vector<ValidationInterfaceQueueInfo> CMainSignals::GetQueueInfo()
+{
+    if (!m_internals) return {};
+    return m_internals->GetQueueInfo();
+}
+
+void CMainSignals::ResetQueueInfo()
+{
+    if (m_internals) m_internals->ResetQueueInfo();
 }
 
 CMainSignals& GetMainSignals()
@@ -118,18 +477,18 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, const std::string& name)
 {
-    // Each connection captures the shared_ptr to ensure that each callback is
+    // Each queue captures the shared_ptr to ensure that each callback is
     // executed before the subscriber is destroyed. For more details see #18338.
-    g_signals.m_internals->Register(std::move(callbacks));
+    g_signals.m_internals->Register(std::move(callbacks), name);
 }
 
-void RegisterValidationInterface(CValidationInterface* callbacks)
+void RegisterValidationInterface(CValidationInterface* callbacks, const std::string& name)
 {
     // Create a shared_ptr with a no-op deleter - CValidationInterface lifecycle
     // is managed by the caller.
-    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}});
+    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}}, name);
 }
 
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
@@ -154,7 +513,12 @@ void UnregisterAllValidationInterfaces()
 
 void CallFunctionInValidationInterfaceQueue(std::function<void()> func)
 {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    g_signals.m_internals->CallFunction(std::move(func));
+}
+
+void CallFunctionInValidationInterfaceQueue(const CValidationInterface& subscriber, std::function<void()> func)
+{
+    g_signals.m_internals->CallFunction(subscriber, std::move(func));
 }
 
 void SyncWithValidationInterfaceQueue()
@@ -168,6 +532,16 @@ void SyncWithValidationInterfaceQueue()
     promise.get_future().wait();
 }
 
+void SyncWithValidationInterfaceQueue(const CValidationInterface& subscriber)
+{
+    AssertLockNotHeld(cs_main);
+    std::promise<void> promise;
+    CallFunctionInValidationInterfaceQueue(subscriber, [&promise] {
+        promise.set_value();
+    });
+    promise.get_future().wait();
+}
+
 // Use a macro instead of a function for conditional logging to prevent
 // evaluating arguments when logging is not enabled.
 //
@@ -176,9 +550,9 @@ void SyncWithValidationInterfaceQueue()
     do {                                                       \
         auto local_name = (name);                              \
         LOG_EVENT("Enqueuing " fmt, local_name, __VA_ARGS__);  \
-        m_internals->m_schedulerClient.AddToProcessQueue([=] { \
+        m_internals->Enqueue([=](CValidationInterface& callbacks) { \
             LOG_EVENT(fmt, local_name, __VA_ARGS__);           \
-            event();                                           \
+            event(callbacks);                                  \
         });                                                    \
     } while (0)
 
@@ -190,8 +564,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    auto event = [pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+    auto event = [pindexNew, pindexFork, fInitialDownload](CValidationInterface& callbacks) {
+        callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: new block hash=%s fork block hash=%s (in IBD=%s)", __func__,
                           pindexNew->GetBlockHash().ToString(),
@@ -200,8 +574,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) {
-    auto event = [tx, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionAddedToMempool(tx, mempool_sequence); });
+    auto event = [tx, mempool_sequence](CValidationInterface& callbacks) {
+        callbacks.TransactionAddedToMempool(tx, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
@@ -209,8 +583,8 @@ void CMainSignals::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t
 }
 
 void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) {
-    auto event = [tx, reason, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence); });
+    auto event = [tx, reason, mempool_sequence](CValidationInterface& callbacks) {
+        callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
@@ -218,8 +592,8 @@ void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemP
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockConnected(pblock, pindex); });
+    auto event = [pblock, pindex](CValidationInterface& callbacks) {
+        callbacks.BlockConnected(pblock, pindex);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(),
@@ -228,8 +602,8 @@ void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, c
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
 {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockDisconnected(pblock, pindex); });
+    auto event = [pblock, pindex](CValidationInterface& callbacks) {
+        callbacks.BlockDisconnected(pblock, pindex);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(),
@@ -237,8 +611,8 @@ void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    auto event = [locator, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.ChainStateFlushed(locator); });
+    auto event = [locator](CValidationInterface& callbacks) {
+        callbacks.ChainStateFlushed(locator);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s", __func__,
                           locator.IsNull() ? "null" : locator.vHave.front().ToString());
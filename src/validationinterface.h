@@ -9,8 +9,11 @@
 #include <primitives/transaction.h> // CTransaction(Ref)
 #include <sync.h>
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 extern RecursiveMutex cs_main;
 class BlockValidationState;
@@ -23,8 +26,13 @@ class uint256;
 class CScheduler;
 enum class MemPoolRemovalReason;
 
-/** Register subscriber */
-void RegisterValidationInterface(CValidationInterface* callbacks);
+//! Threads delivering queued notifications to subscribers
+static const int DEFAULT_VALIDATIONINTERFACE_THREADS = 4;
+//! Notifications a subscriber may fall behind before block validation waits for it
+static const unsigned int DEFAULT_VALIDATIONINTERFACE_QUEUE_LIMIT = 10;
+
+/** Register subscriber. name identifies its queue in getvalidationqueueinfo. */
+void RegisterValidationInterface(CValidationInterface* callbacks, const std::string& name = "");
 /** Unregister subscriber. DEPRECATED. This is not safe to use when the RPC server or main message handler thread is running. */
 void UnregisterValidationInterface(CValidationInterface* callbacks);
 /** Unregister all subscribers */
@@ -35,7 +43,7 @@ void UnregisterAllValidationInterfaces();
 // unregistration is nonblocking and can return before the last notification is
 // processed.
 /** Register subscriber */
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, const std::string& name = "");
 /** Unregister subscriber */
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
 
@@ -49,6 +57,11 @@ void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> c
  * will result in a deadlock (that DEBUG_LOCKORDER will miss).
  */
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+/**
+ * Like CallFunctionInValidationInterfaceQueue, but only waits for the
+ * callbacks generated prior to now for one subscriber to finish.
+ */
+void CallFunctionInValidationInterfaceQueue(const CValidationInterface& subscriber, std::function<void ()> func);
 /**
  * This is a synonym for the following, which asserts certain locks are not
  * held:
@@ -59,6 +72,8 @@ void CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
  *     promise.get_future().wait();
  */
 void SyncWithValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
+/** Wait until all callbacks generated prior to now for one subscriber have finished */
+void SyncWithValidationInterfaceQueue(const CValidationInterface& subscriber) LOCKS_EXCLUDED(cs_main);
 
 /**
  * Implement this to subscribe to events generated in validation
@@ -176,26 +191,58 @@ protected:
     friend class CMainSignals;
 };
 
+/** Queue depth and latency of one subscriber, see getvalidationqueueinfo */
+struct ValidationInterfaceQueueInfo {
+    std::string name;
+    //! Notifications waiting to be delivered
+    size_t pending{0};
+    size_t max_pending{0};
+    //! Notifications delivered
+    uint64_t delivered{0};
+    //! Sum and maximum of the time from queueing a notification to the end of its callback
+    int64_t total_latency_micros{0};
+    int64_t max_latency_micros{0};
+    //! Time spent in the subscriber's callbacks
+    int64_t busy_micros{0};
+};
+
 struct MainSignalsInstance;
 class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>);
+    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+    friend void ::CallFunctionInValidationInterfaceQueue(const CValidationInterface& subscriber, std::function<void ()> func);
 
 public:
-    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
-    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /**
+     * Register a CScheduler to give callbacks which should run in the background (may only be called once).
+     * Every subscriber gets its own queue, and worker_threads threads deliver the queued notifications,
+     * so a slow subscriber does not hold up the others.
+     */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler, int worker_threads = DEFAULT_VALIDATIONINTERFACE_THREADS);
     /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
     void UnregisterBackgroundSignalScheduler();
-    /** Call any remaining callbacks on the calling thread */
+    /** Stop delivering queued notifications in the background. Waits for callbacks in progress to return. */
+    void StopBackgroundWorkers();
+    /** Stop the worker threads and call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** Number of notifications queued for the subscriber that is furthest behind */
     size_t CallbacksPending();
 
+    /** Make WaitForSlowSubscribers wait for subscribers with more than limit notifications queued (0 = never wait) */
+    void SetQueueLimit(size_t limit);
+    size_t GetQueueLimit() const;
+    /** Wait until no subscriber is further behind than the queue limit */
+    void WaitForSlowSubscribers() LOCKS_EXCLUDED(cs_main);
+
+    std::vector<ValidationInterfaceQueueInfo> GetQueueInfo();
+    void ResetQueueInfo();
+
 
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
     void TransactionAddedToMempool(const CTransactionRef&, uint64_t mempool_sequence);
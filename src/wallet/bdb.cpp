@@ -603,7 +603,7 @@ bool BerkeleyDatabase::PeriodicFlush()
     return true;
 }
 
-bool BerkeleyDatabase::Backup(const std::string& strDest) const
+bool BerkeleyDatabase::Backup(const std::string& strDest)
 {
     while (true)
     {
@@ -123,7 +123,7 @@ public:
 
     /** Back up the entire database to a file.
      */
-    bool Backup(const std::string& strDest) const override;
+    bool Backup(const std::string& strDest) override;
 
     /** Make sure all changes are flushed to database file.
      */
@@ -99,6 +99,22 @@ public:
     virtual bool TxnAbort() = 0;
 };
 
+/** Default interval, in milliseconds, over which SQLite wallet writes are grouped into one transaction (0 = commit every write) */
+static const int64_t DEFAULT_WALLET_COMMIT_INTERVAL = 0;
+
+/** Write and commit counters of a WalletDatabase, as reported by getwalletinfo */
+struct WalletDatabaseStats {
+    //! Number of key writes and erases
+    uint64_t writes{0};
+    //! Number of transactions committed to disk
+    uint64_t commits{0};
+    //! Writes not yet committed to disk
+    uint64_t pending_writes{0};
+    //! Total and maximum time spent committing, in microseconds
+    int64_t commit_time_total{0};
+    int64_t commit_time_max{0};
+};
+
 /** An instance of this class represents one database.
  **/
 class WalletDatabase
@@ -124,7 +140,7 @@ public:
 
     /** Back up the entire database to a file.
      */
-    virtual bool Backup(const std::string& strDest) const = 0;
+    virtual bool Backup(const std::string& strDest) = 0;
 
     /** Make sure all changes are flushed to database file.
      */
@@ -137,6 +153,14 @@ public:
        ideal to be called periodically */
     virtual bool PeriodicFlush() = 0;
 
+    /** Commit writes that have been grouped but not yet written to disk.
+     *  If expired_only is set, only commit once the group interval has elapsed.
+     *  Returns true if a transaction was committed. */
+    virtual bool CommitPending(bool expired_only = false) { return false; }
+
+    /** Return write and commit counters, if the backend keeps them. */
+    virtual bool GetStats(WalletDatabaseStats& stats) const { return false; }
+
     virtual void IncrementUpdateCounter() = 0;
 
     virtual void ReloadDbEnv() = 0;
@@ -185,7 +209,7 @@ public:
     void AddRef() override {}
     void RemoveRef() override {}
     bool Rewrite(const char* pszSkip=nullptr) override { return true; }
-    bool Backup(const std::string& strDest) const override { return true; }
+    bool Backup(const std::string& strDest) override { return true; }
     void Close() override {}
     void Flush() override {}
     bool PeriodicFlush() override { return true; }
@@ -16,6 +16,8 @@
 
 #include <univalue.h>
 
+#include <algorithm>
+
 bool VerifyWallets(interfaces::Chain& chain)
 {
     if (gArgs.IsArgSet("-walletdir")) {
@@ -126,11 +128,18 @@ void StartWallets(CScheduler& scheduler, const ArgsManager& args)
         pwallet->postInitProcess();
     }
 
-    // Schedule periodic wallet flushes and tx rebroadcasts
+    // Schedule periodic wallet flushes, tx rebroadcasts and keypool refills
     if (args.GetBoolArg("-flushwallet", DEFAULT_FLUSHWALLET)) {
-        scheduler.scheduleEvery(MaybeCompactWalletDB, std::chrono::milliseconds{500});
+        scheduler.scheduleEvery(MaybeCompactWalletDB, std::chrono::milliseconds{500}, "MaybeCompactWalletDB", CScheduler::JobClass::BACKGROUND);
+    }
+    // Grouped writes are bounded by their own interval, even if the wallet never goes idle
+    const int64_t commit_interval = args.GetArg("-walletcommitinterval", DEFAULT_WALLET_COMMIT_INTERVAL);
+    if (commit_interval > 0) {
+        const int64_t check_interval = std::max<int64_t>(50, std::min<int64_t>(1000, commit_interval / 4));
+        scheduler.scheduleEvery(MaybeCommitWalletWrites, std::chrono::milliseconds{check_interval}, "MaybeCommitWalletWrites", CScheduler::JobClass::BACKGROUND);
     }
-    scheduler.scheduleEvery(MaybeResendWalletTxs, std::chrono::milliseconds{1000});
+    scheduler.scheduleEvery(MaybeResendWalletTxs, std::chrono::milliseconds{1000}, "MaybeResendWalletTxs");
+    scheduler.scheduleEvery(MaybeTopUpKeyPools, std::chrono::milliseconds{1000}, "MaybeTopUpKeyPools");
 }
 
 void FlushWallets()
@@ -14,6 +14,7 @@
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/rawtransaction_util.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
@@ -1594,12 +1595,23 @@ static RPCHelpMan listtransactions()
         LOCK(pwallet->cs_wallet);
 
         const CWallet::TxItems & txOrdered = pwallet->wtxOrdered;
+        const auto& archived = pwallet->m_archived_txs;
 
-        // iterate backwards until we have nCount items to return:
-        for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+        // iterate backwards until we have nCount items to return, merging in
+        // archived transactions, which are only read when the listing reaches them:
+        auto it = txOrdered.rbegin();
+        auto archived_it = archived.rbegin();
+        while (it != txOrdered.rend() || archived_it != archived.rend())
         {
-            CWalletTx *const pwtx = (*it).second;
-            ListTransactions(pwallet, *pwtx, 0, true, ret, filter, filter_label);
+            if (archived_it != archived.rend() && (it == txOrdered.rend() || archived_it->first > it->first)) {
+                std::unique_ptr<CWalletTx> archived_wtx = pwallet->GetArchivedTx(archived_it->second);
+                if (archived_wtx) ListTransactions(pwallet, *archived_wtx, 0, true, ret, filter, filter_label);
+                ++archived_it;
+            } else {
+                CWalletTx *const pwtx = (*it).second;
+                ListTransactions(pwallet, *pwtx, 0, true, ret, filter, filter_label);
+                ++it;
+            }
             if ((int)ret.size() >= (nCount+nFrom)) break;
         }
     }
@@ -1612,6 +1624,14 @@ static RPCHelpMan listtransactions()
         nCount = ret.size() - nFrom;
 
     const std::vector<UniValue>& txs = ret.getValues();
+    if (request.result_writer) {
+        request.result_writer->BeginArray();
+        for (auto tx = txs.rend() - nFrom - nCount; tx != txs.rend() - nFrom; ++tx) {
+            request.result_writer->Value(*tx);
+        }
+        request.result_writer->EndArray();
+        return NullUniValue;
+    }
     UniValue result{UniValue::VARR};
     result.push_backV({ txs.rend() - nFrom - nCount, txs.rend() - nFrom }); // Return oldest to newest
     return result;
@@ -1780,6 +1800,7 @@ static RPCHelpMan gettransaction()
                     },
                     TransactionDescriptionString()),
                     {
+                        {RPCResult::Type::BOOL, "archived", /* optional */ true, "Only present, and true, if the transaction was moved out of memory by -prunestakehistory"},
                         {RPCResult::Type::ARR, "details", "",
                         {
                             {RPCResult::Type::OBJ, "", "",
@@ -1837,11 +1858,15 @@ static RPCHelpMan gettransaction()
     bool verbose = request.params[2].isNull() ? false : request.params[2].get_bool();
 
     UniValue entry(UniValue::VOBJ);
+    std::unique_ptr<CWalletTx> archived_wtx;
     auto it = pwallet->mapWallet.find(hash);
     if (it == pwallet->mapWallet.end()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid or non-wallet transaction id");
+        archived_wtx = pwallet->GetArchivedTx(hash);
+        if (!archived_wtx) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid or non-wallet transaction id");
+        }
     }
-    const CWalletTx& wtx = it->second;
+    const CWalletTx& wtx = archived_wtx ? *archived_wtx : it->second;
 
     CAmount nCredit = wtx.GetCredit(filter);
     CAmount nDebit = wtx.GetDebit(filter);
@@ -1853,6 +1878,7 @@ static RPCHelpMan gettransaction()
         entry.pushKV("fee", ValueFromAmount(nFee));
 
     WalletTxToJSON(pwallet->chain(), wtx, entry);
+    if (archived_wtx) entry.pushKV("archived", true);
 
     UniValue details(UniValue::VARR);
     ListTransactions(pwallet, wtx, 0, false, details, filter, nullptr /* filter_label */);
@@ -2558,6 +2584,14 @@ static RPCHelpMan getwalletinfo()
                             {RPCResult::Type::NUM, "progress", "scanning progress percentage [0.0, 1.0]"},
                         }},
                         {RPCResult::Type::BOOL, "descriptors", "whether this wallet uses descriptors for scriptPubKey management"},
+                        {RPCResult::Type::OBJ, "dbstats", /* optional */ true, "database write statistics since the wallet was loaded (only present for sqlite wallets)",
+                        {
+                            {RPCResult::Type::NUM, "writes", "number of records written or erased"},
+                            {RPCResult::Type::NUM, "commits", "number of transactions committed to disk"},
+                            {RPCResult::Type::NUM, "pending_writes", "writes grouped into the open transaction and not yet committed"},
+                            {RPCResult::Type::NUM, "avg_commit_time", "average commit latency in microseconds"},
+                            {RPCResult::Type::NUM, "max_commit_time", "maximum commit latency in microseconds"},
+                        }},
                     }},
                 },
                 RPCExamples{
@@ -2619,6 +2653,16 @@ static RPCHelpMan getwalletinfo()
         obj.pushKV("scanning", false);
     }
     obj.pushKV("descriptors", pwallet->IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS));
+    WalletDatabaseStats db_stats;
+    if (pwallet->GetDatabase().GetStats(db_stats)) {
+        UniValue dbstats(UniValue::VOBJ);
+        dbstats.pushKV("writes", db_stats.writes);
+        dbstats.pushKV("commits", db_stats.commits);
+        dbstats.pushKV("pending_writes", db_stats.pending_writes);
+        dbstats.pushKV("avg_commit_time", db_stats.commits ? db_stats.commit_time_total / (int64_t)db_stats.commits : 0);
+        dbstats.pushKV("max_commit_time", db_stats.commit_time_max);
+        obj.pushKV("dbstats", dbstats);
+    }
     return obj;
 },
     };
@@ -7,6 +7,7 @@
 #include <script/descriptor.h>
 #include <script/sign.h>
 #include <util/bip32.h>
+#include <util/parallel.h>
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/translation.h>
@@ -331,8 +332,10 @@ bool LegacyScriptPubKeyMan::TopUpInactiveHDChain(const CKeyID seed_id, int64_t i
 
     if (missing > 0) {
         WalletBatch batch(m_storage.GetDatabase());
-        for (int64_t i = missing; i > 0; --i) {
-            GenerateNewKey(batch, chain, internal);
+        if (!batch.TxnBegin()) return false;
+        GenerateNewHDKeys(batch, chain, internal, missing);
+        if (!batch.TxnCommit()) {
+            throw std::runtime_error(std::string(__func__) + ": writing keys failed");
         }
         if (internal) {
             WalletLogPrintf("inactive seed with id %s added %d internal keys\n", HexStr(seed_id), missing);
@@ -547,6 +550,14 @@ unsigned int LegacyScriptPubKeyMan::GetKeyPoolSize() const
     return setInternalKeyPool.size() + setExternalKeyPool.size() + set_pre_split_keypool.size();
 }
 
+bool LegacyScriptPubKeyMan::NeedsTopUp(unsigned int watermark) const
+{
+    LOCK(cs_KeyStore);
+    if (!CanGenerateKeys()) return false;
+    if (setExternalKeyPool.size() < watermark) return true;
+    return IsHDEnabled() && m_storage.CanSupportFeature(FEATURE_HD_SPLIT) && setInternalKeyPool.size() < watermark;
+}
+
 int64_t LegacyScriptPubKeyMan::GetTimeFirstKey() const
 {
     LOCK(cs_KeyStore);
@@ -612,14 +623,15 @@ SigningResult LegacyScriptPubKeyMan::SignBlock(CBlock& block, const CPubKey& pub
     return SigningResult::SIGNING_FAILED;
 }
 
-TransactionError LegacyScriptPubKeyMan::FillPSBT(PartiallySignedTransaction& psbtx, int sighash_type, bool sign, bool bip32derivs, int* n_signed) const
+TransactionError LegacyScriptPubKeyMan::FillPSBT(PartiallySignedTransaction& psbtx, const PrecomputedTransactionData& txdata, int sighash_type, bool sign, bool bip32derivs, int* n_signed) const
 {
     if (n_signed) {
         *n_signed = 0;
     }
+    std::vector<unsigned int> to_sign;
     for (unsigned int i = 0; i < psbtx.tx->vin.size(); ++i) {
         const CTxIn& txin = psbtx.tx->vin[i];
-        PSBTInput& input = psbtx.inputs.at(i);
+        const PSBTInput& input = psbtx.inputs.at(i);
 
         if (PSBTInputSigned(input)) {
             continue;
@@ -639,11 +651,16 @@ TransactionError LegacyScriptPubKeyMan::FillPSBT(PartiallySignedTransaction& psb
             // There's no UTXO so we can just skip this now
             continue;
         }
-        SignatureData sigdata;
-        input.FillSignatureData(sigdata);
-        SignPSBTInput(HidingSigningProvider(this, !sign, !bip32derivs), psbtx, i, sighash_type);
+        to_sign.push_back(i);
+    }
+
+    // Each input only touches its own PSBTInput, so they can be signed in parallel
+    ForEachInputParallel(to_sign.size(), [&](size_t j) {
+        SignPSBTInput(HidingSigningProvider(this, !sign, !bip32derivs), psbtx, to_sign[j], &txdata, sighash_type);
+    });
 
-        bool signed_one = PSBTInputSigned(input);
+    for (unsigned int i : to_sign) {
+        bool signed_one = PSBTInputSigned(psbtx.inputs.at(i));
         if (n_signed && (signed_one || !sign)) {
             // If sign is false, we assume that we _could_ sign if we get here. This
             // will never have false negatives; it is hard to tell under what i
@@ -738,11 +755,11 @@ bool LegacyScriptPubKeyMan::AddKeyPubKeyWithDB(WalletBatch& batch, const CKey& s
     CScript script;
     script = GetScriptForDestination(PKHash(pubkey));
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(batch, script);
     }
     script = GetScriptForRawPubKey(pubkey);
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(batch, script);
     }
 
     if (!m_storage.HasEncryptionKeys()) {
@@ -865,6 +882,12 @@ static bool ExtractPubKey(const CScript &dest, CPubKey& pubKeyOut)
 }
 
 bool LegacyScriptPubKeyMan::RemoveWatchOnly(const CScript &dest)
+{
+    WalletBatch batch(m_storage.GetDatabase());
+    return RemoveWatchOnlyWithDB(batch, dest);
+}
+
+bool LegacyScriptPubKeyMan::RemoveWatchOnlyWithDB(WalletBatch& batch, const CScript& dest)
 {
     {
         LOCK(cs_KeyStore);
@@ -879,7 +902,7 @@ bool LegacyScriptPubKeyMan::RemoveWatchOnly(const CScript &dest)
 
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (!WalletBatch(m_storage.GetDatabase()).EraseWatchOnly(dest))
+    if (!batch.EraseWatchOnly(dest))
         return false;
 
     return true;
@@ -1130,6 +1153,72 @@ void LegacyScriptPubKeyMan::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata&
         throw std::runtime_error(std::string(__func__) + ": writing HD chain model failed");
 }
 
+std::vector<CPubKey> LegacyScriptPubKeyMan::GenerateNewHDKeys(WalletBatch& batch, CHDChain& hd_chain, bool internal, size_t count)
+{
+    assert(!m_storage.IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS));
+    assert(!m_storage.IsWalletFlagSet(WALLET_FLAG_BLANK_WALLET));
+    AssertLockHeld(cs_KeyStore);
+    internal = m_storage.CanSupportFeature(FEATURE_HD_SPLIT) ? internal : false;
+    if (count == 0) return {};
+
+    // Same fixed keypath scheme as DeriveNewChildKey: m/0'/0'/k (external) or m/0'/1'/k (internal)
+    CKey seed;
+    if (!GetKey(hd_chain.seed_id, seed))
+        throw std::runtime_error(std::string(__func__) + ": seed not found");
+    CExtKey master_key;
+    CExtKey account_key;
+    CExtKey chain_key;
+    master_key.SetSeed(seed.begin(), seed.size());
+    master_key.Derive(account_key, BIP32_HARDENED_KEY_LIMIT);
+    account_key.Derive(chain_key, BIP32_HARDENED_KEY_LIMIT + (internal ? 1 : 0));
+    const CKeyID master_id = master_key.key.GetPubKey().GetID();
+    uint32_t& counter = internal ? hd_chain.nInternalChainCounter : hd_chain.nExternalChainCounter;
+
+    std::vector<CPubKey> result;
+    while (result.size() < count) {
+        // Child keys only depend on the chain key and their index
+        const size_t missing = count - result.size();
+        const uint32_t first = counter;
+        std::vector<CKey> keys(missing);
+        std::vector<CPubKey> pubkeys(missing);
+        ParallelFor(missing, std::min(GetNumCores(), MAX_KEYPOOL_TOPUP_THREADS), MIN_KEYS_PER_TOPUP_THREAD, [&](size_t i) {
+            CExtKey child_key;
+            chain_key.Derive(child_key, (first + i) | BIP32_HARDENED_KEY_LIMIT);
+            keys[i] = child_key.key;
+            pubkeys[i] = keys[i].GetPubKey();
+            assert(keys[i].VerifyPubKey(pubkeys[i]));
+        });
+
+        for (size_t i = 0; i < missing; ++i) {
+            const uint32_t index = counter++;
+            // skip keys already known to the wallet
+            if (HaveKey(pubkeys[i].GetID())) continue;
+
+            const int64_t creation_time = GetTime();
+            CKeyMetadata metadata(creation_time);
+            metadata.hdKeypath = std::string(internal ? "m/0'/1'/" : "m/0'/0'/") + ToString(index) + "'";
+            metadata.key_origin.path.push_back(0 | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back((internal ? 1 : 0) | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back(index | BIP32_HARDENED_KEY_LIMIT);
+            std::copy(master_id.begin(), master_id.begin() + 4, metadata.key_origin.fingerprint);
+            metadata.has_key_origin = true;
+            metadata.hd_seed_id = hd_chain.seed_id;
+
+            mapKeyMetadata[pubkeys[i].GetID()] = metadata;
+            UpdateTimeFirstKey(creation_time);
+            if (!AddKeyPubKeyWithDB(batch, keys[i], pubkeys[i])) {
+                throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+            }
+            result.push_back(pubkeys[i]);
+        }
+    }
+
+    // update the chain model in the database, once for the batch
+    if (hd_chain.seed_id == m_hd_chain.seed_id && !batch.WriteHDChain(hd_chain))
+        throw std::runtime_error(std::string(__func__) + ": writing HD chain model failed");
+    return result;
+}
+
 void LegacyScriptPubKeyMan::LoadKeyPool(int64_t nIndex, const CKeyPool &keypool)
 {
     LOCK(cs_KeyStore);
@@ -1274,18 +1363,31 @@ bool LegacyScriptPubKeyMan::TopUp(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
-        bool internal = false;
-        WalletBatch batch(m_storage.GetDatabase());
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                internal = true;
+        if (missingInternal + missingExternal > 0) {
+            // Raise the wallet version before the transaction, SetMinVersion writes through its own batch
+            if (m_storage.CanSupportFeature(FEATURE_COMPRPUBKEY)) {
+                m_storage.SetMinVersion(FEATURE_COMPRPUBKEY);
             }
 
-            CPubKey pubkey(GenerateNewKey(batch, m_hd_chain, internal));
-            AddKeypoolPubkeyWithDB(pubkey, internal, batch);
-        }
-        if (missingInternal + missingExternal > 0) {
+            // Write the whole refill in one database transaction
+            WalletBatch batch(m_storage.GetDatabase());
+            if (!batch.TxnBegin()) return false;
+            if (IsHDEnabled()) {
+                for (const CPubKey& pubkey : GenerateNewHDKeys(batch, m_hd_chain, false, missingExternal)) {
+                    AddKeypoolPubkeyWithDB(pubkey, false, batch);
+                }
+                for (const CPubKey& pubkey : GenerateNewHDKeys(batch, m_hd_chain, true, missingInternal)) {
+                    AddKeypoolPubkeyWithDB(pubkey, true, batch);
+                }
+            } else {
+                for (int64_t i = missingExternal; i--;) {
+                    CPubKey pubkey(GenerateNewKey(batch, m_hd_chain, false));
+                    AddKeypoolPubkeyWithDB(pubkey, false, batch);
+                }
+            }
+            if (!batch.TxnCommit()) {
+                throw std::runtime_error(std::string(__func__) + ": writing keypool failed");
+            }
             WalletLogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size() + set_pre_split_keypool.size(), setInternalKeyPool.size());
         }
     }
@@ -1659,7 +1761,7 @@ bool DescriptorScriptPubKeyMan::GetNewDestination(const OutputType type, CTxDest
     }
 }
 
-static CScript StripAdditionalTransactionData(CScript newScript)
+CScript StripAdditionalTransactionData(CScript newScript)
 {
     const unsigned int scriptSize = newScript.size();
     if (scriptSize >= 29 && scriptSize <= 65 && newScript[0] == OP_DUP && newScript[1] == OP_HASH160 && newScript[2] == 20 && newScript[23] == OP_EQUALVERIFY &&
@@ -1799,21 +1901,51 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
     FlatSigningProvider provider;
     provider.keys = GetKeys();
 
-    WalletBatch batch(m_storage.GetDatabase());
-    uint256 id = GetID();
-    for (int32_t i = m_max_cached_index + 1; i < new_range_end; ++i) {
+    // Expanding an index only reads the descriptor, its cache and the keys, so expand the new range in parallel
+    struct ExpandedIndex {
+        bool expanded{false};
+        std::vector<CScript> scripts;
         FlatSigningProvider out_keys;
-        std::vector<CScript> scripts_temp;
         DescriptorCache temp_cache;
+    };
+    const int32_t first_index = m_max_cached_index + 1;
+    std::vector<ExpandedIndex> expanded(std::max(new_range_end - first_index, 0));
+    const WalletDescriptor& descriptor = m_wallet_descriptor;
+    auto expand = [&](size_t j, const DescriptorCache* first_cache) {
+        ExpandedIndex& e = expanded[j];
+        const int32_t i = first_index + j;
         // Maybe we have a cached xpub and we can expand from the cache first
-        if (!m_wallet_descriptor.descriptor->ExpandFromCache(i, m_wallet_descriptor.cache, scripts_temp, out_keys)) {
-            if (!m_wallet_descriptor.descriptor->Expand(i, provider, scripts_temp, out_keys, &temp_cache)) return false;
+        e.expanded = descriptor.descriptor->ExpandFromCache(i, descriptor.cache, e.scripts, e.out_keys) ||
+                     (first_cache && descriptor.descriptor->ExpandFromCache(i, *first_cache, e.scripts, e.out_keys)) ||
+                     descriptor.descriptor->Expand(i, provider, e.scripts, e.out_keys, &e.temp_cache);
+    };
+    if (!expanded.empty()) {
+        // The first index caches the parent xpubs when they are not cached yet, the others can then expand from them
+        expand(0, nullptr);
+        ParallelFor(expanded.size() - 1, std::min(GetNumCores(), MAX_KEYPOOL_TOPUP_THREADS), MIN_KEYS_PER_TOPUP_THREAD, [&](size_t j) {
+            expand(j + 1, &expanded[0].temp_cache);
+        });
+    }
+
+    // Write the whole refill in one database transaction
+    WalletBatch batch(m_storage.GetDatabase());
+    if (!batch.TxnBegin()) return false;
+    uint256 id = GetID();
+    for (ExpandedIndex& e : expanded) {
+        const int32_t i = m_max_cached_index + 1;
+        if (!e.expanded) {
+            // Keep what was added so far, it matches what is in memory
+            if (!batch.TxnCommit()) {
+                throw std::runtime_error(std::string(__func__) + ": writing cache items failed");
+            }
+            return false;
         }
         // Add all of the scriptPubKeys to the scriptPubKey set
-        for (const CScript& script : scripts_temp) {
+        for (const CScript& script : e.scripts) {
             m_map_script_pub_keys[script] = i;
         }
-        for (const auto& pk_pair : out_keys.pubkeys) {
+        m_storage.AddScriptPubKeys(*this, e.scripts);
+        for (const auto& pk_pair : e.out_keys.pubkeys) {
             const CPubKey& pubkey = pk_pair.second;
             if (m_map_pubkeys.count(pubkey) != 0) {
                 // We don't need to give an error here.
@@ -1823,7 +1955,7 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
             m_map_pubkeys[pubkey] = i;
         }
         // Write the cache
-        for (const auto& parent_xpub_pair : temp_cache.GetCachedParentExtPubKeys()) {
+        for (const auto& parent_xpub_pair : e.temp_cache.GetCachedParentExtPubKeys()) {
             CExtPubKey xpub;
             if (m_wallet_descriptor.cache.GetCachedParentExtPubKey(parent_xpub_pair.first, xpub)) {
                 if (xpub != parent_xpub_pair.second) {
@@ -1836,7 +1968,7 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
             }
             m_wallet_descriptor.cache.CacheParentExtPubKey(parent_xpub_pair.first, parent_xpub_pair.second);
         }
-        for (const auto& derived_xpub_map_pair : temp_cache.GetCachedDerivedExtPubKeys()) {
+        for (const auto& derived_xpub_map_pair : e.temp_cache.GetCachedDerivedExtPubKeys()) {
             for (const auto& derived_xpub_pair : derived_xpub_map_pair.second) {
                 CExtPubKey xpub;
                 if (m_wallet_descriptor.cache.GetCachedDerivedExtPubKey(derived_xpub_map_pair.first, derived_xpub_pair.first, xpub)) {
@@ -1855,6 +1987,9 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
     }
     m_wallet_descriptor.range_end = new_range_end;
     batch.WriteDescriptor(GetID(), m_wallet_descriptor);
+    if (!batch.TxnCommit()) {
+        throw std::runtime_error(std::string(__func__) + ": writing descriptor failed");
+    }
 
     // By this point, the cache size should be the size of the entire range
     assert(m_wallet_descriptor.range_end - 1 == m_max_cached_index);
@@ -2021,6 +2156,12 @@ unsigned int DescriptorScriptPubKeyMan::GetKeyPoolSize() const
     return m_wallet_descriptor.range_end - m_wallet_descriptor.next_index;
 }
 
+bool DescriptorScriptPubKeyMan::NeedsTopUp(unsigned int watermark) const
+{
+    LOCK(cs_desc_man);
+    return m_wallet_descriptor.descriptor->IsRange() && m_wallet_descriptor.range_end - m_wallet_descriptor.next_index < (int64_t)watermark;
+}
+
 int64_t DescriptorScriptPubKeyMan::GetTimeFirstKey() const
 {
     LOCK(cs_desc_man);
@@ -2133,14 +2274,16 @@ SigningResult DescriptorScriptPubKeyMan::SignBlock(CBlock& block, const CPubKey&
     return SigningResult::OK;
 }
 
-TransactionError DescriptorScriptPubKeyMan::FillPSBT(PartiallySignedTransaction& psbtx, int sighash_type, bool sign, bool bip32derivs, int* n_signed) const
+TransactionError DescriptorScriptPubKeyMan::FillPSBT(PartiallySignedTransaction& psbtx, const PrecomputedTransactionData& txdata, int sighash_type, bool sign, bool bip32derivs, int* n_signed) const
 {
     if (n_signed) {
         *n_signed = 0;
     }
+    // Signing providers are gathered under cs_desc_man first, the signing itself runs in parallel
+    std::vector<std::pair<unsigned int, std::unique_ptr<FlatSigningProvider>>> to_sign;
     for (unsigned int i = 0; i < psbtx.tx->vin.size(); ++i) {
         const CTxIn& txin = psbtx.tx->vin[i];
-        PSBTInput& input = psbtx.inputs.at(i);
+        const PSBTInput& input = psbtx.inputs.at(i);
 
         if (PSBTInputSigned(input)) {
             continue;
@@ -2164,8 +2307,6 @@ TransactionError DescriptorScriptPubKeyMan::FillPSBT(PartiallySignedTransaction&
             // There's no UTXO so we can just skip this now
             continue;
         }
-        SignatureData sigdata;
-        input.FillSignatureData(sigdata);
 
         std::unique_ptr<FlatSigningProvider> keys = MakeUnique<FlatSigningProvider>();
         std::unique_ptr<FlatSigningProvider> script_keys = GetSigningProvider(script, sign);
@@ -2182,10 +2323,15 @@ TransactionError DescriptorScriptPubKeyMan::FillPSBT(PartiallySignedTransaction&
                 }
             }
         }
+        to_sign.emplace_back(i, std::move(keys));
+    }
 
-        SignPSBTInput(HidingSigningProvider(keys.get(), !sign, !bip32derivs), psbtx, i, sighash_type);
+    ForEachInputParallel(to_sign.size(), [&](size_t j) {
+        SignPSBTInput(HidingSigningProvider(to_sign[j].second.get(), !sign, !bip32derivs), psbtx, to_sign[j].first, &txdata, sighash_type);
+    });
 
-        bool signed_one = PSBTInputSigned(input);
+    for (const auto& entry : to_sign) {
+        bool signed_one = PSBTInputSigned(psbtx.inputs.at(entry.first));
         if (n_signed && (signed_one || !sign)) {
             // If sign is false, we assume that we _could_ sign if we get here. This
             // will never have false negatives; it is hard to tell under what i
@@ -2255,6 +2401,7 @@ void DescriptorScriptPubKeyMan::SetCache(const DescriptorCache& cache)
             }
             m_map_script_pub_keys[script] = i;
         }
+        m_storage.AddScriptPubKeys(*this, scripts_temp);
         for (const auto& pk_pair : out_keys.pubkeys) {
             const CPubKey& pubkey = pk_pair.second;
             if (m_map_pubkeys.count(pubkey) != 0) {
@@ -23,6 +23,8 @@
 enum class OutputType;
 struct bilingual_str;
 
+class ScriptPubKeyMan;
+
 // Wallet storage things that ScriptPubKeyMans need in order to be able to store things to the wallet database.
 // It provides access to things that are part of the entire wallet and not specific to a ScriptPubKeyMan such as
 // wallet flags, wallet version, encryption keys, encryption status, and the database itself. This allows a
@@ -41,13 +43,25 @@ public:
     virtual const CKeyingMaterial& GetEncryptionKey() const = 0;
     virtual bool HasEncryptionKeys() const = 0;
     virtual bool IsLocked() const = 0;
+    //! Index scriptPubKeys of a ScriptPubKeyMan for wallet-wide IsMine lookups
+    virtual void AddScriptPubKeys(const ScriptPubKeyMan& spk_man, const std::vector<CScript>& scripts) = 0;
+    virtual void RemoveScriptPubKeys(const ScriptPubKeyMan& spk_man) = 0;
 };
 
 //! Default for -keypool
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Default for -keypoolwatermark
+static const unsigned int DEFAULT_KEYPOOL_WATERMARK = 100;
+//! Maximum number of threads deriving keys for one keypool top-up
+static const int MAX_KEYPOOL_TOPUP_THREADS = 8;
+//! Minimum number of keys derived by each top-up thread
+static const size_t MIN_KEYS_PER_TOPUP_THREAD = 16;
 
 std::vector<CKeyID> GetAffectedKeys(const CScript& spk, const SigningProvider& provider);
 
+/** Strip the replay protection suffix from a scriptPubKey, leaving the script a descriptor expands to */
+CScript StripAdditionalTransactionData(CScript newScript);
+
 /** A key from a CWallet's keypool
  *
  * The wallet holds one (for pre HD-split wallets) or several keypools. These
@@ -217,6 +231,8 @@ public:
 
     virtual size_t KeypoolCountExternalKeys() const { return 0; }
     virtual unsigned int GetKeyPoolSize() const { return 0; }
+    /** Whether a chain of the keypool has fewer than watermark unused keys left and TopUp could refill it */
+    virtual bool NeedsTopUp(unsigned int watermark) const { return false; }
 
     virtual int64_t GetTimeFirstKey() const { return 0; }
 
@@ -235,13 +251,17 @@ public:
     virtual SigningResult SignMessage(const std::string& message, const PKHash& pkhash, std::string& str_sig) const { return SigningResult::SIGNING_FAILED; };
     /** Sign a block with the given key */
     virtual SigningResult SignBlock(CBlock& block, const CPubKey& pubkey) const { return SigningResult::SIGNING_FAILED; };
-    /** Adds script and derivation path information to a PSBT, and optionally signs it. */
-    virtual TransactionError FillPSBT(PartiallySignedTransaction& psbt, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const { return TransactionError::INVALID_PSBT; }
+    /** Adds script and derivation path information to a PSBT, and optionally signs it. txdata is PrecomputePSBTData(psbt). */
+    virtual TransactionError FillPSBT(PartiallySignedTransaction& psbt, const PrecomputedTransactionData& txdata, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const { return TransactionError::INVALID_PSBT; }
 
     virtual uint256 GetID() const { return uint256(); }
 
     virtual void SetInternal(bool internal) {}
 
+    /** The lock guarding this ScriptPubKeyMan's keys. Code that writes them within a batch
+      * transaction takes it before TxnBegin, see SQLiteDatabase::m_write_mutex. */
+    virtual RecursiveMutex& GetKeysMutex() const = 0;
+
     /** Prepends the wallet name in logging output to ease debugging in multi-wallet use cases */
     template<typename... Params>
     void WalletLogPrintf(std::string fmt, Params... parameters) const {
@@ -309,6 +329,13 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch& batch, CKeyMetadata& metadata, CKey& secret, CHDChain& hd_chain, bool internal = false) EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
+    /**
+     * HD derive the next count keys of a chain and add them to the wallet. The chain key
+     * is derived once for the batch and the child keys are derived in parallel.
+     */
+    std::vector<CPubKey> GenerateNewHDKeys(WalletBatch& batch, CHDChain& hd_chain, bool internal, size_t count) EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
+
+    bool RemoveWatchOnlyWithDB(WalletBatch& batch, const CScript& dest);
 
     std::set<int64_t> setInternalKeyPool GUARDED_BY(cs_KeyStore);
     std::set<int64_t> setExternalKeyPool GUARDED_BY(cs_KeyStore);
@@ -382,6 +409,7 @@ public:
     int64_t GetOldestKeyPoolTime() const override;
     size_t KeypoolCountExternalKeys() const override;
     unsigned int GetKeyPoolSize() const override;
+    bool NeedsTopUp(unsigned int watermark) const override;
 
     int64_t GetTimeFirstKey() const override;
 
@@ -396,12 +424,14 @@ public:
     bool SignTransaction(CMutableTransaction& tx, const std::map<COutPoint, Coin>& coins, int sighash, std::map<int, std::string>& input_errors) const override;
     SigningResult SignMessage(const std::string& message, const PKHash& pkhash, std::string& str_sig) const override;
     SigningResult SignBlock(CBlock& block, const CPubKey& pubkey) const override;
-    TransactionError FillPSBT(PartiallySignedTransaction& psbt, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const override;
+    TransactionError FillPSBT(PartiallySignedTransaction& psbt, const PrecomputedTransactionData& txdata, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const override;
 
     uint256 GetID() const override;
 
     void SetInternal(bool internal) override;
 
+    RecursiveMutex& GetKeysMutex() const override { return cs_KeyStore; }
+
     // Map from Key ID to key metadata.
     std::map<CKeyID, CKeyMetadata> mapKeyMetadata GUARDED_BY(cs_KeyStore);
 
@@ -558,6 +588,7 @@ public:
         :   ScriptPubKeyMan(storage),
             m_internal(internal)
         {}
+    ~DescriptorScriptPubKeyMan() override { m_storage.RemoveScriptPubKeys(*this); }
 
     mutable RecursiveMutex cs_desc_man;
 
@@ -588,6 +619,7 @@ public:
     int64_t GetOldestKeyPoolTime() const override;
     size_t KeypoolCountExternalKeys() const override;
     unsigned int GetKeyPoolSize() const override;
+    bool NeedsTopUp(unsigned int watermark) const override;
 
     int64_t GetTimeFirstKey() const override;
 
@@ -602,12 +634,14 @@ public:
     bool SignTransaction(CMutableTransaction& tx, const std::map<COutPoint, Coin>& coins, int sighash, std::map<int, std::string>& input_errors) const override;
     SigningResult SignMessage(const std::string& message, const PKHash& pkhash, std::string& str_sig) const override;
     SigningResult SignBlock(CBlock& block, const CPubKey& pubkey) const override;
-    TransactionError FillPSBT(PartiallySignedTransaction& psbt, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const override;
+    TransactionError FillPSBT(PartiallySignedTransaction& psbt, const PrecomputedTransactionData& txdata, int sighash_type = 1 /* SIGHASH_ALL */, bool sign = true, bool bip32derivs = false, int* n_signed = nullptr) const override;
 
     uint256 GetID() const override;
 
     void SetInternal(bool internal) override;
 
+    RecursiveMutex& GetKeysMutex() const override { return cs_desc_man; }
+
     void SetCache(const DescriptorCache& cache);
 
     bool AddKey(const CKeyID& key_id, const CKey& key);
@@ -0,0 +1,104 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/scriptpubkeyset.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+#include <script/script.h>
+
+#include <algorithm>
+#include <limits>
+
+/** Map a fingerprint to a slot. The slot only depends on the fingerprint, so the table can be rehashed without the scripts. */
+static inline size_t SlotOf(uint32_t fingerprint, size_t capacity)
+{
+    return (uint64_t{fingerprint} * capacity) >> 32;
+}
+
+ScriptPubKeySet::ScriptPubKeySet() : m_k0(GetRand(std::numeric_limits<uint64_t>::max())), m_k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+uint32_t ScriptPubKeySet::Fingerprint(const CScript& script) const
+{
+    return CSipHasher(m_k0, m_k1).Write(script.data(), script.size()).Finalize() >> 32;
+}
+
+void ScriptPubKeySet::Insert(Entry entry)
+{
+    const size_t capacity = m_table.size();
+    for (size_t slot = SlotOf(entry.fingerprint, capacity);; slot = (slot + 1 == capacity) ? 0 : slot + 1) {
+        Entry& e = m_table[slot];
+        if (e.owner == 0) {
+            e = entry;
+            ++m_size;
+            return;
+        }
+        // Scripts of the same owner that share a fingerprint need only one entry
+        if (e.fingerprint == entry.fingerprint && e.owner == entry.owner) return;
+    }
+}
+
+void ScriptPubKeySet::Rehash(size_t capacity)
+{
+    std::vector<Entry> old_table(capacity, Entry{0, 0});
+    old_table.swap(m_table);
+    m_size = 0;
+    for (const Entry& e : old_table) {
+        if (e.owner != 0 && m_owners[e.owner - 1] != nullptr) Insert(e);
+    }
+}
+
+void ScriptPubKeySet::Add(const ScriptPubKeyMan* owner, const std::vector<CScript>& scripts)
+{
+    LOCK(m_mutex);
+    auto it = std::find(m_owners.begin(), m_owners.end(), owner);
+    if (it == m_owners.end()) it = m_owners.insert(m_owners.end(), owner);
+    const uint32_t owner_index = (it - m_owners.begin()) + 1;
+
+    const size_t needed = m_size + scripts.size();
+    if (needed * 100 > m_table.size() * MAX_LOAD) {
+        Rehash(std::max<size_t>(needed * 2, 64));
+    }
+    for (const CScript& script : scripts) {
+        Insert(Entry{Fingerprint(script), owner_index});
+    }
+}
+
+void ScriptPubKeySet::RemoveOwner(const ScriptPubKeyMan* owner)
+{
+    LOCK(m_mutex);
+    auto it = std::find(m_owners.begin(), m_owners.end(), owner);
+    if (it == m_owners.end()) return;
+    // Keep the indexes of the other owners stable and drop the entries by rehashing in place
+    *it = nullptr;
+    Rehash(m_table.size());
+}
+
+std::vector<const ScriptPubKeyMan*> ScriptPubKeySet::GetCandidates(const CScript& script) const
+{
+    std::vector<const ScriptPubKeyMan*> candidates;
+    const uint32_t fingerprint = Fingerprint(script);
+    LOCK(m_mutex);
+    const size_t capacity = m_table.size();
+    if (capacity == 0) return candidates;
+    for (size_t slot = SlotOf(fingerprint, capacity);; slot = (slot + 1 == capacity) ? 0 : slot + 1) {
+        const Entry& e = m_table[slot];
+        if (e.owner == 0) break;
+        if (e.fingerprint == fingerprint) candidates.push_back(m_owners[e.owner - 1]);
+    }
+    return candidates;
+}
+
+size_t ScriptPubKeySet::Size() const
+{
+    LOCK(m_mutex);
+    return m_size;
+}
+
+size_t ScriptPubKeySet::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return memusage::DynamicUsage(m_table) + memusage::DynamicUsage(m_owners);
+}
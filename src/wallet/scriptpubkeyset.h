@@ -0,0 +1,65 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_SCRIPTPUBKEYSET_H
+#define BITCOIN_WALLET_SCRIPTPUBKEYSET_H
+
+#include <sync.h>
+
+#include <stdint.h>
+#include <vector>
+
+class CScript;
+class ScriptPubKeyMan;
+
+/**
+ * Salted, open-addressed set of scriptPubKey fingerprints shared by the
+ * ScriptPubKeyMans of a wallet.
+ *
+ * Each entry records a 32-bit SipHash fingerprint of a script and the
+ * ScriptPubKeyMan that owns it. A lookup returns the owners whose fingerprint
+ * matches, which must then compare the full script; for scripts that are not
+ * in the wallet this almost always costs a single hash and a probe of one
+ * cache line, instead of walking every ScriptPubKeyMan's map of scripts.
+ */
+class ScriptPubKeySet
+{
+private:
+    struct Entry {
+        uint32_t fingerprint;
+        //! Index + 1 into m_owners, 0 for an empty slot
+        uint32_t owner;
+    };
+
+    //! Maximum load factor of the table, in percent
+    static constexpr uint64_t MAX_LOAD = 75;
+
+    const uint64_t m_k0, m_k1;
+
+    mutable Mutex m_mutex;
+    std::vector<Entry> m_table GUARDED_BY(m_mutex);
+    std::vector<const ScriptPubKeyMan*> m_owners GUARDED_BY(m_mutex);
+    size_t m_size GUARDED_BY(m_mutex){0};
+
+    uint32_t Fingerprint(const CScript& script) const;
+    void Insert(Entry entry) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    void Rehash(size_t capacity) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+public:
+    ScriptPubKeySet();
+
+    /** Add the scripts of a ScriptPubKeyMan. Adding a script again is a no-op. */
+    void Add(const ScriptPubKeyMan* owner, const std::vector<CScript>& scripts);
+
+    /** Remove all scripts of a ScriptPubKeyMan, e.g. when it is replaced. */
+    void RemoveOwner(const ScriptPubKeyMan* owner);
+
+    /** Return the ScriptPubKeyMans that may own the script. */
+    std::vector<const ScriptPubKeyMan*> GetCandidates(const CScript& script) const;
+
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_WALLET_SCRIPTPUBKEYSET_H
@@ -11,12 +11,15 @@
 #include <util/memory.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <wallet/db.h>
 
 #include <sqlite3.h>
 #include <stdint.h>
 
+#include <algorithm>
+
 static const char* const DATABASE_FILENAME = "wallet.dat";
 static constexpr int32_t WALLET_SCHEMA_VERSION = 0;
 
@@ -34,8 +37,8 @@ static void ErrorLogCallback(void* arg, int code, const char* msg)
     LogPrintf("SQLite Error. Code: %d. Message: %s\n", code, msg);
 }
 
-SQLiteDatabase::SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path, bool mock)
-    : WalletDatabase(), m_mock(mock), m_dir_path(dir_path.string()), m_file_path(file_path.string())
+SQLiteDatabase::SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path, bool mock, int64_t commit_interval)
+    : WalletDatabase(), m_mock(mock), m_dir_path(dir_path.string()), m_file_path(file_path.string()), m_commit_interval(commit_interval)
 {
     {
         LOCK(g_sqlite_mutex);
@@ -239,6 +242,15 @@ void SQLiteDatabase::Open()
         throw std::runtime_error(strprintf("SQLiteDatabase: Failed to enable fullfsync: %s\n", sqlite3_errstr(ret)));
     }
 
+    // Group commits keep a write transaction open for a while, so use a write-ahead log to make
+    // each commit a single append. Switch back to the default rollback journal otherwise.
+    if (!m_mock) {
+        ret = sqlite3_exec(m_db, m_commit_interval > 0 ? "PRAGMA journal_mode = WAL" : "PRAGMA journal_mode = DELETE", nullptr, nullptr, nullptr);
+        if (ret != SQLITE_OK) {
+            throw std::runtime_error(strprintf("SQLiteDatabase: Failed to set the journal mode: %s\n", sqlite3_errstr(ret)));
+        }
+    }
+
     // Make the table for our key-value pairs
     // First check that the main table exists
     sqlite3_stmt* check_main_stmt{nullptr};
@@ -285,13 +297,21 @@ void SQLiteDatabase::Open()
 
 bool SQLiteDatabase::Rewrite(const char* skip)
 {
+    // VACUUM cannot run inside a transaction
+    CommitPending();
+
     // Rewrite the database using the VACUUM command: https://sqlite.org/lang_vacuum.html
     int ret = sqlite3_exec(m_db, "VACUUM", nullptr, nullptr, nullptr);
     return ret == SQLITE_OK;
 }
 
-bool SQLiteDatabase::Backup(const std::string& dest) const
+bool SQLiteDatabase::Backup(const std::string& dest)
 {
+    {
+        LOCK(m_group_mutex);
+        CommitGroupTxn();
+    }
+
     sqlite3* db_copy;
     int res = sqlite3_open(dest.c_str(), &db_copy);
     if (res != SQLITE_OK) {
@@ -319,6 +339,8 @@ bool SQLiteDatabase::Backup(const std::string& dest) const
 
 void SQLiteDatabase::Close()
 {
+    CommitPending();
+
     int res = sqlite3_close(m_db);
     if (res != SQLITE_OK) {
         throw std::runtime_error(strprintf("SQLiteDatabase: Failed to close database: %s\n", sqlite3_errstr(res)));
@@ -326,6 +348,64 @@ void SQLiteDatabase::Close()
     m_db = nullptr;
 }
 
+void SQLiteDatabase::MaybeBeginGroupTxn()
+{
+    if (m_commit_interval <= 0 || m_group_txn_open || !m_db || sqlite3_get_autocommit(m_db) == 0) return;
+    int res = sqlite3_exec(m_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+    if (res != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase: Failed to begin group transaction: %s\n", sqlite3_errstr(res));
+        return;
+    }
+    m_group_txn_open = true;
+    m_group_txn_start = GetTimeMillis();
+}
+
+bool SQLiteDatabase::CommitGroupTxn()
+{
+    // A batch's explicit transaction is nested in the group transaction as a savepoint,
+    // and must be released before the group can be committed.
+    if (!m_group_txn_open || m_txn_depth > 0 || !m_db) return false;
+    const int64_t start = GetTimeMicros();
+    int res = sqlite3_exec(m_db, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
+    if (res != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase: Failed to commit group transaction: %s\n", sqlite3_errstr(res));
+        return false;
+    }
+    m_group_txn_open = false;
+    m_stats.pending_writes = 0;
+    RecordCommit(GetTimeMicros() - start);
+    return true;
+}
+
+void SQLiteDatabase::RecordCommit(int64_t duration)
+{
+    ++m_stats.commits;
+    m_stats.commit_time_total += duration;
+    m_stats.commit_time_max = std::max(m_stats.commit_time_max, duration);
+}
+
+bool SQLiteDatabase::CommitPending(bool expired_only)
+{
+    LOCK(m_group_mutex);
+    if (expired_only && (!m_group_txn_open || GetTimeMillis() - m_group_txn_start < m_commit_interval)) return false;
+    return CommitGroupTxn();
+}
+
+bool SQLiteDatabase::PeriodicFlush()
+{
+    // Only called once the wallet has been idle for a while, so there is no point in waiting any longer.
+    LOCK(m_group_mutex);
+    if (!m_group_txn_open) return false;
+    return CommitGroupTxn();
+}
+
+bool SQLiteDatabase::GetStats(WalletDatabaseStats& stats) const
+{
+    LOCK(m_group_mutex);
+    stats = m_stats;
+    return true;
+}
+
 std::unique_ptr<DatabaseBatch> SQLiteDatabase::MakeBatch(bool flush_on_close)
 {
     // We ignore flush_on_close because we don't do manual flushing for SQLite
@@ -343,8 +423,8 @@ SQLiteBatch::SQLiteBatch(SQLiteDatabase& database)
 
 void SQLiteBatch::Close()
 {
-    // If m_db is in a transaction (i.e. not in autocommit mode), then abort the transaction in progress
-    if (m_database.m_db && sqlite3_get_autocommit(m_database.m_db) == 0) {
+    // If this batch has a transaction in progress, then abort it
+    if (m_txn_active) {
         if (TxnAbort()) {
             LogPrintf("SQLiteBatch: Batch closed unexpectedly without the transaction being explicitly committed or aborted\n");
         } else {
@@ -443,7 +523,7 @@ bool SQLiteBatch::WriteKey(CDataStream&& key, CDataStream&& value, bool overwrit
     }
 
     // Execute
-    res = sqlite3_step(stmt);
+    res = ExecWriteStatement(stmt);
     sqlite3_clear_bindings(stmt);
     sqlite3_reset(stmt);
     if (res != SQLITE_DONE) {
@@ -467,7 +547,7 @@ bool SQLiteBatch::EraseKey(CDataStream&& key)
     }
 
     // Execute
-    res = sqlite3_step(m_delete_stmt);
+    res = ExecWriteStatement(m_delete_stmt);
     sqlite3_clear_bindings(m_delete_stmt);
     sqlite3_reset(m_delete_stmt);
     if (res != SQLITE_DONE) {
@@ -476,6 +556,23 @@ bool SQLiteBatch::EraseKey(CDataStream&& key)
     return res == SQLITE_DONE;
 }
 
+int SQLiteBatch::ExecWriteStatement(sqlite3_stmt* stmt)
+{
+    LOCK2(m_database.m_write_mutex, m_database.m_group_mutex);
+    m_database.MaybeBeginGroupTxn();
+    // Outside of any transaction, the statement is committed on its own
+    const bool autocommit = sqlite3_get_autocommit(m_database.m_db) != 0;
+    const int64_t start = GetTimeMicros();
+    int res = sqlite3_step(stmt);
+    ++m_database.m_stats.writes;
+    if (autocommit) {
+        m_database.RecordCommit(GetTimeMicros() - start);
+    } else if (m_database.m_group_txn_open) {
+        ++m_database.m_stats.pending_writes;
+    }
+    return res;
+}
+
 bool SQLiteBatch::HasKey(CDataStream&& key)
 {
     if (!m_database.m_db) return false;
@@ -536,34 +633,66 @@ void SQLiteBatch::CloseCursor()
     m_cursor_init = false;
 }
 
-bool SQLiteBatch::TxnBegin()
+bool SQLiteBatch::TxnBegin() NO_THREAD_SAFETY_ANALYSIS
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) == 0) return false;
-    int res = sqlite3_exec(m_database.m_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+    if (!m_database.m_db || m_txn_active) return false;
+    // Held until EndTxn, which the thread safety analysis cannot follow
+    ENTER_CRITICAL_SECTION(m_database.m_write_mutex);
+    LOCK(m_database.m_group_mutex);
+    // Nest in the transaction already open on the connection, if any (the
+    // group transaction or another batch's on this thread), so that aborting
+    // this batch only discards its own writes
+    std::string savepoint;
+    if (sqlite3_get_autocommit(m_database.m_db) == 0) {
+        savepoint = strprintf("wallet_batch_%u", ++m_database.m_txn_savepoint_count);
+    }
+    int res = sqlite3_exec(m_database.m_db, savepoint.empty() ? "BEGIN TRANSACTION" : ("SAVEPOINT " + savepoint).c_str(), nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to begin the transaction\n");
+        LEAVE_CRITICAL_SECTION(m_database.m_write_mutex);
+        return false;
     }
-    return res == SQLITE_OK;
+    m_txn_active = true;
+    m_txn_savepoint = savepoint;
+    ++m_database.m_txn_depth;
+    return true;
+}
+
+void SQLiteBatch::EndTxn() NO_THREAD_SAFETY_ANALYSIS
+{
+    AssertLockHeld(m_database.m_group_mutex);
+    m_txn_active = false;
+    m_txn_savepoint.clear();
+    --m_database.m_txn_depth;
+    LEAVE_CRITICAL_SECTION(m_database.m_write_mutex);
 }
 
 bool SQLiteBatch::TxnCommit()
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0) return false;
-    int res = sqlite3_exec(m_database.m_db, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
+    if (!m_database.m_db || !m_txn_active) return false;
+    LOCK(m_database.m_group_mutex);
+    const int64_t start = GetTimeMicros();
+    int res = sqlite3_exec(m_database.m_db, m_txn_savepoint.empty() ? "COMMIT TRANSACTION" : ("RELEASE " + m_txn_savepoint).c_str(), nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to commit the transaction\n");
+        return false;
     }
-    return res == SQLITE_OK;
+    if (m_txn_savepoint.empty()) m_database.RecordCommit(GetTimeMicros() - start);
+    EndTxn();
+    return true;
 }
 
 bool SQLiteBatch::TxnAbort()
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0) return false;
-    int res = sqlite3_exec(m_database.m_db, "ROLLBACK TRANSACTION", nullptr, nullptr, nullptr);
+    if (!m_database.m_db || !m_txn_active) return false;
+    LOCK(m_database.m_group_mutex);
+    int res = sqlite3_exec(m_database.m_db, m_txn_savepoint.empty() ? "ROLLBACK TRANSACTION" : strprintf("ROLLBACK TO %s; RELEASE %s", m_txn_savepoint, m_txn_savepoint).c_str(), nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to abort the transaction\n");
+        return false;
     }
-    return res == SQLITE_OK;
+    EndTxn();
+    return true;
 }
 
 bool ExistsSQLiteDatabase(const fs::path& path)
@@ -576,7 +705,7 @@ std::unique_ptr<SQLiteDatabase> MakeSQLiteDatabase(const fs::path& path, const D
 {
     const fs::path file = path / DATABASE_FILENAME;
     try {
-        auto db = MakeUnique<SQLiteDatabase>(path, file);
+        auto db = MakeUnique<SQLiteDatabase>(path, file, /* mock */ false, gArgs.GetArg("-walletcommitinterval", DEFAULT_WALLET_COMMIT_INTERVAL));
         if (options.verify && !db->Verify(error)) {
             status = DatabaseStatus::FAILED_VERIFY;
             return nullptr;
@@ -5,10 +5,15 @@
 #ifndef BITCOIN_WALLET_SQLITE_H
 #define BITCOIN_WALLET_SQLITE_H
 
+#include <sync.h>
 #include <wallet/db.h>
 
 #include <sqlite3.h>
 
+#include <condition_variable>
+#include <string>
+#include <thread>
+
 struct bilingual_str;
 class SQLiteDatabase;
 
@@ -26,8 +31,19 @@ private:
     sqlite3_stmt* m_delete_stmt{nullptr};
     sqlite3_stmt* m_cursor_stmt{nullptr};
 
+    //! Whether this batch has an explicit transaction open, and the name of
+    //! its savepoint if it is nested in another transaction on the connection
+    bool m_txn_active{false};
+    std::string m_txn_savepoint;
+
+    /** Mark the end of this batch's transaction, releasing the write lock taken by TxnBegin */
+    void EndTxn();
+
     void SetupSQLStatements();
 
+    /** Execute a prepared write or erase statement, joining the group transaction if there is one */
+    int ExecWriteStatement(sqlite3_stmt* stmt);
+
     bool ReadKey(CDataStream&& key, CDataStream& value) override;
     bool WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite = true) override;
     bool EraseKey(CDataStream&& key) override;
@@ -55,19 +71,56 @@ public:
 class SQLiteDatabase : public WalletDatabase
 {
 private:
+    friend class SQLiteBatch;
+
     const bool m_mock{false};
 
     const std::string m_dir_path;
 
     const std::string m_file_path;
 
+    /** Milliseconds over which writes are grouped into one transaction. 0 commits every write. */
+    const int64_t m_commit_interval;
+
+    /** Group commit state. Writes made outside of an explicit batch
+     * transaction join a single open transaction, which is committed once
+     * m_commit_interval has elapsed, at block boundaries, and before the
+     * database is closed, backed up or rewritten.
+     */
+    mutable Mutex m_group_mutex;
+    bool m_group_txn_open GUARDED_BY(m_group_mutex){false};
+    int64_t m_group_txn_start GUARDED_BY(m_group_mutex){0};
+    WalletDatabaseStats m_stats GUARDED_BY(m_group_mutex);
+
+    /** Explicit batch transactions share the connection, so a batch holds
+     * this lock from TxnBegin until its transaction ends, and every write
+     * takes it too. Writes from other threads therefore wait for the
+     * transaction, and aborting it cannot discard them.
+     *
+     * Lock order: cs_wallet and the ScriptPubKeyMan locks come before this
+     * one, which comes before m_group_mutex. A batch must take every wallet
+     * lock its transaction needs before TxnBegin, because a writer waiting
+     * here may hold them. DEBUG_LOCKORDER reports any inversion.
+     */
+    RecursiveMutex m_write_mutex;
+
+    /** Number of open batch transactions. Each one nested in another
+     * transaction is a savepoint with its own name.
+     */
+    int m_txn_depth GUARDED_BY(m_group_mutex){0};
+    uint64_t m_txn_savepoint_count GUARDED_BY(m_group_mutex){0};
+
+    void MaybeBeginGroupTxn() EXCLUSIVE_LOCKS_REQUIRED(m_group_mutex);
+    bool CommitGroupTxn() EXCLUSIVE_LOCKS_REQUIRED(m_group_mutex);
+    void RecordCommit(int64_t duration) EXCLUSIVE_LOCKS_REQUIRED(m_group_mutex);
+
     void Cleanup() noexcept;
 
 public:
     SQLiteDatabase() = delete;
 
     /** Create DB handle to real database */
-    SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path, bool mock = false);
+    SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path, bool mock = false, int64_t commit_interval = DEFAULT_WALLET_COMMIT_INTERVAL);
 
     ~SQLiteDatabase();
 
@@ -88,20 +141,22 @@ public:
 
     /** Back up the entire database to a file.
      */
-    bool Backup(const std::string& dest) const override;
+    bool Backup(const std::string& dest) override;
 
-    /** No-ops
-     *
-     * SQLite always flushes everything to the database file after each transaction
-     * (each Read/Write/Erase that we do is its own transaction unless we called
-     * TxnBegin) so there is no need to have Flush or Periodic Flush.
+    /** SQLite flushes everything to the database file after each transaction.
+     * Unless group commits are enabled, each Read/Write/Erase that we do is its
+     * own transaction (or part of the one started by TxnBegin), so Flush and
+     * PeriodicFlush only have to commit the open group transaction, if any.
      *
      * There is no DB env to reload, so ReloadDbEnv has nothing to do
      */
-    void Flush() override {}
-    bool PeriodicFlush() override { return false; }
+    void Flush() override { CommitPending(); }
+    bool PeriodicFlush() override;
     void ReloadDbEnv() override {}
 
+    bool CommitPending(bool expired_only = false) override;
+    bool GetStats(WalletDatabaseStats& stats) const override;
+
     void IncrementUpdateCounter() override { ++nUpdateCounter; }
 
     std::string Filename() override { return m_file_path; }
@@ -2,13 +2,19 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chrono>
+#include <future>
 #include <memory>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
 #include <fs.h>
 #include <test/util/setup_common.h>
 #include <wallet/bdb.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 
 
 BOOST_FIXTURE_TEST_SUITE(db_tests, BasicTestingSetup)
@@ -69,4 +75,87 @@ BOOST_AUTO_TEST_CASE(getwalletenv_g_dbenvs_free_instance)
     BOOST_CHECK(env_2_a == env_2_b);
 }
 
+#ifdef USE_SQLITE
+BOOST_AUTO_TEST_CASE(sqlite_group_commit)
+{
+    const fs::path dir = GetDataDir() / "sqlite_group_commit";
+    // Use an interval long enough that the group transaction never expires during the test
+    SQLiteDatabase db(dir, dir / "wallet.dat", /* mock */ false, /* commit_interval */ 60 * 60 * 1000);
+    BOOST_CHECK(fs::exists(dir / "wallet.dat-wal"));
+
+    WalletDatabaseStats stats;
+    {
+        std::unique_ptr<DatabaseBatch> batch = db.MakeBatch();
+        BOOST_CHECK(batch->Write(std::string("a"), 1));
+        BOOST_CHECK(batch->Write(std::string("b"), 2));
+        // An explicit transaction is nested in the group and can be aborted on its own
+        BOOST_CHECK(batch->TxnBegin());
+        BOOST_CHECK(batch->Write(std::string("c"), 3));
+        BOOST_CHECK(batch->TxnAbort());
+    }
+    BOOST_CHECK(db.GetStats(stats));
+    BOOST_CHECK_EQUAL(stats.writes, 3U);
+    BOOST_CHECK_EQUAL(stats.commits, 0U);
+
+    BOOST_CHECK(!db.CommitPending(/* expired_only */ true));
+    BOOST_CHECK(db.CommitPending());
+    BOOST_CHECK(!db.CommitPending());
+    BOOST_CHECK(db.GetStats(stats));
+    BOOST_CHECK_EQUAL(stats.commits, 1U);
+    BOOST_CHECK_EQUAL(stats.pending_writes, 0U);
+
+    std::unique_ptr<DatabaseBatch> batch = db.MakeBatch();
+    int value;
+    BOOST_CHECK(batch->Read(std::string("a"), value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(batch->Read(std::string("b"), value));
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_CHECK(!batch->Exists(std::string("c")));
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_batch_transactions)
+{
+    for (const int64_t commit_interval : {int64_t{0}, int64_t{60 * 60 * 1000}}) {
+        const fs::path dir = GetDataDir() / strprintf("sqlite_batch_transactions_%d", commit_interval);
+        SQLiteDatabase db(dir, dir / "wallet.dat", /* mock */ false, commit_interval);
+        std::unique_ptr<DatabaseBatch> batch1 = db.MakeBatch();
+        std::unique_ptr<DatabaseBatch> batch2 = db.MakeBatch();
+        BOOST_CHECK(batch1->Write(std::string("a"), 1));
+
+        // Transactions of two batches on the same thread nest, and aborting
+        // the inner one only discards its own writes
+        BOOST_CHECK(batch1->TxnBegin());
+        BOOST_CHECK(batch1->Write(std::string("b"), 2));
+        BOOST_CHECK(batch2->TxnBegin());
+        BOOST_CHECK(batch2->Write(std::string("c"), 3));
+        BOOST_CHECK(batch2->TxnAbort());
+        BOOST_CHECK(batch1->Exists(std::string("b")));
+        BOOST_CHECK(!batch1->Exists(std::string("c")));
+
+        // A write from another thread waits for the open transaction, and
+        // is not discarded when it is aborted
+        std::promise<void> writer_started;
+        std::promise<bool> writer_done;
+        std::future<bool> write_result = writer_done.get_future();
+        std::thread writer([&] {
+            std::unique_ptr<DatabaseBatch> batch3 = db.MakeBatch();
+            writer_started.set_value();
+            writer_done.set_value(batch3->Write(std::string("d"), 4));
+        });
+        writer_started.get_future().wait();
+        // The write cannot finish while the transaction is open, however long we wait for it
+        BOOST_CHECK(write_result.wait_for(std::chrono::milliseconds{100}) == std::future_status::timeout);
+        BOOST_CHECK(batch1->TxnAbort());
+        BOOST_CHECK(write_result.get());
+        writer.join();
+
+        BOOST_CHECK(db.CommitPending() == (commit_interval > 0));
+        BOOST_CHECK(batch1->Exists(std::string("a")));
+        BOOST_CHECK(!batch1->Exists(std::string("b")));
+        BOOST_CHECK(!batch1->Exists(std::string("c")));
+        BOOST_CHECK(batch1->Exists(std::string("d")));
+    }
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,8 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <key.h>
+#include <script/descriptor.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
+#include <util/strencodings.h>
 #include <wallet/scriptpubkeyman.h>
 #include <wallet/wallet.h>
 
@@ -40,4 +42,70 @@ BOOST_AUTO_TEST_CASE(CanProvide)
     BOOST_CHECK(keyman.CanProvide(p2sh_script, data));
 }
 
+// Test that CWallet::IsMine finds descriptor scripts through the wallet's
+// scriptPubKey index, also after the descriptor has been replaced.
+BOOST_AUTO_TEST_CASE(DescriptorIsMineIndex)
+{
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), "", CreateDummyWalletDatabase());
+    LOCK(wallet.cs_wallet);
+    wallet.SetWalletFlag(WALLET_FLAG_DESCRIPTORS);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CKey other_key;
+    other_key.MakeNewKey(true);
+    const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const CScript other_script = GetScriptForDestination(PKHash(other_key.GetPubKey()));
+    const std::string desc_str = "pkh(" + HexStr(key.GetPubKey()) + ")";
+
+    for (int i = 0; i < 2; ++i) {
+        FlatSigningProvider keys;
+        std::string error;
+        WalletDescriptor w_desc(Parse(desc_str, keys, error, false), 0, 0, 0, 0);
+        BOOST_CHECK(wallet.AddWalletDescriptor(w_desc, keys, "", false));
+        BOOST_CHECK_EQUAL(wallet.IsMine(script), ISMINE_SPENDABLE);
+        BOOST_CHECK_EQUAL(wallet.IsMine(other_script), ISMINE_NO);
+    }
+}
+
+// Test that a keypool top-up derives the same HD keys, with the same key
+// paths, as deriving them one at a time from the seed.
+BOOST_AUTO_TEST_CASE(LegacyHDTopUp)
+{
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), "", CreateDummyWalletDatabase());
+    LOCK(wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_LATEST);
+    LegacyScriptPubKeyMan& keyman = *wallet.GetOrCreateLegacyScriptPubKeyMan();
+
+    CKey seed;
+    seed.MakeNewKey(true);
+    keyman.SetHDSeed(keyman.DeriveNewSeed(seed));
+    BOOST_CHECK(keyman.NeedsTopUp(1));
+    BOOST_CHECK(keyman.TopUp(50));
+    BOOST_CHECK(!keyman.NeedsTopUp(50));
+    BOOST_CHECK(keyman.NeedsTopUp(51));
+    BOOST_CHECK_EQUAL(keyman.GetKeyPoolSize(), 100U);
+    BOOST_CHECK_EQUAL(keyman.GetHDChain().nExternalChainCounter, 50U);
+    BOOST_CHECK_EQUAL(keyman.GetHDChain().nInternalChainCounter, 50U);
+
+    CExtKey master_key;
+    master_key.SetSeed(seed.begin(), seed.size());
+    LOCK(keyman.cs_KeyStore);
+    for (uint32_t chain_index : {0, 1}) {
+        for (uint32_t i = 0; i < 50; ++i) {
+            CExtKey account_key, chain_key, child_key;
+            master_key.Derive(account_key, 0x80000000);
+            account_key.Derive(chain_key, chain_index | 0x80000000);
+            chain_key.Derive(child_key, i | 0x80000000);
+            const CKeyID id = child_key.key.GetPubKey().GetID();
+            BOOST_CHECK(keyman.HaveKey(id));
+            BOOST_CHECK_EQUAL(keyman.mapKeyMetadata.at(id).hdKeypath, strprintf("m/0'/%u'/%u'", chain_index, i));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
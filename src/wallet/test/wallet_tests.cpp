@@ -4,12 +4,15 @@
 
 #include <wallet/wallet.h>
 
+#include <algorithm>
 #include <future>
 #include <memory>
+#include <set>
 #include <stdint.h>
 #include <vector>
 
 #include <interfaces/chain.h>
+#include <interfaces/wallet.h>
 #include <node/context.h>
 #include <policy/policy.h>
 #include <rpc/server.h>
@@ -350,12 +353,9 @@ static int64_t AddTx(ChainstateManager& chainman, CWallet& wallet, uint32_t lock
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
         LOCK(cs_main);
-        auto inserted = chainman.BlockIndex().emplace(GetRandHash(), new CBlockIndex);
-        assert(inserted.second);
-        const uint256& hash = inserted.first->first;
-        block = inserted.first->second;
+        block = chainman.m_blockman.InsertBlockIndex(GetRandHash());
+        const uint256& hash = block->GetBlockHash();
         block->nTime = blockTime;
-        block->phashBlock = &hash;
         confirm = {CWalletTx::Status::CONFIRMED, block->nHeight, hash, 0};
     }
 
@@ -610,6 +610,84 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+BOOST_FIXTURE_TEST_CASE(AvailableCoinsUnspentIndex, ListCoinsTestingSetup)
+{
+    {
+        LOCK(wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(available);
+        BOOST_CHECK_EQUAL(available.size(), 1U);
+    }
+
+    // Spend the only coin in a transaction that is neither mined nor in the
+    // mempool. The coin is no longer available.
+    CTransactionRef tx;
+    CAmount fee;
+    int changePos = -1;
+    bilingual_str error;
+    CCoinControl dummy;
+    FeeCalculation fee_calc_out;
+    BOOST_CHECK(wallet->CreateTransaction({CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */}}, tx, fee, changePos, error, dummy, fee_calc_out));
+    wallet->CommitTransaction(tx, {}, {});
+    {
+        LOCK(wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(available, false /* fOnlySafe */);
+        BOOST_CHECK_EQUAL(available.size(), 0U);
+    }
+
+    // Abandoning the spender must make the coin available again.
+    BOOST_CHECK(wallet->AbandonTransaction(tx->GetHash()));
+    {
+        LOCK(wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(available);
+        BOOST_CHECK_EQUAL(available.size(), 1U);
+        BOOST_CHECK(available[0].tx->GetHash() != tx->GetHash());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(ArchiveStakeHistory, ListCoinsTestingSetup)
+{
+    // Spend the only mature coinbase in a mined transaction
+    const CWalletTx& spender = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    const int spender_height = spender.m_confirm.block_height;
+    const uint256 coinbase_hash = spender.tx->vin[0].prevout.hash;
+    const uint256 spender_hash = spender.GetHash();
+
+    LOCK(wallet->cs_wallet);
+    const CAmount balance = wallet->GetBalance().m_mine_trusted;
+    const size_t num_txs = wallet->mapWallet.size();
+    const CAmount spender_debit = spender.GetDebit(ISMINE_SPENDABLE);
+    BOOST_CHECK(spender_debit > 0);
+    BOOST_CHECK(wallet->mapWallet.at(coinbase_hash).IsCoinBase());
+    auto buried_at = [](int max_height) {
+        return [max_height](const CWalletTx& wtx) { return wtx.m_confirm.block_height <= max_height; };
+    };
+
+    // The coinbase is kept while its spender is not buried
+    BOOST_CHECK_EQUAL(wallet->ArchiveStakeHistory(buried_at(spender_height - 1)), 0);
+    BOOST_CHECK_EQUAL(wallet->mapWallet.size(), num_txs);
+
+    BOOST_CHECK_EQUAL(wallet->ArchiveStakeHistory(buried_at(spender_height)), 1);
+    BOOST_CHECK_EQUAL(wallet->mapWallet.size(), num_txs - 1);
+    BOOST_CHECK(!wallet->mapWallet.count(coinbase_hash));
+    BOOST_CHECK_EQUAL(wallet->GetBalance().m_mine_trusted, balance);
+    BOOST_CHECK_EQUAL(wallet->m_archived_txs.size(), 1U);
+
+    // The spender still knows what it spent, and the coinbase can be read back
+    BOOST_CHECK_EQUAL(wallet->mapWallet.at(spender_hash).GetDebit(ISMINE_SPENDABLE), spender_debit);
+    BOOST_CHECK(wallet->mapWallet.at(spender_hash).IsFromMe(ISMINE_SPENDABLE));
+    std::unique_ptr<CWalletTx> archived = wallet->GetArchivedTx(coinbase_hash);
+    BOOST_REQUIRE(archived);
+    BOOST_CHECK(archived->GetHash() == coinbase_hash);
+    BOOST_CHECK(archived->isConfirmed());
+    BOOST_CHECK(!wallet->GetArchivedTx(spender_hash));
+
+    // Unspent coinbases are never archived
+    BOOST_CHECK_EQUAL(wallet->ArchiveStakeHistory(buried_at(::ChainActive().Height())), 0);
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     NodeContext node;
@@ -800,6 +878,91 @@ BOOST_FIXTURE_TEST_CASE(CreateWallet, TestChain100Setup)
     TestUnloadWallet(std::move(wallet));
 }
 
+BOOST_FIXTURE_TEST_CASE(LoadWalletTransactions, BasicTestingSetup)
+{
+    // Write a chain of transactions, each spending the previous one, with
+    // enough records for the loader to split decoding across threads.
+    CWallet wallet(nullptr /* chain */, "", CreateMockWalletDatabase());
+    const unsigned int num_txs = 2 * MIN_WALLET_LOAD_TXS_PER_THREAD + 1;
+    std::vector<uint256> hashes;
+    {
+        WalletBatch batch(wallet.GetDatabase());
+        uint256 prev_hash;
+        for (unsigned int i = 0; i < num_txs; ++i) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            mtx.vin.emplace_back(COutPoint(prev_hash, 0));
+            mtx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+            CWalletTx wtx(&wallet, MakeTransactionRef(std::move(mtx)));
+            wtx.nOrderPos = i;
+            BOOST_CHECK(batch.WriteTx(wtx));
+            prev_hash = wtx.GetHash();
+            hashes.push_back(prev_hash);
+        }
+    }
+
+    bool first_run;
+    BOOST_CHECK(wallet.LoadWallet(first_run) == DBErrors::LOAD_OK);
+    LOCK(wallet.cs_wallet);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), num_txs);
+    BOOST_CHECK_EQUAL(wallet.wtxOrdered.size(), num_txs);
+    for (unsigned int i = 0; i + 1 < num_txs; ++i) {
+        BOOST_CHECK(wallet.HasWalletSpend(hashes[i]));
+        BOOST_CHECK(wallet.IsSpent(hashes[i], 0));
+    }
+    BOOST_CHECK(!wallet.HasWalletSpend(hashes.back()));
+}
+
+BOOST_FIXTURE_TEST_CASE(GetWalletTxsPage, BasicTestingSetup)
+{
+    // Transactions can share an order position, e.g. when the wallet was
+    // reordered by an old version, so pages have to continue within one
+    const std::vector<int64_t> order_positions{0, 1, 1, 1, 2, 2, 3};
+    auto wallet = std::make_shared<CWallet>(nullptr /* chain */, "", CreateMockWalletDatabase());
+    {
+        WalletBatch batch(wallet->GetDatabase());
+        for (size_t i = 0; i < order_positions.size(); ++i) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            mtx.vin.emplace_back(COutPoint(uint256(), 0));
+            mtx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+            CWalletTx wtx(wallet.get(), MakeTransactionRef(std::move(mtx)));
+            wtx.nOrderPos = order_positions[i];
+            BOOST_CHECK(batch.WriteTx(wtx));
+        }
+    }
+    bool first_run;
+    BOOST_CHECK(wallet->LoadWallet(first_run) == DBErrors::LOAD_OK);
+    std::unique_ptr<interfaces::Wallet> wallet_interface = interfaces::MakeWallet(wallet);
+
+    for (const size_t page_size : {size_t{1}, size_t{2}, size_t{3}, order_positions.size()}) {
+        interfaces::WalletTxsPagePos pos;
+        std::set<uint256> hashes;
+        std::vector<int64_t> positions;
+        size_t pages = 0;
+        while (!pos.end) {
+            BOOST_REQUIRE(++pages <= order_positions.size());
+            for (const interfaces::WalletTx& wtx : wallet_interface->getWalletTxsPage(pos, page_size, {})) {
+                BOOST_CHECK(hashes.insert(wtx.tx->GetHash()).second);
+                positions.push_back(WITH_LOCK(wallet->cs_wallet, return wallet->mapWallet.at(wtx.tx->GetHash()).nOrderPos));
+            }
+        }
+        BOOST_CHECK_EQUAL(hashes.size(), order_positions.size());
+        BOOST_CHECK(std::is_sorted(positions.rbegin(), positions.rend()));
+        // Nothing is left once the end is reached
+        BOOST_CHECK(wallet_interface->getWalletTxsPage(pos, page_size, {}).empty());
+    }
+
+    // The time range is checked by the wallet, so a page can come back short
+    interfaces::WalletTxsPagePos pos;
+    interfaces::WalletTxsPageFilter filter;
+    filter.time_to = -1;
+    BOOST_CHECK(wallet_interface->getWalletTxsPage(pos, order_positions.size() - 1, filter).empty());
+    BOOST_CHECK(!pos.end);
+    BOOST_CHECK(wallet_interface->getWalletTxsPage(pos, order_positions.size(), filter).empty());
+    BOOST_CHECK(pos.end);
+}
+
 BOOST_FIXTURE_TEST_CASE(ZapSelectTx, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain(m_node);
@@ -37,6 +37,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <limits>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -545,13 +546,13 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     {
         const uint256& wtxid = it->second;
         std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(wtxid);
-        if (mit != mapWallet.end()) {
-            int depth = mit->second.GetDepthInMainChain();
-            if (depth > 0  || (depth == 0 && !mit->second.isAbandoned()))
-                return true; // Spent
+        // Same as depth > 0 || (depth == 0 && !abandoned), but without asking
+        // for the tip height, which is not known yet while the wallet loads
+        if (mit != mapWallet.end() && !mit->second.isConflicted() && !mit->second.isAbandoned()) {
+            return true; // Spent
         }
     }
-    return false;
+    return m_archived_spends.count(outpoint) > 0;
 }
 
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
@@ -563,6 +564,8 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+
+    UpdateUnspentOutput(outpoint);
 }
 
 
@@ -571,6 +574,7 @@ void CWallet::AddToSpends(const uint256& wtxid)
     auto it = mapWallet.find(wtxid);
     assert(it != mapWallet.end());
     CWalletTx& thisTx = it->second;
+    UpdateUnspentOutputs(thisTx);
     if (thisTx.IsCoinBase()) // Coinbases don't spend anything!
         return;
 
@@ -578,6 +582,36 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::UpdateUnspentOutput(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    auto it = mapWallet.find(outpoint.hash);
+    if (it != mapWallet.end() && it->second.tx && outpoint.n < it->second.tx->vout.size() &&
+        !IsSpent(outpoint.hash, outpoint.n) && IsMine(it->second.tx->vout[outpoint.n]) != ISMINE_NO) {
+        m_unspent_outputs.insert(outpoint);
+    } else {
+        m_unspent_outputs.erase(outpoint);
+    }
+}
+
+void CWallet::UpdateUnspentOutputs(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (!wtx.tx) return;
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        UpdateUnspentOutput(COutPoint(wtx.GetHash(), i));
+    }
+}
+
+void CWallet::RebuildUnspentOutputs()
+{
+    AssertLockHeld(cs_wallet);
+    m_unspent_outputs.clear();
+    for (const auto& entry : mapWallet) {
+        UpdateUnspentOutputs(entry.second);
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -615,6 +649,12 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
     {
         LOCK(cs_wallet);
         mapMasterKeys[++nMasterKeyMaxID] = kMasterKey;
+        // Wallet locks must be taken before the database write lock held by
+        // the transaction, so lock the keys of every ScriptPubKeyMan first.
+        std::vector<std::unique_ptr<UniqueLock<RecursiveMutex>>> keys_locks;
+        for (const auto& spk_man_pair : m_spk_managers) {
+            keys_locks.push_back(MakeUnique<UniqueLock<RecursiveMutex>>(spk_man_pair.second->GetKeysMutex(), "spk_man->GetKeysMutex()", __FILE__, __LINE__));
+        }
         WalletBatch* encrypted_batch = new WalletBatch(*database);
         if (!encrypted_batch->TxnBegin()) {
             delete encrypted_batch;
@@ -648,6 +688,7 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 
         delete encrypted_batch;
         encrypted_batch = nullptr;
+        keys_locks.clear();
 
         Lock();
         Unlock(strWalletPassphrase);
@@ -755,6 +796,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        // IsMine may have changed for any output (e.g. after an import)
+        RebuildUnspentOutputs();
     }
 }
 
@@ -874,6 +917,9 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const CWalletTx::Confirmatio
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
+        if (!m_archived_txs.empty() && (tx->IsCoinStake() || tx->IsCoinBase())) {
+            ForgetArchivedTx(batch, hash);
+        }
     }
 
     if (!fInsertedNew)
@@ -902,6 +948,7 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const CWalletTx::Confirmatio
             wtx.SetTx(tx);
             fUpdated = true;
         }
+        UpdateUnspentOutputs(wtx);
     }
 
     //// debug print
@@ -941,7 +988,7 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const CWalletTx::Confirmatio
     return &wtx;
 }
 
-bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx)
+bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx, bool link)
 {
     const auto& ins = mapWallet.emplace(std::piecewise_construct, std::forward_as_tuple(hash), std::forward_as_tuple(this, nullptr));
     CWalletTx& wtx = ins.first->second;
@@ -971,6 +1018,16 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
     if (/* insertion took place */ ins.second) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
+    if (link) {
+        LinkLoadedTx(hash);
+    }
+    return true;
+}
+
+void CWallet::LinkLoadedTx(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    const CWalletTx& wtx = mapWallet.at(hash);
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
@@ -981,7 +1038,6 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
             }
         }
     }
-    return true;
 }
 
 bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, CWalletTx::Confirmation confirm, bool fUpdate)
@@ -1041,6 +1097,7 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            UpdateUnspentOutput(txin.prevout);
         }
     }
 }
@@ -1221,6 +1278,9 @@ void CWallet::blockConnected(const CBlock& block, int height)
         SyncTransaction(block.vtx[index], {CWalletTx::Status::CONFIRMED, height, block_hash, (int)index});
         transactionRemovedFromMempool(block.vtx[index], MemPoolRemovalReason::BLOCK, 0 /* mempool_sequence */);
     }
+    if (height % STAKE_ARCHIVE_INTERVAL == 0) PruneStakeHistory();
+    // Block boundaries are durability points for grouped writes
+    GetDatabase().CommitPending();
 }
 
 void CWallet::blockDisconnected(const CBlock& block, int height)
@@ -1236,6 +1296,7 @@ void CWallet::blockDisconnected(const CBlock& block, int height)
     for (const CTransactionRef& ptx : block.vtx) {
         SyncTransaction(ptx, {CWalletTx::Status::UNCONFIRMED, /* block height */ 0, /* block hash */ {}, /* index */ 0});
     }
+    GetDatabase().CommitPending();
 }
 
 void CWallet::updatedBlockTip()
@@ -1265,6 +1326,8 @@ isminetype CWallet::IsMine(const CTxIn &txin) const
         if (txin.prevout.n < prev.tx->vout.size())
             return IsMine(prev.tx->vout[txin.prevout.n]);
     }
+    const auto archived = m_archived_outputs.find(txin.prevout);
+    if (archived != m_archived_outputs.end()) return IsMine(archived->second);
     return ISMINE_NO;
 }
 
@@ -1282,6 +1345,10 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
                 if (IsMine(prev.tx->vout[txin.prevout.n]) & filter)
                     return prev.tx->vout[txin.prevout.n].nValue;
         }
+        const auto archived = m_archived_outputs.find(txin.prevout);
+        if (archived != m_archived_outputs.end() && (IsMine(archived->second) & filter)) {
+            return archived->second.nValue;
+        }
     }
     return 0;
 }
@@ -1302,6 +1369,14 @@ isminetype CWallet::IsMine(const CScript& script) const
 {
     AssertLockHeld(cs_wallet);
     isminetype result = ISMINE_NO;
+    // All ScriptPubKeyMans of a descriptor wallet index their scripts, so only
+    // the ones with a matching fingerprint have to compare the full script
+    if (m_use_script_pub_key_set && IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS)) {
+        for (const ScriptPubKeyMan* spk_man : m_script_pub_key_set.GetCandidates(StripAdditionalTransactionData(script))) {
+            result = std::max(result, spk_man->IsMine(script));
+        }
+        return result;
+    }
     for (const auto& spk_man_pair : m_spk_managers) {
         result = std::max(result, spk_man_pair.second->IsMine(script));
     }
@@ -1384,8 +1459,11 @@ bool CWallet::IsAllFromMe(const CTransaction& tx, const isminefilter& filter) co
     for (const CTxIn& txin : tx.vin)
     {
         auto mi = mapWallet.find(txin.prevout.hash);
-        if (mi == mapWallet.end())
+        if (mi == mapWallet.end()) {
+            const auto archived = m_archived_outputs.find(txin.prevout);
+            if (archived != m_archived_outputs.end() && (IsMine(archived->second) & filter)) continue;
             return false; // any unknown inputs can't be from us
+        }
 
         const CWalletTx& prev = (*mi).second;
 
@@ -2062,11 +2140,12 @@ bool CWalletTx::IsTrusted() const
 bool CWallet::IsTrusted(const CWalletTx& wtx, std::set<uint256>& trusted_parents) const
 {
     AssertLockHeld(cs_wallet);
-    // Quick answer in most cases
-    if (!chain().checkFinalTx(*wtx.tx)) return false;
+    // Quick answer in most cases. Transactions confirmed in the active chain
+    // are final, so only unconfirmed ones need the cs_main finality check.
     int nDepth = wtx.GetDepthInMainChain();
     if (nDepth >= 1) return true;
     if (nDepth < 0) return false;
+    if (!chain().checkFinalTx(*wtx.tx)) return false;
     // using wtx's cached debit
     if (!m_spend_zero_conf_change || !wtx.IsFromMe(ISMINE_ALL)) return false;
 
@@ -2154,6 +2233,13 @@ void MaybeResendWalletTxs()
     }
 }
 
+void MaybeTopUpKeyPools()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
+        pwallet->MaybeTopUpKeyPool();
+    }
+}
+
 
 /** @defgroup Actions
  *
@@ -2218,18 +2304,22 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
     const int max_depth = {coinControl ? coinControl->m_max_depth : DEFAULT_MAX_DEPTH};
 
     std::set<uint256> trusted_parents;
-    for (const auto& entry : mapWallet)
+    // Walk the unspent output index one transaction at a time rather than
+    // every output of every wallet transaction. Outputs of the same
+    // transaction are adjacent in the set.
+    for (auto group_begin = m_unspent_outputs.begin(), group_end = group_begin; group_begin != m_unspent_outputs.end(); group_begin = group_end)
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
+        const uint256 wtxid = group_begin->hash;
+        group_end = m_unspent_outputs.upper_bound(COutPoint(wtxid, std::numeric_limits<uint32_t>::max()));
 
-        if (!chain().checkFinalTx(*wtx.tx)) {
+        const auto entry = mapWallet.find(wtxid);
+        if (entry == mapWallet.end()) {
             continue;
         }
+        const CWalletTx& wtx = entry->second;
 
-        if ((!fOnlyImmature && wtx.IsImmatureCoinBase()) || (fOnlyImmature && !wtx.IsImmatureCoinBase()))
-            continue;
-
+        // Depth is derived from the last processed block height and does not
+        // need cs_main.
         int nDepth = wtx.GetDepthInMainChain();
         if (nDepth < 0)
             continue;
@@ -2239,6 +2329,15 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
         if (nDepth == 0 && !wtx.InMempool())
             continue;
 
+        // Transactions confirmed in the active chain are final, so only ask
+        // the chain (and take cs_main) for the unconfirmed ones.
+        if (nDepth == 0 && !chain().checkFinalTx(*wtx.tx)) {
+            continue;
+        }
+
+        if ((!fOnlyImmature && wtx.IsImmatureCoinBase()) || (fOnlyImmature && !wtx.IsImmatureCoinBase()))
+            continue;
+
         bool safeTx = IsTrusted(wtx, trusted_parents);
 
         // We should not consider coins from transactions that are replacing
@@ -2280,19 +2379,21 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
             continue;
         }
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        for (auto output = group_begin; output != group_end; ++output) {
+            const unsigned int i = output->n;
+
             // Only consider selected coins if add_inputs is false
-            if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(COutPoint(entry.first, i))) {
+            if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(*output)) {
                 continue;
             }
 
             if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(*output))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
             if (IsSpent(wtxid, i))
@@ -2591,10 +2692,13 @@ TransactionError CWallet::FillPSBT(PartiallySignedTransaction& psbtx, bool& comp
         }
     }
 
+    // The sighash midstates only depend on the unsigned transaction and the UTXOs, share them between ScriptPubKeyMans
+    const PrecomputedTransactionData txdata = PrecomputePSBTData(psbtx);
+
     // Fill in information from ScriptPubKeyMans
     for (ScriptPubKeyMan* spk_man : GetAllScriptPubKeyMans()) {
         int n_signed_this_spkm = 0;
-        TransactionError res = spk_man->FillPSBT(psbtx, sighash_type, sign, bip32derivs, &n_signed_this_spkm);
+        TransactionError res = spk_man->FillPSBT(psbtx, txdata, sighash_type, sign, bip32derivs, &n_signed_this_spkm);
         if (res != TransactionError::OK) {
             return res;
         }
@@ -3223,6 +3327,10 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         }
     }
 
+    // Transaction records may have been read before the keys that make their
+    // outputs ours, so evaluate the unspent set once everything is loaded.
+    RebuildUnspentOutputs();
+
     // This wallet is in its first run if there are no ScriptPubKeyMans and it isn't blank or no privkeys
     fFirstRunRet = m_spk_managers.empty() && !IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS) && !IsWalletFlagSet(WALLET_FLAG_BLANK_WALLET);
     if (fFirstRunRet) {
@@ -3267,6 +3375,189 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     return DBErrors::LOAD_OK;
 }
 
+void CWallet::LoadArchivedSpend(const COutPoint& outpoint, const uint256& spender)
+{
+    AssertLockHeld(cs_wallet);
+    m_archived_spends[outpoint] = spender;
+}
+
+void CWallet::LoadArchivedOutput(const COutPoint& outpoint, const CTxOut& txout)
+{
+    AssertLockHeld(cs_wallet);
+    m_archived_outputs[outpoint] = txout;
+}
+
+void CWallet::LoadArchivedTx(int64_t order_pos, const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    m_archived_txs.emplace(order_pos, hash);
+}
+
+std::unique_ptr<CWalletTx> CWallet::GetArchivedTx(const uint256& hash) const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_archived_txs.empty()) return nullptr;
+
+    auto wtx = MakeUnique<CWalletTx>(this, nullptr);
+    ArchivedTxHeader header;
+    if (!WalletBatch(*database).ReadArchivedTx(hash, header, *wtx)) return nullptr;
+    // The transactions it spends may be archived as well, so its debits cannot be recomputed
+    wtx->m_amounts[CWalletTx::DEBIT].Set(ISMINE_SPENDABLE, header.debit_mine);
+    wtx->m_amounts[CWalletTx::DEBIT].Set(ISMINE_WATCH_ONLY, header.debit_watchonly);
+    wtx->m_is_cache_empty = false;
+    if (HaveChain()) {
+        // As in LoadToWallet, the block height is not part of the record
+        Optional<int> block_height = chain().getBlockHeight(wtx->m_confirm.hashBlock);
+        if (block_height) wtx->m_confirm.block_height = *block_height;
+    }
+    return wtx;
+}
+
+void CWallet::ForgetArchivedTx(WalletBatch& batch, const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    ArchivedTxHeader header;
+    if (!batch.ReadArchivedTxHeader(hash, header)) return;
+    batch.EraseArchivedTx(hash);
+    const auto range = m_archived_txs.equal_range(header.order_pos);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == hash) {
+            m_archived_txs.erase(it);
+            break;
+        }
+    }
+}
+
+void CWallet::PruneStakeHistory()
+{
+    AssertLockHeld(cs_wallet);
+    if (!m_prune_stake_history) return;
+    const int depth = m_stake_archive_depth;
+    ArchiveStakeHistory([depth](const CWalletTx& wtx) { return wtx.GetDepthInMainChain() > depth; });
+}
+
+int CWallet::ArchiveStakeHistory(const std::function<bool(const CWalletTx& wtx)>& is_buried)
+{
+    AssertLockHeld(cs_wallet);
+
+    auto spent_buried = [&](const COutPoint& outpoint) {
+        if (m_archived_spends.count(outpoint)) return true;
+        const auto range = mapTxSpends.equal_range(outpoint);
+        for (auto it = range.first; it != range.second; ++it) {
+            const auto mit = mapWallet.find(it->second);
+            if (mit != mapWallet.end() && mit->second.isConfirmed() && is_buried(mit->second)) return true;
+        }
+        return false;
+    };
+
+    std::vector<const CWalletTx*> candidates;
+    for (const auto& entry : mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        if (!(wtx.IsCoinStake() || wtx.IsCoinBase()) || !wtx.isConfirmed() || !is_buried(wtx)) continue;
+        bool spent = true;
+        for (unsigned int i = 0; i < wtx.tx->vout.size() && spent; ++i) {
+            if (IsMine(wtx.tx->vout[i]) != ISMINE_NO) spent = spent_buried(COutPoint(wtx.GetHash(), i));
+        }
+        if (spent) candidates.push_back(&wtx);
+    }
+    if (candidates.empty()) return 0;
+
+    std::set<uint256> archived;
+    for (const CWalletTx* wtx : candidates) archived.insert(wtx->GetHash());
+
+    // Debits and IsMine take the ScriptPubKeyMan locks, which must not be
+    // taken once the database transaction holds the write lock
+    std::vector<ArchivedTxHeader> headers(candidates.size());
+    std::vector<std::vector<bool>> outputs_mine(candidates.size());
+    for (size_t n = 0; n < candidates.size(); ++n) {
+        const CWalletTx* wtx = candidates[n];
+        headers[n].order_pos = wtx->nOrderPos;
+        headers[n].debit_mine = wtx->GetDebit(ISMINE_SPENDABLE);
+        headers[n].debit_watchonly = wtx->GetDebit(ISMINE_WATCH_ONLY);
+        for (const CTxOut& txout : wtx->tx->vout) outputs_mine[n].push_back(IsMine(txout) != ISMINE_NO);
+    }
+
+    // Write all records in one database transaction before touching the in-memory state
+    WalletBatch batch(*database);
+    if (!batch.TxnBegin()) return -1;
+    std::vector<std::pair<int64_t, uint256>> new_txs;
+    std::map<COutPoint, uint256> new_spends;
+    std::map<COutPoint, CTxOut> new_outputs;
+    std::set<COutPoint> stale_spends, stale_outputs;
+    bool ok = true;
+    for (size_t n = 0; n < candidates.size(); ++n) {
+        const CWalletTx* wtx = candidates[n];
+        const uint256& hash = wtx->GetHash();
+        const ArchivedTxHeader& header = headers[n];
+        ok = ok && batch.WriteArchivedTx(header, *wtx) && batch.EraseTx(hash);
+        new_txs.emplace_back(header.order_pos, hash);
+        if (!wtx->IsCoinBase()) {
+            for (const CTxIn& txin : wtx->tx->vin) {
+                if (mapWallet.count(txin.prevout.hash) && !archived.count(txin.prevout.hash)) {
+                    ok = ok && batch.WriteArchivedSpend(txin.prevout, hash);
+                    new_spends.emplace(txin.prevout, hash);
+                }
+                // This transaction's debit is in its record, so it no longer needs the output it spends
+                if (m_archived_outputs.count(txin.prevout)) {
+                    ok = ok && batch.EraseArchivedOutput(txin.prevout);
+                    stale_outputs.insert(txin.prevout);
+                }
+            }
+        }
+        for (unsigned int i = 0; i < wtx->tx->vout.size(); ++i) {
+            const COutPoint outpoint(hash, i);
+            // Spends of this transaction's outputs are not needed once it is gone itself
+            if (m_archived_spends.count(outpoint)) {
+                ok = ok && batch.EraseArchivedSpend(outpoint);
+                stale_spends.insert(outpoint);
+            }
+            // Transactions that stay in the wallet still need our outputs for their debits
+            const auto range = mapTxSpends.equal_range(outpoint);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (!archived.count(it->second) && outputs_mine[n][i]) {
+                    ok = ok && batch.WriteArchivedOutput(outpoint, wtx->tx->vout[i]);
+                    new_outputs.emplace(outpoint, wtx->tx->vout[i]);
+                    break;
+                }
+            }
+        }
+        if (!ok) break;
+    }
+    if (!ok || !batch.TxnCommit()) {
+        batch.TxnAbort();
+        WalletLogPrintf("%s: failed to write archived transactions\n", __func__);
+        return -1;
+    }
+
+    for (const COutPoint& outpoint : stale_spends) m_archived_spends.erase(outpoint);
+    for (const COutPoint& outpoint : stale_outputs) m_archived_outputs.erase(outpoint);
+    m_archived_spends.insert(new_spends.begin(), new_spends.end());
+    m_archived_outputs.insert(new_outputs.begin(), new_outputs.end());
+    m_archived_txs.insert(new_txs.begin(), new_txs.end());
+    for (const uint256& hash : archived) {
+        auto it = mapWallet.find(hash);
+        wtxOrdered.erase(it->second.m_it_wtxOrdered);
+        if (!it->second.IsCoinBase()) {
+            for (const CTxIn& txin : it->second.tx->vin) {
+                auto range = mapTxSpends.equal_range(txin.prevout);
+                for (auto sit = range.first; sit != range.second;) {
+                    sit = sit->second == hash ? mapTxSpends.erase(sit) : std::next(sit);
+                }
+            }
+        }
+        auto sit = mapTxSpends.lower_bound(COutPoint(hash, 0));
+        while (sit != mapTxSpends.end() && sit->first.hash == hash) sit = mapTxSpends.erase(sit);
+        auto uit = m_unspent_outputs.lower_bound(COutPoint(hash, 0));
+        while (uit != m_unspent_outputs.end() && uit->hash == hash) uit = m_unspent_outputs.erase(uit);
+        mapWallet.erase(it);
+        NotifyTransactionChanged(this, hash, CT_DELETED);
+    }
+    MarkDirty();
+
+    WalletLogPrintf("Archived %u spent coinstake and coinbase transactions\n", archived.size());
+    return archived.size();
+}
+
 bool CWallet::SetAddressBookWithDB(WalletBatch& batch, const CTxDestination& address, const std::string& strName, const std::string& strPurpose)
 {
     bool fUpdated = false;
@@ -3355,6 +3646,21 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
     return res;
 }
 
+void CWallet::MaybeTopUpKeyPool()
+{
+    // A watermark above the pool size would keep the pool below it forever
+    const int64_t keypool_size = std::max(gArgs.GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 1);
+    const unsigned int watermark = std::min(std::max(gArgs.GetArg("-keypoolwatermark", DEFAULT_KEYPOOL_WATERMARK), (int64_t) 0), keypool_size);
+
+    LOCK(cs_wallet);
+    if (IsLocked()) return;
+    for (auto spk_man : GetActiveScriptPubKeyMans()) {
+        if (spk_man->NeedsTopUp(watermark)) {
+            spk_man->TopUp();
+        }
+    }
+}
+
 bool CWallet::GetNewDestination(const OutputType type, const std::string label, CTxDestination& dest, std::string& error)
 {
     LOCK(cs_wallet);
@@ -3569,7 +3875,11 @@ bool ReserveDestination::GetReservedDestination(CTxDestination& dest, bool inter
 
     if (nIndex == -1)
     {
-        m_spk_man->TopUp();
+        {
+            // TopUp writes in a batch transaction, so the wallet lock it needs comes first
+            LOCK(pwallet->cs_wallet);
+            m_spk_man->TopUp();
+        }
 
         CKeyPool keypool;
         if (!m_spk_man->GetReservedDestination(type, internal, address, nIndex, keypool)) {
@@ -4022,6 +4332,8 @@ std::shared_ptr<CWallet> CWallet::Create(interfaces::Chain& chain, const std::st
     walletInstance->m_confirm_target = gArgs.GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     walletInstance->m_spend_zero_conf_change = gArgs.GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     walletInstance->m_signal_rbf = gArgs.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
+    walletInstance->m_prune_stake_history = gArgs.GetBoolArg("-prunestakehistory", DEFAULT_PRUNE_STAKE_HISTORY);
+    walletInstance->m_stake_archive_depth = std::max<int64_t>(gArgs.GetArg("-stakearchivedepth", DEFAULT_STAKE_ARCHIVE_DEPTH), COINBASE_MATURITY);
 
     walletInstance->WalletLogPrintf("Wallet completed loading in %15dms\n", GetTimeMillis() - nStart);
 
@@ -4116,12 +4428,21 @@ std::shared_ptr<CWallet> CWallet::Create(interfaces::Chain& chain, const std::st
         }
     }
 
+    {
+        LOCK(walletInstance->cs_wallet);
+        if (walletInstance->m_last_block_processed_height >= 0) walletInstance->PruneStakeHistory();
+    }
+
     walletInstance->SetBroadcastTransactions(gArgs.GetBoolArg("-walletbroadcast", DEFAULT_WALLETBROADCAST));
 
     {
         walletInstance->WalletLogPrintf("setKeyPool.size() = %u\n",      walletInstance->GetKeyPoolSize());
         walletInstance->WalletLogPrintf("mapWallet.size() = %u\n",       walletInstance->mapWallet.size());
+        walletInstance->WalletLogPrintf("archived transactions = %u\n",  WITH_LOCK(walletInstance->cs_wallet, return walletInstance->m_archived_txs.size()));
         walletInstance->WalletLogPrintf("m_address_book.size() = %u\n",  walletInstance->m_address_book.size());
+        if (walletInstance->IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS)) {
+            walletInstance->WalletLogPrintf("scriptPubKey index: %u entries, %u kB\n", walletInstance->m_script_pub_key_set.Size(), walletInstance->m_script_pub_key_set.DynamicMemoryUsage() / 1024);
+        }
     }
 
     return walletInstance;
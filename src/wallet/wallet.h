@@ -22,6 +22,7 @@
 #include <wallet/coinselection.h>
 #include <wallet/crypter.h>
 #include <wallet/scriptpubkeyman.h>
+#include <wallet/scriptpubkeyset.h>
 #include <wallet/walletdb.h>
 #include <wallet/walletutil.h>
 
@@ -89,6 +90,12 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! Default for -prunestakehistory
+static const bool DEFAULT_PRUNE_STAKE_HISTORY = false;
+//! Depth below the best known block at which spent coinstakes are archived
+static const int DEFAULT_STAKE_ARCHIVE_DEPTH = 10000;
+//! Blocks between two runs of stake history pruning
+static const int STAKE_ARCHIVE_INTERVAL = 100;
 //! -maxtxfee default
 constexpr CAmount DEFAULT_TRANSACTION_MAXFEE{10 * COIN}; // 10000 * DEFAULT_TRANSACTION_MINFEE
 //! Discourage users to set fees higher than this amount (in satoshis) per kB
@@ -416,14 +423,26 @@ public:
 
     template<typename Stream>
     void Unserialize(Stream& s)
+    {
+        CTransactionRef ptx;
+        s >> ptx;
+        UnserializeAfterTx(s, std::move(ptx));
+    }
+
+    /** Unserialize the wallet metadata that follows the transaction, for a
+     *  transaction that has already been read from the stream (e.g. decoded
+     *  ahead of time by the bulk wallet loader). */
+    template<typename Stream>
+    void UnserializeAfterTx(Stream& s, CTransactionRef ptx)
     {
         Init();
+        tx = std::move(ptx);
 
         std::vector<uint256> dummy_vector1; //!< Used to be vMerkleBranch
         std::vector<CMerkleTx> dummy_vector2; //!< Used to be vtxPrev
         bool dummy_bool; //! Used to be fSpent
         int serializedIndex;
-        s >> tx >> m_confirm.hashBlock >> dummy_vector1 >> serializedIndex >> dummy_vector2 >> mapValue >> vOrderForm >> fTimeReceivedIsTxTime >> nTimeReceived >> fFromMe >> dummy_bool;
+        s >> m_confirm.hashBlock >> dummy_vector1 >> serializedIndex >> dummy_vector2 >> mapValue >> vOrderForm >> fTimeReceivedIsTxTime >> nTimeReceived >> fFromMe >> dummy_bool;
 
         /* At serialization/deserialization, an nIndex == -1 means that hashBlock refers to
          * the earliest block in the chain we know this or any in-wallet ancestor conflicts
@@ -665,6 +684,35 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Outputs of wallet transactions that are ours and not spent by any
+     * non-conflicted, non-abandoned wallet transaction. AvailableCoins walks
+     * this set instead of every output of every transaction in mapWallet.
+     * Membership is re-evaluated whenever a transaction is added, a spender
+     * changes state (MarkInputsDirty) or IsMine may have changed (MarkDirty).
+     */
+    std::set<COutPoint> m_unspent_outputs GUARDED_BY(cs_wallet);
+    void UpdateUnspentOutput(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateUnspentOutputs(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RebuildUnspentOutputs() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Outpoints of wallet transactions that are spent by an archived
+     * transaction, mapped to the spender. The spender is no longer in
+     * mapWallet or mapTxSpends, so IsSpent falls back to this map.
+     */
+    std::map<COutPoint, uint256> m_archived_spends GUARDED_BY(cs_wallet);
+    /**
+     * Our outputs of archived transactions that are spent by transactions
+     * still in mapWallet, so that IsMine and GetDebit work for their inputs.
+     */
+    std::map<COutPoint, CTxOut> m_archived_outputs GUARDED_BY(cs_wallet);
+
+    /** Drop the archived record of a transaction that was added to mapWallet again, e.g. by a rescan. */
+    void ForgetArchivedTx(WalletBatch& batch, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Archive the stake history buried deeper than m_stake_archive_depth, with -prunestakehistory. */
+    void PruneStakeHistory() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -730,6 +778,11 @@ private:
     std::map<OutputType, ScriptPubKeyMan*> m_external_spk_managers;
     std::map<OutputType, ScriptPubKeyMan*> m_internal_spk_managers;
 
+    //! Fingerprints of the scriptPubKeys of all descriptor ScriptPubKeyMans, used to
+    //! skip the ScriptPubKeyMans that cannot own a script in IsMine. Declared before
+    //! m_spk_managers because they unregister themselves when destroyed.
+    ScriptPubKeySet m_script_pub_key_set;
+
     // Indexed by a unique identifier produced by each ScriptPubKeyMan using
     // ScriptPubKeyMan::GetID. In many cases it will be the hash of an internal structure
     std::map<uint256, std::unique_ptr<ScriptPubKeyMan>> m_spk_managers;
@@ -796,6 +849,13 @@ public:
     typedef std::multimap<int64_t, CWalletTx*> TxItems;
     TxItems wtxOrdered;
 
+    /**
+     * Hashes of the transactions moved out of mapWallet by
+     * ArchiveStakeHistory, by order position. Their records are only read
+     * back from the database when asked for (GetArchivedTx).
+     */
+    std::multimap<int64_t, uint256> m_archived_txs GUARDED_BY(cs_wallet);
+
     int64_t nOrderPosNext GUARDED_BY(cs_wallet) = 0;
     uint64_t nAccountingEntryNumber = 0;
 
@@ -912,7 +972,33 @@ public:
     using UpdateWalletTxFn = std::function<bool(CWalletTx& wtx, bool new_tx)>;
 
     CWalletTx* AddToWallet(CTransactionRef tx, const CWalletTx::Confirmation& confirm, const UpdateWalletTxFn& update_wtx=nullptr, bool fFlushOnClose=true);
-    bool LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx, bool link = true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Record a loaded transaction's spends and propagate conflicts from its
+     *  parents. Done by LoadToWallet unless the caller defers it until every
+     *  transaction record has been read. */
+    void LinkLoadedTx(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void LoadArchivedSpend(const COutPoint& outpoint, const uint256& spender) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void LoadArchivedOutput(const COutPoint& outpoint, const CTxOut& txout) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void LoadArchivedTx(int64_t order_pos, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Read an archived transaction back from the database. It is not added to
+     * mapWallet; debits are restored from the archived record.
+     */
+    std::unique_ptr<CWalletTx> GetArchivedTx(const uint256& hash) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Move fully spent coinstake and coinbase transactions out of mapWallet.
+     *
+     * A transaction is archived when is_buried holds for it and every output
+     * that is ours is spent by a transaction for which is_buried holds as
+     * well. Its record is moved to an archived record of the wallet database,
+     * and the outputs of wallet transactions it spends stay marked as spent
+     * through m_archived_spends.
+     *
+     * @return the number of archived transactions, or -1 if the database could not be updated
+     */
+    int ArchiveStakeHistory(const std::function<bool(const CWalletTx& wtx)>& is_buried) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void transactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override;
     void blockConnected(const CBlock& block, int height) override;
     void blockDisconnected(const CBlock& block, int height) override;
@@ -1020,6 +1106,11 @@ public:
     unsigned int m_confirm_target{DEFAULT_TX_CONFIRM_TARGET};
     bool m_spend_zero_conf_change{DEFAULT_SPEND_ZEROCONF_CHANGE};
     bool m_signal_rbf{DEFAULT_WALLET_RBF};
+    bool m_prune_stake_history{DEFAULT_PRUNE_STAKE_HISTORY};
+    int m_stake_archive_depth{DEFAULT_STAKE_ARCHIVE_DEPTH};
+    //! Whether IsMine of a descriptor wallet only asks the ScriptPubKeyMans found in
+    //! m_script_pub_key_set. Only turned off by benchmarks, to compare with asking all of them.
+    bool m_use_script_pub_key_set{true};
     bool m_allow_fallback_fee{true}; //!< will be false if -fallbackfee=0
     CFeeRate m_min_fee{DEFAULT_TRANSACTION_MINFEE}; //!< Override with -mintxfee
     /**
@@ -1043,6 +1134,8 @@ public:
 
     size_t KeypoolCountExternalKeys() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool TopUpKeyPool(unsigned int kpSize = 0);
+    /** Refill the active keypools that have fewer unused keys left than -keypoolwatermark, if the wallet is unlocked */
+    void MaybeTopUpKeyPool();
 
     int64_t GetOldestKeyPoolTime() const;
 
@@ -1247,6 +1340,9 @@ public:
     const CKeyingMaterial& GetEncryptionKey() const override;
     bool HasEncryptionKeys() const override;
 
+    void AddScriptPubKeys(const ScriptPubKeyMan& spk_man, const std::vector<CScript>& scripts) override { m_script_pub_key_set.Add(&spk_man, scripts); }
+    void RemoveScriptPubKeys(const ScriptPubKeyMan& spk_man) override { m_script_pub_key_set.RemoveOwner(&spk_man); }
+
     /** Get last block processed height */
     int GetLastBlockHeight() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet)
     {
@@ -1302,6 +1398,13 @@ public:
  */
 void MaybeResendWalletTxs();
 
+/**
+ * Called periodically by the schedule thread. Refills the keypools of unlocked
+ * wallets before they run low, so that new addresses and coinstake outputs
+ * do not wait for key derivation.
+ */
+void MaybeTopUpKeyPools();
+
 /** RAII object to check and reserve a wallet rescan */
 class WalletRescanReserver
 {
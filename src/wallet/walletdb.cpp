@@ -20,13 +20,18 @@
 #endif
 #include <wallet/wallet.h>
 
+#include <algorithm>
 #include <atomic>
 #include <string>
+#include <thread>
 
 namespace DBKeys {
 const std::string ACENTRY{"acentry"};
 const std::string ACTIVEEXTERNALSPK{"activeexternalspk"};
 const std::string ACTIVEINTERNALSPK{"activeinternalspk"};
+const std::string ARCHIVED_OUTPUT{"archivedoutput"};
+const std::string ARCHIVED_SPEND{"archivedspend"};
+const std::string ARCHIVED_TX{"archivedtx"};
 const std::string BESTBLOCK_NOMERKLE{"bestblock_nomerkle"};
 const std::string BESTBLOCK{"bestblock"};
 const std::string CRYPTED_KEY{"ckey"};
@@ -91,6 +96,58 @@ bool WalletBatch::EraseTx(uint256 hash)
     return EraseIC(std::make_pair(DBKeys::TX, hash));
 }
 
+bool WalletBatch::WriteArchivedTx(const ArchivedTxHeader& header, const CWalletTx& wtx)
+{
+    CDataStream value(SER_DISK, CLIENT_VERSION);
+    value << header << wtx;
+    return WriteIC(std::make_pair(DBKeys::ARCHIVED_TX, wtx.GetHash()), MakeUCharSpan(value));
+}
+
+namespace {
+struct ArchivedTxReader {
+    ArchivedTxHeader& header;
+    CWalletTx& wtx;
+    template <typename Stream>
+    void Unserialize(Stream& s) { s >> header >> wtx; }
+};
+} // namespace
+
+bool WalletBatch::ReadArchivedTx(const uint256& hash, ArchivedTxHeader& header, CWalletTx& wtx)
+{
+    ArchivedTxReader reader{header, wtx};
+    return m_batch->Read(std::make_pair(DBKeys::ARCHIVED_TX, hash), reader);
+}
+
+bool WalletBatch::ReadArchivedTxHeader(const uint256& hash, ArchivedTxHeader& header)
+{
+    return m_batch->Read(std::make_pair(DBKeys::ARCHIVED_TX, hash), header);
+}
+
+bool WalletBatch::EraseArchivedTx(const uint256& hash)
+{
+    return EraseIC(std::make_pair(DBKeys::ARCHIVED_TX, hash));
+}
+
+bool WalletBatch::WriteArchivedOutput(const COutPoint& outpoint, const CTxOut& txout)
+{
+    return WriteIC(std::make_pair(DBKeys::ARCHIVED_OUTPUT, outpoint), txout);
+}
+
+bool WalletBatch::EraseArchivedOutput(const COutPoint& outpoint)
+{
+    return EraseIC(std::make_pair(DBKeys::ARCHIVED_OUTPUT, outpoint));
+}
+
+bool WalletBatch::WriteArchivedSpend(const COutPoint& outpoint, const uint256& spender)
+{
+    return WriteIC(std::make_pair(DBKeys::ARCHIVED_SPEND, outpoint), spender);
+}
+
+bool WalletBatch::EraseArchivedSpend(const COutPoint& outpoint)
+{
+    return EraseIC(std::make_pair(DBKeys::ARCHIVED_SPEND, outpoint));
+}
+
 bool WalletBatch::WriteKeyMetadata(const CKeyMetadata& meta, const CPubKey& pubkey, const bool overwrite)
 {
     return WriteIC(std::make_pair(DBKeys::KEYMETA, pubkey), meta, overwrite);
@@ -252,6 +309,7 @@ public:
     unsigned int nWatchKeys{0};
     unsigned int nKeyMeta{0};
     unsigned int m_unknown_records{0};
+    unsigned int m_archived_txs{0};
     bool fIsEncrypted{false};
     bool fAnyUnordered{false};
     std::vector<uint256> vWalletUpgrade;
@@ -266,6 +324,53 @@ public:
     }
 };
 
+//! Load a "tx" record into the wallet. If ptx is set, the transaction was
+//! already decoded from the front of ssValue and only the wallet metadata is
+//! left to read.
+static bool LoadTxRecord(CWallet* pwallet, const uint256& hash, CDataStream& ssValue, CTransactionRef ptx,
+                         CWalletScanState& wss, std::string& strErr, bool link = true) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    // LoadToWallet call below creates a new CWalletTx that fill_wtx
+    // callback fills with transaction metadata.
+    auto fill_wtx = [&](CWalletTx& wtx, bool new_tx) {
+        assert(new_tx);
+        if (ptx) {
+            wtx.UnserializeAfterTx(ssValue, std::move(ptx));
+        } else {
+            ssValue >> wtx;
+        }
+        if (wtx.GetHash() != hash)
+            return false;
+
+        // Undo serialize changes in 31600
+        if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+        {
+            if (!ssValue.empty())
+            {
+                char fTmp;
+                char fUnused;
+                std::string unused_string;
+                ssValue >> fTmp >> fUnused >> unused_string;
+                strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                                   wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = fTmp;
+            }
+            else
+            {
+                strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = 0;
+            }
+            wss.vWalletUpgrade.push_back(hash);
+        }
+
+        if (wtx.nOrderPos == -1)
+            wss.fAnyUnordered = true;
+
+        return true;
+    };
+    return pwallet->LoadToWallet(hash, fill_wtx, link);
+}
+
 static bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr, const KeyFilterFn& filter_fn = nullptr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
@@ -292,43 +397,33 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         } else if (strType == DBKeys::TX) {
             uint256 hash;
             ssKey >> hash;
-            // LoadToWallet call below creates a new CWalletTx that fill_wtx
-            // callback fills with transaction metadata.
-            auto fill_wtx = [&](CWalletTx& wtx, bool new_tx) {
-                assert(new_tx);
-                ssValue >> wtx;
-                if (wtx.GetHash() != hash)
-                    return false;
-
-                // Undo serialize changes in 31600
-                if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-                {
-                    if (!ssValue.empty())
-                    {
-                        char fTmp;
-                        char fUnused;
-                        std::string unused_string;
-                        ssValue >> fTmp >> fUnused >> unused_string;
-                        strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                           wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                        wtx.fTimeReceivedIsTxTime = fTmp;
-                    }
-                    else
-                    {
-                        strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                        wtx.fTimeReceivedIsTxTime = 0;
-                    }
-                    wss.vWalletUpgrade.push_back(hash);
-                }
-
-                if (wtx.nOrderPos == -1)
-                    wss.fAnyUnordered = true;
-
-                return true;
-            };
-            if (!pwallet->LoadToWallet(hash, fill_wtx)) {
+            if (!LoadTxRecord(pwallet, hash, ssValue, nullptr, wss, strErr)) {
                 return false;
             }
+        } else if (strType == DBKeys::ARCHIVED_TX) {
+            // Archived transactions stay on disk until they are asked for
+            uint256 hash;
+            ArchivedTxHeader header;
+            ssKey >> hash;
+            ssValue >> header;
+            if (header.nVersion > ArchivedTxHeader::CURRENT_VERSION) {
+                strErr = strprintf("Error reading wallet database: Unsupported archived transaction version %d", header.nVersion);
+                return false;
+            }
+            pwallet->LoadArchivedTx(header.order_pos, hash);
+            wss.m_archived_txs++;
+        } else if (strType == DBKeys::ARCHIVED_OUTPUT) {
+            COutPoint outpoint;
+            CTxOut txout;
+            ssKey >> outpoint;
+            ssValue >> txout;
+            pwallet->LoadArchivedOutput(outpoint, txout);
+        } else if (strType == DBKeys::ARCHIVED_SPEND) {
+            COutPoint outpoint;
+            uint256 spender;
+            ssKey >> outpoint;
+            ssValue >> spender;
+            pwallet->LoadArchivedSpend(outpoint, spender);
         } else if (strType == DBKeys::WATCHS) {
             wss.nWatchKeys++;
             CScript script;
@@ -690,12 +785,74 @@ bool WalletBatch::IsKeyType(const std::string& strType)
             strType == DBKeys::MASTER_KEY || strType == DBKeys::CRYPTED_KEY);
 }
 
+namespace {
+/** A "tx" record read from the database whose transaction is decoded before
+ *  it is inserted into the wallet. */
+struct PendingTxRecord {
+    PendingTxRecord(CDataStream&& key_in, CDataStream&& value_in) : key(std::move(key_in)), value(std::move(value_in)) {}
+    CDataStream key;
+    CDataStream value;
+    uint256 hash;
+    CTransactionRef tx;
+    std::string error;
+};
+
+bool IsTxRecord(const CDataStream& ssKey)
+{
+    static const std::vector<unsigned char> prefix = [] {
+        std::vector<unsigned char> ret;
+        CVectorWriter(SER_DISK, CLIENT_VERSION, ret, 0, DBKeys::TX);
+        return ret;
+    }();
+    return ssKey.size() > prefix.size() && std::equal(prefix.begin(), prefix.end(), ssKey.begin(), [](unsigned char a, char b) { return a == (unsigned char)b; });
+}
+
+/** Decode the transactions of pending "tx" records, spread over up to
+ *  max_threads threads. Records that fail to decode keep a null tx and the
+ *  error message. Returns the number of threads used. */
+int DecodeTxRecords(std::vector<PendingTxRecord>& records, int max_threads)
+{
+    auto decode_range = [&records](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PendingTxRecord& rec = records[i];
+            try {
+                std::string type;
+                rec.key >> type >> rec.hash;
+                rec.value >> rec.tx;
+            } catch (const std::exception& e) {
+                rec.tx.reset();
+                rec.error = e.what();
+            }
+        }
+    };
+
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(max_threads, records.size() / MIN_WALLET_LOAD_TXS_PER_THREAD));
+    const size_t chunk = (records.size() + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(decode_range, std::min(t * chunk, records.size()), std::min((t + 1) * chunk, records.size()));
+    }
+    decode_range(0, std::min(chunk, records.size()));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return threads;
+}
+} // namespace
+
 DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
 {
     CWalletScanState wss;
     bool fNoncriticalErrors = false;
     DBErrors result = DBErrors::LOAD_OK;
 
+    // Transaction records are collected while reading, decoded in parallel and
+    // linked (spends, conflicts) in one pass once all of them are in mapWallet.
+    std::vector<PendingTxRecord> tx_records;
+    int64_t time_start = GetTimeMicros();
+    int64_t time_read = 0, time_decode = 0, time_insert = 0, time_link = 0;
+    int decode_threads = 0;
+
     LOCK(pwallet->cs_wallet);
     try {
         int nMinVersion = 0;
@@ -729,6 +886,11 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
                 return DBErrors::CORRUPT;
             }
 
+            if (IsTxRecord(ssKey)) {
+                tx_records.emplace_back(std::move(ssKey), std::move(ssValue));
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             std::string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
@@ -751,6 +913,46 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 pwallet->WalletLogPrintf("%s\n", strErr);
         }
+        m_batch->CloseCursor();
+        time_read = GetTimeMicros();
+
+        decode_threads = DecodeTxRecords(tx_records, std::min(GetNumCores(), MAX_WALLET_LOAD_THREADS));
+        time_decode = GetTimeMicros();
+
+        std::vector<uint256> loaded;
+        loaded.reserve(tx_records.size());
+        for (PendingTxRecord& rec : tx_records) {
+            std::string strErr = rec.error;
+            bool ok = false;
+            if (rec.tx) {
+                try {
+                    ok = LoadTxRecord(pwallet, rec.hash, rec.value, std::move(rec.tx), wss, strErr, /* link */ false);
+                } catch (const std::exception& e) {
+                    if (strErr.empty()) strErr = e.what();
+                }
+            }
+            if (ok) {
+                loaded.push_back(rec.hash);
+            } else {
+                // Same treatment as a bad transaction record in ReadKeyValue
+                fNoncriticalErrors = true;
+                gArgs.SoftSetBoolArg("-rescan", true);
+            }
+            if (!strErr.empty())
+                pwallet->WalletLogPrintf("%s\n", strErr);
+            // Release the serialized record as soon as it is in mapWallet
+            rec.value = CDataStream(SER_DISK, CLIENT_VERSION);
+        }
+        time_insert = GetTimeMicros();
+
+        for (const uint256& hash : loaded) {
+            pwallet->LinkLoadedTx(hash);
+        }
+        time_link = GetTimeMicros();
+
+        pwallet->WalletLogPrintf("Loaded %u transaction records: read %.2fms, decode %.2fms (%d threads), insert %.2fms, link %.2fms\n",
+            tx_records.size(), 0.001 * (time_read - time_start), 0.001 * (time_decode - time_read), decode_threads,
+            0.001 * (time_insert - time_decode), 0.001 * (time_link - time_insert));
     } catch (...) {
         result = DBErrors::CORRUPT;
     }
@@ -798,6 +1000,9 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
 
     pwallet->WalletLogPrintf("Keys: %u plaintext, %u encrypted, %u w/ metadata, %u total. Unknown wallet records: %u\n",
            wss.nKeys, wss.nCKeys, wss.nKeyMeta, wss.nKeys + wss.nCKeys, wss.m_unknown_records);
+    if (wss.m_archived_txs > 0) {
+        pwallet->WalletLogPrintf("Archived transactions: %u, not loaded\n", wss.m_archived_txs);
+    }
 
     // nTimeFirstKey is only reliable if all keys have metadata
     if (pwallet->IsLegacy() && (wss.nKeys + wss.nCKeys + wss.nWatchKeys) != wss.nKeyMeta) {
@@ -935,6 +1140,13 @@ DBErrors WalletBatch::ZapSelectTx(std::vector<uint256>& vTxHashIn, std::vector<u
     return DBErrors::LOAD_OK;
 }
 
+void MaybeCommitWalletWrites()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
+        pwallet->GetDBHandle().CommitPending(/* expired_only */ true);
+    }
+}
+
 void MaybeCompactWalletDB()
 {
     static std::atomic<bool> fOneThread(false);
@@ -30,11 +30,17 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Maximum number of threads decoding transaction records during wallet load
+static const int MAX_WALLET_LOAD_THREADS = 8;
+//! Don't start another decoding thread for fewer transaction records than this
+static const unsigned int MIN_WALLET_LOAD_TXS_PER_THREAD = 1000;
 
 struct CBlockLocator;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
+class CTxOut;
 class CWallet;
 class CWalletTx;
 class uint160;
@@ -55,6 +61,9 @@ namespace DBKeys {
 extern const std::string ACENTRY;
 extern const std::string ACTIVEEXTERNALSPK;
 extern const std::string ACTIVEINTERNALSPK;
+extern const std::string ARCHIVED_OUTPUT;
+extern const std::string ARCHIVED_SPEND;
+extern const std::string ARCHIVED_TX;
 extern const std::string BESTBLOCK;
 extern const std::string BESTBLOCK_NOMERKLE;
 extern const std::string CRYPTED_KEY;
@@ -167,6 +176,23 @@ public:
     }
 };
 
+/**
+ * Leading part of an "archivedtx" record, readable without decoding the
+ * transaction that follows it in the same format as a "tx" record. Any change
+ * to the record bumps nVersion, so that software which cannot read it skips it.
+ */
+struct ArchivedTxHeader
+{
+    static const int CURRENT_VERSION = 1;
+    int nVersion{CURRENT_VERSION};
+    int64_t order_pos{0};
+    //! Debits of the transaction, computed while the transactions it spends were still in the wallet
+    CAmount debit_mine{0};
+    CAmount debit_watchonly{0};
+
+    SERIALIZE_METHODS(ArchivedTxHeader, obj) { READWRITE(obj.nVersion, obj.order_pos, obj.debit_mine, obj.debit_watchonly); }
+};
+
 /** Access to the wallet database.
  * Opens the database and provides read and write access to it. Each read and write is its own transaction.
  * Multiple operation transactions can be started using TxnBegin() and committed using TxnCommit()
@@ -221,6 +247,15 @@ public:
     bool WriteTx(const CWalletTx& wtx);
     bool EraseTx(uint256 hash);
 
+    bool WriteArchivedTx(const ArchivedTxHeader& header, const CWalletTx& wtx);
+    bool ReadArchivedTx(const uint256& hash, ArchivedTxHeader& header, CWalletTx& wtx);
+    bool ReadArchivedTxHeader(const uint256& hash, ArchivedTxHeader& header);
+    bool EraseArchivedTx(const uint256& hash);
+    bool WriteArchivedOutput(const COutPoint& outpoint, const CTxOut& txout);
+    bool EraseArchivedOutput(const COutPoint& outpoint);
+    bool WriteArchivedSpend(const COutPoint& outpoint, const uint256& spender);
+    bool EraseArchivedSpend(const COutPoint& outpoint);
+
     bool WriteKeyMetadata(const CKeyMetadata& meta, const CPubKey& pubkey, const bool overwrite);
     bool WriteKey(const CPubKey& vchPubKey, const CPrivKey& vchPrivKey, const CKeyMetadata &keyMeta);
     bool WriteCryptedKey(const CPubKey& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret, const CKeyMetadata &keyMeta);
@@ -279,6 +314,9 @@ private:
 //! Compacts BDB state so that wallet.dat is self-contained (if there are changes)
 void MaybeCompactWalletDB();
 
+//! Commits writes grouped by -walletcommitinterval once the interval has elapsed
+void MaybeCommitWalletWrites();
+
 //! Callback for filtering key types to deserialize in ReadKeyValue
 using KeyFilterFn = std::function<bool(const std::string&)>;
 
@@ -2,8 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chainparams.h>
 #include <fs.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <wallet/salvage.h>
 #include <wallet/wallet.h>
@@ -105,6 +107,79 @@ static void WalletShowInfo(CWallet* wallet_instance)
     tfm::format(std::cout, "Address Book: %zu\n", wallet_instance->m_address_book.size());
 }
 
+static std::unique_ptr<WalletDatabase> OpenDatabase(const fs::path& path, DatabaseOptions options)
+{
+    DatabaseStatus status;
+    bilingual_str error;
+    std::unique_ptr<WalletDatabase> database = MakeDatabase(path, options, status, error);
+    if (!database) {
+        tfm::format(std::cerr, "%s\n", error.original);
+    }
+    return database;
+}
+
+static double ElapsedSeconds(int64_t start_micros)
+{
+    return std::max<int64_t>(GetTimeMicros() - start_micros, 1) / 1000000.0;
+}
+
+static bool WalletCompact(const fs::path& path)
+{
+    DatabaseOptions options;
+    options.require_existing = true;
+    std::unique_ptr<WalletDatabase> database = OpenDatabase(path, options);
+    if (!database) return false;
+
+    const fs::path file = database->Filename();
+    const uint64_t size_before = fs::file_size(file);
+    const int64_t start = GetTimeMicros();
+    // Rewriting copies every record into a new file (BDB) or VACUUMs it (SQLite), dropping free pages
+    if (!database->Rewrite()) {
+        tfm::format(std::cerr, "Failed to compact %s\n", file.string());
+        return false;
+    }
+    database->Close();
+    const double elapsed = ElapsedSeconds(start);
+    const uint64_t size_after = fs::file_size(file);
+
+    tfm::format(std::cout, "Compacted %s database %s: %u -> %u bytes in %.3fs (%.2f MiB/s)\n",
+        database->Format(), file.string(), size_before, size_after, elapsed, size_before / elapsed / (1024 * 1024));
+    return true;
+}
+
+static bool WalletPruneStakeHistory(const std::string& name, const fs::path& path)
+{
+    std::shared_ptr<CWallet> wallet_instance = MakeWallet(name, path, /* create= */ false);
+    if (!wallet_instance) return false;
+
+    bool ret;
+    {
+        LOCK(wallet_instance->cs_wallet);
+        // There is no chain to ask for heights, so estimate the depth from
+        // the block times of the newest transaction the wallet has seen
+        int64_t newest_time = 0;
+        for (const auto& entry : wallet_instance->mapWallet) {
+            if (entry.second.isConfirmed()) newest_time = std::max<int64_t>(newest_time, entry.second.nTimeSmart);
+        }
+        const size_t txs_before = wallet_instance->mapWallet.size();
+        const int64_t max_time = newest_time - gArgs.GetArg("-stakearchivedepth", DEFAULT_STAKE_ARCHIVE_DEPTH) * Params().GetConsensus().nPowTargetSpacing;
+        auto is_buried = [max_time](const CWalletTx& wtx) { return wtx.nTimeSmart <= max_time; };
+
+        const int64_t start = GetTimeMicros();
+        const int archived = wallet_instance->ArchiveStakeHistory(is_buried);
+        const double elapsed = ElapsedSeconds(start);
+        ret = archived >= 0;
+        if (ret) {
+            tfm::format(std::cout, "Archived %d of %u transactions with block times up to %s in %.3fs (%.0f transactions/s)\n",
+                archived, txs_before, FormatISO8601DateTime(std::max<int64_t>(max_time, 0)), elapsed, archived / elapsed);
+        } else {
+            tfm::format(std::cerr, "Failed to archive the stake history of %s\n", name);
+        }
+    }
+    wallet_instance->Close();
+    return ret;
+}
+
 bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
 {
     fs::path path = fs::absolute(name, GetWalletDir());
@@ -135,6 +210,10 @@ bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
             }
             return ret;
         }
+    } else if (command == "compact") {
+        return WalletCompact(path);
+    } else if (command == "prune-stake-history") {
+        return WalletPruneStakeHistory(name, path);
     } else {
         tfm::format(std::cerr, "Invalid command: %s\n", command);
         return false;
@@ -206,7 +206,7 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     {
         LOCK(cs_main);
         CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if(!ReadBlockFromDisk(block, pindex, consensusParams, /* tx_arena */ true))
         {
             zmqError("Can't read block from disk");
             return false;
@@ -6,12 +6,16 @@
 
 import hashlib
 import os
+import re
 import stat
 import subprocess
 import textwrap
 
 from test_framework.test_framework import XEPTestFramework
-from test_framework.util import assert_equal
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+)
 
 BUFFER_SIZE = 16 * 1024
 
@@ -255,6 +259,56 @@ class ToolWalletTest(XEPTestFramework):
 
         self.assert_tool_output('', '-wallet=salvage', 'salvage')
 
+    def assert_tool_output_matches(self, pattern, *args):
+        p = self.xep_wallet_process(*args)
+        stdout, stderr = p.communicate()
+        assert_equal(stderr, '')
+        assert_equal(p.poll(), 0)
+        match = re.match(pattern, stdout)
+        assert match, stdout
+        return match
+
+    def test_compact(self):
+        self.log.info('Check compact')
+        self.start_node(0)
+        walletinfo_before = self.nodes[0].getwalletinfo()
+        self.stop_node(0)
+
+        fmt = 'sqlite' if self.options.descriptors else 'bdb'
+        match = self.assert_tool_output_matches(r'Compacted {} database .*: (\d+) -> (\d+) bytes in '.format(fmt), '-wallet=' + self.default_wallet_name, 'compact')
+        assert_greater_than(int(match.group(1)), 0)
+        assert_greater_than(int(match.group(2)), 0)
+
+        self.start_node(0)
+        walletinfo_after = self.nodes[0].getwalletinfo()
+        self.stop_node(0)
+        for key in ['txcount', 'keypoolsize', 'balance', 'immature_balance']:
+            assert_equal(walletinfo_after[key], walletinfo_before[key])
+
+    def test_prune_stake_history(self):
+        self.log.info('Check prune-stake-history')
+        self.start_node(0)
+        node = self.nodes[0]
+        # Spend every mature coinbase, so that they can be archived
+        coinbase_txid = node.getblock(node.getblockhash(1))['tx'][0]
+        node.generate(101)
+        node.sendtoaddress(node.getnewaddress(), node.getbalance(), '', '', True)
+        node.generate(1)
+        balances_before = node.getbalances()
+        txs_before = node.listtransactions('*', 1000)
+        self.stop_node(0)
+
+        match = self.assert_tool_output_matches(r'Archived (\d+) of (\d+) transactions with block times up to ', '-wallet=' + self.default_wallet_name, '-stakearchivedepth=0', 'prune-stake-history')
+        assert_greater_than(int(match.group(1)), 0)
+        assert_greater_than(int(match.group(2)), int(match.group(1)))
+
+        self.start_node(0)
+        assert_equal(node.getbalances(), balances_before)
+        assert_equal(node.gettransaction(coinbase_txid)['archived'], True)
+        txs_after = node.listtransactions('*', 1000)
+        assert_equal(len(txs_after), len(txs_before))
+        self.stop_node(0)
+
     def run_test(self):
         self.wallet_path = os.path.join(self.nodes[0].datadir, self.chain, 'wallets', self.default_wallet_name, self.wallet_data_filename)
         self.test_invalid_tool_commands_and_args()
@@ -267,6 +321,8 @@ class ToolWalletTest(XEPTestFramework):
             self.test_getwalletinfo_on_different_wallet()
             # Salvage is a legacy wallet only thing
             self.test_salvage()
+        self.test_compact()
+        self.test_prune_stake_history()
 
 if __name__ == '__main__':
     ToolWalletTest().main()